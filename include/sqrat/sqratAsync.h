@@ -0,0 +1,400 @@
+//
+// SqratAsync: suspending Squirrel threads and resuming them when work finishes elsewhere
+//
+
+//
+// Copyright (c) 2009 Brandon Jones
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software. If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+#if !defined(_SCRAT_ASYNC_H_)
+#define _SCRAT_ASYNC_H_
+
+#include <squirrel.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include "sqratUtil.h"
+
+namespace Sqrat {
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Pushes the result of asynchronous work onto the stack of the Squirrel thread that waited for it
+///
+/// \param thread Squirrel thread that is about to be resumed
+/// \param errMsg Filled with an error message to raise in the thread instead of returning a value
+///
+/// \return True if exactly one value was pushed, false to raise errMsg in the thread
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+typedef std::function<bool (HSQUIRRELVM thread, string& errMsg)> AsyncResult;
+
+/// @cond DEV
+struct AsyncInbox {
+    struct Completion {
+        HSQUIRRELVM thread;
+        HSQOBJECT   threadObj;
+        AsyncResult result;
+    };
+
+    std::mutex              lock;
+    std::condition_variable posted;
+    std::deque<Completion>  completions;
+};
+/// @endcond
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Handle to a parked Squirrel thread that resumes it once the work it waits for has completed
+///
+/// \remarks
+/// Tickets may be copied and completed from any OS thread, but only the first Complete has an effect. If the VM has been
+/// closed in the meantime the completion is silently dropped.
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class AsyncTicket {
+public:
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Constructs an invalid ticket
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    AsyncTicket() : m_thread(NULL) {
+        sq_resetobject(&m_threadObj);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Checks whether the ticket refers to a parked thread
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool IsValid() const {
+        return m_inbox.get() != NULL;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the parked Squirrel thread
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    HSQUIRRELVM GetThread() const {
+        return m_thread;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Queues the thread to be resumed with a result (may be called from any OS thread)
+    ///
+    /// \param result Called on the VM's OS thread to push the value the suspended call returns (empty means null)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Complete(const AsyncResult& result) const {
+        std::shared_ptr<AsyncInbox> inbox = m_inbox;
+        if (inbox.get() == NULL || m_completed->exchange(true)) {
+            return;
+        }
+        AsyncInbox::Completion completion;
+        completion.thread    = m_thread;
+        completion.threadObj = m_threadObj;
+        completion.result    = result;
+        {
+            std::lock_guard<std::mutex> lock(inbox->lock);
+            inbox->completions.push_back(completion);
+        }
+        inbox->posted.notify_all();
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Queues the thread to be resumed with an error raised at the suspended call (may be called from any OS thread)
+    ///
+    /// \param errMsg Error message
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Fail(const string& errMsg) const {
+        Complete([errMsg](HSQUIRRELVM, string& err) { err = errMsg; return false; });
+    }
+
+private:
+
+    friend class AsyncQueue;
+
+    std::shared_ptr<AsyncInbox>        m_inbox;
+    std::shared_ptr<std::atomic<bool> > m_completed;
+    HSQUIRRELVM                        m_thread;
+    HSQOBJECT                          m_threadObj;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Completion queue shared by all Squirrel threads of a VM
+///
+/// \remarks
+/// A native function that cannot finish right away calls Park and returns the result of sq_suspendvm. Whoever finishes
+/// the work completes the ticket, possibly on another OS thread, and the next Drain on the VM's OS thread pushes the
+/// result and wakes the Squirrel thread up. Drain is called by the sqratthread scheduler between quanta; hosts that run
+/// their own loop must call it themselves.
+///
+/// \remarks
+/// Only threads that something will resume may be suspended. By default every Squirrel thread but the VM the queue was
+/// created for counts as suspendable (see IsSuspendable), so natives called straight from the host block instead.
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class AsyncQueue {
+public:
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the queue of a VM, creating it the first time (the queue lives in the registry until the VM is closed)
+    ///
+    /// \param vm The VM (not a thread of it) when called for the first time
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static AsyncQueue* Get(HSQUIRRELVM vm) {
+        AsyncQueue* queue = Find(vm);
+        if (queue == NULL) {
+            sq_pushregistrytable(vm);
+            sq_pushstring(vm, RegistryKey(), -1);
+            AsyncQueue** ud = reinterpret_cast<AsyncQueue**>(sq_newuserdata(vm, sizeof(AsyncQueue*)));
+            *ud = queue = new AsyncQueue(vm);
+            sq_setreleasehook(vm, -1, &release);
+            sq_rawset(vm, -3);
+            sq_pushstring(vm, DrainKey(), -1);
+            sq_newclosure(vm, &drain, 0);
+            sq_rawset(vm, -3);
+            sq_pop(vm, 1);
+        }
+        return queue;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the queue of a VM without creating it
+    ///
+    /// \return The queue or NULL if Get has never been called for the VM
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static AsyncQueue* Find(HSQUIRRELVM vm) {
+        AsyncQueue* queue = NULL;
+        sq_pushregistrytable(vm);
+        sq_pushstring(vm, RegistryKey(), -1);
+        if (SQ_SUCCEEDED(sq_rawget(vm, -2))) {
+            SQUserPointer ud;
+            if (SQ_SUCCEEDED(sq_getuserdata(vm, -1, &ud, NULL))) {
+                queue = *reinterpret_cast<AsyncQueue**>(ud);
+            }
+            sq_pop(vm, 1);
+        }
+        sq_pop(vm, 1);
+        return queue;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Name of the registry slot that holds the queue (for modules that look it up through the HSQAPI table)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static const SQChar* RegistryKey() {
+        return _SC("__sqrat_asyncqueue__");
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Name of the registry slot that holds a native closure calling Drain and returning its result
+    ///
+    /// \remarks
+    /// Modules cannot call Drain directly since it uses the Squirrel API, so they call this closure instead.
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static const SQChar* DrainKey() {
+        return _SC("__sqrat_asyncdrain__");
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Checks whether a Squirrel thread may be suspended by an asynchronous native
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool IsSuspendable(HSQUIRRELVM thread) const {
+        std::map<HSQUIRRELVM, bool>::const_iterator it = m_suspendable.find(thread);
+        if (it != m_suspendable.end()) {
+            return it->second;
+        }
+        return thread != m_root;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Overrides whether a Squirrel thread may be suspended by an asynchronous native
+    ///
+    /// \param thread      Squirrel thread
+    /// \param suspendable True if the host will Drain the queue and resume the thread, false to make natives block
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void SetSuspendable(HSQUIRRELVM thread, bool suspendable) {
+        m_suspendable[thread] = suspendable;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Parks a Squirrel thread until its ticket is completed
+    ///
+    /// \param thread Thread running the native function (the native must return sq_suspendvm(thread) right after)
+    ///
+    /// \return Ticket that resumes the thread
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    AsyncTicket Park(HSQUIRRELVM thread) {
+        AsyncTicket ticket;
+        ticket.m_inbox     = m_inbox;
+        ticket.m_completed = std::make_shared<std::atomic<bool> >(false);
+        ticket.m_thread    = thread;
+        // keep the thread alive while it waits, nothing else may reference it
+        sq_pushthread(thread, thread);
+        sq_getstackobj(thread, -1, &ticket.m_threadObj);
+        sq_addref(thread, &ticket.m_threadObj);
+        sq_pop(thread, 1);
+        m_parked.insert(thread);
+        return ticket;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Checks whether a Squirrel thread is parked waiting for a completion
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool IsParked(HSQUIRRELVM thread) const {
+        return m_parked.find(thread) != m_parked.end();
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the number of parked Squirrel threads
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    size_t GetParkedCount() const {
+        return m_parked.size();
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Resumes every thread whose ticket has been completed (must be called on the VM's OS thread)
+    ///
+    /// \return Number of threads resumed
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    size_t Drain() {
+        std::deque<AsyncInbox::Completion> completions;
+        {
+            std::lock_guard<std::mutex> lock(m_inbox->lock);
+            completions.swap(m_inbox->completions);
+        }
+        for (size_t i = 0; i < completions.size(); ++i) {
+            m_parked.erase(completions[i].thread);
+            if (m_trackResumed) {
+                m_resumed.push_back(completions[i].thread);
+            }
+            resume(completions[i]);
+        }
+        return completions.size();
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Makes Drain remember the threads it resumes, for schedulers that need to requeue them (see TakeResumed)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void TrackResumed(bool track) {
+        m_trackResumed = track;
+        if (!track) {
+            m_resumed.clear();
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Moves the threads resumed since the last call into a vector (only filled while TrackResumed is on)
+    ///
+    /// \param resumed Receives the threads, in the order they were resumed
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void TakeResumed(std::vector<HSQUIRRELVM>& resumed) {
+        resumed.clear();
+        resumed.swap(m_resumed);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Blocks until a ticket is completed or the timeout expires (does not resume anything, call Drain afterwards)
+    ///
+    /// \param timeout Longest time to wait
+    ///
+    /// \return True if completions are waiting to be drained
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool Wait(std::chrono::nanoseconds timeout) {
+        std::unique_lock<std::mutex> lock(m_inbox->lock);
+        if (m_inbox->completions.empty()) {
+            m_inbox->posted.wait_for(lock, timeout);
+        }
+        return !m_inbox->completions.empty();
+    }
+
+private:
+
+    AsyncQueue(HSQUIRRELVM root) : m_root(root), m_inbox(std::make_shared<AsyncInbox>()), m_trackResumed(false) {
+    }
+
+    static SQInteger drain(HSQUIRRELVM vm) {
+        AsyncQueue* queue = Find(vm);
+        sq_pushinteger(vm, queue != NULL ? static_cast<SQInteger>(queue->Drain()) : 0);
+        return 1;
+    }
+
+    static SQInteger release(SQUserPointer ptr, SQInteger /*size*/) {
+        // threads still parked go down with the VM, so their references are not released here
+        delete *reinterpret_cast<AsyncQueue**>(ptr);
+        return 0;
+    }
+
+    void resume(AsyncInbox::Completion& completion) {
+        HSQUIRRELVM thread = completion.thread;
+        if (sq_getvmstate(thread) == SQ_VMSTATE_SUSPENDED) {
+            string errMsg;
+            SQInteger top = sq_gettop(thread);
+            bool pushed = true;
+            if (completion.result) {
+                pushed = completion.result(thread, errMsg);
+            } else {
+                sq_pushnull(thread);
+            }
+            if (pushed) {
+                sq_wakeupvm(thread, SQTrue, SQFalse, SQTrue, SQFalse);
+            } else {
+                sq_settop(thread, top);
+                sq_throwerror(thread, errMsg.c_str());
+                sq_wakeupvm(thread, SQFalse, SQFalse, SQTrue, SQTrue);
+            }
+        }
+        // released through the VM itself as this may be the last reference to the thread
+        sq_release(m_root, &completion.threadObj);
+    }
+
+    HSQUIRRELVM                 m_root;
+    std::shared_ptr<AsyncInbox> m_inbox;
+    std::set<HSQUIRRELVM>       m_parked;
+    std::map<HSQUIRRELVM, bool> m_suspendable;
+    std::vector<HSQUIRRELVM>    m_resumed;
+    bool                        m_trackResumed;
+};
+
+}
+
+#endif
@@ -0,0 +1,770 @@
+//
+// SqratAsyncMethods: Asynchronous Function Binding
+//
+
+//
+// Copyright (c) 2009 Brandon Jones
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software. If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+#if !defined(_SCRAT_ASYNC_METHODS_H_)
+#define _SCRAT_ASYNC_METHODS_H_
+
+#include <squirrel.h>
+#include <condition_variable>
+#include <exception>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+
+#include "sqratAsync.h"
+#include "sqratThreadPool.h"
+#include "sqratTypes.h"
+
+namespace Sqrat {
+
+/// @cond DEV
+// Shared by the copies of an AsyncCallback and the native that is waiting for it
+struct AsyncCallState {
+    AsyncCallState() : completed(false) {
+    }
+
+    // Completes the parked thread's ticket, or keeps the result for a caller that has not parked (yet)
+    void Finish(const AsyncResult& outcome) {
+        AsyncTicket parked;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (completed) {
+                return;
+            }
+            completed = true;
+            if (!ticket.IsValid()) {
+                result = outcome;
+                done.notify_all();
+                return;
+            }
+            parked = ticket;
+        }
+        parked.Complete(outcome);
+    }
+
+    std::mutex              lock;
+    std::condition_variable done;
+    AsyncTicket             ticket;    // Set once the calling thread has been parked
+    AsyncResult             result;    // Outcome of a call that finished before its thread was parked
+    bool                    completed;
+};
+/// @endcond
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Completion callback handed to functions bound with AsyncFunc that report their result through a callback
+///
+/// \tparam R Type of the result (void if there is none)
+///
+/// \remarks
+/// The callback must be the first parameter of the bound function. It may be copied and called from any OS thread, but
+/// only the first call (or Fail) has an effect. A callback that is never called leaves the script waiting forever.
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+template <class R>
+class AsyncCallback {
+public:
+
+    /// @cond DEV
+    AsyncCallback() : m_state(std::make_shared<AsyncCallState>()) {
+    }
+    /// @endcond
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Completes the call with a result
+    ///
+    /// \param value Value the script receives
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void operator()(const R& value) const {
+        m_state->Finish([value](HSQUIRRELVM thread, string&) {
+            PushVar(thread, value);
+            return true;
+        });
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Completes the call with an error raised in the script
+    ///
+    /// \param errMsg Error message
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Fail(const string& errMsg) const {
+        m_state->Finish([errMsg](HSQUIRRELVM, string& err) { err = errMsg; return false; });
+    }
+
+    /// @cond DEV
+    const std::shared_ptr<AsyncCallState>& GetState() const {
+        return m_state;
+    }
+    /// @endcond
+
+private:
+
+    std::shared_ptr<AsyncCallState> m_state;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Completion callback for bound asynchronous functions without a result
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+template <>
+class AsyncCallback<void> {
+public:
+
+    /// @cond DEV
+    AsyncCallback() : m_state(std::make_shared<AsyncCallState>()) {
+    }
+    /// @endcond
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Completes the call (the script receives null)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void operator()() const {
+        m_state->Finish(AsyncResult());
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Completes the call with an error raised in the script
+    ///
+    /// \param errMsg Error message
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Fail(const string& errMsg) const {
+        m_state->Finish([errMsg](HSQUIRRELVM, string& err) { err = errMsg; return false; });
+    }
+
+    /// @cond DEV
+    const std::shared_ptr<AsyncCallState>& GetState() const {
+        return m_state;
+    }
+    /// @endcond
+
+private:
+
+    std::shared_ptr<AsyncCallState> m_state;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Marks a class whose const member functions may run on the shared ThreadPool (see Class::OffloadFunc)
+///
+/// \tparam C Class to mark, e.g. template <> struct OffloadSafe<Index> { static const bool value = true; };
+///
+/// \remarks
+/// Only mark a class whose const member functions are safe to run while its instance is used from the VM's thread.
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+template <class C>
+struct OffloadSafe {
+    static const bool value = false;
+};
+
+/// @cond DEV
+
+// Reads the arguments of a call in place (Var objects may own references and cannot be copied)
+template <class... A>
+struct AsyncArgs;
+
+template <>
+struct AsyncArgs<> {
+    AsyncArgs(HSQUIRRELVM /*vm*/, SQInteger /*idx*/) {}
+
+    template <class R, class F, class... V>
+    R Apply(F& call, V&... values) {
+        return call(values...);
+    }
+};
+
+template <class A1, class... A>
+struct AsyncArgs<A1, A...> {
+    Var<A1>         head;
+    AsyncArgs<A...> tail;
+
+    AsyncArgs(HSQUIRRELVM vm, SQInteger idx) : head(vm, idx), tail(vm, idx + 1) {}
+
+    template <class R, class F, class... V>
+    R Apply(F& call, V&... values) {
+        return tail.template Apply<R>(call, values..., head.value);
+    }
+};
+
+// Turns whatever a bound function threw into an error message
+inline string AsyncErrorMessage(std::exception_ptr error) {
+#ifdef SCRAT_HAS_CXX_EXCEPTIONS
+    try {
+        std::rethrow_exception(error);
+    } catch (const Exception& e) {
+        return e.Message();
+    } catch (const std::exception& e) {
+#ifdef SQUNICODE
+        return string_to_wstring(e.what());
+#else
+        return e.what();
+#endif
+    } catch (...) {
+    }
+#else
+    SQUNUSED(error);
+#endif
+    return _SC("asynchronous call failed");
+}
+
+// Pushes the outcome of a finished future
+template <class R>
+struct AsyncOutcome {
+    static bool Push(HSQUIRRELVM vm, std::future<R>& future, string& errMsg) {
+        SQTRY_ANY()
+            R value = future.get();
+            PushVar(vm, value);
+            return true;
+        SQCATCH_ANY() {
+            errMsg = AsyncErrorMessage(std::current_exception());
+        }
+        return false;
+    }
+};
+
+template <>
+struct AsyncOutcome<void> {
+    static bool Push(HSQUIRRELVM vm, std::future<void>& future, string& errMsg) {
+        SQTRY_ANY()
+            future.get();
+            sq_pushnull(vm);
+            return true;
+        SQCATCH_ANY() {
+            errMsg = AsyncErrorMessage(std::current_exception());
+        }
+        return false;
+    }
+};
+
+// Returns the result of a future to the script, suspending the calling thread if it is not ready and may be suspended
+// (a future cannot signal that it is ready, so a thread of its own waits for it and completes the ticket)
+template <class R>
+inline SQInteger AsyncAwait(HSQUIRRELVM vm, std::future<R>& future) {
+    if (!future.valid()) {
+        return sq_throwerror(vm, _SC("asynchronous call returned an invalid future"));
+    }
+    if (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        AsyncQueue* queue = AsyncQueue::Get(vm);
+        if (queue->IsSuspendable(vm)) {
+            AsyncTicket ticket = queue->Park(vm);
+            std::shared_ptr<std::future<R> > pending = std::make_shared<std::future<R> >(std::move(future));
+            std::thread([ticket, pending]() {
+                pending->wait();
+                ticket.Complete([pending](HSQUIRRELVM thread, string& errMsg) {
+                    return AsyncOutcome<R>::Push(thread, *pending, errMsg);
+                });
+            }).detach();
+            return sq_suspendvm(vm);
+        }
+    }
+    // ready, or nothing would resume the caller: wait right here
+    string errMsg;
+    if (!AsyncOutcome<R>::Push(vm, future, errMsg)) {
+        return sq_throwerror(vm, errMsg.c_str());
+    }
+    return 1;
+}
+
+// Returns the result of an AsyncCallback to the script, suspending the calling thread if it has not been called yet
+// and the thread may be suspended (the callback then completes the ticket itself)
+inline SQInteger AsyncAwait(HSQUIRRELVM vm, const std::shared_ptr<AsyncCallState>& state) {
+    AsyncQueue* queue = AsyncQueue::Get(vm);
+    std::unique_lock<std::mutex> lock(state->lock);
+    if (!state->completed && queue->IsSuspendable(vm)) {
+        state->ticket = queue->Park(vm);
+        return sq_suspendvm(vm);
+    }
+    // called already, or nothing would resume the caller: wait right here
+    while (!state->completed) {
+        state->done.wait(lock);
+    }
+    AsyncResult result = state->result;
+    lock.unlock();
+    if (!result) {
+        sq_pushnull(vm);
+        return 1;
+    }
+    string errMsg;
+    SQInteger top = sq_gettop(vm);
+    if (!result(vm, errMsg)) {
+        sq_settop(vm, top);
+        return sq_throwerror(vm, errMsg.c_str());
+    }
+    return 1;
+}
+
+template <class F>
+struct AsyncGlobalCall {
+    F method;
+
+    template <class... V>
+    auto operator()(V&... values) -> decltype(method(values...)) {
+        return method(values...);
+    }
+};
+
+template <class C, class F>
+struct AsyncMemberCall {
+    C* ptr;
+    F  method;
+
+    template <class... V>
+    auto operator()(V&... values) -> decltype((ptr->*method)(values...)) {
+        return (ptr->*method)(values...);
+    }
+};
+
+//
+// Squirrel Asynchronous Global Functions
+//
+template <class R, class... A>
+class SqAsyncGlobal {
+public:
+
+    // Returns a future
+    static SQInteger Future(HSQUIRRELVM vm) {
+
+#if !defined (SCRAT_NO_ERROR_CHECKING)
+        if (sq_gettop(vm) != static_cast<SQInteger>(sizeof...(A)) + 2) {
+            return sq_throwerror(vm, _SC("wrong number of parameters"));
+        }
+#endif
+
+        typedef std::future<R> (*M)(A...);
+        M* method;
+        sq_getuserdata(vm, -1, (SQUserPointer*)&method, NULL);
+
+        SQTRY()
+        AsyncArgs<A...> args(vm, 2);
+        SQCATCH_NOEXCEPT(vm) {
+            return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
+        }
+        AsyncGlobalCall<M> call = {*method};
+        std::future<R> future = args.template Apply<std::future<R> >(call);
+        SQCATCH_NOEXCEPT(vm) {
+            return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
+        }
+        return AsyncAwait(vm, future);
+        SQCATCH(vm) {
+            return sq_throwerror(vm, SQWHAT(vm));
+        }
+    }
+
+    // Takes an AsyncCallback as its first parameter
+    static SQInteger Callback(HSQUIRRELVM vm) {
+
+#if !defined (SCRAT_NO_ERROR_CHECKING)
+        if (sq_gettop(vm) != static_cast<SQInteger>(sizeof...(A)) + 2) {
+            return sq_throwerror(vm, _SC("wrong number of parameters"));
+        }
+#endif
+
+        typedef void (*M)(AsyncCallback<R>, A...);
+        M* method;
+        sq_getuserdata(vm, -1, (SQUserPointer*)&method, NULL);
+
+        SQTRY()
+        AsyncArgs<A...> args(vm, 2);
+        SQCATCH_NOEXCEPT(vm) {
+            return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
+        }
+        AsyncCallback<R> done;
+        AsyncGlobalCall<M> call = {*method};
+        args.template Apply<void>(call, done);
+        SQCATCH_NOEXCEPT(vm) {
+            return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
+        }
+        return AsyncAwait(vm, done.GetState());
+        SQCATCH(vm) {
+            return sq_throwerror(vm, SQWHAT(vm));
+        }
+    }
+};
+
+//
+// Squirrel Asynchronous Member Functions
+//
+template <class C, class M, class R, class... A>
+class SqAsyncMember {
+public:
+
+    // Returns a future
+    static SQInteger Future(HSQUIRRELVM vm) {
+
+#if !defined (SCRAT_NO_ERROR_CHECKING)
+        if (sq_gettop(vm) != static_cast<SQInteger>(sizeof...(A)) + 2) {
+            return sq_throwerror(vm, _SC("wrong number of parameters"));
+        }
+#endif
+
+        M* methodPtr;
+        sq_getuserdata(vm, -1, (SQUserPointer*)&methodPtr, NULL);
+
+        C* ptr;
+        SQTRY()
+        ptr = Var<C*>(vm, 1).value;
+        SQCATCH_NOEXCEPT(vm) {
+            return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
+        }
+        SQCATCH(vm) {
+            return sq_throwerror(vm, SQWHAT(vm));
+        }
+
+        SQTRY()
+        AsyncArgs<A...> args(vm, 2);
+        SQCATCH_NOEXCEPT(vm) {
+            return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
+        }
+        AsyncMemberCall<C, M> call = {ptr, *methodPtr};
+        std::future<R> future = args.template Apply<std::future<R> >(call);
+        SQCATCH_NOEXCEPT(vm) {
+            return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
+        }
+        return AsyncAwait(vm, future);
+        SQCATCH(vm) {
+            return sq_throwerror(vm, SQWHAT(vm));
+        }
+    }
+
+    // Takes an AsyncCallback as its first parameter
+    static SQInteger Callback(HSQUIRRELVM vm) {
+
+#if !defined (SCRAT_NO_ERROR_CHECKING)
+        if (sq_gettop(vm) != static_cast<SQInteger>(sizeof...(A)) + 2) {
+            return sq_throwerror(vm, _SC("wrong number of parameters"));
+        }
+#endif
+
+        M* methodPtr;
+        sq_getuserdata(vm, -1, (SQUserPointer*)&methodPtr, NULL);
+
+        C* ptr;
+        SQTRY()
+        ptr = Var<C*>(vm, 1).value;
+        SQCATCH_NOEXCEPT(vm) {
+            return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
+        }
+        SQCATCH(vm) {
+            return sq_throwerror(vm, SQWHAT(vm));
+        }
+
+        SQTRY()
+        AsyncArgs<A...> args(vm, 2);
+        SQCATCH_NOEXCEPT(vm) {
+            return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
+        }
+        AsyncCallback<R> done;
+        AsyncMemberCall<C, M> call = {ptr, *methodPtr};
+        args.template Apply<void>(call, done);
+        SQCATCH_NOEXCEPT(vm) {
+            return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
+        }
+        return AsyncAwait(vm, done.GetState());
+        SQCATCH(vm) {
+            return sq_throwerror(vm, SQWHAT(vm));
+        }
+    }
+};
+
+//
+// Offloaded Function Support
+//
+
+// Owned copy of an argument that can travel to another OS thread
+template <class A>
+struct OffloadArg {
+    typedef typename std::remove_cv<typename std::remove_reference<A>::type>::type Type;
+
+    static Type& Pass(Type& value) {
+        return value;
+    }
+};
+
+template <>
+struct OffloadArg<const SQChar*> {
+    typedef string Type;
+
+    static const SQChar* Pass(Type& value) {
+        return value.c_str();
+    }
+};
+
+template <size_t... I>
+struct OffloadIndices {};
+
+template <size_t N, size_t... I>
+struct MakeOffloadIndices : MakeOffloadIndices<N - 1, N - 1, I...> {};
+
+template <size_t... I>
+struct MakeOffloadIndices<0, I...> {
+    typedef OffloadIndices<I...> Type;
+};
+
+template <class... A>
+struct OffloadArgs {
+    typedef std::tuple<typename OffloadArg<A>::Type...> Tuple;
+
+    // Copies the values read by AsyncArgs
+    struct Pack {
+        template <class... V>
+        Tuple operator()(V&... values) {
+            return Tuple(values...);
+        }
+    };
+
+    template <class R, class M, size_t... I>
+    static R Call(M method, Tuple& args, OffloadIndices<I...>) {
+        return (*method)(OffloadArg<A>::Pass(std::get<I>(args))...);
+    }
+
+    template <class R, class C, class M, size_t... I>
+    static R Call(C* ptr, M method, Tuple& args, OffloadIndices<I...>) {
+        return (ptr->*method)(OffloadArg<A>::Pass(std::get<I>(args))...);
+    }
+};
+
+// Raises an error in the waiting thread, dropping the reference that kept the instance alive (released on the VM's thread)
+inline void OffloadFail(const AsyncTicket& ticket, const string& errMsg, HSQOBJECT instance) {
+    ticket.Complete([errMsg, instance](HSQUIRRELVM thread, string& err) mutable {
+        sq_release(thread, &instance);
+        err = errMsg;
+        return false;
+    });
+}
+
+// Runs an offloaded call and hands its result to the waiting thread
+template <class R>
+struct OffloadOutcome {
+    static void Complete(const AsyncTicket& ticket, const std::function<R ()>& call, HSQOBJECT instance) {
+        std::shared_ptr<R> result;
+        SQTRY_ANY()
+            result = std::make_shared<R>(call());
+        SQCATCH_ANY() {
+            OffloadFail(ticket, AsyncErrorMessage(std::current_exception()), instance);
+            return;
+        }
+        ticket.Complete([result, instance](HSQUIRRELVM thread, string&) mutable {
+            sq_release(thread, &instance);
+            PushVar(thread, *result);
+            return true;
+        });
+    }
+
+    static SQInteger Push(HSQUIRRELVM vm, const std::function<R ()>& call) {
+        R ret = call();
+        PushVar(vm, ret);
+        return 1;
+    }
+};
+
+template <>
+struct OffloadOutcome<void> {
+    static void Complete(const AsyncTicket& ticket, const std::function<void ()>& call, HSQOBJECT instance) {
+        SQTRY_ANY()
+            call();
+        SQCATCH_ANY() {
+            OffloadFail(ticket, AsyncErrorMessage(std::current_exception()), instance);
+            return;
+        }
+        ticket.Complete([instance](HSQUIRRELVM thread, string&) mutable {
+            sq_release(thread, &instance);
+            sq_pushnull(thread);
+            return true;
+        });
+    }
+
+    static SQInteger Push(HSQUIRRELVM /*vm*/, const std::function<void ()>& call) {
+        call();
+        return 0;
+    }
+};
+
+// Runs the call on the shared pool if the calling thread can wait for it, otherwise right here
+// (instanceIdx is the stack slot of the instance a member call runs on, kept alive until the result is back, or 0)
+template <class R>
+inline SQInteger OffloadCall(HSQUIRRELVM vm, const std::function<R ()>& call, SQInteger instanceIdx = 0) {
+    AsyncQueue* queue = AsyncQueue::Get(vm);
+    if (!queue->IsSuspendable(vm)) {
+        return OffloadOutcome<R>::Push(vm, call);
+    }
+    HSQOBJECT instance;
+    sq_resetobject(&instance);
+    if (instanceIdx != 0) {
+        sq_getstackobj(vm, instanceIdx, &instance);
+        sq_addref(vm, &instance);
+    }
+    AsyncTicket ticket = queue->Park(vm);
+    ThreadPool::Shared().Submit([ticket, call, instance]() {
+        OffloadOutcome<R>::Complete(ticket, call, instance);
+    });
+    return sq_suspendvm(vm);
+}
+
+//
+// Squirrel Offloaded Global Functions
+//
+template <class R, class... A>
+class SqOffloadGlobal {
+public:
+
+    static SQInteger Func(HSQUIRRELVM vm) {
+
+#if !defined (SCRAT_NO_ERROR_CHECKING)
+        if (sq_gettop(vm) != static_cast<SQInteger>(sizeof...(A)) + 2) {
+            return sq_throwerror(vm, _SC("wrong number of parameters"));
+        }
+#endif
+
+        typedef R (*M)(A...);
+        typedef typename OffloadArgs<A...>::Tuple Tuple;
+        M* methodPtr;
+        sq_getuserdata(vm, -1, (SQUserPointer*)&methodPtr, NULL);
+        M method = *methodPtr;
+
+        SQTRY()
+        AsyncArgs<A...> args(vm, 2);
+        SQCATCH_NOEXCEPT(vm) {
+            return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
+        }
+        typename OffloadArgs<A...>::Pack pack;
+        std::shared_ptr<Tuple> owned = std::make_shared<Tuple>(args.template Apply<Tuple>(pack));
+        return OffloadCall<R>(vm, [method, owned]() -> R {
+            return OffloadArgs<A...>::template Call<R>(method, *owned, typename MakeOffloadIndices<sizeof...(A)>::Type());
+        });
+        SQCATCH(vm) {
+            return sq_throwerror(vm, SQWHAT(vm));
+        }
+    }
+};
+
+//
+// Squirrel Offloaded Member Functions
+//
+template <class C, class M, class R, class... A>
+class SqOffloadMember {
+public:
+
+    static SQInteger Func(HSQUIRRELVM vm) {
+
+#if !defined (SCRAT_NO_ERROR_CHECKING)
+        if (sq_gettop(vm) != static_cast<SQInteger>(sizeof...(A)) + 2) {
+            return sq_throwerror(vm, _SC("wrong number of parameters"));
+        }
+#endif
+
+        typedef typename OffloadArgs<A...>::Tuple Tuple;
+        M* methodPtr;
+        sq_getuserdata(vm, -1, (SQUserPointer*)&methodPtr, NULL);
+        M method = *methodPtr;
+
+        C* ptr;
+        SQTRY()
+        ptr = Var<C*>(vm, 1).value;
+        SQCATCH_NOEXCEPT(vm) {
+            return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
+        }
+        SQCATCH(vm) {
+            return sq_throwerror(vm, SQWHAT(vm));
+        }
+
+        SQTRY()
+        AsyncArgs<A...> args(vm, 2);
+        SQCATCH_NOEXCEPT(vm) {
+            return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
+        }
+        typename OffloadArgs<A...>::Pack pack;
+        std::shared_ptr<Tuple> owned = std::make_shared<Tuple>(args.template Apply<Tuple>(pack));
+        const C* instance = ptr;
+        return OffloadCall<R>(vm, [instance, method, owned]() -> R {
+            return OffloadArgs<A...>::template Call<R>(instance, method, *owned, typename MakeOffloadIndices<sizeof...(A)>::Type());
+        }, 1);
+        SQCATCH(vm) {
+            return sq_throwerror(vm, SQWHAT(vm));
+        }
+    }
+};
+
+//
+// Asynchronous Function Resolvers
+//
+
+template <class R, class... A>
+inline SQFUNCTION SqAsyncFunc(std::future<R> (* /*method*/)(A...)) {
+    return &SqAsyncGlobal<R, A...>::Future;
+}
+
+template <class R, class... A>
+inline SQFUNCTION SqAsyncFunc(void (* /*method*/)(AsyncCallback<R>, A...)) {
+    return &SqAsyncGlobal<R, A...>::Callback;
+}
+
+template <class C, class R, class... A>
+inline SQFUNCTION SqAsyncMemberFunc(std::future<R> (C::* /*method*/)(A...)) {
+    return &SqAsyncMember<C, std::future<R> (C::*)(A...), R, A...>::Future;
+}
+
+template <class C, class R, class... A>
+inline SQFUNCTION SqAsyncMemberFunc(std::future<R> (C::* /*method*/)(A...) const) {
+    return &SqAsyncMember<C, std::future<R> (C::*)(A...) const, R, A...>::Future;
+}
+
+template <class C, class R, class... A>
+inline SQFUNCTION SqAsyncMemberFunc(void (C::* /*method*/)(AsyncCallback<R>, A...)) {
+    return &SqAsyncMember<C, void (C::*)(AsyncCallback<R>, A...), R, A...>::Callback;
+}
+
+template <class C, class R, class... A>
+inline SQFUNCTION SqAsyncMemberFunc(void (C::* /*method*/)(AsyncCallback<R>, A...) const) {
+    return &SqAsyncMember<C, void (C::*)(AsyncCallback<R>, A...) const, R, A...>::Callback;
+}
+
+template <class R, class... A>
+inline SQFUNCTION SqOffloadFunc(R (* /*method*/)(A...)) {
+    return &SqOffloadGlobal<R, A...>::Func;
+}
+
+template <class C, class R, class... A>
+inline SQFUNCTION SqOffloadMemberFunc(R (C::* /*method*/)(A...)) {
+    static_assert(sizeof(C) == 0, "OffloadFunc only binds const member functions");
+    return NULL;
+}
+
+template <class C, class R, class... A>
+inline SQFUNCTION SqOffloadMemberFunc(R (C::* /*method*/)(A...) const) {
+    static_assert(OffloadSafe<C>::value, "OffloadFunc needs the class to be marked with OffloadSafe");
+    return &SqOffloadMember<C, R (C::*)(A...) const, R, A...>::Func;
+}
+
+/// @endcond
+
+}
+
+#endif
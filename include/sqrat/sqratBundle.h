@@ -0,0 +1,385 @@
+//
+// SqratBundle: Archive of compiled modules with a sorted index
+//
+
+//
+// Copyright (c) 2009 Brandon Jones
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software. If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+#if !defined(_SCRAT_BUNDLE_H_)
+#define _SCRAT_BUNDLE_H_
+
+#include <squirrel.h>
+#include <sqstdio.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "sqratBytecode.h"
+#include "sqratCompileCache.h"
+#include "sqratMappedFile.h"
+#include "sqratScript.h"
+
+namespace Sqrat {
+
+/// @cond DEV
+
+// Layout of a bundle file: a BundleHeader, count BundleEntry records sorted by name, then the names and the bytecode.
+// Offsets are from the start of the file and every number is in the byte order of the machine that wrote it (as is the
+// bytecode itself).
+struct BundleHeader {
+    char     magic[4];   // "SQRB"
+    unsigned format;
+    unsigned count;
+    unsigned reserved;
+};
+
+struct BundleEntry {
+    unsigned long long nameOffset;
+    unsigned long long dataOffset;
+    unsigned long long dataSize;
+    unsigned long long checksum; // BytecodeHash of the bytecode
+    unsigned           nameSize;
+    unsigned           reserved;
+};
+
+/// @endcond
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Read-only bundle of compiled modules, memory mapped and looked up by name
+///
+/// \remarks
+/// Names are narrow strings, usually module names as given to import(). A Bundle never changes once opened, so one Bundle
+/// can serve VMs on any number of threads. The checksum of a module is verified the first time it is found and the
+/// outcome is remembered for the later lookups.
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class Bundle {
+public:
+
+    static const unsigned FORMAT = 1; ///< Format version written by BundleWriter
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Constructs a Bundle with no file
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    Bundle() : m_entries(NULL), m_count(0) {
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Constructs a Bundle and opens a file (check IsOpen)
+    ///
+    /// \param path Path of the bundle file
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    explicit Bundle(const std::string& path) : m_entries(NULL), m_count(0) {
+        Open(path);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Maps a bundle file and checks its header and index
+    ///
+    /// \param path Path of the bundle file
+    ///
+    /// \return True if the file is a valid bundle
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool Open(const std::string& path) {
+        Close();
+        if (!m_file.Open(path) || m_file.Size() < sizeof(BundleHeader)) {
+            Close();
+            return false;
+        }
+        const BundleHeader* header = reinterpret_cast<const BundleHeader*>(m_file.Data());
+        size_t size = m_file.Size();
+        if (memcmp(header->magic, "SQRB", 4) != 0 || header->format != FORMAT ||
+            header->count > (size - sizeof(BundleHeader)) / sizeof(BundleEntry)) {
+            Close();
+            return false;
+        }
+        const BundleEntry* entries = reinterpret_cast<const BundleEntry*>(m_file.Data() + sizeof(BundleHeader));
+        for (unsigned i = 0; i < header->count; ++i) {
+            if (entries[i].nameOffset > size || entries[i].nameSize > size - entries[i].nameOffset ||
+                entries[i].dataOffset > size || entries[i].dataSize > size - entries[i].dataOffset) {
+                Close();
+                return false;
+            }
+        }
+        m_entries = entries;
+        m_count = header->count;
+        m_verified = std::vector<std::atomic<unsigned char> >(m_count);
+        return true;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Unmaps the bundle
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Close() {
+        m_file.Close();
+        m_entries = NULL;
+        m_count = 0;
+        m_verified.clear();
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Checks whether a valid bundle is open
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool IsOpen() const {
+        return m_entries != NULL;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the number of modules in the bundle
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    size_t GetCount() const {
+        return m_count;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the name of a module (modules are sorted by name)
+    ///
+    /// \param index Index of the module
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    std::string GetName(size_t index) const {
+        return std::string(m_file.Data() + m_entries[index].nameOffset, m_entries[index].nameSize);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Finds the bytecode of a module and checks it against its checksum
+    ///
+    /// \param name Name of the module
+    /// \param data Set to the bytecode, which stays valid while the bundle is open
+    /// \param size Set to the size of the bytecode
+    ///
+    /// \return True if the module is in the bundle and intact
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool Find(const std::string& name, const void*& data, size_t& size) const {
+        size_t low = 0;
+        size_t high = m_count;
+        while (low < high) {
+            size_t mid = low + (high - low) / 2;
+            int order = compare(m_entries[mid], name);
+            if (order == 0) {
+                const char* bytes = m_file.Data() + m_entries[mid].dataOffset;
+                size_t length = static_cast<size_t>(m_entries[mid].dataSize);
+                if (!intact(mid, bytes, length)) {
+                    return false;
+                }
+                data = bytes;
+                size = length;
+                return true;
+            }
+            if (order < 0) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return false;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Pushes the closure of a module, read in place from the bundle
+    ///
+    /// \param vm   VM to create the closure in
+    /// \param name Name of the module
+    ///
+    /// \return SQ_OK with the closure on the stack, or SQ_ERROR if the module is missing or damaged
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    SQRESULT Push(HSQUIRRELVM vm, const std::string& name) const {
+        const void* data;
+        size_t size;
+        if (!Find(name, data, size)) {
+            return SQ_ERROR;
+        }
+        Bytecode bytecode(data, size);
+        return sq_readclosure(vm, BytecodeReader, &bytecode);
+    }
+
+private:
+
+    Bundle(const Bundle&);
+    Bundle& operator=(const Bundle&);
+
+    // Orders names the same way std::string (and so BundleWriter) does
+    int compare(const BundleEntry& entry, const std::string& name) const {
+        size_t common = entry.nameSize < name.size() ? entry.nameSize : name.size();
+        int order = memcmp(m_file.Data() + entry.nameOffset, name.data(), common);
+        if (order != 0) {
+            return order;
+        }
+        return entry.nameSize < name.size() ? -1 : (entry.nameSize > name.size() ? 1 : 0);
+    }
+
+    // Checks an entry against its checksum once; threads racing on the first check all store the same outcome
+    bool intact(size_t index, const char* bytes, size_t length) const {
+        unsigned char state = m_verified[index].load(std::memory_order_relaxed);
+        if (state == UNVERIFIED) {
+            state = BytecodeHash(bytes, length) == m_entries[index].checksum ? INTACT : DAMAGED;
+            m_verified[index].store(state, std::memory_order_relaxed);
+        }
+        return state == INTACT;
+    }
+
+    enum { UNVERIFIED = 0, INTACT = 1, DAMAGED = 2 };
+
+    MappedFile                                        m_file;
+    const BundleEntry*                                m_entries;
+    size_t                                            m_count;
+    mutable std::vector<std::atomic<unsigned char> >  m_verified; // one of the states above for each entry
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Collects compiled modules and writes them as a bundle file
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class BundleWriter {
+public:
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Adds bytecode under a name, replacing any module already added with that name
+    ///
+    /// \param name Name of the module
+    /// \param data Bytecode written by sq_writeclosure
+    /// \param size Number of bytes
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Add(const std::string& name, const void* data, size_t size) {
+        const char* bytes = static_cast<const char*>(data);
+        m_modules[name].assign(bytes, bytes + size);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Compiles a script file (or loads its bytecode) and adds it
+    ///
+    /// \param vm   VM used to compile
+    /// \param name Name of the module
+    /// \param path Path of the script file
+    ///
+    /// \return SQ_OK, or SQ_ERROR with the error available from sq_getlasterror
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    SQRESULT AddScript(HSQUIRRELVM vm, const std::string& name, const string& path) {
+        if (SQ_FAILED(sqstd_loadfile(vm, path.c_str(), true))) {
+            return SQ_ERROR;
+        }
+        Bytecode bytecode;
+        SQRESULT result = sq_writeclosure(vm, BytecodeWriter, &bytecode);
+        sq_pop(vm, 1);
+        if (SQ_SUCCEEDED(result)) {
+            Add(name, bytecode.Data(), bytecode.Size());
+        }
+        return result;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the number of modules added so far
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    size_t GetCount() const {
+        return m_modules.size();
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Writes the bundle, replacing the file in one step so readers never see a partial bundle
+    ///
+    /// \param path Path of the bundle file
+    ///
+    /// \return True if successful
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool Write(const std::string& path) const {
+        BundleHeader header;
+        memcpy(header.magic, "SQRB", 4);
+        header.format = Bundle::FORMAT;
+        header.count = static_cast<unsigned>(m_modules.size());
+        header.reserved = 0;
+
+        std::vector<BundleEntry> entries;
+        unsigned long long offset = sizeof(BundleHeader) + m_modules.size() * sizeof(BundleEntry);
+        for (Modules::const_iterator it = m_modules.begin(); it != m_modules.end(); ++it) {
+            BundleEntry entry;
+            entry.nameOffset = offset;
+            entry.nameSize = static_cast<unsigned>(it->first.size());
+            entry.dataOffset = offset + it->first.size();
+            entry.dataSize = it->second.size();
+            entry.checksum = BytecodeHash(it->second.empty() ? NULL : &it->second[0], it->second.size());
+            entry.reserved = 0;
+            entries.push_back(entry);
+            offset = entry.dataOffset + entry.dataSize;
+        }
+
+        std::string temp = path + CompileCache::TempSuffix();
+        FILE* file = fopen(temp.c_str(), "wb");
+        if (file == NULL) {
+            return false;
+        }
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+        if (ok && !entries.empty()) {
+            ok = fwrite(&entries[0], sizeof(BundleEntry), entries.size(), file) == entries.size();
+        }
+        for (Modules::const_iterator it = m_modules.begin(); ok && it != m_modules.end(); ++it) {
+            ok = fwrite(it->first.data(), 1, it->first.size(), file) == it->first.size() &&
+                fwrite(it->second.empty() ? "" : &it->second[0], 1, it->second.size(), file) == it->second.size();
+        }
+        ok = (fclose(file) == 0) && ok;
+#if defined(_WIN32)
+        ok = ok && MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        ok = ok && rename(temp.c_str(), path.c_str()) == 0;
+#endif
+        if (!ok) {
+            remove(temp.c_str());
+        }
+        return ok;
+    }
+
+private:
+
+    typedef std::map<std::string, std::vector<char> > Modules;
+
+    Modules m_modules;
+};
+
+/// @cond DEV
+
+// Declared in sqratScript.h
+inline bool Script::LoadBytecode(const Bundle& bundle, const std::string& name) {
+    const void* data;
+    size_t size;
+    return bundle.Find(name, data, size) && LoadBytecode(data, size);
+}
+
+/// @endcond
+
+}
+
+#endif
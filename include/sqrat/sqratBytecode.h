@@ -31,11 +31,17 @@
 #include <squirrel.h>
 #include <stdlib.h>
 #include <string.h>
+#include <string>
 
 namespace Sqrat {
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /// Helper class for managing Squirrel scripts bytecode
+///
+/// \remarks
+/// A Bytecode either owns a buffer that grows geometrically as sq_writeclosure appends to it, or reads from memory owned
+/// by the caller (see SetView) without copying it. Clear keeps the buffer so one Bytecode can serve many scripts.
+///
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 class Bytecode {
 public:
@@ -46,7 +52,25 @@ public:
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     Bytecode()
         : m_data(0)
+        , m_view(0)
         , m_size(0)
+        , m_capacity(0)
+        , m_readpos(0)
+    {
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Constructs a Bytecode reading from memory owned by the caller (see SetView)
+    ///
+    /// \param data Pointer to buffer containing bytecode
+    /// \param size Size of buffer containing bytecode
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    Bytecode(const void * data, size_t size)
+        : m_data(0)
+        , m_view(static_cast<const char *>(data))
+        , m_size(size)
+        , m_capacity(0)
         , m_readpos(0)
     {
     }
@@ -68,7 +92,7 @@ public:
     ///
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     inline void * Data() const {
-        return m_data;
+        return m_view ? const_cast<char *>(m_view) : m_data;
     }
 
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -80,16 +104,31 @@ public:
     ///
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     SQRESULT SetData(const void * data, size_t size) {
-        if (m_data) {
-            free(m_data);
+        Clear();
+        if (!Reserve(size)) {
+            return SQ_ERROR;
         }
-        m_data = static_cast<char *>(malloc(size));
         memcpy(m_data, data, size);
         m_size = size;
-        m_readpos = 0;
         return SQ_OK;
     }
 
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Reads bytecode from memory owned by the caller without copying it
+    ///
+    /// \param data Pointer to buffer containing bytecode (must outlive the reads)
+    /// \param size Size of buffer containing bytecode
+    ///
+    /// \remarks
+    /// Any buffer owned by the Bytecode is kept for later appends.
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void SetView(const void * data, size_t size) {
+        m_view = static_cast<const char *>(data);
+        m_size = size;
+        m_readpos = 0;
+    }
+
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     /// Appends bytecode from provided buffer
     ///
@@ -99,17 +138,61 @@ public:
     ///
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     SQInteger AppendData(const void * data, size_t size) {
-        if (!m_data) {
-            m_data = static_cast<char *>(malloc(size));
+        if (m_view) {
+            Clear();
         }
-        else {
-            m_data = static_cast<char *>(realloc(m_data, m_size + size));
+        if (m_size + size > m_capacity) {
+            size_t capacity = m_capacity ? m_capacity * 2 : 256;
+            while (capacity < m_size + size) {
+                capacity *= 2;
+            }
+            if (!Reserve(capacity)) {
+                return -1;
+            }
         }
         memcpy(m_data + m_size, data, size);
         m_size += size;
         return static_cast<SQInteger>(size);
     }
 
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Makes sure the owned buffer can hold a number of bytes without growing
+    ///
+    /// \param capacity Number of bytes
+    /// \returns False if the memory could not be allocated
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool Reserve(size_t capacity) {
+        if (capacity <= m_capacity) {
+            return true;
+        }
+        char * data = static_cast<char *>(realloc(m_data, capacity));
+        if (!data) {
+            return false;
+        }
+        m_data = data;
+        m_capacity = capacity;
+        return true;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Empties the Bytecode and drops any view, keeping the owned buffer for reuse
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Clear() {
+        m_view = 0;
+        m_size = 0;
+        m_readpos = 0;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Moves the ReadData position back to the start
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Rewind() {
+        m_readpos = 0;
+    }
+
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     /// Reads bytecode
     ///
@@ -119,10 +202,11 @@ public:
     ///
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     SQInteger ReadData(void * data, size_t size) {
-        if (!m_data || m_size == 0 || m_readpos == m_size)
+        const char * source = static_cast<const char *>(Data());
+        if (!source || m_size == 0 || m_readpos == m_size)
             return -1;
         size_t bytes_to_read = (m_readpos + size <= m_size) ? size : m_size - m_readpos;
-        memcpy(data, m_data + m_readpos, bytes_to_read);
+        memcpy(data, source + m_readpos, bytes_to_read);
         m_readpos += bytes_to_read;
         return static_cast<SQInteger>(bytes_to_read);
     }
@@ -137,10 +221,23 @@ public:
         return m_size;
     }
 
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Returns the number of bytes the owned buffer holds before it has to grow
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    inline size_t Capacity() const {
+        return m_capacity;
+    }
+
 private:
-    char * m_data;    // Buffer holding bytecode
-    size_t m_size;    // Bytecode size
-    size_t m_readpos; // Current bytecode ReadData() position
+    Bytecode(const Bytecode&);
+    Bytecode& operator=(const Bytecode&);
+
+    char * m_data;       // Owned buffer holding bytecode
+    const char * m_view; // Caller's memory being read instead of m_data (if set)
+    size_t m_size;       // Bytecode size
+    size_t m_capacity;   // Size of the owned buffer
+    size_t m_readpos;    // Current bytecode ReadData() position
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -153,7 +250,7 @@ private:
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 inline SQInteger BytecodeReader(SQUserPointer user_data, SQUserPointer data, SQInteger size) {
     Bytecode * bytecode = reinterpret_cast<Bytecode *>(user_data);
-    return bytecode->ReadData(data, static_cast<size_t>(size));;
+    return bytecode->ReadData(data, static_cast<size_t>(size));
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -169,6 +266,38 @@ inline SQInteger BytecodeWriter(SQUserPointer user_data, SQUserPointer data, SQI
     return bytecode->AppendData(data, static_cast<size_t>(size));
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Helper bytecode writer callback appending straight to a std::string, to use with sq_writeclosure
+///
+/// \param user_data Pointer to \a std::string object to write to
+/// \param data Pointer to bytecode data
+/// \param size Number of bytes to write
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+inline SQInteger BytecodeStringWriter(SQUserPointer user_data, SQUserPointer data, SQInteger size) {
+    std::string * str = reinterpret_cast<std::string *>(user_data);
+    str->append(reinterpret_cast<const char *>(data), static_cast<size_t>(size));
+    return size;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// 64-bit FNV-1a hash of a block of memory, as used for bytecode checksums and cache keys
+///
+/// \param data Memory to hash
+/// \param size Number of bytes
+/// \param seed Hash to continue from (to hash several blocks as one)
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+inline unsigned long long BytecodeHash(const void* data, size_t size, unsigned long long seed = 14695981039346656037ULL) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    unsigned long long hash = seed;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
 }
 
 #endif //_SCRAT_BYTECODE_H_
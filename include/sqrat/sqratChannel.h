@@ -0,0 +1,676 @@
+//
+// SqratChannel: bounded channels for passing values between VMs and threads
+//
+
+//
+// Copyright (c) 2009 Brandon Jones
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software. If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+#if !defined(_SCRAT_CHANNEL_H_)
+#define _SCRAT_CHANNEL_H_
+
+#include <squirrel.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include "sqratAsync.h"
+#include "sqratClass.h"
+#include "sqratMarshal.h"
+#include "sqratTable.h"
+
+namespace Sqrat {
+
+/// @cond DEV
+// Bounded multi-producer multi-consumer ring (after Dmitry Vyukov): every cell carries a sequence number that tells
+// producers and consumers whose turn it is, so the fast paths are a single compare-and-swap. The cells are rounded up to
+// a power of two (at least two, which the sequence numbers need), while pushes stop at the exact capacity asked for
+class ChannelRing {
+public:
+
+    ChannelRing(size_t capacity) : m_capacity(capacity), m_enqueuePos(0), m_dequeuePos(0) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        m_mask  = size - 1;
+        m_cells = new Cell[size];
+        for (size_t i = 0; i < size; ++i) {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~ChannelRing() {
+        delete[] m_cells;
+    }
+
+    size_t Capacity() const {
+        return m_capacity;
+    }
+
+    size_t Size() const {
+        size_t enqueued = m_enqueuePos.load(std::memory_order_relaxed);
+        size_t dequeued = m_dequeuePos.load(std::memory_order_relaxed);
+        return enqueued > dequeued ? enqueued - dequeued : 0;
+    }
+
+    bool TryPush(MarshalledValue& value) {
+        Cell* cell;
+        size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &m_cells[pos & m_mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            ptrdiff_t dif = static_cast<ptrdiff_t>(seq) - static_cast<ptrdiff_t>(pos);
+            if (dif == 0) {
+                if (pos - m_dequeuePos.load(std::memory_order_acquire) >= m_capacity) {
+                    return false;
+                }
+                if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(MarshalledValue& value) {
+        Cell* cell;
+        size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &m_cells[pos & m_mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            ptrdiff_t dif = static_cast<ptrdiff_t>(seq) - static_cast<ptrdiff_t>(pos + 1);
+            if (dif == 0) {
+                if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = m_dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->value);
+        cell->value = MarshalledValue();
+        cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+
+    struct Cell {
+        std::atomic<size_t> sequence;
+        MarshalledValue     value;
+    };
+
+    ChannelRing(const ChannelRing&);
+    ChannelRing& operator=(const ChannelRing&);
+
+    Cell*               m_cells;
+    size_t              m_mask;
+    size_t              m_capacity;
+    std::atomic<size_t> m_enqueuePos;
+    std::atomic<size_t> m_dequeuePos;
+};
+
+// State shared by every Channel handle of one channel
+struct ChannelState {
+    typedef std::shared_ptr<MarshalledValue> Message;
+
+    // A coroutine parked in send, with a reference to the value it sends so that a failed send can give the value back
+    struct ParkedSend {
+        AsyncTicket ticket;
+        Message     message;
+        HSQOBJECT   source;
+    };
+
+    ChannelState(size_t capacity) : ring(capacity), waiters(0), closed(false) {}
+
+    ChannelRing                                     ring;
+    std::mutex                                      lock;     // guards everything below except the atomics
+    std::condition_variable                         readable;
+    std::condition_variable                         writable;
+    std::atomic<int>                                waiters;  // blocked OS threads plus parked coroutines
+    std::atomic<bool>                               closed;
+    std::deque<AsyncTicket>                         receivers;
+    std::deque<ParkedSend>                          senders;
+};
+/// @endcond
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Bounded channel that moves MarshalledValues between threads and VMs
+///
+/// \remarks
+/// A Channel is a handle: copies refer to the same channel, so pushing a Channel into several VMs connects them. Sending
+/// and receiving never take a lock unless somebody is waiting.
+///
+/// \remarks
+/// In scripts, send and recv suspend the calling coroutine when the channel is full or empty (see AsyncQueue) and block
+/// the OS thread otherwise. Values are marshalled with MarshalledValue::MARSHAL_MOVE and MARSHAL_PACK, so a sent Buffer is
+/// emptied in the sender (unless the send fails) and arrays and tables travel in packed form.
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class Channel {
+public:
+
+    static const size_t DEFAULT_CAPACITY = 64; ///< Capacity used by the default constructor
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Creates a new channel
+    ///
+    /// \param capacity Number of values the channel holds before send blocks (at least 1)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    explicit Channel(size_t capacity = DEFAULT_CAPACITY) : m_state(std::make_shared<ChannelState>(capacity)) {
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Sends a value if there is room
+    ///
+    /// \param value Value to send (moved from if the send succeeds)
+    ///
+    /// \return False if the channel is full or closed
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool TrySend(MarshalledValue& value) {
+        if (m_state->closed || !m_state->ring.TryPush(value)) {
+            return false;
+        }
+        wakeWaiters();
+        return true;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Sends a value, blocking while the channel is full
+    ///
+    /// \param value Value to send (moved from if the send succeeds)
+    ///
+    /// \return False if the channel is closed
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool Send(MarshalledValue& value) {
+        if (TrySend(value)) {
+            return true;
+        }
+        ChannelState& state = *m_state;
+        std::unique_lock<std::mutex> lock(state.lock);
+        ++state.waiters;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool sent;
+        while (!(sent = !state.closed && state.ring.TryPush(value)) && !state.closed) {
+            state.writable.wait(lock);
+        }
+        --state.waiters;
+        if (sent) {
+            serve(lock);
+        }
+        return sent;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Receives a value if one is available
+    ///
+    /// \param value Filled with the received value
+    ///
+    /// \return False if the channel is empty
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool TryRecv(MarshalledValue& value) {
+        if (!m_state->ring.TryPop(value)) {
+            return false;
+        }
+        wakeWaiters();
+        return true;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Receives a value, blocking while the channel is empty
+    ///
+    /// \param value Filled with the received value
+    ///
+    /// \return False if the channel is closed and empty
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool Recv(MarshalledValue& value) {
+        if (TryRecv(value)) {
+            return true;
+        }
+        ChannelState& state = *m_state;
+        std::unique_lock<std::mutex> lock(state.lock);
+        ++state.waiters;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool received;
+        while (!(received = state.ring.TryPop(value)) && !state.closed) {
+            state.readable.wait(lock);
+        }
+        --state.waiters;
+        if (received) {
+            serve(lock);
+        }
+        return received;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Closes the channel: sends fail from now on, and receives fail once the values already sent have been received
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Close() {
+        ChannelState& state = *m_state;
+        std::unique_lock<std::mutex> lock(state.lock);
+        state.closed = true;
+        serve(lock);
+        while (!state.receivers.empty()) {
+            state.receivers.front().Complete(AsyncResult());
+            state.receivers.pop_front();
+            --state.waiters;
+        }
+        while (!state.senders.empty()) {
+            ChannelState::Message message = state.senders.front().message;
+            HSQOBJECT source = state.senders.front().source;
+            state.senders.front().ticket.Complete([message, source](HSQUIRRELVM thread, string& errMsg) {
+                HSQOBJECT obj = source;
+                sq_pushobject(thread, obj);
+                message->Restore(thread, -1);
+                sq_pop(thread, 1);
+                sq_release(thread, &obj);
+                errMsg = _SC("send on a closed channel");
+                return false;
+            });
+            state.senders.pop_front();
+            --state.waiters;
+        }
+        state.readable.notify_all();
+        state.writable.notify_all();
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Checks whether the channel has been closed
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool IsClosed() const {
+        return m_state->closed;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the number of values waiting to be received (approximate while other threads use the channel)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    size_t Size() const {
+        return m_state->ring.Size();
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the number of values the channel can hold
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    size_t Capacity() const {
+        return m_state->ring.Capacity();
+    }
+
+    /// @cond DEV
+
+    static SQInteger sqSend(HSQUIRRELVM vm) {
+        SQTRY()
+        Channel* self = Var<Channel*>(vm, 1).value;
+        SQCATCH_NOEXCEPT(vm) {
+            return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
+        }
+        if (self->IsClosed()) {
+            return sq_throwerror(vm, _SC("send on a closed channel"));
+        }
+        // moved rather than copied, so every failure below gives the script its Buffer back
+        ChannelState::Message message = std::make_shared<MarshalledValue>();
+        string errMsg;
+        if (!MarshalledValue::FromStack(vm, 2, *message, errMsg, MarshalledValue::MARSHAL_MOVE | MarshalledValue::MARSHAL_PACK)) {
+            return sq_throwerror(vm, errMsg.c_str());
+        }
+        if (self->TrySend(*message)) {
+            return 0;
+        }
+        if (self->IsClosed()) {
+            message->Restore(vm, 2);
+            return sq_throwerror(vm, _SC("send on a closed channel"));
+        }
+        AsyncQueue* queue = AsyncQueue::Get(vm);
+        if (queue->IsSuspendable(vm)) {
+            ChannelState& state = *self->m_state;
+            std::unique_lock<std::mutex> lock(state.lock);
+            ++state.waiters;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!state.closed && state.ring.TryPush(*message)) {
+                --state.waiters;
+                self->serve(lock);
+                return 0;
+            }
+            if (state.closed) {
+                --state.waiters;
+                message->Restore(vm, 2);
+                return sq_throwerror(vm, _SC("send on a closed channel"));
+            }
+            ChannelState::ParkedSend parked;
+            parked.ticket = queue->Park(vm);
+            parked.message = message;
+            sq_getstackobj(vm, 2, &parked.source);
+            sq_addref(vm, &parked.source);
+            state.senders.push_back(parked);
+            return sq_suspendvm(vm);
+        }
+        if (!self->Send(*message)) {
+            message->Restore(vm, 2);
+            return sq_throwerror(vm, _SC("send on a closed channel"));
+        }
+        return 0;
+        SQCATCH(vm) {
+            return sq_throwerror(vm, SQWHAT(vm));
+        }
+    }
+
+    static SQInteger sqTrySend(HSQUIRRELVM vm) {
+        SQTRY()
+        Channel* self = Var<Channel*>(vm, 1).value;
+        SQCATCH_NOEXCEPT(vm) {
+            return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
+        }
+        if (self->IsClosed()) {
+            sq_pushbool(vm, SQFalse);
+            return 1;
+        }
+        MarshalledValue message;
+        string errMsg;
+        if (!MarshalledValue::FromStack(vm, 2, message, errMsg, MarshalledValue::MARSHAL_MOVE | MarshalledValue::MARSHAL_PACK)) {
+            return sq_throwerror(vm, errMsg.c_str());
+        }
+        // moved rather than copied, so a full or closed channel gives the script its Buffer back
+        if (!self->TrySend(message)) {
+            message.Restore(vm, 2);
+            sq_pushbool(vm, SQFalse);
+            return 1;
+        }
+        sq_pushbool(vm, SQTrue);
+        return 1;
+        SQCATCH(vm) {
+            return sq_throwerror(vm, SQWHAT(vm));
+        }
+    }
+
+    static SQInteger sqRecv(HSQUIRRELVM vm) {
+        SQTRY()
+        Channel* self = Var<Channel*>(vm, 1).value;
+        SQCATCH_NOEXCEPT(vm) {
+            return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
+        }
+        MarshalledValue message;
+        if (self->TryRecv(message)) {
+            message.PushMove(vm);
+            return 1;
+        }
+        AsyncQueue* queue = AsyncQueue::Get(vm);
+        if (queue->IsSuspendable(vm) && !self->IsClosed()) {
+            ChannelState& state = *self->m_state;
+            std::unique_lock<std::mutex> lock(state.lock);
+            ++state.waiters;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (state.ring.TryPop(message) || state.closed) {
+                --state.waiters;
+                self->serve(lock);
+                message.PushMove(vm);
+                return 1;
+            }
+            state.receivers.push_back(queue->Park(vm));
+            return sq_suspendvm(vm);
+        }
+        self->Recv(message);
+        message.PushMove(vm);
+        return 1;
+        SQCATCH(vm) {
+            return sq_throwerror(vm, SQWHAT(vm));
+        }
+    }
+
+    static SQInteger sqTryRecv(HSQUIRRELVM vm) {
+        SQTRY()
+        Channel* self = Var<Channel*>(vm, 1).value;
+        SQCATCH_NOEXCEPT(vm) {
+            return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
+        }
+        MarshalledValue message;
+        self->TryRecv(message);
+        message.PushMove(vm);
+        return 1;
+        SQCATCH(vm) {
+            return sq_throwerror(vm, SQWHAT(vm));
+        }
+    }
+
+    /// @endcond
+
+private:
+
+    // Called after a successful send or receive: only takes the lock if somebody may be waiting
+    void wakeWaiters() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_state->waiters.load() > 0) {
+            std::unique_lock<std::mutex> lock(m_state->lock);
+            serve(lock);
+        }
+    }
+
+    // Hands values to parked coroutines and wakes blocked threads (the lock must be held)
+    void serve(std::unique_lock<std::mutex>& /*lock*/) {
+        ChannelState& state = *m_state;
+        bool progress = true;
+        while (progress) {
+            progress = false;
+            while (!state.senders.empty() && state.ring.TryPush(*state.senders.front().message)) {
+                HSQOBJECT source = state.senders.front().source;
+                state.senders.front().ticket.Complete([source](HSQUIRRELVM thread, string&) {
+                    HSQOBJECT obj = source;
+                    sq_release(thread, &obj);
+                    sq_pushnull(thread);
+                    return true;
+                });
+                state.senders.pop_front();
+                --state.waiters;
+                progress = true;
+            }
+            while (!state.receivers.empty()) {
+                ChannelState::Message message = std::make_shared<MarshalledValue>();
+                if (!state.ring.TryPop(*message)) {
+                    break;
+                }
+                state.receivers.front().Complete([message](HSQUIRRELVM thread, string&) {
+                    message->PushMove(thread);
+                    return true;
+                });
+                state.receivers.pop_front();
+                --state.waiters;
+                progress = true;
+            }
+        }
+        state.readable.notify_all();
+        state.writable.notify_all();
+    }
+
+    std::shared_ptr<ChannelState> m_state;
+};
+
+/// @cond DEV
+inline SQInteger sqBufferGet(HSQUIRRELVM vm) {
+    SQTRY()
+    Buffer* self = Var<Buffer*>(vm, 1).value;
+    SQCATCH_NOEXCEPT(vm) {
+        return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
+    }
+    SQInteger index = Var<SQInteger>(vm, 2).value;
+    SQCATCH_NOEXCEPT(vm) {
+        return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
+    }
+    if (index < 0 || static_cast<size_t>(index) >= self->Length()) {
+        return sq_throwerror(vm, _SC("index out of range"));
+    }
+    double value = self->GetElement(static_cast<size_t>(index));
+    if (self->GetElementType() == Buffer::FLOAT32 || self->GetElementType() == Buffer::FLOAT64) {
+        sq_pushfloat(vm, static_cast<SQFloat>(value));
+    } else {
+        sq_pushinteger(vm, static_cast<SQInteger>(value));
+    }
+    return 1;
+    SQCATCH(vm) {
+        return sq_throwerror(vm, SQWHAT(vm));
+    }
+}
+
+inline SQInteger sqBufferSet(HSQUIRRELVM vm) {
+    SQTRY()
+    Buffer* self = Var<Buffer*>(vm, 1).value;
+    SQCATCH_NOEXCEPT(vm) {
+        return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
+    }
+    SQInteger index = Var<SQInteger>(vm, 2).value;
+    double value = Var<double>(vm, 3).value;
+    SQCATCH_NOEXCEPT(vm) {
+        return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
+    }
+    if (index < 0 || static_cast<size_t>(index) >= self->Length()) {
+        return sq_throwerror(vm, _SC("index out of range"));
+    }
+    self->SetElement(static_cast<size_t>(index), value);
+    return 0;
+    SQCATCH(vm) {
+        return sq_throwerror(vm, SQWHAT(vm));
+    }
+}
+
+inline SQInteger sqBufferLen(HSQUIRRELVM vm) {
+    SQTRY()
+    Buffer* self = Var<Buffer*>(vm, 1).value;
+    SQCATCH_NOEXCEPT(vm) {
+        return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
+    }
+    sq_pushinteger(vm, static_cast<SQInteger>(self->Length()));
+    return 1;
+    SQCATCH(vm) {
+        return sq_throwerror(vm, SQWHAT(vm));
+    }
+}
+
+inline SQInteger sqBufferResize(HSQUIRRELVM vm) {
+    SQTRY()
+    Buffer* self = Var<Buffer*>(vm, 1).value;
+    SQCATCH_NOEXCEPT(vm) {
+        return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
+    }
+    SQInteger length = Var<SQInteger>(vm, 2).value;
+    SQCATCH_NOEXCEPT(vm) {
+        return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
+    }
+    if (length < 0) {
+        return sq_throwerror(vm, _SC("negative length"));
+    }
+    self->Resize(static_cast<size_t>(length));
+    return 0;
+    SQCATCH(vm) {
+        return sq_throwerror(vm, SQWHAT(vm));
+    }
+}
+
+inline SQInteger sqBufferNew(HSQUIRRELVM vm) {
+    SQInteger type, length;
+    if (SQ_FAILED(sq_getinteger(vm, 2, &type)) || SQ_FAILED(sq_getinteger(vm, 3, &length))) {
+        return sq_throwerror(vm, _SC("expected an element type and a length"));
+    }
+    if (type < Buffer::UINT8 || type > Buffer::FLOAT64) {
+        return sq_throwerror(vm, _SC("unknown element type"));
+    }
+    if (length < 0) {
+        return sq_throwerror(vm, _SC("negative length"));
+    }
+    ClassType<Buffer>::PushInstance(vm, new Buffer(static_cast<Buffer::ElementType>(type), static_cast<size_t>(length)), true);
+    return 1;
+}
+
+inline SQInteger sqChannelNew(HSQUIRRELVM vm) {
+    SQInteger capacity = Channel::DEFAULT_CAPACITY;
+    if (sq_gettop(vm) >= 2 && SQ_FAILED(sq_getinteger(vm, 2, &capacity))) {
+        return sq_throwerror(vm, _SC("capacity must be an integer"));
+    }
+    if (capacity < 1) {
+        return sq_throwerror(vm, _SC("capacity must be at least 1"));
+    }
+    ClassType<Channel>::PushInstance(vm, new Channel(static_cast<size_t>(capacity)), true);
+    return 1;
+}
+/// @endcond
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Binds Buffer and Channel into the root table of a VM
+///
+/// \param vm VM to bind into
+///
+/// \remarks
+/// In script, newbuffer(type, length) creates a zero filled Buffer where type is one of Buffer.UINT8, Buffer.INT32,
+/// Buffer.FLOAT32 or Buffer.FLOAT64, with methods get(i), set(i, v), len() and resize(n). newchannel([capacity]) creates
+/// a Channel with methods send(v), trysend(v), recv(), tryrecv(), close(), isclosed(), len() and capacity(). recv returns
+/// null once the channel is closed and empty, tryrecv returns null when nothing is waiting.
+///
+/// \remarks
+/// To connect VMs, create a Channel in C++ and push the same Channel into each of them (e.g. with Table::SetValue).
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+inline void RegisterChannelLib(HSQUIRRELVM vm) {
+    AsyncQueue::Get(vm);
+    RootTable root(vm);
+    root.Bind(_SC("Buffer"), Class<Buffer>(vm, _SC("Buffer"))
+        .SetStaticValue(_SC("UINT8"), static_cast<int>(Buffer::UINT8))
+        .SetStaticValue(_SC("INT32"), static_cast<int>(Buffer::INT32))
+        .SetStaticValue(_SC("FLOAT32"), static_cast<int>(Buffer::FLOAT32))
+        .SetStaticValue(_SC("FLOAT64"), static_cast<int>(Buffer::FLOAT64))
+        .SquirrelFunc(_SC("get"), &sqBufferGet, 2, _SC(".i"))
+        .SquirrelFunc(_SC("set"), &sqBufferSet, 3, _SC(".in"))
+        .SquirrelFunc(_SC("len"), &sqBufferLen, 1)
+        .SquirrelFunc(_SC("resize"), &sqBufferResize, 2, _SC(".i"))
+    );
+    root.Bind(_SC("Channel"), Class<Channel, CopyOnly<Channel> >(vm, _SC("Channel"))
+        .SquirrelFunc(_SC("send"), &Channel::sqSend, 2)
+        .SquirrelFunc(_SC("trysend"), &Channel::sqTrySend, 2)
+        .SquirrelFunc(_SC("recv"), &Channel::sqRecv, 1)
+        .SquirrelFunc(_SC("tryrecv"), &Channel::sqTryRecv, 1)
+        .Func(_SC("close"), &Channel::Close)
+        .Func(_SC("isclosed"), &Channel::IsClosed)
+        .Func(_SC("len"), &Channel::Size)
+        .Func(_SC("capacity"), &Channel::Capacity)
+    );
+    root.SquirrelFunc(_SC("newchannel"), &sqChannelNew);
+    root.SquirrelFunc(_SC("newbuffer"), &sqBufferNew);
+}
+
+}
+
+#endif
@@ -35,7 +35,9 @@
 #include "sqratObject.h"
 #include "sqratClassType.h"
 #include "sqratMemberMethods.h"
+#include "sqratAsyncMethods.h"
 #include "sqratAllocator.h"
+#include "sqratMemory.h"
 #include "sqratTypes.h"
 
 namespace Sqrat
@@ -119,6 +121,7 @@ public:
             sq_addref(v, &classObj); // must addref before the pop!
             sq_pop(v, 1);
             InitClass(cd);
+            MemoryAccount::TrackClass(v, className, sizeof(C), &ClassInstances);
         }
     }
 
@@ -452,6 +455,49 @@ public:
         return *this;
     }
 
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Binds a class function whose result arrives later
+    ///
+    /// \param name   Name of the function as it will appear in Squirrel
+    /// \param method Function returning a std::future<R>, or taking an AsyncCallback<R> as its first parameter
+    ///
+    /// \tparam F Type of function (usually doesnt need to be defined explicitly)
+    ///
+    /// \return The Class itself so the call can be chained
+    ///
+    /// \remarks
+    /// See TableBase::AsyncFunc. The instance must outlive the work the function starts.
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    template<class F>
+    Class& AsyncFunc(const SQChar* name, F method) {
+        AsyncQueue::Get(vm);
+        BindFunc(name, &method, sizeof(method), SqAsyncMemberFunc(method));
+        return *this;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Binds a class function that runs on the shared ThreadPool instead of the VM's thread
+    ///
+    /// \param name   Name of the function as it will appear in Squirrel
+    /// \param method Const member function to bind (must not touch any VM)
+    ///
+    /// \tparam F Type of function (usually doesnt need to be defined explicitly)
+    ///
+    /// \return The Class itself so the call can be chained
+    ///
+    /// \remarks
+    /// See TableBase::OffloadFunc. The class must be marked with OffloadSafe, since scripts may keep using the instance
+    /// while the call runs. The instance is not copied, the call holds a reference to it until the result is back.
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    template<class F>
+    Class& OffloadFunc(const SQChar* name, F method) {
+        AsyncQueue::Get(vm);
+        BindFunc(name, &method, sizeof(method), SqOffloadMemberFunc(method));
+        return *this;
+    }
+
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     /// Binds a class function with overloading enabled
     ///
@@ -642,6 +688,10 @@ protected:
         }
     }
 
+    static size_t ClassInstances(HSQUIRRELVM vm) {
+        return ClassType<C>::getClassData(vm)->instances->size();
+    }
+
     // Initialize the required data structure for the class
     void InitClass(ClassData<C>* cd) {
         cd->instances.Init(new typename unordered_map<C*, HSQOBJECT>::type);
@@ -654,7 +704,7 @@ protected:
 
         // add the default constructor
         sq_pushstring(vm, _SC("constructor"), -1);
-        sq_newclosure(vm, &A::New, 0);
+        MemoryAccount::NewClosure(vm, &A::New, 0);
         sq_newslot(vm, -3, false);
 
         // add the set table (static)
@@ -706,6 +756,15 @@ protected:
         sq_pop(vm, 1);
     }
 
+    virtual string GetBindingScope() const {
+        return ClassType<C>::ClassName();
+    }
+
+    // Checks whether table is the get table of the class (the other accessor table being the set table)
+    bool IsGetTable(HSQOBJECT table) const {
+        return table._unVal.pTable == ClassType<C>::getClassData(vm)->getTable._unVal.pTable;
+    }
+
     // Helper function used to bind getters and setters
     inline void BindAccessor(const SQChar* name, void* var, size_t varSize, SQFUNCTION func, HSQOBJECT table) {
         // Push the get or set table
@@ -717,7 +776,7 @@ protected:
         memcpy(varPtr, var, varSize);
 
         // Create the accessor function
-        sq_newclosure(vm, func, 1);
+        NewBindingClosure(func, name, IsGetTable(table) ? _SC(" (get)") : _SC(" (set)"));
 
         // Add the accessor to the table
         sq_newslot(vm, -3, false);
@@ -754,7 +813,7 @@ protected:
 
         // Bind overloaded allocator function
         sq_pushstring(vm, overloadName.c_str(), -1);
-        sq_newclosure(vm, method, 0);
+        MemoryAccount::NewClosure(vm, method, 0);
         sq_setparamscheck(vm,nParams + 1,NULL);
         sq_newslot(vm, -3, false);
         sq_pop(vm, 1);
@@ -1035,6 +1094,7 @@ public:
             sq_addref(v, &classObj); // must addref before the pop!
             sq_pop(v, 1);
             InitDerivedClass(v, cd, bd);
+            MemoryAccount::TrackClass(v, className, sizeof(C), &Class<C, A>::ClassInstances);
         }
     }
 
@@ -1053,7 +1113,7 @@ protected:
 
         // add the default constructor
         sq_pushstring(vm, _SC("constructor"), -1);
-        sq_newclosure(vm, &A::New, 0);
+        MemoryAccount::NewClosure(vm, &A::New, 0);
         sq_newslot(vm, -3, false);
 
         // clone the base classes set table (static)
@@ -29,6 +29,7 @@
 #define _SCRAT_CLASSTYPE_H_
 
 #include <squirrel.h>
+#include <mutex>
 #include <typeinfo>
 
 #include "sqratUtil.h"
@@ -84,7 +85,10 @@ public:
         }
     };
     static SQRAT_API WeakPtr<AbstractStaticClassData>& _getStaticClassData(const std::type_info* type) {
+        // classes may be bound from several threads at once (one VM per thread), so the lookup is locked
+        static std::mutex lock;
         static std::map<const std::type_info*, WeakPtr<AbstractStaticClassData>, compare_type_info> data;
+        std::lock_guard<std::mutex> guard(lock);
         return data[type];
     }
 #endif
@@ -118,7 +122,9 @@ public:
     }
 
     static WeakPtr<AbstractStaticClassData>& getStaticClassData() {
-        return _ClassType_helper::_getStaticClassData(&typeid(C));
+        // map entries never move, so the lookup only has to be done once per type
+        static WeakPtr<AbstractStaticClassData>& data = _ClassType_helper::_getStaticClassData(&typeid(C));
+        return data;
     }
 
     static inline bool hasClassData(HSQUIRRELVM vm) {
@@ -140,17 +146,17 @@ public:
 
     static inline AbstractStaticClassData*& BaseClass() {
         assert(getStaticClassData().Expired() == false); // fails because called before a Sqrat::Class for this type exists
-        return getStaticClassData().Lock()->baseClass;
+        return getStaticClassData().Get()->baseClass;
     }
 
     static inline string& ClassName() {
         assert(getStaticClassData().Expired() == false); // fails because called before a Sqrat::Class for this type exists
-        return getStaticClassData().Lock()->className;
+        return getStaticClassData().Get()->className;
     }
 
     static inline COPYFUNC& CopyFunc() {
         assert(getStaticClassData().Expired() == false); // fails because called before a Sqrat::Class for this type exists
-        return getStaticClassData().Lock()->copyFunc;
+        return getStaticClassData().Get()->copyFunc;
     }
 
     static SQInteger DeleteInstance(SQUserPointer ptr, SQInteger size) {
@@ -213,7 +219,7 @@ public:
                 return NULL;
             }
 
-            classType = getStaticClassData().Lock().Get();
+            classType = getStaticClassData().Get();
 
 #if !defined (SCRAT_NO_ERROR_CHECKING)
             if (SQ_FAILED(sq_getinstanceup(vm, idx, (SQUserPointer*)&instance, classType, SQTrue))) {
@@ -226,7 +232,7 @@ public:
                 return NULL;
             }
 #else
-            sq_getinstanceup(vm, idx, (SQUserPointer*)&instance, 0);
+            sq_getinstanceup(vm, idx, (SQUserPointer*)&instance, 0, SQFalse);
 #endif
         }
         else /* value is likely of integral type like enums, cannot return a pointer */
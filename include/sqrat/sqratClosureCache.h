@@ -0,0 +1,241 @@
+//
+// SqratClosureCache: In-memory cache of closures compiled from strings
+//
+
+//
+// Copyright (c) 2009 Brandon Jones
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software. If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+#if !defined(_SCRAT_CLOSURE_CACHE_H_)
+#define _SCRAT_CLOSURE_CACHE_H_
+
+#include <squirrel.h>
+#include <list>
+
+#include "sqratBytecode.h"
+#include "sqratUtil.h"
+
+namespace Sqrat {
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Least recently used set of closures compiled from source strings in one VM
+///
+/// \remarks
+/// Compiling the same text again pushes the closure compiled the first time, so evaluating the same expression over and
+/// over only pays for the compiler once. Entries are keyed by the source text and the script name (which ends up in
+/// error messages). The cache holds a reference to each closure and releases it when the entry is dropped.
+///
+/// A ClosureCache belongs to a single VM and must be destroyed before it.
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class ClosureCache {
+public:
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Constructs an empty cache
+    ///
+    /// \param v        VM that compiles the closures
+    /// \param capacity Number of closures kept (0 disables the cache)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ClosureCache(HSQUIRRELVM v = DefaultVM::Get(), size_t capacity = 64)
+        : vm(v)
+        , m_capacity(capacity)
+        , m_hits(0)
+        , m_misses(0)
+    {
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Releases every closure in the cache
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ~ClosureCache() {
+        Clear();
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Pushes the closure of a source string, compiling it only if it is not in the cache
+    ///
+    /// \param source Squirrel source text
+    /// \param name   Name of the script (for errors)
+    ///
+    /// \return SQ_OK with the closure on the stack, or the error of sq_compilebuffer
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    SQRESULT Compile(const string& source, const string& name = _SC("")) {
+        unsigned long long key = Key(source, name);
+        Index::iterator found = m_index.find(key);
+        if (found != m_index.end() && found->second->source == source && found->second->name == name) {
+            m_entries.splice(m_entries.begin(), m_entries, found->second);
+            sq_pushobject(vm, found->second->closure);
+            ++m_hits;
+            return SQ_OK;
+        }
+
+        ++m_misses;
+        if (SQ_FAILED(sq_compilebuffer(vm, source.c_str(), static_cast<SQInteger>(source.size()), name.c_str(), true))) {
+            return SQ_ERROR;
+        }
+        if (m_capacity == 0) {
+            return SQ_OK;
+        }
+        if (found != m_index.end()) {
+            // another text with the same hash: the newer one takes the slot
+            drop(found);
+        }
+        Entry entry;
+        entry.key = key;
+        entry.source = source;
+        entry.name = name;
+        sq_getstackobj(vm, -1, &entry.closure);
+        sq_addref(vm, &entry.closure);
+        m_entries.push_front(entry);
+        m_index[key] = m_entries.begin();
+        trim();
+        return SQ_OK;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Drops the closure of a source string so the next Compile of it compiles again
+    ///
+    /// \param source Squirrel source text
+    /// \param name   Name of the script it was compiled with
+    ///
+    /// \return True if the source was in the cache
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool Invalidate(const string& source, const string& name = _SC("")) {
+        Index::iterator found = m_index.find(Key(source, name));
+        if (found == m_index.end() || found->second->source != source || found->second->name != name) {
+            return false;
+        }
+        drop(found);
+        return true;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Drops every closure in the cache
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Clear() {
+        for (Entries::iterator it = m_entries.begin(); it != m_entries.end(); ++it) {
+            sq_release(vm, &it->closure);
+        }
+        m_entries.clear();
+        m_index.clear();
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Changes the number of closures kept, dropping the least recently used ones if needed
+    ///
+    /// \param capacity Number of closures kept (0 disables the cache)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void SetCapacity(size_t capacity) {
+        m_capacity = capacity;
+        trim();
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the number of closures kept at most
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    size_t GetCapacity() const {
+        return m_capacity;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the number of closures currently in the cache
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    size_t GetSize() const {
+        return m_entries.size();
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the number of Compile calls served from the cache
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    size_t GetHits() const {
+        return m_hits;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the number of Compile calls that ran the compiler
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    size_t GetMisses() const {
+        return m_misses;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the VM the closures belong to
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    HSQUIRRELVM GetVM() const {
+        return vm;
+    }
+
+private:
+
+    ClosureCache(const ClosureCache&);
+    ClosureCache& operator=(const ClosureCache&);
+
+    struct Entry {
+        unsigned long long key;
+        string             source;
+        string             name;
+        HSQOBJECT          closure;
+    };
+
+    typedef std::list<Entry> Entries;
+    typedef unordered_map<unsigned long long, Entries::iterator>::type Index;
+
+    static unsigned long long Key(const string& source, const string& name) {
+        unsigned long long key = BytecodeHash(source.data(), source.size() * sizeof(SQChar));
+        return BytecodeHash(name.data(), name.size() * sizeof(SQChar), key);
+    }
+
+    void drop(Index::iterator found) {
+        sq_release(vm, &found->second->closure);
+        m_entries.erase(found->second);
+        m_index.erase(found);
+    }
+
+    void trim() {
+        while (m_entries.size() > m_capacity) {
+            drop(m_index.find(m_entries.back().key));
+        }
+    }
+
+    HSQUIRRELVM vm;
+    size_t      m_capacity;
+    size_t      m_hits;
+    size_t      m_misses;
+    Entries     m_entries;
+    Index       m_index;
+};
+
+}
+
+#endif
@@ -0,0 +1,450 @@
+//
+// SqratCompileCache: On-disk cache of compiled script files
+//
+
+//
+// Copyright (c) 2009 Brandon Jones
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software. If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+#if !defined(_SCRAT_COMPILE_CACHE_H_)
+#define _SCRAT_COMPILE_CACHE_H_
+
+#include <squirrel.h>
+#include <sqstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <direct.h>
+#include <sys/utime.h>
+#if !defined(NOMINMAX)
+#define NOMINMAX
+#endif
+#include <windows.h>
+// Windows defines fix (comes after the one in sqratObject.h, so redo it for Object::GetObject)
+#undef GetObject
+#else
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+#include "sqratBytecode.h"
+#include "sqratScript.h"
+#include "sqratUtil.h"
+
+namespace Sqrat {
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Directory of compiled script files reused across process starts
+///
+/// \remarks
+/// Each source file has one entry, named after a hash of its path, the compile options and the Squirrel build. An entry
+/// also records a hash of the source text, so an edited file is compiled again and its entry replaced. Entries are
+/// written to a temporary file and renamed into place, so VMs on other threads or in other processes never read a
+/// partial entry. When the directory grows past its limit the least recently used entries are removed (loading an entry
+/// counts as a use), and temporary files left behind by crashed writers are swept at the same time.
+///
+/// One CompileCache may be shared by any number of Scripts and VMs on any threads.
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class CompileCache : public CompileCacheBase {
+public:
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Constructs a cache in a directory (created if missing)
+    ///
+    /// \param directory Directory holding the entries
+    /// \param maxBytes  Total size of the entries above which the least recently used are removed (down to 3/4 of it)
+    /// \param options   Anything else the compiled code depends on (e.g. whether debug info is enabled)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    CompileCache(const std::string& directory, size_t maxBytes = 64 * 1024 * 1024, const string& options = string())
+        : m_directory(directory)
+        , m_options(options)
+        , m_maxBytes(maxBytes)
+        , m_hits(0)
+        , m_misses(0)
+        , m_totalBytes(0)
+        , m_scanned(false)
+    {
+#if defined(_WIN32)
+        _mkdir(m_directory.c_str());
+#else
+        mkdir(m_directory.c_str(), 0755);
+#endif
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Pushes the compiled closure of a script file, from the cache if it is up to date
+    ///
+    /// \param vm   VM to push the closure in
+    /// \param path Path of the script file
+    ///
+    /// \return SQ_OK with the closure on the stack, or the error of sqstd_loadfile
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    virtual SQRESULT Load(HSQUIRRELVM vm, const string& path) {
+        std::string source;
+        if (!ReadFile(NarrowPath(path), source)) {
+            return sqstd_loadfile(vm, path.c_str(), true);
+        }
+        unsigned long long key = EntryKey(path);
+        unsigned long long contentHash = Hash(source.data(), source.size());
+        std::string entry = EntryPath(key);
+
+        std::string cached;
+        if (ReadFile(entry, cached) && cached.size() > sizeof(Header)) {
+            Header header;
+            memcpy(&header, cached.data(), sizeof(Header));
+            if (memcmp(header.magic, "SQCC", 4) == 0 && header.format == FORMAT && header.key == key &&
+                header.contentHash == contentHash && header.contentSize == source.size()) {
+                Bytecode bytecode(cached.data() + sizeof(Header), cached.size() - sizeof(Header));
+                if (SQ_SUCCEEDED(sq_readclosure(vm, BytecodeReader, &bytecode))) {
+                    ++m_hits;
+                    Touch(entry);
+                    return SQ_OK;
+                }
+            }
+        }
+
+        ++m_misses;
+        if (SQ_FAILED(sqstd_loadfile(vm, path.c_str(), true))) {
+            return SQ_ERROR;
+        }
+        Store(vm, entry, key, contentHash, source.size());
+        return SQ_OK;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Removes every entry of the cache
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Clear() {
+        std::lock_guard<std::mutex> lock(m_evictLock);
+        std::vector<EntryInfo> entries;
+        ListEntries(entries, NULL);
+        for (size_t i = 0; i < entries.size(); ++i) {
+            remove(entries[i].path.c_str());
+        }
+        m_totalBytes = 0;
+        m_scanned = true;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the number of loads served from the cache
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    size_t GetHits() const {
+        return m_hits;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the number of loads that had to compile the script
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    size_t GetMisses() const {
+        return m_misses;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the directory holding the entries
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    const std::string& GetDirectory() const {
+        return m_directory;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// 64-bit FNV-1a hash of a block of memory (see BytecodeHash)
+    ///
+    /// \param data Memory to hash
+    /// \param size Number of bytes
+    /// \param seed Hash to continue from (to hash several blocks as one)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static unsigned long long Hash(const void* data, size_t size, unsigned long long seed = 14695981039346656037ULL) {
+        return BytecodeHash(data, size, seed);
+    }
+
+    /// @cond DEV
+
+    // Suffix of a temporary file that is unique across processes (the id) and across the threads of this process (the
+    // counter), for writers that publish a file by renaming it into place
+    static std::string TempSuffix() {
+        char suffix[64];
+        sprintf(suffix, ".%lu.%lu.tmp", processId(), static_cast<unsigned long>(tempCounter()++));
+        return suffix;
+    }
+
+    /// @endcond
+
+private:
+
+    CompileCache(const CompileCache&);
+    CompileCache& operator=(const CompileCache&);
+
+    static const unsigned FORMAT = 1;
+    static const time_t   STALE_TEMP_SECONDS = 3600; // Age after which a temporary file is taken to be abandoned
+
+    // Start of every entry, followed by the bytecode
+    struct Header {
+        char               magic[4];
+        unsigned           format;
+        unsigned long long key;
+        unsigned long long contentHash;
+        unsigned long long contentSize;
+    };
+
+    struct EntryInfo {
+        std::string path;
+        size_t      size;
+        time_t      mtime;
+
+        bool operator<(const EntryInfo& other) const {
+            return mtime < other.mtime;
+        }
+    };
+
+    // Identifies the entry of a source path under this cache's options and the Squirrel build
+    unsigned long long EntryKey(const string& path) const {
+        unsigned long long key = Hash(path.data(), path.size() * sizeof(SQChar));
+        key = Hash(m_options.data(), m_options.size() * sizeof(SQChar), key);
+        int build[4] = {
+#if defined(SQUIRREL_VERSION_NUMBER)
+            SQUIRREL_VERSION_NUMBER,
+#else
+            0,
+#endif
+            static_cast<int>(sizeof(SQChar)), static_cast<int>(sizeof(SQInteger)), static_cast<int>(sizeof(SQFloat))
+        };
+        return Hash(build, sizeof(build), key);
+    }
+
+    std::string EntryPath(unsigned long long key) const {
+        char name[32];
+        sprintf(name, "%016llx.sqcc", key);
+        return m_directory + "/" + name;
+    }
+
+    static std::string NarrowPath(const string& path) {
+#if defined(SQUNICODE)
+        return wstring_to_string(path);
+#else
+        return path;
+#endif
+    }
+
+    static bool ReadFile(const std::string& path, std::string& contents) {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (file == NULL) {
+            return false;
+        }
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        bool ok = size >= 0;
+        if (ok) {
+            contents.resize(static_cast<size_t>(size));
+            ok = size == 0 || fread(&contents[0], 1, contents.size(), file) == contents.size();
+        }
+        fclose(file);
+        return ok;
+    }
+
+    static SQInteger FileWriter(SQUserPointer file, SQUserPointer data, SQInteger size) {
+        return static_cast<SQInteger>(fwrite(data, 1, static_cast<size_t>(size), static_cast<FILE*>(file)));
+    }
+
+    // Writes the closure on top of the stack as the entry (the closure stays on the stack)
+    void Store(HSQUIRRELVM vm, const std::string& entry, unsigned long long key, unsigned long long contentHash, size_t contentSize) {
+        std::string temp = entry + TempSuffix();
+        FILE* file = fopen(temp.c_str(), "wb");
+        if (file == NULL) {
+            return;
+        }
+        Header header;
+        memcpy(header.magic, "SQCC", 4);
+        header.format = FORMAT;
+        header.key = key;
+        header.contentHash = contentHash;
+        header.contentSize = contentSize;
+        bool ok = fwrite(&header, sizeof(Header), 1, file) == 1 && SQ_SUCCEEDED(sq_writeclosure(vm, FileWriter, file));
+        long size = ftell(file);
+        ok = (fclose(file) == 0) && ok && size > 0;
+        size_t replaced = FileSize(entry);
+        if (!ok || !Publish(temp, entry)) {
+            remove(temp.c_str());
+            return;
+        }
+        Account(static_cast<size_t>(size), replaced);
+    }
+
+    static size_t FileSize(const std::string& path) {
+        struct stat st;
+        return stat(path.c_str(), &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+    }
+
+    // Marks an entry as just used, so that eviction keeps it longer
+    static void Touch(const std::string& path) {
+#if defined(_WIN32)
+        _utime(path.c_str(), NULL);
+#else
+        utime(path.c_str(), NULL);
+#endif
+    }
+
+    static unsigned long processId() {
+#if defined(_WIN32)
+        return static_cast<unsigned long>(GetCurrentProcessId());
+#else
+        return static_cast<unsigned long>(getpid());
+#endif
+    }
+
+    static std::atomic<size_t>& tempCounter() {
+        static std::atomic<size_t> counter(0);
+        return counter;
+    }
+
+    // Moves a finished temporary file over the entry in one step
+    static bool Publish(const std::string& temp, const std::string& entry) {
+#if defined(_WIN32)
+        return MoveFileExA(temp.c_str(), entry.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        return rename(temp.c_str(), entry.c_str()) == 0;
+#endif
+    }
+
+    // Lists the entries, and the temporary files of unfinished (or abandoned) writes if temps is not NULL
+    void ListEntries(std::vector<EntryInfo>& entries, std::vector<EntryInfo>* temps) const {
+#if defined(_WIN32)
+        ListMatching(m_directory + "/*.sqcc", entries);
+        if (temps != NULL) {
+            ListMatching(m_directory + "/*.sqcc.*.tmp", *temps);
+        }
+#else
+        DIR* dir = opendir(m_directory.c_str());
+        if (dir == NULL) {
+            return;
+        }
+        while (dirent* item = readdir(dir)) {
+            std::string name(item->d_name);
+            if (name.size() > 5 && name.compare(name.size() - 5, 5, ".sqcc") == 0) {
+                AddEntry(entries, m_directory + "/" + name);
+            } else if (temps != NULL && name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0 &&
+                       name.find(".sqcc.") != std::string::npos) {
+                AddEntry(*temps, m_directory + "/" + name);
+            }
+        }
+        closedir(dir);
+#endif
+    }
+
+#if defined(_WIN32)
+    void ListMatching(const std::string& pattern, std::vector<EntryInfo>& entries) const {
+        WIN32_FIND_DATAA data;
+        HANDLE find = FindFirstFileA(pattern.c_str(), &data);
+        if (find == INVALID_HANDLE_VALUE) {
+            return;
+        }
+        do {
+            AddEntry(entries, m_directory + "/" + data.cFileName);
+        } while (FindNextFileA(find, &data));
+        FindClose(find);
+    }
+#endif
+
+    static void AddEntry(std::vector<EntryInfo>& entries, const std::string& path) {
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0) {
+            EntryInfo info;
+            info.path = path;
+            info.size = static_cast<size_t>(st.st_size);
+            info.mtime = st.st_mtime;
+            entries.push_back(info);
+        }
+    }
+
+    // Counts a stored entry, and scans the directory the first time or once the count goes past maxBytes
+    // (entries written by other processes are only seen by the next scan)
+    void Account(size_t added, size_t replaced) {
+        std::lock_guard<std::mutex> lock(m_evictLock);
+        size_t total = m_totalBytes + added;
+        total = total > replaced ? total - replaced : 0;
+        if (!m_scanned || total > m_maxBytes) {
+            Evict();
+        } else {
+            m_totalBytes = total;
+        }
+    }
+
+    // Recounts the directory, sweeps abandoned temporary files and, if it is over maxBytes, removes the least recently
+    // used entries until it is down to 3/4 of it, so that the next scan is many stores away (m_evictLock must be held)
+    void Evict() {
+        std::vector<EntryInfo> entries;
+        std::vector<EntryInfo> temps;
+        ListEntries(entries, &temps);
+        time_t now = time(NULL);
+        for (size_t i = 0; i < temps.size(); ++i) {
+            if (now - temps[i].mtime > STALE_TEMP_SECONDS) {
+                remove(temps[i].path.c_str());
+            }
+        }
+        size_t total = 0;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            total += entries[i].size;
+        }
+        if (total > m_maxBytes) {
+            size_t target = m_maxBytes - m_maxBytes / 4;
+            std::sort(entries.begin(), entries.end());
+            for (size_t i = 0; i < entries.size() && total > target; ++i) {
+                if (remove(entries[i].path.c_str()) == 0) {
+                    total -= entries[i].size;
+                }
+            }
+        }
+        m_totalBytes = total;
+        m_scanned = true;
+    }
+
+    std::string         m_directory;
+    string              m_options;
+    size_t              m_maxBytes;
+    std::atomic<size_t> m_hits;
+    std::atomic<size_t> m_misses;
+    std::mutex          m_evictLock;  // guards the directory scans and the fields below
+    size_t              m_totalBytes; // size of the entries as last counted plus what this cache stored since
+    bool                m_scanned;
+};
+
+}
+
+#endif
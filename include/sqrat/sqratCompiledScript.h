@@ -0,0 +1,174 @@
+//
+// SqratCompiledScript: Immutable bytecode image shared between VMs
+//
+
+//
+// Copyright (c) 2009 Brandon Jones
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software. If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+#if !defined(_SCRAT_COMPILED_SCRIPT_H_)
+#define _SCRAT_COMPILED_SCRIPT_H_
+
+#include <squirrel.h>
+#include <sqstdio.h>
+#include <memory>
+#include <vector>
+
+#include "sqratBytecode.h"
+#include "sqratUtil.h"
+
+namespace Sqrat {
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Script compiled once and instantiated in any number of VMs
+///
+/// \remarks
+/// A CompiledScript holds the output of sq_writeclosure. The image never changes after it is made, and copies share it,
+/// so one CompiledScript can be handed to VMs on many threads at once. Each VM reads its closure straight from the shared
+/// image (see Push and the Script constructor taking a CompiledScript) without compiling or touching the file system.
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class CompiledScript {
+public:
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Constructs an empty CompiledScript
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    CompiledScript() {
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Constructs a CompiledScript from a copy of existing bytecode
+    ///
+    /// \param data Bytecode written by sq_writeclosure
+    /// \param size Number of bytes
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    CompiledScript(const void* data, size_t size) {
+        if (size > 0) {
+            const char* bytes = static_cast<const char*>(data);
+            m_image = std::make_shared<const std::vector<char> >(bytes, bytes + size);
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Compiles a string containing a Squirrel script
+    ///
+    /// \param vm     VM used to compile (the image does not depend on it afterwards)
+    /// \param script String containing a Squirrel script
+    /// \param name   Optional string containing the script's name (for errors)
+    ///
+    /// \return The compiled script, or an empty one if compiling failed
+    ///
+    /// \remarks
+    /// This function MUST have its Error handled if it occurred.
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static CompiledScript FromString(HSQUIRRELVM vm, const string& script, const string& name = _SC("")) {
+        if (SQ_FAILED(sq_compilebuffer(vm, script.c_str(), static_cast<SQInteger>(script.size()), name.c_str(), true))) {
+            SQTHROW(vm, LastErrorString(vm));
+            return CompiledScript();
+        }
+        return fromTop(vm);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Compiles a file containing a Squirrel script (or loads its bytecode)
+    ///
+    /// \param vm   VM used to compile (the image does not depend on it afterwards)
+    /// \param path File path containing a Squirrel script
+    ///
+    /// \return The compiled script, or an empty one if loading failed
+    ///
+    /// \remarks
+    /// This function MUST have its Error handled if it occurred.
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static CompiledScript FromFile(HSQUIRRELVM vm, const string& path) {
+        if (SQ_FAILED(sqstd_loadfile(vm, path.c_str(), true))) {
+            SQTHROW(vm, LastErrorString(vm));
+            return CompiledScript();
+        }
+        return fromTop(vm);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Pushes a new closure read from the image
+    ///
+    /// \param vm VM to create the closure in (may be called from any thread that owns vm)
+    ///
+    /// \return SQ_OK with the closure on the stack, or SQ_ERROR if the image is empty or invalid
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    SQRESULT Push(HSQUIRRELVM vm) const {
+        if (IsEmpty()) {
+            return SQ_ERROR;
+        }
+        Bytecode bytecode(Data(), Size());
+        return sq_readclosure(vm, BytecodeReader, &bytecode);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the bytecode of the image (NULL if empty)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    const void* Data() const {
+        return m_image ? &(*m_image)[0] : NULL;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the size of the image in bytes
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    size_t Size() const {
+        return m_image ? m_image->size() : 0;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Checks whether there is an image
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool IsEmpty() const {
+        return !m_image;
+    }
+
+private:
+
+    // Writes the closure on top of the stack into a new image and pops it
+    static CompiledScript fromTop(HSQUIRRELVM vm) {
+        Bytecode bytecode;
+        SQRESULT result = sq_writeclosure(vm, BytecodeWriter, &bytecode);
+        sq_pop(vm, 1);
+        if (SQ_FAILED(result)) {
+            SQTHROW(vm, LastErrorString(vm));
+            return CompiledScript();
+        }
+        return CompiledScript(bytecode.Data(), bytecode.Size());
+    }
+
+    std::shared_ptr<const std::vector<char> > m_image;
+};
+
+}
+
+#endif
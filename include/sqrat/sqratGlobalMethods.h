@@ -30,6 +30,7 @@
 #define _SCRAT_GLOBAL_METHODS_H_
 
 #include <squirrel.h>
+#include "sqratInstrumentation.h"
 #include "sqratTypes.h"
 
 namespace Sqrat {
@@ -58,7 +59,9 @@ public:
         sq_getuserdata(vm, -1, (SQUserPointer*)&method, NULL);
 
         SQTRY()
+        SQRAT_CALLEE_BEGIN();
         R ret = (*method)();
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -88,9 +91,11 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (*method)(
                     a1.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -121,10 +126,12 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (*method)(
                     a1.value,
                     a2.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -156,11 +163,13 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (*method)(
                     a1.value,
                     a2.value,
                     a3.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -193,12 +202,14 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (*method)(
                     a1.value,
                     a2.value,
                     a3.value,
                     a4.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -232,6 +243,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (*method)(
                     a1.value,
                     a2.value,
@@ -239,6 +251,7 @@ public:
                     a4.value,
                     a5.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -273,6 +286,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (*method)(
                     a1.value,
                     a2.value,
@@ -281,6 +295,7 @@ public:
                     a5.value,
                     a6.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -316,6 +331,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (*method)(
                     a1.value,
                     a2.value,
@@ -325,6 +341,7 @@ public:
                     a6.value,
                     a7.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -361,6 +378,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (*method)(
                     a1.value,
                     a2.value,
@@ -371,6 +389,7 @@ public:
                     a7.value,
                     a8.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -408,6 +427,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (*method)(
                     a1.value,
                     a2.value,
@@ -419,6 +439,7 @@ public:
                     a8.value,
                     a9.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -457,6 +478,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (*method)(
                     a1.value,
                     a2.value,
@@ -469,6 +491,7 @@ public:
                     a9.value,
                     a10.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -508,6 +531,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (*method)(
                     a1.value,
                     a2.value,
@@ -521,6 +545,7 @@ public:
                     a10.value,
                     a11.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -561,6 +586,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (*method)(
                     a1.value,
                     a2.value,
@@ -575,6 +601,7 @@ public:
                     a11.value,
                     a12.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -616,6 +643,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (*method)(
                     a1.value,
                     a2.value,
@@ -631,6 +659,7 @@ public:
                     a12.value,
                     a13.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -673,6 +702,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (*method)(
                     a1.value,
                     a2.value,
@@ -689,6 +719,7 @@ public:
                     a13.value,
                     a14.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -724,7 +755,9 @@ public:
         sq_getuserdata(vm, -1, (SQUserPointer*)&method, NULL);
 
         SQTRY()
+        SQRAT_CALLEE_BEGIN();
         R& ret = (*method)();
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -754,9 +787,11 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (*method)(
                     a1.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -787,10 +822,12 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (*method)(
                     a1.value,
                     a2.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -822,11 +859,13 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (*method)(
                     a1.value,
                     a2.value,
                     a3.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -859,12 +898,14 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (*method)(
                     a1.value,
                     a2.value,
                     a3.value,
                     a4.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -898,6 +939,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (*method)(
                     a1.value,
                     a2.value,
@@ -905,6 +947,7 @@ public:
                     a4.value,
                     a5.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -939,6 +982,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (*method)(
                     a1.value,
                     a2.value,
@@ -947,6 +991,7 @@ public:
                     a5.value,
                     a6.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -982,6 +1027,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (*method)(
                     a1.value,
                     a2.value,
@@ -991,6 +1037,7 @@ public:
                     a6.value,
                     a7.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1027,6 +1074,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (*method)(
                     a1.value,
                     a2.value,
@@ -1037,6 +1085,7 @@ public:
                     a7.value,
                     a8.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1074,6 +1123,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (*method)(
                     a1.value,
                     a2.value,
@@ -1085,6 +1135,7 @@ public:
                     a8.value,
                     a9.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1123,6 +1174,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (*method)(
                     a1.value,
                     a2.value,
@@ -1135,6 +1187,7 @@ public:
                     a9.value,
                     a10.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1174,6 +1227,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (*method)(
                     a1.value,
                     a2.value,
@@ -1187,6 +1241,7 @@ public:
                     a10.value,
                     a11.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1227,6 +1282,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (*method)(
                     a1.value,
                     a2.value,
@@ -1241,6 +1297,7 @@ public:
                     a11.value,
                     a12.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1282,6 +1339,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (*method)(
                     a1.value,
                     a2.value,
@@ -1297,6 +1355,7 @@ public:
                     a12.value,
                     a13.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1339,6 +1398,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (*method)(
                     a1.value,
                     a2.value,
@@ -1355,6 +1415,7 @@ public:
                     a13.value,
                     a14.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1390,7 +1451,9 @@ public:
         sq_getuserdata(vm, -1, (SQUserPointer*)&method, NULL);
 
         SQTRY()
+        SQRAT_CALLEE_BEGIN();
         (*method)();
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1419,9 +1482,11 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (*method)(
             a1.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1451,10 +1516,12 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (*method)(
             a1.value,
             a2.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1485,11 +1552,13 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (*method)(
             a1.value,
             a2.value,
             a3.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1521,12 +1590,14 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (*method)(
             a1.value,
             a2.value,
             a3.value,
             a4.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1559,6 +1630,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (*method)(
             a1.value,
             a2.value,
@@ -1566,6 +1638,7 @@ public:
             a4.value,
             a5.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1599,6 +1672,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (*method)(
             a1.value,
             a2.value,
@@ -1607,6 +1681,7 @@ public:
             a5.value,
             a6.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1641,6 +1716,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (*method)(
             a1.value,
             a2.value,
@@ -1650,6 +1726,7 @@ public:
             a6.value,
             a7.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1685,6 +1762,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (*method)(
             a1.value,
             a2.value,
@@ -1695,6 +1773,7 @@ public:
             a7.value,
             a8.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1731,6 +1810,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (*method)(
             a1.value,
             a2.value,
@@ -1742,6 +1822,7 @@ public:
             a8.value,
             a9.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1779,6 +1860,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (*method)(
             a1.value,
             a2.value,
@@ -1791,6 +1873,7 @@ public:
             a9.value,
             a10.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1829,6 +1912,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (*method)(
             a1.value,
             a2.value,
@@ -1842,6 +1926,7 @@ public:
             a10.value,
             a11.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1881,6 +1966,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (*method)(
             a1.value,
             a2.value,
@@ -1895,6 +1981,7 @@ public:
             a11.value,
             a12.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1935,6 +2022,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (*method)(
             a1.value,
             a2.value,
@@ -1950,6 +2038,7 @@ public:
             a12.value,
             a13.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1991,6 +2080,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (*method)(
             a1.value,
             a2.value,
@@ -2007,6 +2097,7 @@ public:
             a13.value,
             a14.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -0,0 +1,494 @@
+//
+// SqratInstrumentation: Opt-in call counters and timings of native bindings
+//
+
+//
+// Copyright (c) 2009 Brandon Jones
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software. If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+#if !defined(_SCRAT_INSTRUMENTATION_H_)
+#define _SCRAT_INSTRUMENTATION_H_
+
+#include <squirrel.h>
+#include <vector>
+
+#if defined(SCRAT_ENABLE_INSTRUMENTATION)
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <map>
+#endif
+
+#include "sqratMemory.h"
+#include "sqratUtil.h"
+
+namespace Sqrat {
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Counters of one native binding (see Instrumentation)
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct BindingCounters {
+    BindingCounters() : calls(0), errors(0), totalNs(0), maxNs(0), calleeNs(0) {
+    }
+
+    string             name;     ///< Class.function for class members, function for tables; accessors end in " (get)" or " (set)"
+    unsigned long long calls;    ///< Number of calls
+    unsigned long long errors;   ///< Number of calls that raised a script error
+    unsigned long long totalNs;  ///< Time spent in the binding, callee included
+    unsigned long long maxNs;    ///< Longest call
+    unsigned long long calleeNs; ///< Time spent in the bound C++ function itself (totalNs - calleeNs is marshalling)
+};
+
+/// @cond DEV
+
+// Tracks which Sqrat tool (Trace or Profiler) owns the native debug hook of a VM, since a VM only has one
+class NativeDebugHook {
+public:
+
+    // Installs hook on behalf of owner, unless another owner holds the VM's hook already
+    static bool Claim(HSQUIRRELVM vm, const SQChar* owner, SQDEBUGHOOK hook) {
+        sq_pushregistrytable(vm);
+        sq_pushstring(vm, RegistryKey(), -1);
+        if (SQ_SUCCEEDED(sq_rawget(vm, -2))) {
+            const SQChar* holder = NULL;
+            sq_getstring(vm, -1, &holder);
+            bool mine = holder != NULL && string(holder) == owner;
+            sq_pop(vm, 2);
+            if (!mine) {
+                return false;
+            }
+        } else {
+            sq_pushstring(vm, RegistryKey(), -1);
+            sq_pushstring(vm, owner, -1);
+            sq_rawset(vm, -3);
+            sq_pop(vm, 1);
+        }
+        sq_setnativedebughook(vm, hook);
+        return true;
+    }
+
+    // Removes the hook if owner holds it
+    static void Release(HSQUIRRELVM vm, const SQChar* owner) {
+        sq_pushregistrytable(vm);
+        sq_pushstring(vm, RegistryKey(), -1);
+        if (SQ_SUCCEEDED(sq_rawget(vm, -2))) {
+            const SQChar* holder = NULL;
+            sq_getstring(vm, -1, &holder);
+            bool mine = holder != NULL && string(holder) == owner;
+            sq_pop(vm, 1);
+            if (mine) {
+                sq_pushstring(vm, RegistryKey(), -1);
+                sq_rawdeleteslot(vm, -2, SQFalse);
+                sq_setnativedebughook(vm, NULL);
+            }
+        }
+        sq_pop(vm, 1);
+    }
+
+private:
+
+    static const SQChar* RegistryKey() {
+        return _SC("__sqrat_debughook__");
+    }
+};
+
+/// @endcond
+
+#if defined(SCRAT_ENABLE_INSTRUMENTATION)
+
+/// @cond DEV
+
+// Marks the call of the bound C++ function inside a dispatcher
+#define SQRAT_CALLEE_BEGIN() Sqrat::Instrumentation::CalleeBegin()
+#define SQRAT_CALLEE_END()   Sqrat::Instrumentation::CalleeEnd()
+
+/// @endcond
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Per-binding call counts and native time, compiled in with SCRAT_ENABLE_INSTRUMENTATION
+///
+/// \remarks
+/// When the macro is defined, every function, overload and variable accessor bound through Sqrat goes through a
+/// counting dispatcher that records its calls, errors and time, and the dispatchers split that time between
+/// marshalling and the bound C++ function. Without the macro nothing is recorded, the bindings are the same as
+/// before and Snapshot is always empty.
+///
+/// \remarks
+/// Counters belong to the VM the bindings were made in and live until it is closed. Snapshot and Reset must be called
+/// from the thread running the VM (between frames, for instance); scripts can use the functions added by Register.
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class Instrumentation {
+public:
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Checks whether instrumentation is compiled in
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static bool IsEnabled() {
+        return true;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the counters of every binding of a VM that has been called, busiest first
+    ///
+    /// \param vm Target VM
+    ///
+    /// \return Counters of each binding (bindings of the same name are added together)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static std::vector<BindingCounters> Snapshot(HSQUIRRELVM vm) {
+        std::vector<BindingCounters> result;
+        Data* data = find(vm);
+        if (data == NULL) {
+            return result;
+        }
+        std::map<string, size_t> index;
+        for (std::list<Binding>::const_iterator it = data->bindings.begin(); it != data->bindings.end(); ++it) {
+            if (it->counters.calls == 0) {
+                continue;
+            }
+            std::map<string, size_t>::iterator found = index.find(it->counters.name);
+            if (found == index.end()) {
+                index[it->counters.name] = result.size();
+                result.push_back(it->counters);
+            } else {
+                BindingCounters& total = result[found->second];
+                total.calls += it->counters.calls;
+                total.errors += it->counters.errors;
+                total.totalNs += it->counters.totalNs;
+                total.calleeNs += it->counters.calleeNs;
+                if (it->counters.maxNs > total.maxNs) {
+                    total.maxNs = it->counters.maxNs;
+                }
+            }
+        }
+        std::sort(result.begin(), result.end(), busier);
+        return result;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Sets every counter of a VM back to zero
+    ///
+    /// \param vm Target VM
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static void Reset(HSQUIRRELVM vm) {
+        Data* data = find(vm);
+        if (data == NULL) {
+            return;
+        }
+        for (std::list<Binding>::iterator it = data->bindings.begin(); it != data->bindings.end(); ++it) {
+            string name = it->counters.name;
+            it->counters = BindingCounters();
+            it->counters.name = name;
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Adds instrumentation_snapshot() and instrumentation_reset() to the root table of a VM
+    ///
+    /// \param vm Target VM
+    ///
+    /// \remarks
+    /// instrumentation_snapshot returns an array of tables with the fields of BindingCounters (name, calls, errors,
+    /// total_ns, max_ns, callee_ns and marshal_ns).
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static void Register(HSQUIRRELVM vm) {
+        sq_pushroottable(vm);
+        sq_pushstring(vm, _SC("instrumentation_snapshot"), -1);
+        sq_newclosure(vm, &snapshotFunc, 0);
+        sq_newslot(vm, -3, false);
+        sq_pushstring(vm, _SC("instrumentation_reset"), -1);
+        sq_newclosure(vm, &resetFunc, 0);
+        sq_newslot(vm, -3, false);
+        sq_pop(vm, 1);
+    }
+
+    /// @cond DEV
+
+    // Replaces sq_newclosure(vm, func, 1) for a binding whose userdata is on top of the stack
+    static void NewClosure(HSQUIRRELVM vm, SQFUNCTION func, const string& name) {
+        Data* data = get(vm);
+        data->bindings.push_back(Binding());
+        Binding& binding = data->bindings.back();
+        binding.func = func;
+        binding.counters.name = name;
+
+        // the binding goes below the userdata, so the dispatcher sees the userdata at -1 as it expects
+        sq_pushuserpointer(vm, &binding);
+        sq_push(vm, -2);
+        sq_remove(vm, -3);
+        MemoryAccount::NewClosure(vm, &dispatch, 2);
+    }
+
+    // Called with enter set to true before, and to false after, every instrumented binding call (see Profiler, Trace)
+    typedef void (*Observer)(HSQUIRRELVM vm, const BindingCounters& binding, bool enter);
+
+    // Adds an observer once; there is room for MAX_OBSERVERS of them and they are never removed
+    static void AddObserver(Observer observer) {
+        for (int i = 0; i < MAX_OBSERVERS; ++i) {
+            Observer expected = NULL;
+            if (observerSlot(i).compare_exchange_strong(expected, observer) || expected == observer) {
+                return;
+            }
+        }
+    }
+
+    static void CalleeBegin() {
+        Frame* frame = current();
+        if (frame != NULL) {
+            frame->calleeStart = now();
+        }
+    }
+
+    static void CalleeEnd() {
+        Frame* frame = current();
+        if (frame != NULL && frame->calleeStart != 0) {
+            frame->calleeNs += now() - frame->calleeStart;
+            frame->calleeStart = 0;
+        }
+    }
+
+    /// @endcond
+
+private:
+
+    static const int MAX_OBSERVERS = 4;
+
+    struct Binding {
+        SQFUNCTION      func;
+        BindingCounters counters;
+    };
+
+    struct Data {
+        std::list<Binding> bindings; // a list so that dispatchers can keep pointers to its elements
+    };
+
+    // Call of a binding in progress on this thread (calls nest when a binding calls back into a script)
+    struct Frame {
+        Frame(Binding* b) : binding(b), start(now()), calleeStart(0), calleeNs(0), previous(current()) {
+            current() = this;
+        }
+
+        ~Frame() {
+            unsigned long long end = now();
+            if (calleeStart != 0) { // the callee threw
+                calleeNs += end - calleeStart;
+            }
+            unsigned long long elapsed = end - start;
+            BindingCounters& counters = binding->counters;
+            ++counters.calls;
+            counters.totalNs += elapsed;
+            counters.calleeNs += calleeNs;
+            if (elapsed > counters.maxNs) {
+                counters.maxNs = elapsed;
+            }
+            current() = previous;
+        }
+
+        Binding*           binding;
+        unsigned long long start;
+        unsigned long long calleeStart;
+        unsigned long long calleeNs;
+        Frame*             previous;
+    };
+
+    static unsigned long long now() {
+        return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    static Frame*& current() {
+        static thread_local Frame* frame = NULL;
+        return frame;
+    }
+
+    static SQInteger dispatch(HSQUIRRELVM vm) {
+        SQUserPointer ptr;
+        sq_getuserpointer(vm, -2, &ptr);
+        sq_remove(vm, -2);
+        Binding* binding = static_cast<Binding*>(ptr);
+        if (observerSlot(0).load(std::memory_order_relaxed) == NULL) {
+            return call(vm, binding);
+        }
+        notify(vm, binding, true);
+        SQInteger result = call(vm, binding);
+        notify(vm, binding, false);
+        return result;
+    }
+
+    static void notify(HSQUIRRELVM vm, Binding* binding, bool enter) {
+        for (int i = 0; i < MAX_OBSERVERS; ++i) {
+            Observer observer = observerSlot(i).load(std::memory_order_relaxed);
+            if (observer == NULL) {
+                break;
+            }
+            observer(vm, binding->counters, enter);
+        }
+    }
+
+    static SQInteger call(HSQUIRRELVM vm, Binding* binding) {
+        Frame frame(binding);
+        SQInteger result = binding->func(vm);
+        if (SQ_FAILED(result)) {
+            ++binding->counters.errors;
+        }
+        return result;
+    }
+
+    static std::atomic<Observer>& observerSlot(int i) {
+        static std::atomic<Observer> observers[MAX_OBSERVERS];
+        return observers[i];
+    }
+
+    static bool busier(const BindingCounters& a, const BindingCounters& b) {
+        return a.totalNs > b.totalNs;
+    }
+
+    static const SQChar* registryKey() {
+        return _SC("__sqrat_instrumentation__");
+    }
+
+    static Data* find(HSQUIRRELVM vm) {
+        Data* data = NULL;
+        sq_pushregistrytable(vm);
+        sq_pushstring(vm, registryKey(), -1);
+        if (SQ_SUCCEEDED(sq_rawget(vm, -2))) {
+            SQUserPointer ud;
+            if (SQ_SUCCEEDED(sq_getuserdata(vm, -1, &ud, NULL))) {
+                data = *reinterpret_cast<Data**>(ud);
+            }
+            sq_pop(vm, 1);
+        }
+        sq_pop(vm, 1);
+        return data;
+    }
+
+    static Data* get(HSQUIRRELVM vm) {
+        Data* data = find(vm);
+        if (data == NULL) {
+            sq_pushregistrytable(vm);
+            sq_pushstring(vm, registryKey(), -1);
+            Data** ud = reinterpret_cast<Data**>(sq_newuserdata(vm, sizeof(Data*)));
+            *ud = data = new Data();
+            sq_setreleasehook(vm, -1, &release);
+            sq_rawset(vm, -3);
+            sq_pop(vm, 1);
+        }
+        return data;
+    }
+
+    static SQInteger release(SQUserPointer ptr, SQInteger /*size*/) {
+        delete *reinterpret_cast<Data**>(ptr);
+        return 0;
+    }
+
+    static void pushInteger(HSQUIRRELVM vm, const SQChar* key, unsigned long long value) {
+        sq_pushstring(vm, key, -1);
+        sq_pushinteger(vm, static_cast<SQInteger>(value));
+        sq_newslot(vm, -3, false);
+    }
+
+    static SQInteger snapshotFunc(HSQUIRRELVM vm) {
+        std::vector<BindingCounters> counters = Snapshot(vm);
+        sq_newarray(vm, 0);
+        for (size_t i = 0; i < counters.size(); ++i) {
+            sq_newtable(vm);
+            sq_pushstring(vm, _SC("name"), -1);
+            sq_pushstring(vm, counters[i].name.c_str(), static_cast<SQInteger>(counters[i].name.size()));
+            sq_newslot(vm, -3, false);
+            pushInteger(vm, _SC("calls"), counters[i].calls);
+            pushInteger(vm, _SC("errors"), counters[i].errors);
+            pushInteger(vm, _SC("total_ns"), counters[i].totalNs);
+            pushInteger(vm, _SC("max_ns"), counters[i].maxNs);
+            pushInteger(vm, _SC("callee_ns"), counters[i].calleeNs);
+            pushInteger(vm, _SC("marshal_ns"), counters[i].totalNs - counters[i].calleeNs);
+            sq_arrayappend(vm, -2);
+        }
+        return 1;
+    }
+
+    static SQInteger resetFunc(HSQUIRRELVM vm) {
+        Reset(vm);
+        return 0;
+    }
+};
+
+#else
+
+/// @cond DEV
+
+#define SQRAT_CALLEE_BEGIN()
+#define SQRAT_CALLEE_END()
+
+/// @endcond
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Per-binding call counts and native time (compiled out: define SCRAT_ENABLE_INSTRUMENTATION to record them)
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class Instrumentation {
+public:
+
+    static bool IsEnabled() {
+        return false;
+    }
+
+    static std::vector<BindingCounters> Snapshot(HSQUIRRELVM /*vm*/) {
+        return std::vector<BindingCounters>();
+    }
+
+    static void Reset(HSQUIRRELVM /*vm*/) {
+    }
+
+    static void Register(HSQUIRRELVM vm) {
+        sq_pushroottable(vm);
+        sq_pushstring(vm, _SC("instrumentation_snapshot"), -1);
+        sq_newclosure(vm, &snapshotFunc, 0);
+        sq_newslot(vm, -3, false);
+        sq_pushstring(vm, _SC("instrumentation_reset"), -1);
+        sq_newclosure(vm, &resetFunc, 0);
+        sq_newslot(vm, -3, false);
+        sq_pop(vm, 1);
+    }
+
+private:
+
+    static SQInteger snapshotFunc(HSQUIRRELVM vm) {
+        sq_newarray(vm, 0);
+        return 1;
+    }
+
+    static SQInteger resetFunc(HSQUIRRELVM /*vm*/) {
+        return 0;
+    }
+};
+
+#endif
+
+}
+
+#endif
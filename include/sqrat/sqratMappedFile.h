@@ -0,0 +1,308 @@
+//
+// SqratMappedFile: Read-only memory mapping of a whole file
+//
+
+//
+// Copyright (c) 2009 Brandon Jones
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software. If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+#if !defined(_SCRAT_MAPPED_FILE_H_)
+#define _SCRAT_MAPPED_FILE_H_
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#if !defined(NOMINMAX)
+#define NOMINMAX
+#endif
+#include <windows.h>
+// Windows defines fix (comes after the one in sqratObject.h, so redo it for Object::GetObject)
+#undef GetObject
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "sqratBytecode.h"
+#include "sqratScript.h"
+
+namespace Sqrat {
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Read-only view of the contents of a file
+///
+/// \remarks
+/// The file is mapped into memory when the platform allows it. Files that cannot be mapped (empty files, pipes, some
+/// network file systems) are read into a buffer instead, so callers always get one contiguous block.
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class MappedFile {
+public:
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Constructs a MappedFile with no file
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    MappedFile() : m_data(NULL), m_size(0), m_mapped(false), m_open(false) {
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Constructs a MappedFile and opens a file (check IsOpen)
+    ///
+    /// \param path Path of the file
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    explicit MappedFile(const std::string& path) : m_data(NULL), m_size(0), m_mapped(false), m_open(false) {
+        Open(path);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Unmaps the file
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ~MappedFile() {
+        Close();
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Maps a file, replacing the file mapped before
+    ///
+    /// \param path Path of the file
+    ///
+    /// \return True if the contents of the file are available
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool Open(const std::string& path) {
+        Close();
+        if (!map(path)) {
+            read(path);
+        }
+        return m_open;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Unmaps the file (Data becomes invalid)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Close() {
+        if (m_mapped) {
+#if defined(_WIN32)
+            UnmapViewOfFile(m_data);
+#else
+            munmap(const_cast<char*>(m_data), m_size);
+#endif
+        }
+        std::vector<char>().swap(m_buffer);
+        m_data = NULL;
+        m_size = 0;
+        m_mapped = false;
+        m_open = false;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the contents of the file (NULL if the file is not open or empty)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    const char* Data() const {
+        return m_data;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the size of the file in bytes
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    size_t Size() const {
+        return m_size;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Checks whether a file is open
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool IsOpen() const {
+        return m_open;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Checks whether the file is mapped rather than read into a buffer
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool IsMapped() const {
+        return m_mapped;
+    }
+
+private:
+
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    bool map(const std::string& path) {
+#if defined(_WIN32)
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER size;
+        HANDLE mapping = NULL;
+        if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+            mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        }
+        CloseHandle(file);
+        if (mapping == NULL) {
+            return false;
+        }
+        void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        if (view == NULL) {
+            return false;
+        }
+        m_data = static_cast<const char*>(view);
+        m_size = static_cast<size_t>(size.QuadPart);
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        void* view = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            view = mmap(NULL, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+        if (view == MAP_FAILED) {
+            return false;
+        }
+        m_data = static_cast<const char*>(view);
+        m_size = static_cast<size_t>(st.st_size);
+#endif
+        m_mapped = true;
+        m_open = true;
+        return true;
+    }
+
+    void read(const std::string& path) {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (file == NULL) {
+            return;
+        }
+        char chunk[4096];
+        size_t count;
+        while ((count = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+            m_buffer.insert(m_buffer.end(), chunk, chunk + count);
+        }
+        m_open = !ferror(file);
+        fclose(file);
+        m_size = m_buffer.size();
+        m_data = m_size > 0 ? &m_buffer[0] : NULL;
+    }
+
+    const char*       m_data;
+    size_t            m_size;
+    bool              m_mapped;
+    bool              m_open;
+    std::vector<char> m_buffer;
+};
+
+/// @cond DEV
+
+// Script's memory mapped loaders, declared in sqratScript.h and only defined for code that includes this header
+
+inline void Script::CompileMappedFile(const string& path) {
+    if(!sq_isnull(obj)) {
+        sq_release(vm, &obj);
+        sq_resetobject(&obj);
+    }
+
+#if !defined (SCRAT_NO_ERROR_CHECKING)
+    if(SQ_FAILED(loadMappedFile(path))) {
+        SQTHROW(vm, LastErrorString(vm));
+        return;
+    }
+#else
+    loadMappedFile(path);
+#endif
+    sq_getstackobj(vm,-1,&obj);
+    sq_addref(vm, &obj);
+    sq_pop(vm, 1);
+}
+
+inline bool Script::CompileMappedFile(const string& path, string& errMsg) {
+    if(!sq_isnull(obj)) {
+        sq_release(vm, &obj);
+        sq_resetobject(&obj);
+    }
+
+#if !defined (SCRAT_NO_ERROR_CHECKING)
+    if(SQ_FAILED(loadMappedFile(path))) {
+        errMsg = LastErrorString(vm);
+        return false;
+    }
+#else
+    loadMappedFile(path);
+#endif
+    sq_getstackobj(vm,-1,&obj);
+    sq_addref(vm, &obj);
+    sq_pop(vm, 1);
+    return true;
+}
+
+inline bool Script::LoadBytecodeFile(const string& path) {
+    MappedFile file(narrowPath(path));
+    return file.IsOpen() && LoadBytecode(file.Data(), file.Size());
+}
+
+inline SQRESULT Script::loadMappedFile(const string& path) {
+    Trace::Scope trace(vm, Trace::TRACE_COMPILE, _SC("load"), path.c_str());
+    MappedFile file(narrowPath(path));
+    if (!file.IsOpen()) {
+        return sqstd_loadfile(vm, path.c_str(), true); // reports the error as usual
+    }
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(file.Data());
+    size_t size = file.Size();
+    if (size >= 2 && bytes[0] == 0xFA && bytes[1] == 0xFA) { // SQ_BYTECODE_STREAM_TAG
+        Bytecode bytecode(bytes, size);
+        return sq_readclosure(vm, BytecodeReader, &bytecode);
+    }
+#if defined(SQUNICODE)
+    return sqstd_loadfile(vm, path.c_str(), true);
+#else
+    if (size >= 2 && ((bytes[0] == 0xFF && bytes[1] == 0xFE) || (bytes[0] == 0xFE && bytes[1] == 0xFF))) {
+        return sqstd_loadfile(vm, path.c_str(), true); // UTF-16 has to be re-encoded
+    }
+    const SQChar* text = size > 0 ? file.Data() : _SC("");
+    if (size >= 3 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF) { // UTF-8 BOM
+        text += 3;
+        size -= 3;
+    }
+    return sq_compilebuffer(vm, text, static_cast<SQInteger>(size), path.c_str(), true);
+#endif
+}
+
+/// @endcond
+
+}
+
+#endif
@@ -0,0 +1,1123 @@
+//
+// SqratMarshal: VM independent values for moving data between Squirrel VMs and threads
+//
+
+//
+// Copyright (c) 2009 Brandon Jones
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software. If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+#if !defined(_SCRAT_MARSHAL_H_)
+#define _SCRAT_MARSHAL_H_
+
+#include <squirrel.h>
+#include <sqstdblob.h>
+#include <string.h>
+#include <utility>
+#include <vector>
+
+#include "sqratClassType.h"
+#include "sqratTypes.h"
+#include "sqratUtil.h"
+
+namespace Sqrat {
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Typed block of memory that can be handed from one VM to another without copying
+///
+/// \remarks
+/// Scripts see a Buffer once it has been bound with RegisterChannelLib (see sqratChannel.h).
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class Buffer {
+public:
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Types of the elements of a Buffer
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    enum ElementType {
+        UINT8   = 0, ///< unsigned 8-bit integers
+        INT32   = 1, ///< signed 32-bit integers
+        FLOAT32 = 2, ///< 32-bit floats
+        FLOAT64 = 3  ///< 64-bit floats
+    };
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Constructs an empty buffer of bytes
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    Buffer() : m_type(UINT8) {
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Constructs a zero filled buffer
+    ///
+    /// \param type   Type of the elements
+    /// \param length Number of elements
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    Buffer(ElementType type, size_t length) : m_type(type), m_bytes(length * ElementSize(type)) {
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the size in bytes of one element of the given type
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static size_t ElementSize(ElementType type) {
+        switch (type) {
+        case INT32:   return 4;
+        case FLOAT32: return 4;
+        case FLOAT64: return 8;
+        default:      return 1;
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the type of the elements
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ElementType GetElementType() const {
+        return m_type;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the number of elements
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    size_t Length() const {
+        return m_bytes.size() / ElementSize(m_type);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Changes the number of elements (new elements are zero)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Resize(size_t length) {
+        m_bytes.resize(length * ElementSize(m_type));
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the element storage
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    std::vector<unsigned char>& Bytes() {
+        return m_bytes;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the element storage
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    const std::vector<unsigned char>& Bytes() const {
+        return m_bytes;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Reads an element as a double (index must be less than Length())
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    double GetElement(size_t index) const {
+        const unsigned char* p = &m_bytes[index * ElementSize(m_type)];
+        switch (m_type) {
+        case INT32:   { int   v; memcpy(&v, p, sizeof(v)); return v; }
+        case FLOAT32: { float v; memcpy(&v, p, sizeof(v)); return v; }
+        case FLOAT64: { double v; memcpy(&v, p, sizeof(v)); return v; }
+        default:      return *p;
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Writes an element converted from a double (index must be less than Length())
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void SetElement(size_t index, double value) {
+        unsigned char* p = &m_bytes[index * ElementSize(m_type)];
+        switch (m_type) {
+        case INT32:   { int   v = static_cast<int>(value);   memcpy(p, &v, sizeof(v)); break; }
+        case FLOAT32: { float v = static_cast<float>(value); memcpy(p, &v, sizeof(v)); break; }
+        case FLOAT64: { memcpy(p, &value, sizeof(value)); break; }
+        default:      *p = static_cast<unsigned char>(value); break;
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Exchanges contents with another buffer without copying
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Swap(Buffer& other) {
+        std::swap(m_type, other.m_type);
+        m_bytes.swap(other.m_bytes);
+    }
+
+private:
+
+    ElementType                m_type;
+    std::vector<unsigned char> m_bytes;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Owns a copy of a Squirrel value that is not tied to any VM
+///
+/// \remarks
+/// Only plain data can be marshalled: null, bools, integers, floats, strings, Buffers, blobs, and arrays and tables made
+/// of those. Closures, classes, other instances, userdata and threads belong to the VM that created them and are rejected.
+///
+/// \remarks
+/// With MARSHAL_MOVE a Buffer is taken over without copying its elements and the script's Buffer is left empty (blobs
+/// cannot give up their memory, so they are copied and then truncated). With MARSHAL_PACK arrays and tables are written
+/// into one compact byte string (TYPE_PACKED) rather than a tree of values, which is much cheaper for large containers.
+///
+/// \remarks
+/// A MarshalledValue holds no VM references, so it may be created on one thread and pushed on another (but a single
+/// MarshalledValue must not be used by two threads at the same time).
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class MarshalledValue {
+public:
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// The kinds of values a MarshalledValue can hold
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    enum Type {
+        TYPE_NULL,    ///< null
+        TYPE_BOOL,    ///< bool
+        TYPE_INTEGER, ///< integer
+        TYPE_FLOAT,   ///< float
+        TYPE_STRING,  ///< string
+        TYPE_ARRAY,   ///< array of MarshalledValues
+        TYPE_TABLE,   ///< table of MarshalledValue key/value pairs
+        TYPE_BUFFER,  ///< Sqrat::Buffer
+        TYPE_BLOB,    ///< bytes of a blob from the Squirrel blob library
+        TYPE_PACKED   ///< array or table in packed form (see Unpack)
+    };
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Flags for FromStack
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    enum Flags {
+        MARSHAL_COPY = 0, ///< Copy everything and leave the source untouched
+        MARSHAL_MOVE = 1, ///< Take over Buffers and empty blobs instead of leaving them intact
+        MARSHAL_PACK = 2  ///< Pack arrays and tables into TYPE_PACKED values
+    };
+
+    static const int MAX_DEPTH = 64; ///< Deepest nesting of arrays and tables that FromStack accepts (also catches cycles)
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Constructs a null value
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    MarshalledValue() : m_type(TYPE_NULL) {
+        m_integer = 0;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Constructs a bool value
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    MarshalledValue(bool b) : m_type(TYPE_BOOL) {
+        m_integer = 0;
+        m_bool = b;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Constructs an integer value
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    MarshalledValue(int i) : m_type(TYPE_INTEGER) {
+        m_integer = i;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Constructs an integer value
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    MarshalledValue(long i) : m_type(TYPE_INTEGER) {
+        m_integer = static_cast<SQInteger>(i);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Constructs an integer value
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    MarshalledValue(long long i) : m_type(TYPE_INTEGER) {
+        m_integer = static_cast<SQInteger>(i);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Constructs a float value
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    MarshalledValue(double f) : m_type(TYPE_FLOAT) {
+        m_float = static_cast<SQFloat>(f);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Constructs a string value
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    MarshalledValue(const SQChar* s) : m_type(TYPE_STRING), m_string(s) {
+        m_integer = 0;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Constructs a string value
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    MarshalledValue(const string& s) : m_type(TYPE_STRING), m_string(s) {
+        m_integer = 0;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Constructs a Buffer value by taking over the contents of a Buffer (which is left empty)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    explicit MarshalledValue(Buffer& buffer) : m_type(TYPE_BUFFER) {
+        m_integer = 0;
+        m_buffer.Swap(buffer);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Creates a blob value
+    ///
+    /// \param data Bytes of the blob
+    /// \param size Number of bytes
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static MarshalledValue NewBlob(const void* data, size_t size) {
+        MarshalledValue v;
+        v.m_type = TYPE_BLOB;
+        v.m_buffer.Bytes().assign(static_cast<const unsigned char*>(data), static_cast<const unsigned char*>(data) + size);
+        return v;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Creates an empty array value
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static MarshalledValue NewArray() {
+        MarshalledValue v;
+        v.m_type = TYPE_ARRAY;
+        return v;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Creates an empty table value
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static MarshalledValue NewTable() {
+        MarshalledValue v;
+        v.m_type = TYPE_TABLE;
+        return v;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the kind of value held
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    Type GetType() const {
+        return m_type;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Checks whether the value is null
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool IsNull() const {
+        return m_type == TYPE_NULL;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the value as a bool (integers and floats are compared against zero, null is false, anything else is true)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool GetBool() const {
+        switch (m_type) {
+        case TYPE_NULL:    return false;
+        case TYPE_BOOL:    return m_bool;
+        case TYPE_INTEGER: return m_integer != 0;
+        case TYPE_FLOAT:   return m_float != 0;
+        default:           return true;
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the value as an integer (floats are truncated, bools become 0 or 1, anything else is 0)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    SQInteger GetInteger() const {
+        switch (m_type) {
+        case TYPE_BOOL:    return m_bool ? 1 : 0;
+        case TYPE_INTEGER: return m_integer;
+        case TYPE_FLOAT:   return static_cast<SQInteger>(m_float);
+        default:           return 0;
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the value as a float (integers are converted, bools become 0 or 1, anything else is 0)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    SQFloat GetFloat() const {
+        switch (m_type) {
+        case TYPE_BOOL:    return m_bool ? 1.0f : 0.0f;
+        case TYPE_INTEGER: return static_cast<SQFloat>(m_integer);
+        case TYPE_FLOAT:   return m_float;
+        default:           return 0;
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the string held (empty if the value is not a string)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    const string& GetString() const {
+        return m_string;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the Buffer held, or the bytes of a blob or packed value (as a buffer of UINT8)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    const Buffer& GetBuffer() const {
+        return m_buffer;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Moves the Buffer held, or the bytes of a blob or packed value, into another Buffer (the value becomes null)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void TakeBuffer(Buffer& out) {
+        out.Swap(m_buffer);
+        *this = MarshalledValue();
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gives back what FromStack with MARSHAL_MOVE took from a Buffer or blob, for when the value could not be used after all
+    ///
+    /// \param vm  VM the value was read from
+    /// \param idx Index of the Buffer or blob it was read from
+    ///
+    /// \remarks
+    /// Only a Buffer or blob read as the value itself is given back (the value becomes null); one nested in an array or
+    /// table was copied rather than moved if MARSHAL_PACK was set.
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Restore(HSQUIRRELVM vm, SQInteger idx) {
+        if (m_type == TYPE_BUFFER) {
+            Buffer* buffer = getBuffer(vm, idx);
+            if (buffer != NULL) {
+                buffer->Swap(m_buffer);
+                *this = MarshalledValue();
+            }
+        } else if (m_type == TYPE_BLOB) {
+            size_t size = m_buffer.Bytes().size();
+            resizeBlob(vm, idx, size);
+            SQUserPointer data;
+            if (size != 0 && SQ_SUCCEEDED(sqstd_getblob(vm, idx, &data)) && static_cast<size_t>(sqstd_getblobsize(vm, idx)) == size) {
+                memcpy(data, &m_buffer.Bytes()[0], size);
+                *this = MarshalledValue();
+            }
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Converts a packed value back into a tree of values (anything else is returned as is)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    MarshalledValue Unpack() const {
+        if (m_type != TYPE_PACKED) {
+            return *this;
+        }
+        MarshalledValue out;
+        size_t pos = 0;
+        unpack(m_buffer.Bytes(), pos, out);
+        return out;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the number of elements of an array or the number of slots of a table (0 for anything else)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    size_t Size() const {
+        return m_type == TYPE_TABLE ? m_items.size() / 2 : m_items.size();
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets an element of an array
+    ///
+    /// \param index Index of the element (must be less than Size())
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    const MarshalledValue& operator[](size_t index) const {
+        assert(m_type == TYPE_ARRAY && index < m_items.size());
+        return m_items[index];
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the key of a table slot
+    ///
+    /// \param index Index of the slot (must be less than Size())
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    const MarshalledValue& KeyAt(size_t index) const {
+        assert(m_type == TYPE_TABLE && index * 2 < m_items.size());
+        return m_items[index * 2];
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the value of a table slot
+    ///
+    /// \param index Index of the slot (must be less than Size())
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    const MarshalledValue& ValueAt(size_t index) const {
+        assert(m_type == TYPE_TABLE && index * 2 + 1 < m_items.size());
+        return m_items[index * 2 + 1];
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Finds the value of a table slot by key
+    ///
+    /// \param key Key of the slot (compared by type and value)
+    ///
+    /// \return Pointer to the value or NULL if there is no such slot
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    const MarshalledValue* Find(const MarshalledValue& key) const {
+        if (m_type != TYPE_TABLE) {
+            return NULL;
+        }
+        for (size_t i = 0; i < m_items.size(); i += 2) {
+            if (m_items[i] == key) {
+                return &m_items[i + 1];
+            }
+        }
+        return NULL;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Appends an element to an array value
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Append(const MarshalledValue& value) {
+        assert(m_type == TYPE_ARRAY);
+        m_items.push_back(value);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Adds a slot to a table value (no check is made for duplicate keys, the last one wins when pushed)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Set(const MarshalledValue& key, const MarshalledValue& value) {
+        assert(m_type == TYPE_TABLE);
+        m_items.push_back(key);
+        m_items.push_back(value);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Compares two values by type and contents
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool operator==(const MarshalledValue& other) const {
+        if (m_type != other.m_type) {
+            return false;
+        }
+        switch (m_type) {
+        case TYPE_NULL:    return true;
+        case TYPE_BOOL:    return m_bool == other.m_bool;
+        case TYPE_INTEGER: return m_integer == other.m_integer;
+        case TYPE_FLOAT:   return m_float == other.m_float;
+        case TYPE_STRING:  return m_string == other.m_string;
+        case TYPE_BUFFER:
+        case TYPE_BLOB:
+        case TYPE_PACKED:  return m_buffer.GetElementType() == other.m_buffer.GetElementType() && m_buffer.Bytes() == other.m_buffer.Bytes();
+        default:           return m_items == other.m_items;
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Compares two values by type and contents
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool operator!=(const MarshalledValue& other) const {
+        return !(*this == other);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Copies a value off the stack of a VM
+    ///
+    /// \param vm     VM to read from
+    /// \param idx    Index of the value on the stack
+    /// \param out    Filled with the copied value
+    /// \param errMsg Filled with the reason if the value could not be marshalled
+    /// \param flags  Combination of Flags
+    ///
+    /// \return True on success, false if the value (or something inside it) cannot be marshalled
+    ///
+    /// \remarks
+    /// A failed FromStack takes nothing from the VM, even with MARSHAL_MOVE.
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static bool FromStack(HSQUIRRELVM vm, SQInteger idx, MarshalledValue& out, string& errMsg, int flags = MARSHAL_COPY) {
+        if (idx < 0) {
+            idx = sq_gettop(vm) + idx + 1;
+        }
+        SQObjectType type = sq_gettype(vm, idx);
+        if ((flags & MARSHAL_PACK) && (type == OT_ARRAY || type == OT_TABLE)) {
+            out = MarshalledValue();
+            out.m_type = TYPE_PACKED;
+            return pack(vm, idx, out.m_buffer.Bytes(), errMsg, 0);
+        }
+        // a failure halfway through a container would lose the Buffers already moved, so check the whole tree first
+        if ((flags & MARSHAL_MOVE) && (type == OT_ARRAY || type == OT_TABLE) && !check(vm, idx, errMsg, 0)) {
+            return false;
+        }
+        return read(vm, idx, out, errMsg, flags, 0);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Pushes a new Squirrel object holding a copy of the value onto the stack of a VM
+    ///
+    /// \param vm VM to push on to
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Push(HSQUIRRELVM vm) const {
+        switch (m_type) {
+        case TYPE_NULL:
+            sq_pushnull(vm);
+            break;
+        case TYPE_BOOL:
+            sq_pushbool(vm, m_bool);
+            break;
+        case TYPE_INTEGER:
+            sq_pushinteger(vm, m_integer);
+            break;
+        case TYPE_FLOAT:
+            sq_pushfloat(vm, m_float);
+            break;
+        case TYPE_STRING:
+            sq_pushstring(vm, m_string.c_str(), static_cast<SQInteger>(m_string.size()));
+            break;
+        case TYPE_ARRAY:
+            sq_newarray(vm, 0);
+            for (size_t i = 0; i < m_items.size(); ++i) {
+                m_items[i].Push(vm);
+                sq_arrayappend(vm, -2);
+            }
+            break;
+        case TYPE_TABLE:
+            sq_newtableex(vm, static_cast<SQInteger>(m_items.size() / 2));
+            for (size_t i = 0; i < m_items.size(); i += 2) {
+                m_items[i].Push(vm);
+                m_items[i + 1].Push(vm);
+                sq_newslot(vm, -3, SQFalse);
+            }
+            break;
+        case TYPE_BUFFER:
+            pushBuffer(vm, m_buffer);
+            break;
+        case TYPE_BLOB:
+            pushBlob(vm, m_buffer.Bytes());
+            break;
+        case TYPE_PACKED: {
+            size_t pos = 0;
+            pushPacked(vm, m_buffer.Bytes(), pos);
+            break;
+        }
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Pushes the value onto the stack of a VM, handing a Buffer over to the VM instead of copying it
+    ///
+    /// \param vm VM to push on to
+    ///
+    /// \remarks
+    /// The value is left null if it was a Buffer.
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void PushMove(HSQUIRRELVM vm) {
+        if (m_type == TYPE_BUFFER && ClassType<Buffer>::hasClassData(vm)) {
+            Buffer* buffer = new Buffer();
+            buffer->Swap(m_buffer);
+            ClassType<Buffer>::PushInstance(vm, buffer, true);
+            *this = MarshalledValue();
+        } else {
+            Push(vm);
+        }
+    }
+
+private:
+
+    // Packed form: one tag byte per value followed by its payload in host byte order
+    enum PackTag {
+        PACK_NULL = 'n', PACK_TRUE = 't', PACK_FALSE = 'f', PACK_INTEGER = 'i', PACK_FLOAT = 'd',
+        PACK_STRING = 's', PACK_ARRAY = 'a', PACK_TABLE = 'h', PACK_BUFFER = 'u', PACK_BLOB = 'b'
+    };
+
+    static Buffer* getBuffer(HSQUIRRELVM vm, SQInteger idx) {
+        if (sq_gettype(vm, idx) != OT_INSTANCE || !ClassType<Buffer>::hasClassData(vm)) {
+            return NULL;
+        }
+        std::pair<Buffer*, SharedPtr<unordered_map<Buffer*, HSQOBJECT>::type> >* instance = NULL;
+        if (SQ_FAILED(sq_getinstanceup(vm, idx, (SQUserPointer*)&instance, ClassType<Buffer>::getStaticClassData().Get(), SQFalse)) || instance == NULL) {
+            return NULL;
+        }
+        return instance->first;
+    }
+
+    static void pushBuffer(HSQUIRRELVM vm, const Buffer& buffer) {
+        if (ClassType<Buffer>::hasClassData(vm)) {
+            ClassType<Buffer>::PushInstance(vm, new Buffer(buffer), true);
+        } else {
+            pushBlob(vm, buffer.Bytes());
+        }
+    }
+
+    static void pushBlob(HSQUIRRELVM vm, const std::vector<unsigned char>& bytes) {
+        SQUserPointer data = sqstd_createblob(vm, static_cast<SQInteger>(bytes.size()));
+        if (data != NULL && !bytes.empty()) {
+            memcpy(data, &bytes[0], bytes.size());
+        } else if (data == NULL) {
+            sq_pushnull(vm); // blob library not registered in this VM
+        }
+    }
+
+    static void resizeBlob(HSQUIRRELVM vm, SQInteger idx, size_t size) {
+        idx = idx < 0 ? sq_gettop(vm) + idx + 1 : idx;
+        SQInteger top = sq_gettop(vm);
+        sq_pushstring(vm, _SC("resize"), -1);
+        if (SQ_SUCCEEDED(sq_get(vm, idx))) {
+            sq_push(vm, idx);
+            sq_pushinteger(vm, static_cast<SQInteger>(size));
+            sq_call(vm, 2, SQFalse, SQFalse);
+        }
+        sq_settop(vm, top);
+    }
+
+    // Fails exactly where read would, without taking anything from the VM
+    static bool check(HSQUIRRELVM vm, SQInteger idx, string& errMsg, int depth) {
+        switch (sq_gettype(vm, idx)) {
+        case OT_NULL:
+        case OT_BOOL:
+        case OT_INTEGER:
+        case OT_FLOAT:
+        case OT_STRING:
+            return true;
+        case OT_ARRAY:
+        case OT_TABLE: {
+            if (depth >= MAX_DEPTH) {
+                errMsg = _SC("cannot marshal value: nesting too deep (or cyclic)");
+                return false;
+            }
+            bool isTable = sq_gettype(vm, idx) == OT_TABLE;
+            sq_pushnull(vm);
+            while (SQ_SUCCEEDED(sq_next(vm, idx))) {
+                SQInteger top = sq_gettop(vm);
+                if ((isTable && !check(vm, top - 1, errMsg, depth + 1)) || !check(vm, top, errMsg, depth + 1)) {
+                    sq_pop(vm, 3);
+                    return false;
+                }
+                sq_pop(vm, 2);
+            }
+            sq_pop(vm, 1);
+            return true;
+        }
+        case OT_INSTANCE: {
+            SQUserPointer data;
+            if (getBuffer(vm, idx) != NULL || SQ_SUCCEEDED(sqstd_getblob(vm, idx, &data))) {
+                return true;
+            }
+        }
+        // fall through
+        default:
+            errMsg = _SC("cannot marshal value of this type (only null, bool, integer, float, string, Buffer, blob, array and table can cross VMs)");
+            return false;
+        }
+    }
+
+    static bool read(HSQUIRRELVM vm, SQInteger idx, MarshalledValue& out, string& errMsg, int flags, int depth) {
+        switch (sq_gettype(vm, idx)) {
+        case OT_NULL:
+            out = MarshalledValue();
+            return true;
+        case OT_BOOL: {
+            SQBool b;
+            sq_getbool(vm, idx, &b);
+            out = MarshalledValue(b != SQFalse);
+            return true;
+        }
+        case OT_INTEGER: {
+            SQInteger i;
+            sq_getinteger(vm, idx, &i);
+            out = MarshalledValue();
+            out.m_type = TYPE_INTEGER;
+            out.m_integer = i;
+            return true;
+        }
+        case OT_FLOAT: {
+            SQFloat f;
+            sq_getfloat(vm, idx, &f);
+            out = MarshalledValue();
+            out.m_type = TYPE_FLOAT;
+            out.m_float = f;
+            return true;
+        }
+        case OT_STRING: {
+            const SQChar* s;
+            sq_getstring(vm, idx, &s);
+            out = MarshalledValue();
+            out.m_type = TYPE_STRING;
+            out.m_string.assign(s, static_cast<size_t>(sq_getsize(vm, idx)));
+            return true;
+        }
+        case OT_ARRAY:
+        case OT_TABLE: {
+            if (depth >= MAX_DEPTH) {
+                errMsg = _SC("cannot marshal value: nesting too deep (or cyclic)");
+                return false;
+            }
+            bool isTable = sq_gettype(vm, idx) == OT_TABLE;
+            out = isTable ? NewTable() : NewArray();
+            out.m_items.reserve(static_cast<size_t>(sq_getsize(vm, idx)) * (isTable ? 2 : 1));
+            sq_pushnull(vm);
+            while (SQ_SUCCEEDED(sq_next(vm, idx))) {
+                SQInteger top = sq_gettop(vm);
+                if (isTable) {
+                    out.m_items.push_back(MarshalledValue());
+                    if (!read(vm, top - 1, out.m_items.back(), errMsg, flags, depth + 1)) {
+                        sq_pop(vm, 3);
+                        return false;
+                    }
+                }
+                out.m_items.push_back(MarshalledValue());
+                if (!read(vm, top, out.m_items.back(), errMsg, flags, depth + 1)) {
+                    sq_pop(vm, 3);
+                    return false;
+                }
+                sq_pop(vm, 2);
+            }
+            sq_pop(vm, 1);
+            return true;
+        }
+        case OT_INSTANCE: {
+            Buffer* buffer = getBuffer(vm, idx);
+            if (buffer != NULL) {
+                out = MarshalledValue();
+                out.m_type = TYPE_BUFFER;
+                if (flags & MARSHAL_MOVE) {
+                    out.m_buffer.Swap(*buffer);
+                } else {
+                    out.m_buffer = *buffer;
+                }
+                return true;
+            }
+            SQUserPointer data;
+            if (SQ_SUCCEEDED(sqstd_getblob(vm, idx, &data))) {
+                out = NewBlob(data, static_cast<size_t>(sqstd_getblobsize(vm, idx)));
+                if (flags & MARSHAL_MOVE) {
+                    resizeBlob(vm, idx, 0);
+                }
+                return true;
+            }
+        }
+        // fall through
+        default:
+            errMsg = _SC("cannot marshal value of this type (only null, bool, integer, float, string, Buffer, blob, array and table can cross VMs)");
+            return false;
+        }
+    }
+
+    template <class T>
+    static void write(std::vector<unsigned char>& out, const T& value) {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(&value);
+        out.insert(out.end(), p, p + sizeof(T));
+    }
+
+    template <class T>
+    static T fetch(const std::vector<unsigned char>& in, size_t& pos) {
+        T value;
+        memcpy(&value, &in[pos], sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+
+    static void writeBytes(std::vector<unsigned char>& out, const void* data, size_t size) {
+        write(out, static_cast<SQUnsignedInteger>(size));
+        out.insert(out.end(), static_cast<const unsigned char*>(data), static_cast<const unsigned char*>(data) + size);
+    }
+
+    static bool pack(HSQUIRRELVM vm, SQInteger idx, std::vector<unsigned char>& out, string& errMsg, int depth) {
+        switch (sq_gettype(vm, idx)) {
+        case OT_NULL:
+            out.push_back(PACK_NULL);
+            return true;
+        case OT_BOOL: {
+            SQBool b;
+            sq_getbool(vm, idx, &b);
+            out.push_back(b ? PACK_TRUE : PACK_FALSE);
+            return true;
+        }
+        case OT_INTEGER: {
+            SQInteger i;
+            sq_getinteger(vm, idx, &i);
+            out.push_back(PACK_INTEGER);
+            write(out, i);
+            return true;
+        }
+        case OT_FLOAT: {
+            SQFloat f;
+            sq_getfloat(vm, idx, &f);
+            out.push_back(PACK_FLOAT);
+            write(out, f);
+            return true;
+        }
+        case OT_STRING: {
+            const SQChar* s;
+            sq_getstring(vm, idx, &s);
+            out.push_back(PACK_STRING);
+            writeBytes(out, s, static_cast<size_t>(sq_getsize(vm, idx)) * sizeof(SQChar));
+            return true;
+        }
+        case OT_ARRAY:
+        case OT_TABLE: {
+            if (depth >= MAX_DEPTH) {
+                errMsg = _SC("cannot marshal value: nesting too deep (or cyclic)");
+                return false;
+            }
+            bool isTable = sq_gettype(vm, idx) == OT_TABLE;
+            out.push_back(isTable ? PACK_TABLE : PACK_ARRAY);
+            write(out, static_cast<SQUnsignedInteger>(sq_getsize(vm, idx)));
+            sq_pushnull(vm);
+            while (SQ_SUCCEEDED(sq_next(vm, idx))) {
+                SQInteger top = sq_gettop(vm);
+                if ((isTable && !pack(vm, top - 1, out, errMsg, depth + 1)) || !pack(vm, top, out, errMsg, depth + 1)) {
+                    sq_pop(vm, 3);
+                    return false;
+                }
+                sq_pop(vm, 2);
+            }
+            sq_pop(vm, 1);
+            return true;
+        }
+        case OT_INSTANCE: {
+            Buffer* buffer = getBuffer(vm, idx);
+            if (buffer != NULL) {
+                out.push_back(PACK_BUFFER);
+                out.push_back(static_cast<unsigned char>(buffer->GetElementType()));
+                writeBytes(out, buffer->Bytes().empty() ? NULL : &buffer->Bytes()[0], buffer->Bytes().size());
+                return true;
+            }
+            SQUserPointer data;
+            if (SQ_SUCCEEDED(sqstd_getblob(vm, idx, &data))) {
+                out.push_back(PACK_BLOB);
+                writeBytes(out, data, static_cast<size_t>(sqstd_getblobsize(vm, idx)));
+                return true;
+            }
+        }
+        // fall through
+        default:
+            errMsg = _SC("cannot marshal value of this type (only null, bool, integer, float, string, Buffer, blob, array and table can cross VMs)");
+            return false;
+        }
+    }
+
+    static void pushPacked(HSQUIRRELVM vm, const std::vector<unsigned char>& in, size_t& pos) {
+        unsigned char tag = in[pos++];
+        switch (tag) {
+        case PACK_TRUE:
+        case PACK_FALSE:
+            sq_pushbool(vm, tag == PACK_TRUE);
+            break;
+        case PACK_INTEGER:
+            sq_pushinteger(vm, fetch<SQInteger>(in, pos));
+            break;
+        case PACK_FLOAT:
+            sq_pushfloat(vm, fetch<SQFloat>(in, pos));
+            break;
+        case PACK_STRING: {
+            size_t size = static_cast<size_t>(fetch<SQUnsignedInteger>(in, pos));
+            string s(size / sizeof(SQChar), 0);
+            if (size > 0) {
+                memcpy(&s[0], &in[pos], size);
+            }
+            pos += size;
+            sq_pushstring(vm, s.c_str(), static_cast<SQInteger>(s.size()));
+            break;
+        }
+        case PACK_ARRAY: {
+            SQUnsignedInteger count = fetch<SQUnsignedInteger>(in, pos);
+            sq_newarray(vm, 0);
+            for (SQUnsignedInteger i = 0; i < count; ++i) {
+                pushPacked(vm, in, pos);
+                sq_arrayappend(vm, -2);
+            }
+            break;
+        }
+        case PACK_TABLE: {
+            SQUnsignedInteger count = fetch<SQUnsignedInteger>(in, pos);
+            sq_newtableex(vm, static_cast<SQInteger>(count));
+            for (SQUnsignedInteger i = 0; i < count; ++i) {
+                pushPacked(vm, in, pos);
+                pushPacked(vm, in, pos);
+                sq_newslot(vm, -3, SQFalse);
+            }
+            break;
+        }
+        case PACK_BUFFER:
+        case PACK_BLOB: {
+            Buffer buffer(tag == PACK_BUFFER ? static_cast<Buffer::ElementType>(in[pos++]) : Buffer::UINT8, 0);
+            size_t size = static_cast<size_t>(fetch<SQUnsignedInteger>(in, pos));
+            buffer.Bytes().assign(in.begin() + pos, in.begin() + pos + size);
+            pos += size;
+            if (tag == PACK_BUFFER) {
+                pushBuffer(vm, buffer);
+            } else {
+                pushBlob(vm, buffer.Bytes());
+            }
+            break;
+        }
+        default:
+            sq_pushnull(vm);
+            break;
+        }
+    }
+
+    static void unpack(const std::vector<unsigned char>& in, size_t& pos, MarshalledValue& out) {
+        unsigned char tag = in[pos++];
+        out = MarshalledValue();
+        switch (tag) {
+        case PACK_TRUE:
+        case PACK_FALSE:
+            out = MarshalledValue(tag == PACK_TRUE);
+            break;
+        case PACK_INTEGER:
+            out.m_type = TYPE_INTEGER;
+            out.m_integer = fetch<SQInteger>(in, pos);
+            break;
+        case PACK_FLOAT:
+            out.m_type = TYPE_FLOAT;
+            out.m_float = fetch<SQFloat>(in, pos);
+            break;
+        case PACK_STRING: {
+            size_t size = static_cast<size_t>(fetch<SQUnsignedInteger>(in, pos));
+            out.m_type = TYPE_STRING;
+            out.m_string.assign(size / sizeof(SQChar), 0);
+            if (size > 0) {
+                memcpy(&out.m_string[0], &in[pos], size);
+            }
+            pos += size;
+            break;
+        }
+        case PACK_ARRAY:
+        case PACK_TABLE: {
+            SQUnsignedInteger count = fetch<SQUnsignedInteger>(in, pos) * (tag == PACK_TABLE ? 2 : 1);
+            out.m_type = tag == PACK_TABLE ? TYPE_TABLE : TYPE_ARRAY;
+            out.m_items.resize(static_cast<size_t>(count));
+            for (SQUnsignedInteger i = 0; i < count; ++i) {
+                unpack(in, pos, out.m_items[static_cast<size_t>(i)]);
+            }
+            break;
+        }
+        case PACK_BUFFER:
+        case PACK_BLOB: {
+            out.m_type = tag == PACK_BUFFER ? TYPE_BUFFER : TYPE_BLOB;
+            Buffer buffer(tag == PACK_BUFFER ? static_cast<Buffer::ElementType>(in[pos++]) : Buffer::UINT8, 0);
+            size_t size = static_cast<size_t>(fetch<SQUnsignedInteger>(in, pos));
+            buffer.Bytes().assign(in.begin() + pos, in.begin() + pos + size);
+            pos += size;
+            out.m_buffer.Swap(buffer);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    Type m_type;
+    union {
+        bool      m_bool;
+        SQInteger m_integer;
+        SQFloat   m_float;
+    };
+    string m_string;
+    std::vector<MarshalledValue> m_items; // array elements, or table keys and values interleaved
+    Buffer m_buffer;                      // Buffer, blob bytes, or packed bytes
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Used to get and push MarshalledValues to and from the stack
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+template<>
+struct Var<MarshalledValue> {
+
+    MarshalledValue value; ///< The actual value of get operations
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Attempts to copy the value off the stack at idx
+    ///
+    /// \param vm  Target VM
+    /// \param idx Index trying to be read
+    ///
+    /// \remarks
+    /// This function MUST have its Error handled if it occurred.
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    Var(HSQUIRRELVM vm, SQInteger idx) {
+        string errMsg;
+        if (!MarshalledValue::FromStack(vm, idx, value, errMsg)) {
+            SQTHROW(vm, errMsg);
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Called by Sqrat::PushVar to put a MarshalledValue on the stack
+    ///
+    /// \param vm    Target VM
+    /// \param value Value to push on to the VM's stack
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static void push(HSQUIRRELVM vm, const MarshalledValue& value) {
+        value.Push(vm);
+    }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Used to get and push MarshalledValues to and from the stack
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+template<>
+struct Var<MarshalledValue&> : Var<MarshalledValue> {Var(HSQUIRRELVM vm, SQInteger idx) : Var<MarshalledValue>(vm, idx) {}};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Used to get and push MarshalledValues to and from the stack
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+template<>
+struct Var<const MarshalledValue&> : Var<MarshalledValue> {Var(HSQUIRRELVM vm, SQInteger idx) : Var<MarshalledValue>(vm, idx) {}};
+
+}
+
+#endif
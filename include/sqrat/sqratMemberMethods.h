@@ -30,6 +30,7 @@
 #define _SCRAT_MEMBER_METHODS_H_
 
 #include <squirrel.h>
+#include "sqratInstrumentation.h"
 #include "sqratTypes.h"
 
 namespace Sqrat {
@@ -73,7 +74,9 @@ public:
         }
 
         SQTRY()
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)();
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -111,7 +114,9 @@ public:
         }
 
         SQTRY()
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)();
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -154,9 +159,11 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)(
                     a1.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -198,9 +205,11 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)(
                     a1.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -244,10 +253,12 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)(
                     a1.value,
                     a2.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -290,10 +301,12 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)(
                     a1.value,
                     a2.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -338,11 +351,13 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)(
                     a1.value,
                     a2.value,
                     a3.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -386,11 +401,13 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)(
                     a1.value,
                     a2.value,
                     a3.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -436,12 +453,14 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)(
                     a1.value,
                     a2.value,
                     a3.value,
                     a4.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -486,12 +505,14 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)(
                     a1.value,
                     a2.value,
                     a3.value,
                     a4.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -538,6 +559,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -545,6 +567,7 @@ public:
                     a4.value,
                     a5.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -590,6 +613,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -597,6 +621,7 @@ public:
                     a4.value,
                     a5.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -644,6 +669,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -652,6 +678,7 @@ public:
                     a5.value,
                     a6.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -698,6 +725,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -706,6 +734,7 @@ public:
                     a5.value,
                     a6.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -754,6 +783,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -763,6 +793,7 @@ public:
                     a6.value,
                     a7.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -810,6 +841,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -819,6 +851,7 @@ public:
                     a6.value,
                     a7.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -868,6 +901,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -878,6 +912,7 @@ public:
                     a7.value,
                     a8.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -926,6 +961,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -936,6 +972,7 @@ public:
                     a7.value,
                     a8.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -986,6 +1023,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -997,6 +1035,7 @@ public:
                     a8.value,
                     a9.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1046,6 +1085,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -1057,6 +1097,7 @@ public:
                     a8.value,
                     a9.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1109,6 +1150,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -1121,6 +1163,7 @@ public:
                     a9.value,
                     a10.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1171,6 +1214,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -1183,6 +1227,7 @@ public:
                     a9.value,
                     a10.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1236,6 +1281,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -1249,6 +1295,7 @@ public:
                     a10.value,
                     a11.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1300,6 +1347,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -1313,6 +1361,7 @@ public:
                     a10.value,
                     a11.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1367,6 +1416,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -1381,6 +1431,7 @@ public:
                     a11.value,
                     a12.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1433,6 +1484,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -1447,6 +1499,7 @@ public:
                     a11.value,
                     a12.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1501,6 +1554,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -1516,6 +1570,7 @@ public:
                     a12.value,
                     a13.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1569,6 +1624,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -1584,6 +1640,7 @@ public:
                     a12.value,
                     a13.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1639,6 +1696,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -1655,6 +1713,7 @@ public:
                     a13.value,
                     a14.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1709,6 +1768,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -1725,6 +1785,7 @@ public:
                     a13.value,
                     a14.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1773,7 +1834,9 @@ public:
         }
 
         SQTRY()
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)();
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1811,7 +1874,9 @@ public:
         }
 
         SQTRY()
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)();
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1854,9 +1919,11 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)(
                     a1.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1898,9 +1965,11 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)(
                     a1.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1944,10 +2013,12 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)(
                     a1.value,
                     a2.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -1990,10 +2061,12 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)(
                     a1.value,
                     a2.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -2038,11 +2111,13 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)(
                     a1.value,
                     a2.value,
                     a3.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -2086,11 +2161,13 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)(
                     a1.value,
                     a2.value,
                     a3.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -2136,12 +2213,14 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)(
                     a1.value,
                     a2.value,
                     a3.value,
                     a4.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -2186,12 +2265,14 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)(
                     a1.value,
                     a2.value,
                     a3.value,
                     a4.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -2238,6 +2319,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -2245,6 +2327,7 @@ public:
                     a4.value,
                     a5.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -2290,6 +2373,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -2297,6 +2381,7 @@ public:
                     a4.value,
                     a5.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -2344,6 +2429,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -2352,6 +2438,7 @@ public:
                     a5.value,
                     a6.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -2398,6 +2485,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -2406,6 +2494,7 @@ public:
                     a5.value,
                     a6.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -2454,6 +2543,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -2463,6 +2553,7 @@ public:
                     a6.value,
                     a7.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -2510,6 +2601,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -2519,6 +2611,7 @@ public:
                     a6.value,
                     a7.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -2568,6 +2661,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -2578,6 +2672,7 @@ public:
                     a7.value,
                     a8.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -2626,6 +2721,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -2636,6 +2732,7 @@ public:
                     a7.value,
                     a8.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -2686,6 +2783,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -2697,6 +2795,7 @@ public:
                     a8.value,
                     a9.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -2746,6 +2845,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -2757,6 +2857,7 @@ public:
                     a8.value,
                     a9.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -2809,6 +2910,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -2821,6 +2923,7 @@ public:
                     a9.value,
                     a10.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -2871,6 +2974,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -2883,6 +2987,7 @@ public:
                     a9.value,
                     a10.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -2936,6 +3041,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -2949,6 +3055,7 @@ public:
                     a10.value,
                     a11.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -3000,6 +3107,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -3013,6 +3121,7 @@ public:
                     a10.value,
                     a11.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -3067,6 +3176,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -3081,6 +3191,7 @@ public:
                     a11.value,
                     a12.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -3133,6 +3244,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -3147,6 +3259,7 @@ public:
                     a11.value,
                     a12.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -3201,6 +3314,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -3216,6 +3330,7 @@ public:
                     a12.value,
                     a13.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -3269,6 +3384,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -3284,6 +3400,7 @@ public:
                     a12.value,
                     a13.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -3339,6 +3456,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -3355,6 +3473,7 @@ public:
                     a13.value,
                     a14.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -3409,6 +3528,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         R& ret = (ptr->*method)(
                     a1.value,
                     a2.value,
@@ -3425,6 +3545,7 @@ public:
                     a13.value,
                     a14.value
                 );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -3474,7 +3595,9 @@ public:
         }
 
         SQTRY()
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)();
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -3511,7 +3634,9 @@ public:
         }
 
         SQTRY()
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)();
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -3553,9 +3678,11 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)(
             a1.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -3596,9 +3723,11 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)(
             a1.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -3641,10 +3770,12 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)(
             a1.value,
             a2.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -3686,10 +3817,12 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)(
             a1.value,
             a2.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -3733,11 +3866,13 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)(
             a1.value,
             a2.value,
             a3.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -3780,11 +3915,13 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)(
             a1.value,
             a2.value,
             a3.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -3829,12 +3966,14 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)(
             a1.value,
             a2.value,
             a3.value,
             a4.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -3878,12 +4017,14 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)(
             a1.value,
             a2.value,
             a3.value,
             a4.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -3929,6 +4070,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)(
             a1.value,
             a2.value,
@@ -3936,6 +4078,7 @@ public:
             a4.value,
             a5.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -3980,6 +4123,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)(
             a1.value,
             a2.value,
@@ -3987,6 +4131,7 @@ public:
             a4.value,
             a5.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -4033,6 +4178,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)(
             a1.value,
             a2.value,
@@ -4041,6 +4187,7 @@ public:
             a5.value,
             a6.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -4086,6 +4233,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)(
             a1.value,
             a2.value,
@@ -4094,6 +4242,7 @@ public:
             a5.value,
             a6.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -4141,6 +4290,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)(
             a1.value,
             a2.value,
@@ -4150,6 +4300,7 @@ public:
             a6.value,
             a7.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -4196,6 +4347,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)(
             a1.value,
             a2.value,
@@ -4205,6 +4357,7 @@ public:
             a6.value,
             a7.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -4253,6 +4406,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)(
             a1.value,
             a2.value,
@@ -4263,6 +4417,7 @@ public:
             a7.value,
             a8.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -4310,6 +4465,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)(
             a1.value,
             a2.value,
@@ -4320,6 +4476,7 @@ public:
             a7.value,
             a8.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -4369,6 +4526,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)(
             a1.value,
             a2.value,
@@ -4380,6 +4538,7 @@ public:
             a8.value,
             a9.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -4428,6 +4587,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)(
             a1.value,
             a2.value,
@@ -4439,6 +4599,7 @@ public:
             a8.value,
             a9.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -4489,6 +4650,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)(
             a1.value,
             a2.value,
@@ -4501,6 +4663,7 @@ public:
             a9.value,
             a10.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -4550,6 +4713,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)(
             a1.value,
             a2.value,
@@ -4562,6 +4726,7 @@ public:
             a9.value,
             a10.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -4613,6 +4778,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)(
             a1.value,
             a2.value,
@@ -4626,6 +4792,7 @@ public:
             a10.value,
             a11.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -4676,6 +4843,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)(
             a1.value,
             a2.value,
@@ -4689,6 +4857,7 @@ public:
             a10.value,
             a11.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -4741,6 +4910,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)(
             a1.value,
             a2.value,
@@ -4755,6 +4925,7 @@ public:
             a11.value,
             a12.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -4806,6 +4977,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)(
             a1.value,
             a2.value,
@@ -4820,6 +4992,7 @@ public:
             a11.value,
             a12.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -4873,6 +5046,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)(
             a1.value,
             a2.value,
@@ -4888,6 +5062,7 @@ public:
             a12.value,
             a13.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -4940,6 +5115,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)(
             a1.value,
             a2.value,
@@ -4955,6 +5131,7 @@ public:
             a12.value,
             a13.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -5009,6 +5186,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)(
             a1.value,
             a2.value,
@@ -5025,6 +5203,7 @@ public:
             a13.value,
             a14.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
@@ -5078,6 +5257,7 @@ public:
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
+        SQRAT_CALLEE_BEGIN();
         (ptr->*method)(
             a1.value,
             a2.value,
@@ -5094,6 +5274,7 @@ public:
             a13.value,
             a14.value
         );
+        SQRAT_CALLEE_END();
         SQCATCH_NOEXCEPT(vm) {
             return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
         }
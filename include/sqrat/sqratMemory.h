@@ -0,0 +1,506 @@
+//
+// SqratMemory: Per-VM memory accounting and budgets
+//
+
+//
+// Copyright (c) 2009 Brandon Jones
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software. If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+#if !defined(_SCRAT_MEMORY_H_)
+#define _SCRAT_MEMORY_H_
+
+#include <squirrel.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <atomic>
+#include <list>
+#include <vector>
+
+#include "sqratUtil.h"
+
+namespace Sqrat {
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Live instances of a bound class in a VM (see MemoryAccount::Classes)
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct ClassMemory {
+    string name;      ///< Name the class was bound under
+    size_t instances; ///< Instances the VM currently holds
+    size_t bytes;     ///< instances * sizeof(C), the C++ objects themselves
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Counts the memory a VM allocates through sq_malloc, sq_realloc and sq_free and enforces a budget on it
+///
+/// \remarks
+/// Squirrel only calls the accounting allocators when it is built with SQ_EXCLUDE_DEFAULT_MEMFUNCTIONS and exactly one
+/// source file of the host defines SCRAT_DEFINE_MEMORY_FUNCTIONS before including this header; otherwise the figures
+/// stay at zero. Each block then carries a small header naming the account it was charged to, so it is credited back
+/// to the right account wherever it is freed.
+///
+/// \remarks
+/// The allocators do not know which VM they allocate for: they charge the account made current on the calling thread
+/// by a Scope. SqratVM opens one around everything it does with an accounted VM; hosts that use the VM directly open
+/// one around their own calls.
+///
+/// \remarks
+/// Squirrel cannot survive a failed allocation, so the allocators only raise a flag when usage crosses a limit, and the
+/// budget is enforced where a script error can be raised: at every call into a function, property or constructor bound
+/// with Sqrat in the VM, when Check is called, and before SqratVM runs anything. A script that goes over the soft limit
+/// gets one error it may catch and recover from; over the hard limit, every such point fails until usage drops back.
+///
+/// \remarks
+/// The hard limit does NOT stop a running script that only executes Squirrel code and built-in functions, such as
+/// `while (true) a.append(array(1000))`: Squirrel offers no other point where an error can be raised (its debug hooks
+/// cannot fail), so such a script keeps allocating until it calls into a binding or returns. Hosts that run untrusted
+/// scripts must also bound their running time, for instance by running them as sqratthread tasks.
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class MemoryAccount {
+public:
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Makes an account the one charged by the allocators of the calling thread, for the lifetime of the Scope
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    class Scope {
+    public:
+
+        /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        /// Makes an account current
+        ///
+        /// \param account Account to charge (NULL to charge none)
+        ///
+        /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        explicit Scope(MemoryAccount* account) : m_previous(Current()) {
+            Current() = account;
+        }
+
+        /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        /// Makes the account of a VM current
+        ///
+        /// \param vm VM whose account to charge (none if it has no account)
+        ///
+        /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        explicit Scope(HSQUIRRELVM vm) : m_previous(Current()) {
+            Current() = Find(vm);
+        }
+
+        /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        /// Makes the previous account current again
+        ///
+        /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        ~Scope() {
+            Current() = m_previous;
+        }
+
+    private:
+
+        Scope(const Scope&);
+        Scope& operator=(const Scope&);
+
+        MemoryAccount* m_previous;
+    };
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Creates an account, owned by the caller until Release
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    MemoryAccount() : m_vm(NULL), m_refs(1), m_current(0), m_peak(0), m_allocations(0), m_reallocations(0), m_frees(0), m_softLimit(0), m_hardLimit(0), m_overLimit(false), m_softRaised(false) {
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gives up the caller's ownership (the account goes once the blocks charged to it are freed too)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Release() {
+        if (m_refs.fetch_sub(1) == 1) {
+            delete this;
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Associates the account with a VM, so that Find, Scope, Check and the class bindings made from now on can use it
+    ///
+    /// \param vm Target VM
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Attach(HSQUIRRELVM vm) {
+        m_vm = vm;
+        m_refs.fetch_add(1);
+        attachedCount().fetch_add(1);
+        sq_pushregistrytable(vm);
+        sq_pushstring(vm, registryKey(), -1);
+        MemoryAccount** ud = reinterpret_cast<MemoryAccount**>(sq_newuserdata(vm, sizeof(MemoryAccount*)));
+        *ud = this;
+        sq_setreleasehook(vm, -1, &release);
+        sq_rawset(vm, -3);
+        sq_pop(vm, 1);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Finds the account attached to a VM
+    ///
+    /// \param vm Target VM
+    ///
+    /// \return The account, or NULL if there is none
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static MemoryAccount* Find(HSQUIRRELVM vm) {
+        MemoryAccount* account = NULL;
+        if (attachedCount().load(std::memory_order_relaxed) == 0) {
+            return account;
+        }
+        sq_pushregistrytable(vm);
+        sq_pushstring(vm, registryKey(), -1);
+        if (SQ_SUCCEEDED(sq_rawget(vm, -2))) {
+            SQUserPointer ud;
+            if (SQ_SUCCEEDED(sq_getuserdata(vm, -1, &ud, NULL))) {
+                account = *reinterpret_cast<MemoryAccount**>(ud);
+            }
+            sq_pop(vm, 1);
+        }
+        sq_pop(vm, 1);
+        return account;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the account charged by the allocators of the calling thread
+    ///
+    /// \return A reference to the current account (NULL for none)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static MemoryAccount*& Current() {
+        static thread_local MemoryAccount* account = NULL;
+        return account;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Sets the budget
+    ///
+    /// \param softLimit Bytes above which the next checkpoint raises one script error (0 for no limit)
+    /// \param hardLimit Bytes above which every checkpoint raises a script error (0 for no limit)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void SetBudget(size_t softLimit, size_t hardLimit) {
+        m_softLimit.store(softLimit);
+        m_hardLimit.store(hardLimit);
+        m_softRaised = false;
+        m_overLimit.store(isOverLimit(m_current.load()));
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Raises a script error if the account is over its budget
+    ///
+    /// \param vm VM to raise the error in
+    ///
+    /// \return SQ_OK, or the result of sq_throwerror
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    SQRESULT Check(HSQUIRRELVM vm) {
+        if (!m_overLimit.load(std::memory_order_relaxed)) {
+            return SQ_OK;
+        }
+        size_t current = m_current.load(std::memory_order_relaxed);
+        size_t hardLimit = m_hardLimit.load(std::memory_order_relaxed);
+        size_t softLimit = m_softLimit.load(std::memory_order_relaxed);
+        if (hardLimit != 0 && current > hardLimit) {
+            return sq_throwerror(vm, _SC("memory budget exceeded"));
+        }
+        if (softLimit != 0 && current > softLimit) {
+            if (!m_softRaised) {
+                m_softRaised = true;
+                return sq_throwerror(vm, _SC("soft memory budget exceeded"));
+            }
+        } else {
+            m_softRaised = false;
+        }
+        if (!isOverLimit(current)) {
+            m_overLimit.store(false, std::memory_order_relaxed);
+            if (isOverLimit(m_current.load(std::memory_order_relaxed))) { // grown again meanwhile
+                m_overLimit.store(true, std::memory_order_relaxed);
+            }
+        }
+        return SQ_OK;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Checks whether the account is over its hard limit
+    ///
+    /// \return True if it is
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool IsOverHardLimit() const {
+        size_t hardLimit = m_hardLimit.load(std::memory_order_relaxed);
+        return hardLimit != 0 && m_current.load(std::memory_order_relaxed) > hardLimit;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the number of bytes allocated and not freed yet
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    size_t CurrentBytes() const {
+        return m_current.load(std::memory_order_relaxed);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the highest number of bytes allocated at once
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    size_t PeakBytes() const {
+        return m_peak.load(std::memory_order_relaxed);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the number of blocks allocated
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    unsigned long long Allocations() const {
+        return m_allocations.load(std::memory_order_relaxed);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the number of blocks resized
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    unsigned long long Reallocations() const {
+        return m_reallocations.load(std::memory_order_relaxed);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the number of blocks freed
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    unsigned long long Frees() const {
+        return m_frees.load(std::memory_order_relaxed);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the live instances of every class bound in the VM since the account was attached to it
+    ///
+    /// \return One entry per class, from the thread running the VM
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    std::vector<ClassMemory> Classes() const {
+        std::vector<ClassMemory> result;
+        for (std::list<TrackedClass>::const_iterator it = m_classes.begin(); it != m_classes.end(); ++it) {
+            ClassMemory entry;
+            entry.name = it->name;
+            entry.instances = it->count(m_vm);
+            entry.bytes = entry.instances * it->size;
+            result.push_back(entry);
+        }
+        return result;
+    }
+
+    /// @cond DEV
+
+    // Called by Class for each class it binds, with a function counting the live instances of the class in a VM
+    static void TrackClass(HSQUIRRELVM vm, const string& name, size_t size, size_t (*count)(HSQUIRRELVM)) {
+        MemoryAccount* account = Find(vm);
+        if (account != NULL) {
+            TrackedClass tracked = {name, size, count};
+            account->m_classes.push_back(tracked);
+        }
+    }
+
+    // Replaces sq_newclosure for the bindings Sqrat creates, so that calls to them check the budget of an accounted VM
+    static void NewClosure(HSQUIRRELVM vm, SQFUNCTION func, SQUnsignedInteger nfreevars) {
+        MemoryAccount* account = Find(vm);
+        if (account == NULL) {
+            sq_newclosure(vm, func, nfreevars);
+            return;
+        }
+        GuardedFunc guarded = {account, func};
+        account->m_guarded.push_back(guarded);
+
+        // the guard comes last and is popped before the call, so that func finds its own free variables at the top
+        sq_pushuserpointer(vm, &account->m_guarded.back());
+        sq_newclosure(vm, &guardedCall, nfreevars + 1);
+    }
+
+    // Implementations of sq_vm_malloc, sq_vm_realloc and sq_vm_free
+    static void* Malloc(SQUnsignedInteger size) {
+        Header* header = static_cast<Header*>(malloc(sizeof(Header) + static_cast<size_t>(size)));
+        if (header == NULL) {
+            return NULL;
+        }
+        header->account = Current();
+        if (header->account != NULL) {
+            header->account->allocated(static_cast<size_t>(size));
+        }
+        return header + 1;
+    }
+
+    static void* Realloc(void* p, SQUnsignedInteger oldsize, SQUnsignedInteger size) {
+        if (p == NULL) {
+            return Malloc(size);
+        }
+        Header* header = static_cast<Header*>(realloc(static_cast<Header*>(p) - 1, sizeof(Header) + static_cast<size_t>(size)));
+        if (header == NULL) {
+            return NULL;
+        }
+        if (header->account != NULL) {
+            header->account->reallocated(static_cast<size_t>(oldsize), static_cast<size_t>(size));
+        }
+        return header + 1;
+    }
+
+    static void Free(void* p, SQUnsignedInteger size) {
+        if (p == NULL) {
+            return;
+        }
+        Header* header = static_cast<Header*>(p) - 1;
+        MemoryAccount* account = header->account;
+        free(header);
+        if (account != NULL) {
+            account->freed(static_cast<size_t>(size));
+        }
+    }
+
+    /// @endcond
+
+private:
+
+    // Put in front of every block, sized so that the block that follows keeps the alignment malloc gives
+    union Header {
+        MemoryAccount* account;
+        max_align_t    align;
+    };
+
+    struct TrackedClass {
+        string name;
+        size_t size;
+        size_t (*count)(HSQUIRRELVM);
+    };
+
+    struct GuardedFunc {
+        MemoryAccount* account;
+        SQFUNCTION     func;
+    };
+
+    ~MemoryAccount() {
+    }
+
+    MemoryAccount(const MemoryAccount&);
+    MemoryAccount& operator=(const MemoryAccount&);
+
+    void allocated(size_t size) {
+        m_refs.fetch_add(1, std::memory_order_relaxed);
+        m_allocations.fetch_add(1, std::memory_order_relaxed);
+        grow(size);
+    }
+
+    void reallocated(size_t oldsize, size_t size) {
+        m_reallocations.fetch_add(1, std::memory_order_relaxed);
+        if (size >= oldsize) {
+            grow(size - oldsize);
+        } else {
+            m_current.fetch_sub(oldsize - size, std::memory_order_relaxed);
+        }
+    }
+
+    void freed(size_t size) {
+        m_frees.fetch_add(1, std::memory_order_relaxed);
+        m_current.fetch_sub(size, std::memory_order_relaxed);
+        Release();
+    }
+
+    void grow(size_t size) {
+        size_t current = m_current.fetch_add(size, std::memory_order_relaxed) + size;
+        size_t peak = m_peak.load(std::memory_order_relaxed);
+        while (current > peak && !m_peak.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {
+        }
+        if (isOverLimit(current)) {
+            m_overLimit.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    bool isOverLimit(size_t current) const {
+        size_t softLimit = m_softLimit.load(std::memory_order_relaxed);
+        size_t hardLimit = m_hardLimit.load(std::memory_order_relaxed);
+        return (softLimit != 0 && current > softLimit) || (hardLimit != 0 && current > hardLimit);
+    }
+
+    static SQInteger guardedCall(HSQUIRRELVM vm) {
+        SQUserPointer ptr;
+        sq_getuserpointer(vm, -1, &ptr);
+        sq_poptop(vm);
+        GuardedFunc* guarded = static_cast<GuardedFunc*>(ptr);
+        if (SQ_FAILED(guarded->account->Check(vm))) {
+            return SQ_ERROR;
+        }
+        return guarded->func(vm);
+    }
+
+    static const SQChar* registryKey() {
+        return _SC("__sqrat_memory__");
+    }
+
+    // Number of accounts attached to VMs, so that VMs without one are not looked up every time a binding is made
+    static std::atomic<int>& attachedCount() {
+        static std::atomic<int> count(0);
+        return count;
+    }
+
+    static SQInteger release(SQUserPointer ptr, SQInteger /*size*/) {
+        attachedCount().fetch_sub(1);
+        (*reinterpret_cast<MemoryAccount**>(ptr))->Release();
+        return 0;
+    }
+
+    HSQUIRRELVM                         m_vm;
+    std::atomic<long>                   m_refs;     // the owner, the VM it is attached to and every live block
+    std::atomic<size_t>                 m_current;
+    std::atomic<size_t>                 m_peak;
+    std::atomic<unsigned long long>     m_allocations;
+    std::atomic<unsigned long long>     m_reallocations;
+    std::atomic<unsigned long long>     m_frees;
+    std::atomic<size_t>                 m_softLimit;
+    std::atomic<size_t>                 m_hardLimit;
+    std::atomic<bool>                   m_overLimit; // set by the allocators, so that Check is cheap until then
+    bool                                m_softRaised;
+    std::list<TrackedClass>             m_classes;
+    std::list<GuardedFunc>              m_guarded;   // a list so that closures can keep pointers to its elements
+};
+
+}
+
+#if defined(SCRAT_DEFINE_MEMORY_FUNCTIONS)
+
+// The allocators of a Squirrel built with SQ_EXCLUDE_DEFAULT_MEMFUNCTIONS (defined in one source file only)
+void* sq_vm_malloc(SQUnsignedInteger size) {
+    return Sqrat::MemoryAccount::Malloc(size);
+}
+
+void* sq_vm_realloc(void* p, SQUnsignedInteger oldsize, SQUnsignedInteger size) {
+    return Sqrat::MemoryAccount::Realloc(p, oldsize, size);
+}
+
+void sq_vm_free(void* p, SQUnsignedInteger size) {
+    Sqrat::MemoryAccount::Free(p, size);
+}
+
+#endif
+
+#endif
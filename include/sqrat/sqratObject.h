@@ -32,6 +32,8 @@
 #include <string.h>
 
 #include "sqratAllocator.h"
+#include "sqratInstrumentation.h"
+#include "sqratMemory.h"
 #include "sqratTypes.h"
 #include "sqratOverloadMethods.h"
 #include "sqratUtil.h"
@@ -450,6 +452,24 @@ public:
 protected:
 /// @cond DEV
 
+    // Name that instrumentation puts before the names of the bindings of this object (declared in every build so that
+    // the vtable of Object does not depend on SCRAT_ENABLE_INSTRUMENTATION)
+    virtual string GetBindingScope() const {
+        return string();
+    }
+
+    // Creates the closure of a binding whose userdata is on top of the stack (counted when instrumentation is enabled)
+    inline void NewBindingClosure(SQFUNCTION func, const SQChar* name, const SQChar* suffix = _SC("")) {
+#if defined(SCRAT_ENABLE_INSTRUMENTATION)
+        string scope = GetBindingScope();
+        Instrumentation::NewClosure(vm, func, (scope.empty() ? scope : scope + _SC(".")) + name + suffix);
+#else
+        SQUNUSED(name);
+        SQUNUSED(suffix);
+        MemoryAccount::NewClosure(vm, func, 1);
+#endif
+    }
+
     // Bind a function and it's associated Squirrel closure to the object
     inline void BindFunc(const SQChar* name, void* method, size_t methodSize, SQFUNCTION func, bool staticVar = false) {
         sq_pushobject(vm, GetObject());
@@ -458,7 +478,7 @@ protected:
         SQUserPointer methodPtr = sq_newuserdata(vm, static_cast<SQUnsignedInteger>(methodSize));
         memcpy(methodPtr, method, methodSize);
 
-        sq_newclosure(vm, func, 1);
+        NewBindingClosure(func, name);
         sq_newslot(vm, -3, staticVar);
         sq_pop(vm,1); // pop table
     }
@@ -470,7 +490,7 @@ protected:
         SQUserPointer methodPtr = sq_newuserdata(vm, static_cast<SQUnsignedInteger>(methodSize));
         memcpy(methodPtr, method, methodSize);
 
-        sq_newclosure(vm, func, 1);
+        NewBindingClosure(func, _SC("[]"));
         sq_newslot(vm, -3, staticVar);
         sq_pop(vm,1); // pop table
     }
@@ -492,7 +512,7 @@ protected:
         sq_pushstring(vm, overloadName.c_str(), -1);
         SQUserPointer methodPtr = sq_newuserdata(vm, static_cast<SQUnsignedInteger>(methodSize));
         memcpy(methodPtr, method, methodSize);
-        sq_newclosure(vm, func, 1);
+        NewBindingClosure(func, overloadName.c_str());
         sq_newslot(vm, -3, staticVar);
 
         sq_pop(vm,1); // pop table
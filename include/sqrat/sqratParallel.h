@@ -0,0 +1,500 @@
+//
+// SqratParallel: Data-parallel map and reduce over arrays for pure native functions
+//
+
+//
+// Copyright (c) 2009 Brandon Jones
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software. If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+#if !defined(_SCRAT_PARALLEL_H_)
+#define _SCRAT_PARALLEL_H_
+
+#include <squirrel.h>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "sqratAsyncMethods.h"
+#include "sqratThreadPool.h"
+#include "sqratTypes.h"
+
+/// Smallest number of array elements handed to one thread by parallel_map and parallel_reduce
+#if !defined(SCRAT_PARALLEL_GRAIN)
+#define SCRAT_PARALLEL_GRAIN 64
+#endif
+
+namespace Sqrat {
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Splits a range of indices across the shared ThreadPool and the calling thread
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class ParallelFor {
+public:
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the number of chunks a range of the given size is split into
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static size_t ChunkCount(size_t count) {
+        size_t chunks = (count + SCRAT_PARALLEL_GRAIN - 1) / SCRAT_PARALLEL_GRAIN;
+        size_t limit = ThreadPool::Shared().GetThreadCount() + 1;
+        return chunks < limit ? chunks : limit;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Runs body once per chunk and returns when every chunk is done
+    ///
+    /// \param count  Number of indices
+    /// \param chunks Number of chunks (see ChunkCount)
+    /// \param body   Called as body(chunk, begin, end) (must not touch any VM)
+    ///
+    /// \return The first exception thrown by body, or an empty pointer
+    ///
+    /// \remarks
+    /// The first chunk runs on the calling thread while the others wait for a pool thread.
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static std::exception_ptr Run(size_t count, size_t chunks, const std::function<void (size_t, size_t, size_t)>& body) {
+        if (chunks == 0) {
+            return std::exception_ptr();
+        }
+        Join join(chunks);
+        for (size_t c = 1; c < chunks; ++c) {
+            Join* joinPtr = &join;
+            const std::function<void (size_t, size_t, size_t)>* bodyPtr = &body;
+            ThreadPool::Shared().Submit([joinPtr, bodyPtr, count, chunks, c]() {
+                joinPtr->RunChunk(*bodyPtr, c, count * c / chunks, count * (c + 1) / chunks);
+            });
+        }
+        join.RunChunk(body, 0, 0, count / chunks);
+        return join.Wait();
+    }
+
+private:
+
+    // Counts finished chunks (lives on the caller's stack until Wait returns)
+    class Join {
+    public:
+        explicit Join(size_t chunks) : m_remaining(chunks) {}
+
+        void RunChunk(const std::function<void (size_t, size_t, size_t)>& body, size_t chunk, size_t begin, size_t end) {
+            std::exception_ptr error;
+            SQTRY_ANY()
+                body(chunk, begin, end);
+            SQCATCH_ANY() {
+                error = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(m_lock);
+            if (error && !m_error) {
+                m_error = error;
+            }
+            if (--m_remaining == 0) {
+                m_done.notify_all();
+            }
+        }
+
+        std::exception_ptr Wait() {
+            std::unique_lock<std::mutex> lock(m_lock);
+            while (m_remaining > 0) {
+                m_done.wait(lock);
+            }
+            return m_error;
+        }
+
+    private:
+        std::mutex              m_lock;
+        std::condition_variable m_done;
+        size_t                  m_remaining;
+        std::exception_ptr      m_error;
+    };
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Typed kernel behind a function bound with PureFunc
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class PureKernel {
+public:
+
+    virtual ~PureKernel() {}
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Pushes an array holding the function applied to every element of the array at idx
+    ///
+    /// \return 1 on success, or an error from sq_throwerror
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    virtual SQInteger Map(HSQUIRRELVM vm, SQInteger idx) = 0;
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Pushes the array at idx folded with the function, starting from the value at initIdx (0 to start from the first element)
+    ///
+    /// \return 1 on success, or an error from sq_throwerror
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    virtual SQInteger Reduce(HSQUIRRELVM vm, SQInteger idx, SQInteger initIdx) = 0;
+};
+
+/// @cond DEV
+
+// Holder for one result (keeps std::vector<bool> from packing results that different threads write)
+template <class T>
+struct PureSlot {
+    T value;
+};
+
+// Copies the elements of a Squirrel array into owned C++ values
+template <class A>
+struct PureInput {
+    typedef typename OffloadArg<A>::Type Type;
+
+    static SQInteger Load(HSQUIRRELVM vm, SQInteger idx, std::vector<Type>& values) {
+        SQInteger size = sq_getsize(vm, idx);
+        values.reserve(static_cast<size_t>(size));
+        for (SQInteger i = 0; i < size; ++i) {
+            sq_pushinteger(vm, i);
+            sq_rawget(vm, idx);
+            SQTRY()
+            Var<A> value(vm, -1);
+            SQCATCH_NOEXCEPT(vm) {
+                sq_pop(vm, 1);
+                return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
+            }
+            values.push_back(value.value);
+            SQCATCH(vm) {
+                sq_pop(vm, 1);
+                return sq_throwerror(vm, SQWHAT(vm));
+            }
+            sq_pop(vm, 1);
+        }
+        return SQ_OK;
+    }
+
+    static SQInteger LoadOne(HSQUIRRELVM vm, SQInteger idx, Type& out) {
+        SQTRY()
+        Var<A> value(vm, idx);
+        SQCATCH_NOEXCEPT(vm) {
+            return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
+        }
+        out = value.value;
+        SQCATCH(vm) {
+            return sq_throwerror(vm, SQWHAT(vm));
+        }
+        return SQ_OK;
+    }
+};
+
+// Kernel of a function taking one argument (usable with parallel_map)
+template <class R, class A>
+class PureUnaryKernel : public PureKernel {
+public:
+    typedef R (*M)(A);
+
+    explicit PureUnaryKernel(M method) : m_method(method) {}
+
+    virtual SQInteger Map(HSQUIRRELVM vm, SQInteger idx) {
+        typedef typename PureInput<A>::Type In;
+        typedef typename OffloadArg<R>::Type Out;
+
+        std::vector<In> inputs;
+        if (SQ_FAILED(PureInput<A>::Load(vm, idx, inputs))) {
+            return SQ_ERROR;
+        }
+        std::vector<PureSlot<Out> > outputs(inputs.size());
+        M method = m_method;
+        std::exception_ptr error = ParallelFor::Run(inputs.size(), ParallelFor::ChunkCount(inputs.size()),
+            [&inputs, &outputs, method](size_t, size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    outputs[i].value = method(OffloadArg<A>::Pass(inputs[i]));
+                }
+            });
+        if (error) {
+            return sq_throwerror(vm, AsyncErrorMessage(error).c_str());
+        }
+
+        sq_newarray(vm, static_cast<SQInteger>(outputs.size()));
+        for (size_t i = 0; i < outputs.size(); ++i) {
+            sq_pushinteger(vm, static_cast<SQInteger>(i));
+            PushVar(vm, outputs[i].value);
+            sq_set(vm, -3);
+        }
+        return 1;
+    }
+
+    virtual SQInteger Reduce(HSQUIRRELVM vm, SQInteger /*idx*/, SQInteger /*initIdx*/) {
+        return sq_throwerror(vm, _SC("parallel_reduce needs a function taking two arguments"));
+    }
+
+private:
+    M m_method;
+};
+
+// Kernel of a function combining two values of one type (usable with parallel_reduce)
+template <class R, class A1, class A2>
+class PureBinaryKernel : public PureKernel {
+public:
+    typedef R (*M)(A1, A2);
+
+    explicit PureBinaryKernel(M method) : m_method(method) {}
+
+    virtual SQInteger Map(HSQUIRRELVM vm, SQInteger /*idx*/) {
+        return sq_throwerror(vm, _SC("parallel_map needs a function taking one argument"));
+    }
+
+    virtual SQInteger Reduce(HSQUIRRELVM vm, SQInteger idx, SQInteger initIdx) {
+        typedef typename PureInput<A1>::Type T;
+
+        std::vector<T> inputs;
+        if (SQ_FAILED(PureInput<A1>::Load(vm, idx, inputs))) {
+            return SQ_ERROR;
+        }
+        PureSlot<T> acc;
+        size_t first = 0;
+        if (initIdx != 0) {
+            if (SQ_FAILED(PureInput<A1>::LoadOne(vm, initIdx, acc.value))) {
+                return SQ_ERROR;
+            }
+        } else if (inputs.empty()) {
+            return sq_throwerror(vm, _SC("reduce of an empty array with no initial value"));
+        } else {
+            acc.value = inputs[0];
+            first = 1;
+        }
+
+        // Each chunk folds its own elements, the partial results are folded in order on this thread
+        size_t count = inputs.size() - first;
+        size_t chunks = ParallelFor::ChunkCount(count);
+        std::vector<PureSlot<T> > partials(chunks);
+        M method = m_method;
+        std::exception_ptr error = ParallelFor::Run(count, chunks,
+            [&inputs, &partials, method, first](size_t chunk, size_t begin, size_t end) {
+                T part = inputs[first + begin];
+                for (size_t i = first + begin + 1; i < first + end; ++i) {
+                    part = method(OffloadArg<A1>::Pass(part), OffloadArg<A2>::Pass(inputs[i]));
+                }
+                partials[chunk].value = part;
+            });
+        SQTRY_ANY()
+            if (error) {
+                std::rethrow_exception(error);
+            }
+            for (size_t c = 0; c < partials.size(); ++c) {
+                acc.value = method(OffloadArg<A1>::Pass(acc.value), OffloadArg<A2>::Pass(partials[c].value));
+            }
+        SQCATCH_ANY() {
+            return sq_throwerror(vm, AsyncErrorMessage(std::current_exception()).c_str());
+        }
+        PushVar(vm, acc.value);
+        return 1;
+    }
+
+private:
+    M m_method;
+};
+
+template <class R, class A>
+inline PureKernel* SqPureKernel(R (*method)(A)) {
+    return new PureUnaryKernel<R, A>(method);
+}
+
+template <class R, class A1, class A2>
+inline PureKernel* SqPureKernel(R (*method)(A1, A2)) {
+    return new PureBinaryKernel<R, A1, A2>(method);
+}
+
+/// @endcond
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Per-VM record of the closures bound with PureFunc and their kernels
+///
+/// \remarks
+/// The record lives in the registry, so every thread of a VM sees the same functions.
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class PureFunctions {
+public:
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Records the kernel of the closure stored under a key of a table
+    ///
+    /// \param vm     VM the closure belongs to
+    /// \param table  Table holding the closure
+    /// \param name   Key of the closure in the table
+    /// \param kernel Kernel to record (the VM takes ownership)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static void Register(HSQUIRRELVM vm, HSQOBJECT& table, const SQChar* name, PureKernel* kernel) {
+        sq_pushregistrytable(vm);
+        sq_pushstring(vm, RegistryKey(), -1);
+        if (SQ_FAILED(sq_rawget(vm, -2))) {
+            sq_newtable(vm);
+            sq_pushstring(vm, RegistryKey(), -1);
+            sq_push(vm, -2);
+            sq_rawset(vm, -4);
+        }
+        sq_pushobject(vm, table);
+        sq_pushstring(vm, name, -1);
+        if (SQ_FAILED(sq_rawget(vm, -2))) {
+            sq_pop(vm, 3);
+            delete kernel;
+            return;
+        }
+        sq_remove(vm, -2);
+        PureKernel** ud = reinterpret_cast<PureKernel**>(sq_newuserdata(vm, sizeof(PureKernel*)));
+        *ud = kernel;
+        sq_setreleasehook(vm, -1, &release);
+        sq_rawset(vm, -3);
+        sq_pop(vm, 2);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the kernel of the closure at idx
+    ///
+    /// \return The kernel or NULL if the closure was not bound with PureFunc
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static PureKernel* Find(HSQUIRRELVM vm, SQInteger idx) {
+        PureKernel* kernel = NULL;
+        idx = (idx < 0) ? sq_gettop(vm) + idx + 1 : idx;
+        sq_pushregistrytable(vm);
+        sq_pushstring(vm, RegistryKey(), -1);
+        if (SQ_SUCCEEDED(sq_rawget(vm, -2))) {
+            sq_push(vm, idx);
+            if (SQ_SUCCEEDED(sq_rawget(vm, -2))) {
+                SQUserPointer ud;
+                if (SQ_SUCCEEDED(sq_getuserdata(vm, -1, &ud, NULL))) {
+                    kernel = *reinterpret_cast<PureKernel**>(ud);
+                }
+                sq_pop(vm, 1);
+            }
+            sq_pop(vm, 1);
+        }
+        sq_pop(vm, 1);
+        return kernel;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Name of the registry slot that holds the table of pure closures
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static const SQChar* RegistryKey() {
+        return _SC("__sqrat_purefuncs__");
+    }
+
+private:
+
+    static SQInteger release(SQUserPointer p, SQInteger /*size*/) {
+        delete *reinterpret_cast<PureKernel**>(p);
+        return 0;
+    }
+};
+
+/// @cond DEV
+
+// parallel_map(fn, array): fn applied to every element, in parallel if fn was bound with PureFunc
+inline SQInteger sqParallelMap(HSQUIRRELVM vm) {
+    PureKernel* kernel = PureFunctions::Find(vm, 2);
+    if (kernel != NULL) {
+        return kernel->Map(vm, 3);
+    }
+    SQInteger size = sq_getsize(vm, 3);
+    sq_newarray(vm, size);
+    for (SQInteger i = 0; i < size; ++i) {
+        sq_pushinteger(vm, i);
+        sq_push(vm, 2);
+        sq_pushroottable(vm);
+        sq_pushinteger(vm, i);
+        sq_rawget(vm, 3);
+        if (SQ_FAILED(sq_call(vm, 2, SQTrue, SQTrue))) {
+            return SQ_ERROR;
+        }
+        sq_remove(vm, -2);
+        sq_set(vm, -3);
+    }
+    return 1;
+}
+
+// parallel_reduce(fn, array[, initial]): array folded with fn, in parallel if fn was bound with PureFunc
+inline SQInteger sqParallelReduce(HSQUIRRELVM vm) {
+    SQInteger initIdx = (sq_gettop(vm) >= 4) ? 4 : 0;
+    PureKernel* kernel = PureFunctions::Find(vm, 2);
+    if (kernel != NULL) {
+        return kernel->Reduce(vm, 3, initIdx);
+    }
+    SQInteger size = sq_getsize(vm, 3);
+    SQInteger first = 0;
+    if (initIdx != 0) {
+        sq_push(vm, initIdx);
+    } else if (size == 0) {
+        return sq_throwerror(vm, _SC("reduce of an empty array with no initial value"));
+    } else {
+        sq_pushinteger(vm, 0);
+        sq_rawget(vm, 3);
+        first = 1;
+    }
+    for (SQInteger i = first; i < size; ++i) {
+        sq_push(vm, 2);
+        sq_pushroottable(vm);
+        sq_push(vm, -3);
+        sq_pushinteger(vm, i);
+        sq_rawget(vm, 3);
+        if (SQ_FAILED(sq_call(vm, 3, SQTrue, SQTrue))) {
+            return SQ_ERROR;
+        }
+        sq_remove(vm, -2);
+        sq_remove(vm, -2);
+    }
+    return 1;
+}
+
+/// @endcond
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Adds parallel_map and parallel_reduce to the root table of a VM
+///
+/// \param vm VM to register the functions in
+///
+/// \remarks
+/// parallel_map(fn, array) and parallel_reduce(fn, array[, initial]) accept any function. Those bound with PureFunc have
+/// the array copied into C++ values once, processed in chunks on the shared ThreadPool and the result built in one pass.
+/// Other functions are called in order on the VM's thread. parallel_reduce expects fn to be associative.
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+inline void RegisterParallelLib(HSQUIRRELVM vm) {
+    sq_pushroottable(vm);
+    sq_pushstring(vm, _SC("parallel_map"), -1);
+    sq_newclosure(vm, &sqParallelMap, 0);
+    sq_setparamscheck(vm, 3, _SC(".ca"));
+    sq_newslot(vm, -3, false);
+    sq_pushstring(vm, _SC("parallel_reduce"), -1);
+    sq_newclosure(vm, &sqParallelReduce, 0);
+    sq_setparamscheck(vm, -3, _SC(".ca."));
+    sq_newslot(vm, -3, false);
+    sq_pop(vm, 1);
+}
+
+}
+
+#endif
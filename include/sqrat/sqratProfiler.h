@@ -0,0 +1,660 @@
+//
+// SqratProfiler: Script profiler built on the Squirrel debug hook
+//
+
+//
+// Copyright (c) 2009 Brandon Jones
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software. If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+#if !defined(_SCRAT_PROFILER_H_)
+#define _SCRAT_PROFILER_H_
+
+#include <squirrel.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <map>
+#include <vector>
+
+#include "sqratInstrumentation.h"
+#include "sqratUtil.h"
+
+namespace Sqrat {
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Profile of one function (see Profiler)
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct ProfileEntry {
+    ProfileEntry() : line(0), native(false), calls(0), inclusiveNs(0), exclusiveNs(0) {
+    }
+
+    string             name;        ///< Function name ("unknown" for anonymous functions)
+    string             source;      ///< Source name the function was compiled from ("[native]" for bindings)
+    SQInteger          line;        ///< Line the function was entered at
+    bool               native;      ///< Whether this is a Sqrat binding rather than a script function
+    unsigned long long calls;       ///< Number of calls seen while profiling
+    unsigned long long inclusiveNs; ///< Time spent in the function, callees included (recursion counted once)
+    unsigned long long exclusiveNs; ///< Time spent in the function itself
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Call-tree profiler of the scripts running in a VM
+///
+/// \remarks
+/// Start installs a native debug hook on the VM that follows every call and return to build a call tree, and Stop
+/// removes it, so a profile can be taken from a live process at any time. Trace needs the same hook, so a VM that is
+/// attached to Trace cannot be profiled until it is detached. Each tree node only sums its own time; the
+/// per-function figures and the collapsed stacks are folded from the tree when they are asked for.
+///
+/// \remarks
+/// With a sampling interval of 1 the clock is read on every call and return and the times are exact. With an interval
+/// of N the calls are still all counted, but the clock is only read on one event in N (line events included, when
+/// scripts are compiled with debug info) and the time since the previous reading is charged to the stack at that
+/// moment, which cuts the overhead of deep or chatty scripts for a statistical profile.
+///
+/// \remarks
+/// Squirrel does not report calls of native closures. When SCRAT_ENABLE_INSTRUMENTATION is defined the Sqrat bindings
+/// show up as functions of their own (source "[native]"); otherwise their time counts as time of the calling script.
+///
+/// \remarks
+/// Coroutine threads keep stacks of their own and inherit the hook if they are created after Start. Everything here
+/// must be called from the thread running the VM; scripts can use the functions added by Register.
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class Profiler {
+public:
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Starts (or restarts) profiling a VM, adding to what has been recorded since the last Reset
+    ///
+    /// \param vm          Target VM
+    /// \param sampleEvery Read the clock on one event in sampleEvery (1 times every call exactly)
+    ///
+    /// \return False if the VM's debug hook is taken by Trace (nothing is profiled then)
+    ///
+    /// \remarks
+    /// When called while the VM is running a script, the functions already on its stack are taken into account.
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static bool Start(HSQUIRRELVM vm, unsigned int sampleEvery = 1) {
+        if (!NativeDebugHook::Claim(vm, _SC("profiler"), &hook)) {
+            return false;
+        }
+#if defined(SCRAT_ENABLE_INSTRUMENTATION)
+        Instrumentation::AddObserver(&observe);
+#endif
+        Data* data = get(vm);
+        if (data->running) {
+            data->charge(now());
+        }
+        data->running = true;
+        data->sampleEvery = sampleEvery > 0 ? sampleEvery : 1;
+        data->countdown = data->sampleEvery;
+        data->threads.clear();
+        ++generation();
+
+        // frames entered before the hook was installed never get a call event, so they are pushed here
+        Node** current = &data->threads[vm];
+        *current = data->root();
+        SQInteger level = 0;
+        SQStackInfos si;
+        while (SQ_SUCCEEDED(sq_stackinfos(vm, level, &si))) {
+            ++level;
+        }
+        while (level-- > 0) {
+            sq_stackinfos(vm, level, &si);
+            if (si.line >= 0) { // native closures report no line and no return event
+                *current = data->enterSeeded(*current, si.source, si.line, si.funcname);
+            }
+        }
+
+        data->last = now();
+        data->lastNode = *current;
+        return true;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Stops profiling a VM, keeping what has been recorded
+    ///
+    /// \param vm Target VM
+    ///
+    /// \remarks
+    /// Coroutine threads that inherited the hook keep calling it until they end, but it returns at once.
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static void Stop(HSQUIRRELVM vm) {
+        Data* data = find(vm);
+        if (data == NULL || !data->running) {
+            return;
+        }
+        data->charge(now());
+        data->running = false;
+        NativeDebugHook::Release(vm, _SC("profiler"));
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Checks whether a VM is being profiled
+    ///
+    /// \param vm Target VM
+    ///
+    /// \return True between Start and Stop
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static bool IsRunning(HSQUIRRELVM vm) {
+        Data* data = find(vm);
+        return data != NULL && data->running;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Discards everything recorded for a VM (profiling goes on if it was running)
+    ///
+    /// \param vm Target VM
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static void Reset(HSQUIRRELVM vm) {
+        Data* data = find(vm);
+        if (data == NULL) {
+            return;
+        }
+        bool running = data->running;
+        unsigned int sampleEvery = data->sampleEvery;
+        Stop(vm);
+        data->clear();
+        ++generation();
+        if (running) {
+            Start(vm, sampleEvery);
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the profile of every function called while profiling a VM, by decreasing exclusive time
+    ///
+    /// \param vm Target VM
+    ///
+    /// \return One entry per function
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static std::vector<ProfileEntry> Report(HSQUIRRELVM vm) {
+        std::vector<ProfileEntry> result;
+        Data* data = find(vm);
+        if (data == NULL) {
+            return result;
+        }
+        if (data->running) {
+            data->charge(now());
+        }
+        for (std::list<Function>::iterator it = data->functions.begin(); it != data->functions.end(); ++it) {
+            it->entry = ProfileEntry();
+            it->entry.name = it->name;
+            it->entry.source = it->source;
+            it->entry.line = it->line;
+            it->entry.native = it->native;
+            it->active = 0;
+        }
+        Node* root = data->root();
+        for (size_t i = 0; i < root->children.size(); ++i) {
+            fold(root->children[i]);
+        }
+        for (std::list<Function>::const_iterator it = data->functions.begin(); it != data->functions.end(); ++it) {
+            if (it->entry.calls > 0 || it->entry.inclusiveNs > 0) {
+                result.push_back(it->entry);
+            }
+        }
+        std::sort(result.begin(), result.end(), busier);
+        return result;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the recorded stacks of a VM in the collapsed format read by flame graph tools
+    ///
+    /// \param vm Target VM
+    ///
+    /// \return One "outer (source:line);inner (source:line) nanoseconds" line per stack that took time
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static string CollapsedStacks(HSQUIRRELVM vm) {
+        string result;
+        Data* data = find(vm);
+        if (data == NULL) {
+            return result;
+        }
+        if (data->running) {
+            data->charge(now());
+        }
+        Node* root = data->root();
+        for (size_t i = 0; i < root->children.size(); ++i) {
+            collapse(root->children[i], string(), result);
+        }
+        return result;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Adds profiler_start([sample_every]), profiler_stop(), profiler_reset(), profiler_report() and
+    /// profiler_collapsed() to the root table of a VM
+    ///
+    /// \param vm Target VM
+    ///
+    /// \remarks
+    /// profiler_report returns an array of tables with the fields of ProfileEntry (name, source, line, native, calls,
+    /// inclusive_ns and exclusive_ns) and profiler_collapsed returns the string of CollapsedStacks.
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static void Register(HSQUIRRELVM vm) {
+        sq_pushroottable(vm);
+        newFunc(vm, _SC("profiler_start"), &startFunc, -1, _SC(".n"));
+        newFunc(vm, _SC("profiler_stop"), &stopFunc, 1, NULL);
+        newFunc(vm, _SC("profiler_reset"), &resetFunc, 1, NULL);
+        newFunc(vm, _SC("profiler_report"), &reportFunc, 1, NULL);
+        newFunc(vm, _SC("profiler_collapsed"), &collapsedFunc, 1, NULL);
+        sq_pop(vm, 1);
+    }
+
+private:
+
+    struct Function {
+        Function() : line(0), native(false), sourcePtr(NULL), namePtr(NULL), active(0) {
+        }
+
+        string         name;
+        string         source;
+        SQInteger      line;
+        bool           native;
+        const SQChar*  sourcePtr; // strings the hook was last given for this function, to skip comparing them
+        const SQChar*  namePtr;
+        int            active;    // times the function is on the path being folded
+        ProfileEntry   entry;
+    };
+
+    struct Node {
+        Node(Node* p, Function* f) : parent(p), function(f), calls(0), selfNs(0) {
+        }
+
+        Node*               parent;
+        Function*           function;
+        unsigned long long  calls;
+        unsigned long long  selfNs;
+        std::vector<Node*>  children;
+    };
+
+    struct Data {
+        Data() : running(false), sampleEvery(1), countdown(1), last(0), lastNode(NULL) {
+            clear();
+        }
+
+        Node* root() {
+            return &nodes.front();
+        }
+
+        void clear() {
+            nodes.clear();
+            functions.clear();
+            threads.clear();
+            nodes.push_back(Node(NULL, NULL));
+            lastNode = root();
+        }
+
+        // Gives the time since the last reading to the node that was running
+        void charge(unsigned long long time) {
+            lastNode->selfNs += time - last;
+            last = time;
+        }
+
+        Node* enter(Node* node, const SQChar* source, SQInteger line, const SQChar* name, bool native) {
+            source = orUnknown(source);
+            name = orUnknown(name);
+            for (size_t i = 0; i < node->children.size(); ++i) {
+                Function* f = node->children[i]->function;
+                if (f->line == line && f->native == native && f->sourcePtr == source && f->namePtr == name) {
+                    return count(node->children[i]);
+                }
+            }
+            for (size_t i = 0; i < node->children.size(); ++i) {
+                Function* f = node->children[i]->function;
+                if (f->line == line && f->native == native && f->source == source && f->name == name) {
+                    f->sourcePtr = source;
+                    f->namePtr = name;
+                    return count(node->children[i]);
+                }
+            }
+            return count(child(node, function(source, line, name, native)));
+        }
+
+        // Like enter for a frame found on the stack by Start, whose line is where it is now rather than where it began
+        Node* enterSeeded(Node* node, const SQChar* source, SQInteger line, const SQChar* name) {
+            source = orUnknown(source);
+            name = orUnknown(name);
+            for (std::list<Function>::iterator it = functions.begin(); it != functions.end(); ++it) {
+                if (!it->native && it->source == source && it->name == name) {
+                    for (size_t i = 0; i < node->children.size(); ++i) {
+                        if (node->children[i]->function == &*it) {
+                            return node->children[i];
+                        }
+                    }
+                    return child(node, &*it);
+                }
+            }
+            return child(node, function(source, line, name, false));
+        }
+
+        // Returns to the caller of the innermost frame of the function, if it is on the stack at all (frames left
+        // without a return event, such as a generator that yielded, are dropped on the way)
+        Node* leave(Node* node, const SQChar* source, const SQChar* name, bool native) {
+            source = orUnknown(source);
+            name = orUnknown(name);
+            for (Node* n = node; n->parent != NULL; n = n->parent) {
+                Function* f = n->function;
+                if (f->native == native && ((f->sourcePtr == source && f->namePtr == name) || (f->source == source && f->name == name))) {
+                    return n->parent;
+                }
+            }
+            return node;
+        }
+
+        Node* count(Node* node) {
+            ++node->calls;
+            return node;
+        }
+
+        Node* child(Node* node, Function* f) {
+            nodes.push_back(Node(node, f));
+            node->children.push_back(&nodes.back());
+            return &nodes.back();
+        }
+
+        Function* function(const SQChar* source, SQInteger line, const SQChar* name, bool native) {
+            functions.push_back(Function());
+            Function& f = functions.back();
+            f.name = name;
+            f.source = source;
+            f.line = line;
+            f.native = native;
+            f.sourcePtr = source;
+            f.namePtr = name;
+            return &f;
+        }
+
+        static const SQChar* orUnknown(const SQChar* str) {
+            return str != NULL ? str : _SC("unknown");
+        }
+
+        bool                            running;
+        unsigned int                    sampleEvery;
+        unsigned int                    countdown;
+        unsigned long long              last;
+        Node*                           lastNode;
+        std::list<Node>                 nodes;     // the first node is the root, a list so that pointers stay valid
+        std::list<Function>             functions;
+        std::map<HSQUIRRELVM, Node*>    threads;   // innermost frame of each thread of the VM
+    };
+
+    // Profile and thread of the VM the hook was last called for on this OS thread
+    struct Cache {
+        HSQUIRRELVM vm;
+        unsigned    generation;
+        Data*       data;
+        Node**      current;
+    };
+
+    static void hook(HSQUIRRELVM v, SQInteger type, const SQChar* source, SQInteger line, const SQChar* name) {
+        if (type == _SC('l')) {
+            Cache& cache = lookup(v);
+            if (cache.data != NULL && cache.data->running && cache.data->sampleEvery > 1) {
+                tick(cache.data);
+            }
+        } else if (type == _SC('c')) {
+            event(v, source, line, name, false, true);
+        } else if (type == _SC('r')) {
+            event(v, source, line, name, false, false);
+        }
+    }
+
+#if defined(SCRAT_ENABLE_INSTRUMENTATION)
+    static void observe(HSQUIRRELVM vm, const BindingCounters& binding, bool enter) {
+        event(vm, nativeSource(), 0, binding.name.c_str(), true, enter);
+    }
+#endif
+
+    static void event(HSQUIRRELVM v, const SQChar* source, SQInteger line, const SQChar* name, bool native, bool enter) {
+        Cache& cache = lookup(v);
+        Data* data = cache.data;
+        if (data == NULL || !data->running) {
+            return;
+        }
+        tick(data);
+        Node*& current = *cache.current;
+        current = enter ? data->enter(current, source, line, name, native) : data->leave(current, source, name, native);
+        data->lastNode = current;
+    }
+
+    static void tick(Data* data) {
+        if (--data->countdown == 0) {
+            data->countdown = data->sampleEvery;
+            data->charge(now());
+        }
+    }
+
+    static Cache& lookup(HSQUIRRELVM v) {
+        static thread_local Cache cache = {NULL, 0, NULL, NULL};
+        unsigned gen = generation().load(std::memory_order_relaxed);
+        if (cache.vm != v || cache.generation != gen) {
+            cache.vm = v;
+            cache.generation = gen;
+            cache.data = find(v);
+            cache.current = NULL;
+            if (cache.data != NULL) {
+                Node*& current = cache.data->threads[v];
+                if (current == NULL) {
+                    current = cache.data->root();
+                }
+                cache.current = &current;
+            }
+        }
+        return cache;
+    }
+
+    // Changes whenever a profile is created, destroyed or has its threads forgotten, which voids every Cache
+    static std::atomic<unsigned>& generation() {
+        static std::atomic<unsigned> gen(0);
+        return gen;
+    }
+
+    // Adds the figures of a subtree to its functions and returns its total time
+    static unsigned long long fold(Node* node) {
+        Function* f = node->function;
+        unsigned long long totalNs = node->selfNs;
+        ++f->active;
+        for (size_t i = 0; i < node->children.size(); ++i) {
+            totalNs += fold(node->children[i]);
+        }
+        --f->active;
+        f->entry.calls += node->calls;
+        f->entry.exclusiveNs += node->selfNs;
+        if (f->active == 0) { // only the outermost frame of a recursion counts towards the inclusive time
+            f->entry.inclusiveNs += totalNs;
+        }
+        return totalNs;
+    }
+
+    static void collapse(Node* node, const string& prefix, string& out) {
+        string path = prefix;
+        if (!path.empty()) {
+            path += _SC(';');
+        }
+        path += frameName(*node->function);
+        if (node->selfNs > 0) {
+            out += path;
+            out += _SC(' ');
+            out += toString(node->selfNs);
+            out += _SC('\n');
+        }
+        for (size_t i = 0; i < node->children.size(); ++i) {
+            collapse(node->children[i], path, out);
+        }
+    }
+
+    static string frameName(const Function& f) {
+        string name = f.name + _SC(" (") + f.source;
+        if (!f.native) {
+            name += _SC(':') + toString(static_cast<unsigned long long>(f.line));
+        }
+        name += _SC(')');
+        std::replace(name.begin(), name.end(), _SC(';'), _SC(':'));
+        return name;
+    }
+
+    static string toString(unsigned long long value) {
+        SQChar buf[24];
+        SQChar* p = buf + sizeof(buf) / sizeof(SQChar);
+        *--p = 0;
+        do {
+            *--p = static_cast<SQChar>(_SC('0') + value % 10);
+            value /= 10;
+        } while (value != 0);
+        return string(p);
+    }
+
+    static bool busier(const ProfileEntry& a, const ProfileEntry& b) {
+        return a.exclusiveNs > b.exclusiveNs;
+    }
+
+    static const SQChar* nativeSource() {
+        return _SC("[native]");
+    }
+
+    static unsigned long long now() {
+        return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    static const SQChar* registryKey() {
+        return _SC("__sqrat_profiler__");
+    }
+
+    static Data* find(HSQUIRRELVM vm) {
+        Data* data = NULL;
+        sq_pushregistrytable(vm);
+        sq_pushstring(vm, registryKey(), -1);
+        if (SQ_SUCCEEDED(sq_rawget(vm, -2))) {
+            SQUserPointer ud;
+            if (SQ_SUCCEEDED(sq_getuserdata(vm, -1, &ud, NULL))) {
+                data = *reinterpret_cast<Data**>(ud);
+            }
+            sq_pop(vm, 1);
+        }
+        sq_pop(vm, 1);
+        return data;
+    }
+
+    static Data* get(HSQUIRRELVM vm) {
+        Data* data = find(vm);
+        if (data == NULL) {
+            sq_pushregistrytable(vm);
+            sq_pushstring(vm, registryKey(), -1);
+            Data** ud = reinterpret_cast<Data**>(sq_newuserdata(vm, sizeof(Data*)));
+            *ud = data = new Data();
+            sq_setreleasehook(vm, -1, &release);
+            sq_rawset(vm, -3);
+            sq_pop(vm, 1);
+            ++generation();
+        }
+        return data;
+    }
+
+    static SQInteger release(SQUserPointer ptr, SQInteger /*size*/) {
+        delete *reinterpret_cast<Data**>(ptr);
+        ++generation();
+        return 0;
+    }
+
+    static void newFunc(HSQUIRRELVM vm, const SQChar* name, SQFUNCTION func, SQInteger nparams, const SQChar* typemask) {
+        sq_pushstring(vm, name, -1);
+        sq_newclosure(vm, func, 0);
+        sq_setparamscheck(vm, nparams, typemask);
+        sq_newslot(vm, -3, false);
+    }
+
+    static void pushSlot(HSQUIRRELVM vm, const SQChar* key, const string& value) {
+        sq_pushstring(vm, key, -1);
+        sq_pushstring(vm, value.c_str(), static_cast<SQInteger>(value.size()));
+        sq_newslot(vm, -3, false);
+    }
+
+    static void pushSlot(HSQUIRRELVM vm, const SQChar* key, unsigned long long value) {
+        sq_pushstring(vm, key, -1);
+        sq_pushinteger(vm, static_cast<SQInteger>(value));
+        sq_newslot(vm, -3, false);
+    }
+
+    static SQInteger startFunc(HSQUIRRELVM vm) {
+        SQInteger sampleEvery = 1;
+        if (sq_gettop(vm) >= 2) {
+            sq_getinteger(vm, 2, &sampleEvery);
+        }
+        if (!Start(vm, sampleEvery > 0 ? static_cast<unsigned int>(sampleEvery) : 1)) {
+            return sq_throwerror(vm, _SC("the debug hook of the VM is used by Trace"));
+        }
+        return 0;
+    }
+
+    static SQInteger stopFunc(HSQUIRRELVM vm) {
+        Stop(vm);
+        return 0;
+    }
+
+    static SQInteger resetFunc(HSQUIRRELVM vm) {
+        Reset(vm);
+        return 0;
+    }
+
+    static SQInteger reportFunc(HSQUIRRELVM vm) {
+        std::vector<ProfileEntry> entries = Report(vm);
+        sq_newarray(vm, 0);
+        for (size_t i = 0; i < entries.size(); ++i) {
+            sq_newtable(vm);
+            pushSlot(vm, _SC("name"), entries[i].name);
+            pushSlot(vm, _SC("source"), entries[i].source);
+            sq_pushstring(vm, _SC("line"), -1);
+            sq_pushinteger(vm, entries[i].line);
+            sq_newslot(vm, -3, false);
+            sq_pushstring(vm, _SC("native"), -1);
+            sq_pushbool(vm, entries[i].native);
+            sq_newslot(vm, -3, false);
+            pushSlot(vm, _SC("calls"), entries[i].calls);
+            pushSlot(vm, _SC("inclusive_ns"), entries[i].inclusiveNs);
+            pushSlot(vm, _SC("exclusive_ns"), entries[i].exclusiveNs);
+            sq_arrayappend(vm, -2);
+        }
+        return 1;
+    }
+
+    static SQInteger collapsedFunc(HSQUIRRELVM vm) {
+        string stacks = CollapsedStacks(vm);
+        sq_pushstring(vm, stacks.c_str(), static_cast<SQInteger>(stacks.size()));
+        return 1;
+    }
+};
+
+}
+
+#endif
@@ -34,9 +34,42 @@
 
 #include "sqratObject.h"
 #include "sqratBytecode.h"
+#include "sqratClosureCache.h"
+#include "sqratCompiledScript.h"
+#include "sqratTrace.h"
 
 namespace Sqrat {
 
+// The loaders that need platform file APIs are defined in the headers that provide them (sqratMappedFile.h and
+// sqratBundle.h), so that plain users of Script do not pull in those APIs
+class Bundle;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Interface of the compile caches Script::CompileFile can go through (see CompileCache in sqrat/sqratCompileCache.h)
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class CompileCacheBase {
+public:
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Destructs the cache
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    virtual ~CompileCacheBase() {
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Pushes the compiled closure of a script file
+    ///
+    /// \param vm   VM to push the closure in
+    /// \param path Path of the script file
+    ///
+    /// \return SQ_OK with the closure on the stack, or the error of loading the file
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    virtual SQRESULT Load(HSQUIRRELVM vm, const string& path) = 0;
+};
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /// Helper class for managing Squirrel scripts
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -49,7 +82,59 @@ public:
     /// \param v VM that the Script will be associated with
     ///
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    Script(HSQUIRRELVM v = DefaultVM::Get()) : Object(v, true) {
+    Script(HSQUIRRELVM v = DefaultVM::Get()) : Object(v, true), m_compileCache(NULL), m_closureCache(NULL) {
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Constructs a Script from a shared bytecode image
+    ///
+    /// \param image Compiled script (read in place, nothing is compiled)
+    /// \param v     VM that the Script will be associated with
+    ///
+    /// \remarks
+    /// This function MUST have its Error handled if it occurred.
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    Script(const CompiledScript& image, HSQUIRRELVM v = DefaultVM::Get()) : Object(v, true), m_compileCache(NULL), m_closureCache(NULL) {
+        if (!LoadBytecode(image.Data(), image.Size())) {
+            SQTHROW(vm, _SC("invalid bytecode image"));
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Makes CompileFile go through an on-disk compile cache
+    ///
+    /// \param cache Cache to use (NULL to always compile the file), usually a CompileCache; it must outlive the Script
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void SetCompileCache(CompileCacheBase* cache) {
+        m_compileCache = cache;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the compile cache used by CompileFile (NULL if none)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    CompileCacheBase* GetCompileCache() const {
+        return m_compileCache;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Makes CompileString reuse closures already compiled from the same text
+    ///
+    /// \param cache Cache of the Script's VM (NULL to always compile); it must outlive the Script
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void SetClosureCache(ClosureCache* cache) {
+        m_closureCache = cache;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the closure cache used by CompileString (NULL if none)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ClosureCache* GetClosureCache() const {
+        return m_closureCache;
     }
 
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -69,12 +154,12 @@ public:
         }
 
 #if !defined (SCRAT_NO_ERROR_CHECKING)
-        if(SQ_FAILED(sq_compilebuffer(vm, script.c_str(), static_cast<SQInteger>(script.size() /** sizeof(SQChar)*/), name.c_str(), true))) {
+        if(SQ_FAILED(compileString(script, name))) {
             SQTHROW(vm, LastErrorString(vm));
             return;
         }
 #else
-        sq_compilebuffer(vm, script.c_str(), static_cast<SQInteger>(script.size() /** sizeof(SQChar)*/), name.c_str(), true);
+        compileString(script, name);
 #endif
         sq_getstackobj(vm,-1,&obj);
         sq_addref(vm, &obj);
@@ -96,12 +181,12 @@ public:
         }
 
 #if !defined (SCRAT_NO_ERROR_CHECKING)
-        if(SQ_FAILED(sq_compilebuffer(vm, script.c_str(), static_cast<SQInteger>(script.size() /** sizeof(SQChar)*/), name.c_str(), true))) {
+        if(SQ_FAILED(compileString(script, name))) {
             errMsg = LastErrorString(vm);
             return false;
         }
 #else
-        sq_compilebuffer(vm, script.c_str(), static_cast<SQInteger>(script.size() /** sizeof(SQChar)*/), name.c_str(), true);
+        compileString(script, name);
 #endif
         sq_getstackobj(vm,-1,&obj);
         sq_addref(vm, &obj);
@@ -125,12 +210,12 @@ public:
         }
 
 #if !defined (SCRAT_NO_ERROR_CHECKING)
-        if(SQ_FAILED(sqstd_loadfile(vm, path.c_str(), true))) {
+        if(SQ_FAILED(loadFile(path))) {
             SQTHROW(vm, LastErrorString(vm));
             return;
         }
 #else
-        sqstd_loadfile(vm, path.c_str(), true);
+        loadFile(path);
 #endif
         sq_getstackobj(vm,-1,&obj);
         sq_addref(vm, &obj);
@@ -151,12 +236,12 @@ public:
         }
 
 #if !defined (SCRAT_NO_ERROR_CHECKING)
-        if(SQ_FAILED(sqstd_loadfile(vm, path.c_str(), true))) {
+        if(SQ_FAILED(loadFile(path))) {
             errMsg = LastErrorString(vm);
             return false;
         }
 #else
-        sqstd_loadfile(vm, path.c_str(), true);
+        loadFile(path);
 #endif
         sq_getstackobj(vm,-1,&obj);
         sq_addref(vm, &obj);
@@ -164,6 +249,36 @@ public:
         return true;
     }
 
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Sets up the Script using a file containing a Squirrel script or its bytecode, read through a memory mapping
+    ///
+    /// \param path File path containing a Squirrel script
+    ///
+    /// \remarks
+    /// The compiler or bytecode reader works straight from the mapped file. Files that need re-encoding (UTF-16, or any
+    /// source file in a SQUNICODE build) are loaded through sqstd_loadfile as CompileFile does.
+    ///
+    /// \remarks
+    /// Defined in sqrat/sqratMappedFile.h, which must be included to use it.
+    ///
+    /// \remarks
+    /// This function MUST have its Error handled if it occurred.
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    inline void CompileMappedFile(const string& path);
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Sets up the Script using a file containing a Squirrel script or its bytecode, read through a memory mapping
+    ///
+    /// \param path   File path containing a Squirrel script
+    /// \param errMsg String that is filled with any errors that may occur
+    ///
+    /// \remarks
+    /// Defined in sqrat/sqratMappedFile.h, which must be included to use it.
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    inline bool CompileMappedFile(const string& path, string& errMsg);
+
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     /// Runs the script
     ///
@@ -243,20 +358,39 @@ public:
     ///
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     std::string SaveBytecode() {
-        Bytecode bytecode;
+        std::string str;
 #if !defined (SCRAT_NO_ERROR_CHECKING)
         if (!sq_isnull(obj)) {
             sq_pushobject(vm, obj);
-            if (SQ_FAILED(sq_writeclosure(vm, BytecodeWriter, &bytecode))) {
+            if (SQ_FAILED(sq_writeclosure(vm, BytecodeStringWriter, &str))) {
                 SQTHROW(vm, LastErrorString(vm));
             }
         }
 #else
         sq_pushobject(vm, obj);
-        sq_writeclosure(vm, BytecodeWriter, &bytecode);
+        sq_writeclosure(vm, BytecodeStringWriter, &str);
 #endif
         sq_pop(vm, 1); // needed?
-        return std::string(reinterpret_cast<char*>(bytecode.Data()), bytecode.Size());
+        return str;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Saves script's bytecode into a Bytecode owned by the caller
+    ///
+    /// \param bytecode Bytecode to fill (cleared first, its buffer is reused)
+    ///
+    /// \return True on success
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool SaveBytecode(Bytecode& bytecode) {
+        bytecode.Clear();
+        if (sq_isnull(obj)) {
+            return false;
+        }
+        sq_pushobject(vm, obj);
+        SQRESULT result = sq_writeclosure(vm, BytecodeWriter, &bytecode);
+        sq_pop(vm, 1);
+        return SQ_SUCCEEDED(result);
     }
 
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -266,8 +400,22 @@ public:
     ///
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     bool LoadBytecode(const std::string& str) {
+        return LoadBytecode(str.data(), str.size());
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Loads script's bytecode straight from memory owned by the caller
+    ///
+    /// \param data Pointer to the bytecode (e.g. an existing buffer or a memory-mapped file)
+    /// \param size Size of the bytecode in bytes
+    ///
+    /// \remarks
+    /// The memory is read in place and only needs to stay valid during the call.
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool LoadBytecode(const void* data, size_t size) {
 #if !defined (SCRAT_NO_ERROR_CHECKING)
-        if (str.empty()) {
+        if (size == 0) {
             return false;
         }
 #endif
@@ -275,8 +423,7 @@ public:
             sq_release(vm, &obj);
             sq_resetobject(&obj);
         }
-        Bytecode bytecode;
-        bytecode.SetData(str.c_str(), str.size());
+        Bytecode bytecode(data, size);
 #if !defined (SCRAT_NO_ERROR_CHECKING)
         if (SQ_FAILED(sq_readclosure(vm, BytecodeReader, &bytecode))) {
             return false;
@@ -289,6 +436,64 @@ public:
         sq_pop(vm, 1);
         return true;
     }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Sets up the Script using a module of a bundle, read in place from the mapped bundle
+    ///
+    /// \param bundle Open bundle
+    /// \param name   Name of the module in the bundle
+    ///
+    /// \return True if the module was found, intact and loaded
+    ///
+    /// \remarks
+    /// Defined in sqrat/sqratBundle.h, which must be included to use it.
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    inline bool LoadBytecode(const Bundle& bundle, const std::string& name);
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Sets up the Script using a bytecode file, read in place through a memory mapping
+    ///
+    /// \param path Path of a file written by WriteCompiledFile or sq_writeclosure
+    ///
+    /// \return True if successful
+    ///
+    /// \remarks
+    /// Defined in sqrat/sqratMappedFile.h, which must be included to use it.
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    inline bool LoadBytecodeFile(const string& path);
+
+private:
+
+    static std::string narrowPath(const string& path) {
+#if defined(SQUNICODE)
+        return wstring_to_string(path);
+#else
+        return path;
+#endif
+    }
+
+    inline SQRESULT loadMappedFile(const string& path);
+
+    SQRESULT loadFile(const string& path) {
+        Trace::Scope trace(vm, Trace::TRACE_COMPILE, _SC("load"), path.c_str());
+        if (m_compileCache != NULL) {
+            return m_compileCache->Load(vm, path);
+        }
+        return sqstd_loadfile(vm, path.c_str(), true);
+    }
+
+    SQRESULT compileString(const string& script, const string& name) {
+        Trace::Scope trace(vm, Trace::TRACE_COMPILE, _SC("compile"), name.c_str());
+        if (m_closureCache != NULL && m_closureCache->GetVM() == vm) {
+            return m_closureCache->Compile(script, name);
+        }
+        return sq_compilebuffer(vm, script.c_str(), static_cast<SQInteger>(script.size() /** sizeof(SQChar)*/), name.c_str(), true);
+    }
+
+    CompileCacheBase* m_compileCache;
+    ClosureCache*     m_closureCache;
 };
 
 }
@@ -30,13 +30,18 @@
 
 #include <squirrel.h>
 #include <string.h>
+#include <functional>
 
 #include "sqratObject.h"
 #include "sqratFunction.h"
 #include "sqratGlobalMethods.h"
+#include "sqratAsyncMethods.h"
+#include "sqratParallel.h"
 
 namespace Sqrat {
 
+class Table;
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /// The base class for Table that implements almost all of its functionality
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -89,6 +94,21 @@ public:
         sq_pop(vm,1); // pop table
     }
 
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Defers a set of bindings until a script reads a key the Table does not have yet
+    ///
+    /// \param bind Function that fills the Table (e.g. with a large set of Class bindings)
+    ///
+    /// \return The Table itself so the call can be chained
+    ///
+    /// \remarks
+    /// The Table gets a delegate whose _get runs the pending functions in order until the key exists, then the delegate
+    /// is dropped. Slots added this way are not seen by foreach or the 'in' operator before that. A Table that already
+    /// has another delegate cannot be made lazy. The same delegate serves lazy imports (see sqrat_import_lazy).
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    TableBase& LazyBind(const std::function<void (Table&)>& bind);
+
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     /// Binds a raw Squirrel closure to the Table
     ///
@@ -195,6 +215,74 @@ public:
         return *this;
     }
 
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Sets a key in the Table to a function whose result arrives later
+    ///
+    /// \param name   The key in the table being assigned a value
+    /// \param method Function returning a std::future<R>, or taking an AsyncCallback<R> as its first parameter
+    ///
+    /// \tparam F Type of function (only define this if you need to choose a certain template specialization or overload)
+    ///
+    /// \return The Table itself so the call can be chained
+    ///
+    /// \remarks
+    /// If the result is not ready, a calling coroutine is suspended and resumed with the result by AsyncQueue::Drain (the
+    /// sqratthread scheduler drains the queue on every step). Calls made directly from the host block until the result
+    /// is ready. The result may be produced on any OS thread.
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    template<class F>
+    TableBase& AsyncFunc(const SQChar* name, F method) {
+        AsyncQueue::Get(vm);
+        BindFunc(name, &method, sizeof(method), SqAsyncFunc(method));
+        return *this;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Sets a key in the Table to a function that runs on the shared ThreadPool instead of the VM's thread
+    ///
+    /// \param name   The key in the table being assigned a value
+    /// \param method Function that is being placed in the Table (must not touch any VM)
+    ///
+    /// \tparam F Type of function (only define this if you need to choose a certain template specialization or overload)
+    ///
+    /// \return The Table itself so the call can be chained
+    ///
+    /// \remarks
+    /// The arguments are copied into owned values on the VM's thread, so strings and class instances passed by reference
+    /// do not need to outlive the call. A calling coroutine is suspended until the function returns (see AsyncFunc), a
+    /// call made directly from the host runs the function in place.
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    template<class F>
+    TableBase& OffloadFunc(const SQChar* name, F method) {
+        AsyncQueue::Get(vm);
+        BindFunc(name, &method, sizeof(method), SqOffloadFunc(method));
+        return *this;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Sets a key in the Table to a pure function that parallel_map and parallel_reduce can run on the shared ThreadPool
+    ///
+    /// \param name   The key in the table being assigned a value
+    /// \param method Function taking one argument (for parallel_map), or two arguments of its result type (for parallel_reduce)
+    ///
+    /// \tparam F Type of function (only define this if you need to choose a certain template specialization or overload)
+    ///
+    /// \return The Table itself so the call can be chained
+    ///
+    /// \remarks
+    /// The function is also callable like one bound with Func. It must not touch any VM or shared state, since
+    /// parallel_map calls it from several threads at once (see RegisterParallelLib).
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    template<class F>
+    TableBase& PureFunc(const SQChar* name, F method) {
+        BindFunc(name, &method, sizeof(method), SqGlobalFunc(method));
+        PureFunctions::Register(vm, GetObject(), name, SqPureKernel(method));
+        return *this;
+    }
+
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     /// Sets a key in the Table to a specific function and allows the key to be overloaded with functions of a different amount of arguments
     ///
@@ -437,6 +525,131 @@ public:
     }
 };
 
+/// @cond DEV
+
+// Delegate of a lazy table: its _get runs the loaders listed under PendingKey (shared with sqimport's lazy imports)
+class LazyBindings {
+public:
+
+    // Pushes the loaders still pending for the table at idx, if it was made lazy
+    static bool PushPending(HSQUIRRELVM vm, SQInteger idx) {
+        if (SQ_FAILED(sq_getdelegate(vm, idx))) {
+            return false;
+        }
+        if (sq_gettype(vm, -1) != OT_TABLE) {
+            sq_pop(vm, 1);
+            return false;
+        }
+        sq_pushstring(vm, PendingKey(), -1);
+        if (SQ_FAILED(sq_rawget(vm, -2))) {
+            sq_pop(vm, 1);
+            return false;
+        }
+        sq_remove(vm, -2); // pop delegate
+        return true;
+    }
+
+    // Adds the loader on top of the stack to the table at idx (pops the loader)
+    static bool Add(HSQUIRRELVM vm, SQInteger idx) {
+        if (!PushPending(vm, idx)) {
+            sq_getdelegate(vm, idx);
+            bool hasDelegate = sq_gettype(vm, -1) != OT_NULL;
+            sq_pop(vm, 1);
+            if (hasDelegate) {
+                sq_pop(vm, 1);
+                return false;
+            }
+            sq_newtable(vm);
+            sq_pushstring(vm, _SC("_get"), -1);
+            sq_newclosure(vm, &get, 0);
+            sq_newslot(vm, -3, false);
+            sq_pushstring(vm, PendingKey(), -1);
+            sq_newarray(vm, 0);
+            sq_newslot(vm, -3, false);
+            sq_setdelegate(vm, idx);
+            PushPending(vm, idx);
+        }
+        sq_push(vm, -2);
+        sq_arrayappend(vm, -2);
+        sq_pop(vm, 2); // pop pending loaders and loader
+        return true;
+    }
+
+    // Loader calling a C++ function with the table
+    static SQInteger bind(HSQUIRRELVM vm) {
+        std::function<void (Table&)>** bindPtr;
+        sq_getuserdata(vm, -1, (SQUserPointer*)&bindPtr, NULL);
+        HSQOBJECT obj;
+        sq_getstackobj(vm, 1, &obj);
+        Table table(obj, vm);
+        SQTRY()
+        (**bindPtr)(table);
+        SQCATCH_NOEXCEPT(vm) {
+            return sq_throwerror(vm, SQWHAT_NOEXCEPT(vm));
+        }
+        SQCATCH(vm) {
+            return sq_throwerror(vm, SQWHAT(vm));
+        }
+        return 0;
+    }
+
+    static SQInteger release(SQUserPointer p, SQInteger /*size*/) {
+        delete *reinterpret_cast<std::function<void (Table&)>**>(p);
+        return 0;
+    }
+
+    static const SQChar* PendingKey() {
+        return _SC("__sqrat_lazy__");
+    }
+
+private:
+
+    // _get of a lazy table: runs the pending loaders in order until one of them provides the key
+    static SQInteger get(HSQUIRRELVM vm) {
+        if (!PushPending(vm, 1)) {
+            sq_pushnull(vm);
+            return sq_throwobject(vm);
+        }
+        while (sq_getsize(vm, 3) > 0) {
+            sq_pushinteger(vm, 0);
+            sq_rawget(vm, 3);
+            sq_arrayremove(vm, 3, 0);
+            if (sq_getsize(vm, 3) == 0) {
+                sq_pushnull(vm);
+                sq_setdelegate(vm, 1); // the table is complete from now on
+            }
+            sq_push(vm, 1);
+            SQRESULT res = sq_call(vm, 1, false, true);
+            sq_pop(vm, 1); // pop loader
+            if (SQ_FAILED(res)) {
+                return SQ_ERROR;
+            }
+            sq_push(vm, 2);
+            if (SQ_SUCCEEDED(sq_rawget(vm, 1))) {
+                return 1;
+            }
+        }
+        sq_pushnull(vm); // "clean" failure: the index does not exist
+        return sq_throwobject(vm);
+    }
+};
+
+/// @endcond
+
+inline TableBase& TableBase::LazyBind(const std::function<void (Table&)>& bind) {
+    sq_pushobject(vm, GetObject());
+    std::function<void (Table&)>** bindPtr = reinterpret_cast<std::function<void (Table&)>**>(sq_newuserdata(vm, sizeof(std::function<void (Table&)>*)));
+    *bindPtr = new std::function<void (Table&)>(bind);
+    sq_setreleasehook(vm, -1, &LazyBindings::release);
+    sq_newclosure(vm, &LazyBindings::bind, 1);
+    bool added = LazyBindings::Add(vm, sq_gettop(vm) - 1);
+    sq_pop(vm, 1); // pop table
+    if (!added) {
+        SQTHROW(vm, _SC("the table already has a delegate"));
+    }
+    return *this;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /// Table that is a reference to the Squirrel root table for a given VM
 /// The Squirrel root table is usually where all globals are stored by the Squirrel language.
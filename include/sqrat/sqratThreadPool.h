@@ -0,0 +1,155 @@
+//
+// SqratThreadPool: Worker threads for offloaded native calls
+//
+
+//
+// Copyright (c) 2009 Brandon Jones
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software. If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+#if !defined(_SCRAT_THREAD_POOL_H_)
+#define _SCRAT_THREAD_POOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Sqrat {
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Fixed set of OS threads running plain C++ jobs (no VM is touched on these threads)
+///
+/// \remarks
+/// Used by OffloadFunc bindings through Shared(). Jobs run in submission order on whichever thread is free.
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class ThreadPool {
+public:
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Starts the threads
+    ///
+    /// \param threadCount Number of threads (0 means one per hardware thread)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    explicit ThreadPool(unsigned threadCount = 0) : m_stop(false) {
+        if (threadCount == 0) {
+            threadCount = std::thread::hardware_concurrency();
+            if (threadCount == 0) {
+                threadCount = 1;
+            }
+        }
+        for (unsigned i = 0; i < threadCount; ++i) {
+            m_threads.push_back(std::thread(&ThreadPool::run, this));
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Runs the jobs still queued and joins the threads
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        for (size_t i = 0; i < m_threads.size(); ++i) {
+            m_threads[i].join();
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Queues a job (may be called from any OS thread)
+    ///
+    /// \param job Function to run on one of the pool's threads
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Submit(const std::function<void ()>& job) {
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_jobs.push_back(job);
+        }
+        m_wake.notify_one();
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the number of threads in the pool
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    unsigned GetThreadCount() const {
+        return static_cast<unsigned>(m_threads.size());
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the number of jobs waiting for a thread
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    size_t GetQueueDepth() const {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_jobs.size();
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the pool shared by all VMs, started on first use and stopped at exit
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static ThreadPool& Shared() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+private:
+
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    void run() {
+        for (;;) {
+            std::function<void ()> job;
+            {
+                std::unique_lock<std::mutex> lock(m_lock);
+                while (m_jobs.empty() && !m_stop) {
+                    m_wake.wait(lock);
+                }
+                if (m_jobs.empty()) {
+                    return;
+                }
+                job.swap(m_jobs.front());
+                m_jobs.pop_front();
+            }
+            job();
+        }
+    }
+
+    std::vector<std::thread>            m_threads;
+    std::deque<std::function<void ()> > m_jobs;
+    mutable std::mutex                  m_lock;
+    std::condition_variable             m_wake;
+    bool                                m_stop;
+};
+
+}
+
+#endif
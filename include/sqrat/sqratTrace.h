@@ -0,0 +1,610 @@
+//
+// SqratTrace: Timeline of script and binding activity in the Chrome trace-event format
+//
+
+//
+// Copyright (c) 2009 Brandon Jones
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software. If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+#if !defined(_SCRAT_TRACE_H_)
+#define _SCRAT_TRACE_H_
+
+#include <squirrel.h>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "sqratInstrumentation.h"
+#include "sqratUtil.h"
+
+namespace Sqrat {
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Records what the VMs of the process do over time and writes it out as Chrome trace-event JSON
+///
+/// \remarks
+/// Tracing is process-wide and only covers the VMs passed to Attach, optionally narrowed to a set of function names.
+/// It records script functions entering and returning (through the VM's native debug hook), Sqrat bindings (when
+/// SCRAT_ENABLE_INSTRUMENTATION is defined), sqratthread tasks running and suspending, imports, compilations made by
+/// Script, and collections made through CollectGarbage.
+///
+/// \remarks
+/// Each OS thread writes to a ring buffer of its own without locking; Flush drains them all and may be called from any
+/// thread, while the VMs keep running. A full ring drops new events until it is flushed (the count of dropped events is
+/// part of the output). The ring of an OS thread that has ended is freed once its events have been flushed. The JSON opens in chrome://tracing and in the Perfetto UI: every OS thread is shown as a
+/// process and every Squirrel thread running on it (a VM or a coroutine) as a thread of that process, so coroutines
+/// that suspend halfway through a function keep their own, well nested track.
+///
+/// \remarks
+/// The hook used for script functions is the one Profiler uses too, so a VM can be traced or profiled but not both:
+/// Attach fails while Profiler is running on the VM, and Profiler::Start fails while the VM is attached.
+/// Binary modules that are built separately from the host record into rings of their own unless they share its symbols.
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class Trace {
+public:
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Kinds of events, to be combined as flags
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    enum Category {
+        TRACE_SCRIPT  = 1,  ///< Script functions
+        TRACE_NATIVE  = 2,  ///< Sqrat bindings (needs SCRAT_ENABLE_INSTRUMENTATION)
+        TRACE_THREAD  = 4,  ///< sqratthread tasks running, suspending and finishing
+        TRACE_IMPORT  = 8,  ///< Imported modules
+        TRACE_COMPILE = 16, ///< Scripts compiled or loaded by Script
+        TRACE_GC      = 32, ///< Garbage collections made through CollectGarbage
+        TRACE_ALL     = 63  ///< Everything
+    };
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Starts recording
+    ///
+    /// \param categories Categories to record
+    /// \param capacity   Number of events each OS thread can buffer between two flushes
+    ///
+    /// \remarks
+    /// The capacity applies to the rings of OS threads that have not recorded anything yet.
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static void Start(unsigned int categories = TRACE_ALL, size_t capacity = 65536) {
+#if defined(SCRAT_ENABLE_INSTRUMENTATION)
+        Instrumentation::AddObserver(&observe);
+#endif
+        state().capacity.store(capacity > 0 ? capacity : 1);
+        state().categories.store(categories);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Stops recording, keeping the buffered events until the next Flush
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static void Stop() {
+        state().categories.store(0);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Checks whether a category of events is being recorded
+    ///
+    /// \param category One of the categories
+    ///
+    /// \return True if it is
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static bool IsEnabled(unsigned int category) {
+        return (state().categories.load(std::memory_order_relaxed) & category) != 0;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Includes a VM in the trace and hooks its script functions
+    ///
+    /// \param vm        Target VM (its coroutines created from now on are included too)
+    /// \param functions Names of the script functions and bindings to record, or an empty list for all of them
+    ///
+    /// \return False if the VM's debug hook is taken by Profiler (the VM is then left out of the trace)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static bool Attach(HSQUIRRELVM vm, const std::vector<string>& functions = std::vector<string>()) {
+        if (!NativeDebugHook::Claim(vm, _SC("trace"), &hook)) {
+            return false;
+        }
+        Data* data = get(vm);
+        data->functions = functions;
+        ++generation();
+        return true;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Leaves a VM out of the trace again
+    ///
+    /// \param vm Target VM
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static void Detach(HSQUIRRELVM vm) {
+        sq_pushregistrytable(vm);
+        sq_pushstring(vm, RegistryKey(), -1);
+        sq_rawdeleteslot(vm, -2, SQFalse);
+        sq_pop(vm, 1);
+        ++generation();
+        NativeDebugHook::Release(vm, _SC("trace"));
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Checks whether the events of a VM (or of one of its coroutines) are recorded
+    ///
+    /// \param vm Target VM
+    ///
+    /// \return True if the VM is attached
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static bool IsAttached(HSQUIRRELVM vm) {
+        return lookup(vm) != NULL;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Takes every buffered event out of the rings
+    ///
+    /// \return A complete trace-event JSON document ({"traceEvents": [...]})
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static std::string Flush() {
+        std::string json = "{\"traceEvents\":[";
+        unsigned long long dropped = 0;
+        bool first = true;
+        State& s = state();
+        std::lock_guard<std::mutex> lock(s.lock);
+        for (size_t i = 0; i < s.rings.size(); ++i) {
+            Ring& ring = *s.rings[i];
+            appendSeparator(json, first);
+            json += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":";
+            appendNumber(json, ring.thread);
+            json += ",\"args\":{\"name\":\"thread ";
+            appendNumber(json, ring.thread);
+            json += "\"}}";
+
+            size_t tail = ring.tail.load(std::memory_order_relaxed);
+            size_t head = ring.head.load(std::memory_order_acquire);
+            for (; tail != head; ++tail) {
+                appendSeparator(json, first);
+                appendEvent(json, ring.thread, ring.events[tail % ring.events.size()]);
+            }
+            ring.tail.store(tail, std::memory_order_release);
+            dropped += ring.dropped.exchange(0);
+        }
+        removeFinished(s);
+        dropped += s.dropped;
+        s.dropped = 0;
+        json += "],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped_events\":\"";
+        appendNumber(json, dropped);
+        json += "\"}}";
+        return json;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Takes every buffered event out of the rings and writes them to a file
+    ///
+    /// \param path Path of the JSON file to write
+    ///
+    /// \return True if successful
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static bool Flush(const std::string& path) {
+        std::string json = Flush();
+        FILE* file = fopen(path.c_str(), "wb");
+        if (file == NULL) {
+            return false;
+        }
+        bool written = fwrite(json.data(), 1, json.size(), file) == json.size();
+        return fclose(file) == 0 && written;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Runs the garbage collector of a VM, recording the collection
+    ///
+    /// \param vm Target VM
+    ///
+    /// \return The result of sq_collectgarbage
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    static SQInteger CollectGarbage(HSQUIRRELVM vm) {
+        Scope scope(vm, TRACE_GC, _SC("collectgarbage"));
+        return sq_collectgarbage(vm);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Records the span of the enclosing block, if its category is enabled and the VM is attached
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    class Scope {
+    public:
+
+        /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        /// Records the beginning of the span
+        ///
+        /// \param vm       VM doing the work
+        /// \param category Category of the span
+        /// \param name     Name of the span
+        /// \param source   Optional detail shown with the span (a path, for instance)
+        ///
+        /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        Scope(HSQUIRRELVM vm, unsigned int category, const SQChar* name, const SQChar* source = NULL) : m_vm(NULL), m_category(category), m_name(name) {
+            if (IsEnabled(category) && IsAttached(vm)) {
+                m_vm = vm;
+                Record('B', category, vm, name, source, 0);
+            }
+        }
+
+        /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        /// Records the end of the span
+        ///
+        /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        ~Scope() {
+            if (m_vm != NULL) {
+                Record('E', m_category, m_vm, m_name, NULL, 0);
+            }
+        }
+
+    private:
+
+        Scope(const Scope&);
+        Scope& operator=(const Scope&);
+
+        HSQUIRRELVM    m_vm;
+        unsigned int   m_category;
+        const SQChar*  m_name;
+    };
+
+    /// @cond DEV
+
+    // Adds an event to the ring of the calling OS thread, without checking that the VM is attached
+    // phase is 'B' (begin), 'E' (end) or 'i' (instant); vm is the Squirrel thread the event belongs to
+    static void Record(char phase, unsigned int category, HSQUIRRELVM vm, const SQChar* name, const SQChar* source, SQInteger line) {
+        if (!IsEnabled(category)) {
+            return;
+        }
+        Ring& ring = localRing();
+        size_t head = ring.head.load(std::memory_order_relaxed);
+        if (head - ring.tail.load(std::memory_order_acquire) >= ring.events.size()) {
+            ring.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        Event& event = ring.events[head % ring.events.size()];
+        event.ts = now();
+        event.vm = vm;
+        event.line = line;
+        event.phase = phase;
+        event.category = static_cast<unsigned char>(category);
+        copyText(event.name, name);
+        copyText(event.source, source);
+        ring.head.store(head + 1, std::memory_order_release);
+    }
+
+    // The registry slot that exists while a VM is attached, for modules that reach the Squirrel API through HSQAPI
+    static const SQChar* RegistryKey() {
+        return _SC("__sqrat_trace__");
+    }
+
+    /// @endcond
+
+private:
+
+    static const size_t TEXT_SIZE = 64;
+
+    struct Event {
+        unsigned long long ts;
+        HSQUIRRELVM        vm;
+        SQInteger          line;
+        char               phase;
+        unsigned char      category;
+        SQChar             name[TEXT_SIZE];
+        SQChar             source[TEXT_SIZE];
+    };
+
+    // Written by one OS thread only, read by Flush under the state lock
+    struct Ring {
+        Ring(size_t capacity, unsigned int t) : events(capacity), head(0), tail(0), dropped(0), finished(false), thread(t) {
+        }
+
+        std::vector<Event>                   events;
+        std::atomic<size_t>                  head;    // next event to write
+        std::atomic<size_t>                  tail;    // next event to read
+        std::atomic<unsigned long long>      dropped;
+        std::atomic<bool>                    finished; // the OS thread has ended, so nothing more gets written
+        unsigned int                         thread;
+    };
+
+    // Holds the ring of the calling OS thread and hands it back to Flush when the thread ends
+    struct LocalRing {
+        ~LocalRing() {
+            if (ring) {
+                State& s = state();
+                std::lock_guard<std::mutex> lock(s.lock);
+                ring->finished.store(true, std::memory_order_release);
+                removeFinished(s);
+            }
+        }
+
+        std::shared_ptr<Ring> ring;
+    };
+
+    struct State {
+        State() : categories(0), capacity(65536), nextThread(1), dropped(0), epoch(now()) {
+        }
+
+        std::atomic<unsigned int>            categories;
+        std::atomic<size_t>                  capacity;
+        std::mutex                           lock;
+        std::vector<std::shared_ptr<Ring> >  rings;   // kept after their OS thread ends, until they are flushed
+        unsigned int                         nextThread;
+        unsigned long long                   dropped; // events dropped by rings freed before the next Flush
+        unsigned long long                   epoch;
+    };
+
+    struct Data {
+        std::vector<string> functions;
+    };
+
+    static State& state() {
+        static State s;
+        return s;
+    }
+
+    static Ring& localRing() {
+        static thread_local LocalRing local;
+        if (!local.ring) {
+            State& s = state();
+            std::lock_guard<std::mutex> lock(s.lock);
+            local.ring = std::make_shared<Ring>(s.capacity.load(), s.nextThread++);
+            s.rings.push_back(local.ring);
+        }
+        return *local.ring;
+    }
+
+    // Frees the rings of ended OS threads that have been drained (the lock of s is held); their dropped counts are kept
+    static void removeFinished(State& s) {
+        size_t kept = 0;
+        for (size_t i = 0; i < s.rings.size(); ++i) {
+            Ring& ring = *s.rings[i];
+            if (ring.finished.load(std::memory_order_acquire) &&
+                ring.tail.load(std::memory_order_relaxed) == ring.head.load(std::memory_order_acquire)) {
+                s.dropped += ring.dropped.exchange(0);
+            } else {
+                s.rings[kept++] = s.rings[i];
+            }
+        }
+        s.rings.resize(kept);
+    }
+
+    static void hook(HSQUIRRELVM v, SQInteger type, const SQChar* source, SQInteger line, const SQChar* name) {
+        if ((type != _SC('c') && type != _SC('r')) || !IsEnabled(TRACE_SCRIPT)) {
+            return;
+        }
+        Data* data = lookup(v);
+        if (data != NULL && selected(data, name)) {
+            Record(type == _SC('c') ? 'B' : 'E', TRACE_SCRIPT, v, name, source, line);
+        }
+    }
+
+#if defined(SCRAT_ENABLE_INSTRUMENTATION)
+    static void observe(HSQUIRRELVM vm, const BindingCounters& binding, bool enter) {
+        if (!IsEnabled(TRACE_NATIVE)) {
+            return;
+        }
+        Data* data = lookup(vm);
+        if (data != NULL && selected(data, binding.name.c_str())) {
+            Record(enter ? 'B' : 'E', TRACE_NATIVE, vm, binding.name.c_str(), NULL, 0);
+        }
+    }
+#endif
+
+    static bool selected(const Data* data, const SQChar* name) {
+        if (data->functions.empty()) {
+            return true;
+        }
+        if (name == NULL) {
+            return false;
+        }
+        for (size_t i = 0; i < data->functions.size(); ++i) {
+            if (data->functions[i] == name) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Attached data of the VM (or of the VM owning a coroutine), through a cache of the last VM asked about
+    static Data* lookup(HSQUIRRELVM v) {
+        static thread_local HSQUIRRELVM cachedVm = NULL;
+        static thread_local unsigned int cachedGeneration = 0;
+        static thread_local Data* cachedData = NULL;
+        unsigned int gen = generation().load(std::memory_order_relaxed);
+        if (cachedVm != v || cachedGeneration != gen) {
+            cachedVm = v;
+            cachedGeneration = gen;
+            cachedData = find(v);
+        }
+        return cachedData;
+    }
+
+    // Changes whenever a VM is attached, detached or closed, which voids the caches of lookup
+    static std::atomic<unsigned int>& generation() {
+        static std::atomic<unsigned int> gen(1);
+        return gen;
+    }
+
+    static Data* find(HSQUIRRELVM vm) {
+        Data* data = NULL;
+        sq_pushregistrytable(vm);
+        sq_pushstring(vm, RegistryKey(), -1);
+        if (SQ_SUCCEEDED(sq_rawget(vm, -2))) {
+            SQUserPointer ud;
+            if (SQ_SUCCEEDED(sq_getuserdata(vm, -1, &ud, NULL))) {
+                data = *reinterpret_cast<Data**>(ud);
+            }
+            sq_pop(vm, 1);
+        }
+        sq_pop(vm, 1);
+        return data;
+    }
+
+    static Data* get(HSQUIRRELVM vm) {
+        Data* data = find(vm);
+        if (data == NULL) {
+            sq_pushregistrytable(vm);
+            sq_pushstring(vm, RegistryKey(), -1);
+            Data** ud = reinterpret_cast<Data**>(sq_newuserdata(vm, sizeof(Data*)));
+            *ud = data = new Data();
+            sq_setreleasehook(vm, -1, &release);
+            sq_rawset(vm, -3);
+            sq_pop(vm, 1);
+            ++generation();
+        }
+        return data;
+    }
+
+    static SQInteger release(SQUserPointer ptr, SQInteger /*size*/) {
+        delete *reinterpret_cast<Data**>(ptr);
+        ++generation();
+        return 0;
+    }
+
+    static unsigned long long now() {
+        return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // Copies at most TEXT_SIZE - 1 characters, never cutting a UTF-8 sequence (or a UTF-16 surrogate pair) in two
+    static void copyText(SQChar* dest, const SQChar* src) {
+        size_t i = 0;
+        if (src != NULL) {
+            for (; i < TEXT_SIZE - 1 && src[i] != 0; ++i) {
+                dest[i] = src[i];
+            }
+            if (src[i] != 0) {
+                i = codePointBoundary(dest, i);
+            }
+        }
+        dest[i] = 0;
+    }
+
+    // Length of the longest prefix of the first size characters of text that ends on a whole code point
+    static size_t codePointBoundary(const SQChar* text, size_t size) {
+        if (sizeof(SQChar) == 1) {
+            size_t start = size;
+            while (start > 0 && (static_cast<unsigned char>(text[start - 1]) & 0xC0) == 0x80) {
+                --start; // continuation bytes
+            }
+            if (start == 0) {
+                return size;
+            }
+            unsigned char lead = static_cast<unsigned char>(text[start - 1]);
+            size_t length = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+            return size - (start - 1) < length ? start - 1 : size;
+        }
+        if (size == 0) {
+            return size;
+        }
+        unsigned long last = static_cast<unsigned long>(text[size - 1]);
+        return last >= 0xD800 && last <= 0xDBFF ? size - 1 : size; // high surrogate
+    }
+
+    static const char* categoryName(unsigned int category) {
+        switch (category) {
+        case TRACE_SCRIPT:  return "script";
+        case TRACE_NATIVE:  return "native";
+        case TRACE_THREAD:  return "thread";
+        case TRACE_IMPORT:  return "import";
+        case TRACE_COMPILE: return "compile";
+        default:            return "gc";
+        }
+    }
+
+    static void appendSeparator(std::string& json, bool& first) {
+        if (!first) {
+            json += ",\n";
+        }
+        first = false;
+    }
+
+    static void appendNumber(std::string& json, unsigned long long value) {
+        char buf[24];
+        snprintf(buf, sizeof(buf), "%llu", value);
+        json += buf;
+    }
+
+    // Squirrel characters above ASCII are written as they are in narrow builds (UTF-8) and escaped in SQUNICODE builds
+    static void appendString(std::string& json, const SQChar* str) {
+        json += '"';
+        for (; *str != 0; ++str) {
+            unsigned long c = static_cast<unsigned long>(*str);
+            if (c == '"' || c == '\\') {
+                json += '\\';
+                json += static_cast<char>(c);
+            } else if (c < 0x20 || (sizeof(SQChar) > 1 && c > 0x7E)) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04lx", c & 0xFFFF);
+                json += buf;
+            } else {
+                json += static_cast<char>(c);
+            }
+        }
+        json += '"';
+    }
+
+    static void appendEvent(std::string& json, unsigned int pid, const Event& event) {
+        unsigned long long ts = event.ts - state().epoch;
+        char buf[64];
+        json += "{\"name\":";
+        appendString(json, event.name[0] != 0 ? event.name : _SC("unknown"));
+        json += ",\"cat\":\"";
+        json += categoryName(event.category);
+        json += "\",\"ph\":\"";
+        json += event.phase;
+        snprintf(buf, sizeof(buf), "\",\"ts\":%llu.%03llu,\"pid\":", ts / 1000, ts % 1000);
+        json += buf;
+        appendNumber(json, pid);
+        json += ",\"tid\":";
+        appendNumber(json, static_cast<unsigned long long>(reinterpret_cast<size_t>(event.vm) & 0x7FFFFFFF));
+        if (event.phase == 'i') {
+            json += ",\"s\":\"t\"";
+        }
+        if (event.source[0] != 0) {
+            json += ",\"args\":{\"source\":";
+            appendString(json, event.source);
+            if (event.line > 0) {
+                json += ",\"line\":";
+                appendNumber(json, static_cast<unsigned long long>(event.line));
+            }
+            json += "}";
+        }
+        json += "}";
+    }
+};
+
+}
+
+#endif
@@ -143,6 +143,19 @@ namespace Sqrat {
     #define SQWHAT_NOEXCEPT(vm)  Error::Message(vm).c_str()
 #endif
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Define macros that catch anything bound C++ code throws on a worker thread, in every error handling mode
+/// (they compile to a plain block when the compiler has exceptions turned off, for example with -fno-exceptions)
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#if defined (__cpp_exceptions) || defined (__EXCEPTIONS) || defined (_CPPUNWIND)
+    #define SCRAT_HAS_CXX_EXCEPTIONS
+    #define SQCATCH_ANY()        } catch (...)
+    #define SQTRY_ANY()          try {
+#else
+    #define SQCATCH_ANY()        } if (SQRAT_CONST_CONDITION(false))
+    #define SQTRY_ANY()          {
+#endif
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /// Removes unused variable warnings in a way that Doxygen can understand
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1151,6 +1164,21 @@ public:
         return other;
     }
 
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Accesses the managed object without sharing ownership of it
+    ///
+    /// \return Pointer to the managed object or NULL if it no longer exists
+    ///
+    /// \remarks
+    /// Unlike Lock this leaves the reference counts alone. It is not thread-safe: calls from several threads are only
+    /// sound while no thread releases the object or copies, resets or locks a pointer sharing its counts.
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    T* Get() const
+    {
+        return Expired() ? NULL : m_Ptr;
+    }
+
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     /// Clears the associated object for this WeakPtr
     ///
@@ -32,6 +32,7 @@
 #include <sqrat.h>
 
 #include <iostream>
+#include <mutex>
 #include <stdarg.h>
 #include <stdio.h>
 
@@ -54,39 +55,61 @@ namespace Sqrat
 /// Helper class that wraps a Squirrel virtual machine in a C++ API
 ///
 /// \remarks
-/// This class is not currently thread-safe for the case of different VMs running in different threads (all others are)
+/// Different SqratVMs may be created, used and destroyed on different threads, but a single SqratVM must only be used by
+/// one thread at a time. Binding the same C++ class into VMs on several threads at once is not safe (see Sqrat::VMPool).
 ///
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 class SqratVM
 {
 private:
 
+    Sqrat::MemoryAccount* m_memory; // before m_vm, which is allocated on it
     HSQUIRRELVM m_vm;
     Sqrat::RootTable* m_rootTable;
     Sqrat::Script* m_script;
+    Sqrat::ClosureCache* m_closureCache;
     Sqrat::string m_lastErrorMsg;
 
     static void s_addVM(HSQUIRRELVM vm, SqratVM* sqratvm)
     {
-        // TODO for user: use mutex to lock ms_sqratVMs if necessary for your uses
+        std::lock_guard<std::mutex> lock(ms_sqratVMsLock());
         ms_sqratVMs().insert(std::make_pair(vm, sqratvm));
     }
 
     static void s_deleteVM(HSQUIRRELVM vm)
     {
-        // TODO for user: use mutex to lock ms_sqratVMs if necessary for your uses
+        std::lock_guard<std::mutex> lock(ms_sqratVMsLock());
         ms_sqratVMs().erase(vm);
     }
 
     static SqratVM* s_getVM(HSQUIRRELVM vm)
     {
-        // TODO for user: use mutex to lock ms_sqratVMs if necessary for your uses
-        return ms_sqratVMs()[vm];
+        std::lock_guard<std::mutex> lock(ms_sqratVMsLock());
+        unordered_map<HSQUIRRELVM, SqratVM*>::type::iterator it = ms_sqratVMs().find(vm);
+        return it != ms_sqratVMs().end() ? it->second : NULL;
     }
 
 private:
 
     static SQRAT_API unordered_map<HSQUIRRELVM, SqratVM*>::type& ms_sqratVMs();
+    static SQRAT_API std::mutex& ms_sqratVMsLock();
+
+    static HSQUIRRELVM s_openVM(int initialStackSize, Sqrat::MemoryAccount* account)
+    {
+        Sqrat::MemoryAccount::Scope scope(account);
+        return sq_open(initialStackSize);
+    }
+
+    // Refuses to run anything while the VM is over its hard memory limit
+    bool overBudget()
+    {
+        if(m_memory != NULL && m_memory->IsOverHardLimit())
+        {
+            m_lastErrorMsg = _SC("memory budget exceeded");
+            return true;
+        }
+        return false;
+    }
 
     static void printFunc(HSQUIRRELVM /*v*/, const SQChar *s, ...)
     {
@@ -99,9 +122,10 @@ private:
     static SQInteger runtimeErrorHandler(HSQUIRRELVM v)
     {
         const SQChar *sErr = 0;
-        if(sq_gettop(v) >= 1)
+        SqratVM* sqratvm = s_getVM(v);
+        if(sqratvm != NULL && sq_gettop(v) >= 1)
         {
-            Sqrat::string& errStr = s_getVM(v)->m_lastErrorMsg;
+            Sqrat::string& errStr = sqratvm->m_lastErrorMsg;
             if(SQ_SUCCEEDED(sq_getstring(v, 2, &sErr)))
             {
                 errStr = sErr;
@@ -127,7 +151,11 @@ private:
 		scsprintf(buf, _SC("%s:%d:%d: %s"), source, (int) line, (int) column, desc);
 	#endif
         buf[sizeof(buf)/sizeof(SQChar) - 1] = 0;
-        s_getVM(v)->m_lastErrorMsg = buf;
+        SqratVM* sqratvm = s_getVM(v);
+        if(sqratvm != NULL)
+        {
+            sqratvm->m_lastErrorMsg = buf;
+        }
     }
 
 public:
@@ -155,14 +183,22 @@ public:
     ///
     /// \param initialStackSize Initial size of the execution stack (if the stack is too small it will automatically grow)
     /// \param libsToLoad       Specifies what standard Squirrel libraries should be loaded
+    /// \param accountMemory    Should the memory of the VM be accounted for (see Sqrat::MemoryAccount)?
     ///
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    SqratVM(int initialStackSize = 1024, unsigned char libsToLoad = LIB_ALL): m_vm(sq_open(initialStackSize))
+    SqratVM(int initialStackSize = 1024, unsigned char libsToLoad = LIB_ALL, bool accountMemory = false)
+        : m_memory(accountMemory ? new Sqrat::MemoryAccount() : NULL)
+        , m_vm(s_openVM(initialStackSize, m_memory))
         , m_rootTable(new Sqrat::RootTable(m_vm))
         , m_script(new Sqrat::Script(m_vm))
+        , m_closureCache(new Sqrat::ClosureCache(m_vm))
         , m_lastErrorMsg()
     {
+        Sqrat::MemoryAccount::Scope scope(m_memory);
+        if (m_memory != NULL)
+            m_memory->Attach(m_vm);
         s_addVM(m_vm, this);
+        m_script->SetClosureCache(m_closureCache);
         //register std libs
         sq_pushroottable(m_vm);
         if (libsToLoad & LIB_IO)
@@ -186,10 +222,14 @@ public:
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     ~SqratVM()
     {
+        Sqrat::MemoryAccount::Scope scope(m_memory);
         s_deleteVM(m_vm);
         delete m_script;
+        delete m_closureCache;
         delete m_rootTable;
         sq_close(m_vm);
+        if (m_memory != NULL)
+            m_memory->Release();
     }
 
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -225,6 +265,49 @@ public:
         return *m_script;
     }
 
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the cache of closures DoString compiled (64 entries by default, SetCapacity(0) turns it off)
+    ///
+    /// \return ClosureCache for the VM
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    Sqrat::ClosureCache& GetClosureCache()
+    {
+        return *m_closureCache;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the memory account of the VM
+    ///
+    /// \return The MemoryAccount, or NULL if the VM was not created with accountMemory
+    ///
+    /// \remarks
+    /// Hosts that call into the VM directly rather than through DoString, DoFile or DoCompiled should open a
+    /// Sqrat::MemoryAccount::Scope on it first, so that what the VM allocates meanwhile is charged to it.
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    Sqrat::MemoryAccount* GetMemoryAccount()
+    {
+        return m_memory;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Sets the memory budget of the VM (see Sqrat::MemoryAccount::SetBudget)
+    ///
+    /// \param softLimit Bytes above which the script gets one error it can catch (0 for no limit)
+    /// \param hardLimit Bytes above which the script keeps failing and the VM refuses to run anything (0 for no limit)
+    ///
+    /// \remarks
+    /// Does nothing if the VM was not created with accountMemory. A running script is only stopped when it next calls
+    /// into a binding: one that runs nothing but Squirrel code and built-in functions is not.
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void SetMemoryBudget(size_t softLimit, size_t hardLimit)
+    {
+        if (m_memory != NULL)
+            m_memory->SetBudget(softLimit, hardLimit);
+    }
+
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     /// Gets the error message for the most recent Squirrel error with the VM
     ///
@@ -286,8 +369,13 @@ public:
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     ERROR_STATE DoString(const Sqrat::string& str)
     {
+        Sqrat::MemoryAccount::Scope scope(m_memory);
         Sqrat::string msg;
         m_lastErrorMsg.clear();
+        if(overBudget())
+        {
+            return SQRAT_RUNTIME_ERROR;
+        }
         if(!m_script->CompileString(str, msg))
         {
             if(m_lastErrorMsg.empty())
@@ -307,6 +395,17 @@ public:
         return SQRAT_NO_ERROR;
     }
 
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Makes DoFile reuse compiled files from an on-disk compile cache
+    ///
+    /// \param cache Cache to use (NULL to always compile the file); it must outlive the VM
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void SetCompileCache(Sqrat::CompileCacheBase* cache)
+    {
+        m_script->SetCompileCache(cache);
+    }
+
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     /// Runs a file containing a Squirrel script
     ///
@@ -317,8 +416,13 @@ public:
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     ERROR_STATE DoFile(const Sqrat::string& file)
     {
+        Sqrat::MemoryAccount::Scope scope(m_memory);
         Sqrat::string msg;
         m_lastErrorMsg.clear();
+        if(overBudget())
+        {
+            return SQRAT_RUNTIME_ERROR;
+        }
         if(!m_script->CompileFile(file, msg))
         {
             if(m_lastErrorMsg.empty())
@@ -338,6 +442,42 @@ public:
         return SQRAT_NO_ERROR;
     }
 
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Runs a script compiled ahead of time (possibly in another VM)
+    ///
+    /// \param image Compiled script
+    ///
+    /// \return An ERROR_STATE representing what happened
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ERROR_STATE DoCompiled(const Sqrat::CompiledScript& image)
+    {
+        Sqrat::MemoryAccount::Scope scope(m_memory);
+        Sqrat::string msg;
+        m_lastErrorMsg.clear();
+        if(overBudget())
+        {
+            return SQRAT_RUNTIME_ERROR;
+        }
+        if(!m_script->LoadBytecode(image.Data(), image.Size()))
+        {
+            if(m_lastErrorMsg.empty())
+            {
+                m_lastErrorMsg = _SC("invalid bytecode image");
+            }
+            return SQRAT_COMPILE_ERROR;
+        }
+        if(!m_script->Run(msg))
+        {
+            if(m_lastErrorMsg.empty())
+            {
+                m_lastErrorMsg = msg;
+            }
+            return SQRAT_RUNTIME_ERROR;
+        }
+        return SQRAT_NO_ERROR;
+    }
+
 };
 
 #if !defined(SCRAT_IMPORT)
@@ -345,6 +485,11 @@ inline unordered_map<HSQUIRRELVM, SqratVM*>::type& SqratVM::ms_sqratVMs() {
     static unordered_map<HSQUIRRELVM, SqratVM*>::type ms;
     return ms;
 }
+
+inline std::mutex& SqratVM::ms_sqratVMsLock() {
+    static std::mutex lock;
+    return lock;
+}
 #endif
 
 }
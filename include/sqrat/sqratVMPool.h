@@ -0,0 +1,489 @@
+//
+// SqratVMPool: pool of worker threads that each own a Squirrel VM
+//
+
+//
+// Copyright (c) 2009 Brandon Jones
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software. If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+#if !defined(_SCRAT_VMPOOL_H_)
+#define _SCRAT_VMPOOL_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "sqratVM.h"
+#include "sqratMarshal.h"
+
+namespace Sqrat {
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Statistics for one worker of a VMPool
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct VMPoolWorkerStats {
+    unsigned long long jobs;            ///< Number of jobs the worker has run
+    unsigned long long errors;          ///< Number of those jobs that failed
+    unsigned long long stolen;          ///< Number of those jobs that were taken from another worker's queue
+    unsigned long long busyNanoseconds; ///< Time spent running jobs
+    double             utilisation;     ///< Fraction of the pool's lifetime spent running jobs (0 to 1)
+
+    /// latency[i] counts jobs whose time from Submit to completion was within [2^i, 2^(i+1)) microseconds
+    /// (bucket 0 also counts anything quicker, the last bucket also counts anything slower)
+    std::vector<unsigned long long> latency;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Statistics for a whole VMPool
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct VMPoolStats {
+    size_t                         queueDepth; ///< Number of jobs submitted but not yet picked up by a worker
+    unsigned long long             submitted;  ///< Number of jobs submitted
+    unsigned long long             completed;  ///< Number of jobs that finished successfully
+    unsigned long long             failed;     ///< Number of jobs that finished with an error
+    std::vector<VMPoolWorkerStats> workers;    ///< Statistics of each worker
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Runs Squirrel functions on a fixed set of worker threads that each own a SqratVM
+///
+/// \remarks
+/// Every worker creates its SqratVM on its own thread, runs the binding initializer on it and then runs each script in
+/// the script set. Initialization is done one worker at a time because binding a Sqrat::Class touches data shared by all
+/// VMs. DefaultVM is process wide and is left alone, so the initializer must bind through the VM it is given (for example
+/// vm.GetRootTable() and Class<T>(vm.GetVM(), name)). Scripts are compiled only once, by the constructor, and every worker
+/// reads them from the same bytecode image (see CompiledScript).
+///
+/// \remarks
+/// A job is the name of a function in the root table plus its arguments. Arguments and results are MarshalledValues, so
+/// only plain data crosses between threads. Each worker has its own job queue, and idle workers steal from busy ones.
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class VMPool {
+public:
+
+    /// Called on each worker thread with the worker's VM to bind C++ functions and classes
+    typedef std::function<void (SqratVM&)> Initializer;
+
+    static const size_t LATENCY_BUCKETS = 32; ///< Number of buckets in VMPoolWorkerStats::latency
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Starts the workers and waits until all of them have initialized their VMs
+    ///
+    /// \param workerCount Number of worker threads (0 means one per hardware thread)
+    /// \param init        Binding initializer run on every VM (may be empty)
+    /// \param scripts     Paths of scripts that are run on every VM after the initializer
+    /// \param stackSize   Initial stack size of every VM
+    /// \param libsToLoad  Standard Squirrel libraries loaded into every VM (see SqratVM)
+    ///
+    /// \remarks
+    /// Workers that fail to initialize exit and take no jobs (see GetReadyWorkerCount and GetInitErrorMsg).
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    VMPool(unsigned int workerCount,
+           const Initializer& init,
+           const std::vector<string>& scripts = std::vector<string>(),
+           int stackSize = 1024,
+           unsigned char libsToLoad = SqratVM::LIB_ALL)
+        : m_init(init)
+        , m_scripts(scripts)
+        , m_stackSize(stackSize)
+        , m_libsToLoad(libsToLoad)
+        , m_started(0)
+        , m_stop(false)
+        , m_pending(0)
+        , m_next(0)
+        , m_submitted(0)
+        , m_completed(0)
+        , m_failed(0)
+        , m_startTime(std::chrono::steady_clock::now())
+    {
+        if (workerCount == 0) {
+            workerCount = std::thread::hardware_concurrency();
+            if (workerCount == 0) {
+                workerCount = 1;
+            }
+        }
+        compileScripts();
+        m_workers.reserve(workerCount);
+        for (unsigned int i = 0; i < workerCount; ++i) {
+            m_workers.push_back(new Worker());
+        }
+        for (unsigned int i = 0; i < workerCount; ++i) {
+            m_workers[i]->thread = std::thread(&VMPool::run, this, i);
+        }
+
+        std::unique_lock<std::mutex> lock(m_wakeLock);
+        while (m_started < m_workers.size()) {
+            m_startedCond.wait(lock);
+        }
+        for (size_t i = 0; i < m_workers.size(); ++i) {
+            if (m_workers[i]->ready) {
+                m_ready.push_back(i);
+            }
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Destructor (runs any jobs still queued, then stops the workers)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ~VMPool() {
+        Shutdown();
+        for (size_t i = 0; i < m_workers.size(); ++i) {
+            // jobs that raced with Shutdown are failed rather than leaked
+            for (size_t j = 0; j < m_workers[i]->jobs.size(); ++j) {
+                m_workers[i]->jobs[j]->result.set_exception(std::make_exception_ptr(Exception(_SC("the pool has been shut down"))));
+                delete m_workers[i]->jobs[j];
+            }
+            delete m_workers[i];
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Queues a call to a function in the root table of one of the VMs
+    ///
+    /// \param function Name of the function in the root table
+    /// \param args     Arguments passed to the function (the root table is passed as this)
+    ///
+    /// \return Future that receives the function's return value, or a Sqrat::Exception if the call failed
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    std::future<MarshalledValue> Submit(const string& function, std::vector<MarshalledValue> args = std::vector<MarshalledValue>()) {
+        Job* job = new Job();
+        job->function = function;
+        job->args.swap(args);
+        job->submitted = std::chrono::steady_clock::now();
+        std::future<MarshalledValue> result = job->result.get_future();
+
+        bool stopped = true;
+        if (!m_ready.empty()) {
+            // checked under the lock Shutdown sets it with, and counted before it is queued: a worker taking it right away
+            // cannot bring m_pending below zero, and no worker exits while it is pending
+            std::lock_guard<std::mutex> lock(m_wakeLock);
+            stopped = m_stop;
+            if (!stopped) {
+                ++m_pending;
+            }
+        }
+        if (stopped) {
+            job->result.set_exception(std::make_exception_ptr(Exception(m_ready.empty() ? _SC("no VM in the pool initialized successfully") : _SC("the pool has been shut down"))));
+            delete job;
+            return result;
+        }
+
+        ++m_submitted;
+        Worker& worker = *m_workers[m_ready[m_next++ % m_ready.size()]];
+        {
+            std::lock_guard<std::mutex> lock(worker.lock);
+            worker.jobs.push_back(job);
+        }
+        m_wake.notify_one();
+        return result;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Runs every queued job and then stops the workers (called by the destructor, later Submits fail)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(m_wakeLock);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        for (size_t i = 0; i < m_workers.size(); ++i) {
+            if (m_workers[i]->thread.joinable()) {
+                m_workers[i]->thread.join();
+            }
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the number of worker threads
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    size_t GetWorkerCount() const {
+        return m_workers.size();
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the number of workers that initialized successfully and take jobs
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    size_t GetReadyWorkerCount() const {
+        return m_ready.size();
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Gets the error message of the last worker that failed to initialize (empty if all succeeded)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    string GetInitErrorMsg() const {
+        std::lock_guard<std::mutex> lock(m_setupLock);
+        return m_initErrorMsg;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Takes a snapshot of the pool statistics
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    VMPoolStats GetStats() const {
+        VMPoolStats stats;
+        stats.queueDepth = m_pending;
+        stats.submitted  = m_submitted;
+        stats.completed  = m_completed;
+        stats.failed     = m_failed;
+        double lifetime = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_startTime).count());
+        stats.workers.resize(m_workers.size());
+        for (size_t i = 0; i < m_workers.size(); ++i) {
+            const Worker& worker = *m_workers[i];
+            VMPoolWorkerStats& ws = stats.workers[i];
+            ws.jobs            = worker.jobs_run;
+            ws.errors          = worker.errors;
+            ws.stolen          = worker.stolen;
+            ws.busyNanoseconds = worker.busy;
+            ws.utilisation     = lifetime > 0 ? static_cast<double>(ws.busyNanoseconds) / lifetime : 0;
+            ws.latency.resize(LATENCY_BUCKETS);
+            for (size_t b = 0; b < LATENCY_BUCKETS; ++b) {
+                ws.latency[b] = worker.latency[b];
+            }
+        }
+        return stats;
+    }
+
+private:
+
+    struct Job {
+        string                        function;
+        std::vector<MarshalledValue>  args;
+        std::promise<MarshalledValue> result;
+        std::chrono::steady_clock::time_point submitted;
+    };
+
+    struct Worker {
+        Worker() : ready(false), jobs_run(0), errors(0), stolen(0), busy(0) {
+            for (size_t b = 0; b < LATENCY_BUCKETS; ++b) {
+                latency[b] = 0;
+            }
+        }
+
+        std::mutex        lock;     // guards jobs
+        std::deque<Job*>  jobs;     // owner pops from the front, thieves from the back
+        std::thread       thread;
+        bool              ready;    // written before m_started is bumped, read after the constructor has seen it
+        std::atomic<unsigned long long> jobs_run;
+        std::atomic<unsigned long long> errors;
+        std::atomic<unsigned long long> stolen;
+        std::atomic<unsigned long long> busy;
+        std::atomic<unsigned long long> latency[LATENCY_BUCKETS];
+    };
+
+    VMPool(const VMPool&);
+    VMPool& operator=(const VMPool&);
+
+    // Compiles every script once for all workers; a script that fails to compile is left to DoFile so that each
+    // worker reports the error as before
+    void compileScripts() {
+        HSQUIRRELVM scratch = sq_open(1024);
+        for (size_t i = 0; i < m_scripts.size(); ++i) {
+            CompiledScript image;
+            SQTRY()
+                image = CompiledScript::FromFile(scratch, m_scripts[i]);
+            SQCATCH(scratch) {
+                image = CompiledScript();
+            }
+            SQCLEAR(scratch);
+            m_images.push_back(image);
+        }
+        sq_close(scratch);
+    }
+
+    string initialize(SqratVM& vm) {
+        string errMsg;
+        if (m_init) {
+            m_init(vm);
+        }
+        for (size_t i = 0; i < m_scripts.size() && errMsg.empty(); ++i) {
+            SqratVM::ERROR_STATE state = m_images[i].IsEmpty() ? vm.DoFile(m_scripts[i]) : vm.DoCompiled(m_images[i]);
+            if (state != SqratVM::SQRAT_NO_ERROR) {
+                errMsg = m_scripts[i] + _SC(": ") + vm.GetLastErrorMsg();
+            }
+        }
+        return errMsg;
+    }
+
+    void run(size_t index) {
+        Worker& self = *m_workers[index];
+        SqratVM* vm;
+        {
+            std::lock_guard<std::mutex> setup(m_setupLock);
+            vm = new SqratVM(m_stackSize, m_libsToLoad);
+            string errMsg = initialize(*vm);
+            self.ready = errMsg.empty();
+            if (!self.ready) {
+                m_initErrorMsg = errMsg;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_wakeLock);
+            ++m_started;
+        }
+        m_startedCond.notify_all();
+
+        while (self.ready) {
+            bool stolen = false;
+            Job* job = take(index, stolen);
+            if (job == NULL) {
+                std::unique_lock<std::mutex> lock(m_wakeLock);
+                while (!m_stop && m_pending == 0) {
+                    m_wake.wait(lock);
+                }
+                if (m_stop && m_pending == 0) {
+                    break;
+                }
+                continue;
+            }
+            execute(*vm, self, job, stolen);
+        }
+
+        // releasing class bindings touches data shared by all VMs, so tear down one VM at a time too
+        std::lock_guard<std::mutex> setup(m_setupLock);
+        delete vm;
+    }
+
+    Job* take(size_t index, bool& stolen) {
+        Job* job = NULL;
+        {
+            Worker& self = *m_workers[index];
+            std::lock_guard<std::mutex> lock(self.lock);
+            if (!self.jobs.empty()) {
+                job = self.jobs.front();
+                self.jobs.pop_front();
+            }
+        }
+        for (size_t i = 1; job == NULL && i < m_workers.size(); ++i) {
+            Worker& victim = *m_workers[(index + i) % m_workers.size()];
+            std::lock_guard<std::mutex> lock(victim.lock);
+            if (!victim.jobs.empty()) {
+                job = victim.jobs.back();
+                victim.jobs.pop_back();
+                stolen = true;
+            }
+        }
+        if (job != NULL) {
+            --m_pending;
+        }
+        return job;
+    }
+
+    void execute(SqratVM& vm, Worker& self, Job* job, bool stolen) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        HSQUIRRELVM v = vm.GetVM();
+        SQInteger top = sq_gettop(v);
+        MarshalledValue result;
+        string errMsg;
+        sq_pushroottable(v);
+        sq_pushstring(v, job->function.c_str(), static_cast<SQInteger>(job->function.size()));
+        if (SQ_FAILED(sq_get(v, -2))) {
+            errMsg = _SC("the index '") + job->function + _SC("' does not exist");
+        } else {
+            sq_pushroottable(v);
+            for (size_t i = 0; i < job->args.size(); ++i) {
+                job->args[i].Push(v);
+            }
+            vm.SetLastErrorMsg(string());
+            if (SQ_FAILED(sq_call(v, static_cast<SQInteger>(job->args.size()) + 1, SQTrue, SQTrue))) {
+                errMsg = vm.GetLastErrorMsg();
+                if (errMsg.empty()) {
+                    errMsg = LastErrorString(v);
+                }
+            } else {
+                MarshalledValue::FromStack(v, -1, result, errMsg);
+            }
+        }
+        sq_settop(v, top);
+
+        if (errMsg.empty()) {
+            job->result.set_value(result);
+            ++m_completed;
+        } else {
+            job->result.set_exception(std::make_exception_ptr(Exception(errMsg)));
+            ++self.errors;
+            ++m_failed;
+        }
+
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        unsigned long long micros = static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::microseconds>(end - job->submitted).count());
+        size_t bucket = 0;
+        while (micros > 1 && bucket + 1 < LATENCY_BUCKETS) {
+            micros >>= 1;
+            ++bucket;
+        }
+        ++self.latency[bucket];
+        ++self.jobs_run;
+        if (stolen) {
+            ++self.stolen;
+        }
+        self.busy += static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        delete job;
+    }
+
+    Initializer                 m_init;
+    std::vector<string>         m_scripts;
+    std::vector<CompiledScript> m_images;      // m_scripts compiled once, shared by every worker
+    int                         m_stackSize;
+    unsigned char               m_libsToLoad;
+
+    std::vector<Worker*>        m_workers;
+    std::vector<size_t>         m_ready;       // indices of workers that take jobs (fixed once the constructor returns)
+
+    mutable std::mutex          m_setupLock;   // serializes VM creation, initialization and destruction
+    string                      m_initErrorMsg;
+
+    std::mutex                  m_wakeLock;    // guards m_started, m_stop and increments of m_pending (made before the job is queued)
+    std::condition_variable     m_wake;
+    std::condition_variable     m_startedCond;
+    size_t                      m_started;
+    std::atomic<bool>           m_stop;
+    std::atomic<size_t>         m_pending;
+
+    std::atomic<size_t>         m_next;
+    std::atomic<unsigned long long> m_submitted;
+    std::atomic<unsigned long long> m_completed;
+    std::atomic<unsigned long long> m_failed;
+    std::chrono::steady_clock::time_point m_startTime;
+};
+
+}
+
+#endif
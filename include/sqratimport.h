@@ -29,18 +29,104 @@
 #define _SQ_IMPORT_H_
 
 #include <squirrel.h>
+#include "sqmodule.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    /// To be documented...
+    /// Entry point of a module reaching Squirrel through the HSQAPI table (the signature of sqmodule_load)
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    typedef SQRESULT (*SQRATMODULELOAD)(HSQUIRRELVM v, HSQAPI api);
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Entry point of a module linked into the executable that calls the Squirrel API directly
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    typedef SQRESULT (*SQRATSTATICLOAD)(HSQUIRRELVM v);
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Imports the module named at -2 into the table at -1, replacing both with that table on the stack
+    ///
+    /// Modules linked in with sqrat_register_staticmodule are found first, then modules of bundles (see
+    /// sqrat_import_addbundle). Otherwise the name is looked for as given, then with ".nut", relative to the working
+    /// directory and then to each search path (see sqrat_import_addpath).
+    /// A ".cnut" file at least as new as its source is loaded instead of it. Names that match no script are opened as
+    /// binary modules. The file found is remembered, so later imports do not search again.
+    ///
+    /// The module runs once per VM: its slots are kept in a cache keyed by the file it was loaded from, and later
+    /// imports copy them from there.
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     SQUIRREL_API SQRESULT sqrat_import(HSQUIRRELVM v);
 
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    /// To be documented...
+    /// Same as sqrat_import, but loads and runs the module again and replaces its cached table
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    SQUIRREL_API SQRESULT sqrat_import_reload(HSQUIRRELVM v);
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Same as sqrat_import, but the module is only imported once a missing key of the table is read
+    ///
+    /// The table gets a delegate whose _get imports the pending modules in order until the key exists, and then drops
+    /// the delegate. Tables that already have another delegate cannot be made lazy. Slots the module adds are not seen
+    /// by foreach or the 'in' operator until then.
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    SQUIRREL_API SQRESULT sqrat_import_lazy(HSQUIRRELVM v);
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Drops a module from the import cache of a VM so the next import loads it again (NULL drops every module)
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    SQUIRREL_API SQRESULT sqrat_import_invalidate(HSQUIRRELVM v, const SQChar* moduleName);
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Appends a directory to the import search paths of a VM
+    ///
+    /// The paths start out as the directories listed in the SQRAT_IMPORT_PATH environment variable (separated by ':', or
+    /// ';' on Windows).
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    SQUIRREL_API SQRESULT sqrat_import_addpath(HSQUIRRELVM v, const SQChar* path);
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Removes every import search path of a VM and forgets where modules were found
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    SQUIRREL_API SQRESULT sqrat_import_clearpaths(HSQUIRRELVM v);
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Makes the modules of a bundle file importable in a VM (see Sqrat::Bundle)
+    ///
+    /// Bundles are searched in the order they were added, after static modules and before any file. A name is looked
+    /// up as given and then without a ".nut" or ".cnut" extension. Each bundle file is mapped once per process and
+    /// shared by every VM.
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    SQUIRREL_API SQRESULT sqrat_import_addbundle(HSQUIRRELVM v, const SQChar* path);
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Compiles script files (or loads their bytecode) and writes them as one bundle file
+    ///
+    /// Each module is named after its path without the ".nut" or ".cnut" extension and with '/' as separator, so a bundle
+    /// built from the directory the scripts are imported from resolves the same names. On failure the error is
+    /// available from sq_getlasterror.
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    SQUIRREL_API SQRESULT sqrat_bundle_build(HSQUIRRELVM v, const SQChar* output, const SQChar* const* files, SQInteger count);
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Links a module into the executable under a name, so importing that name runs load without touching the filesystem
+    ///
+    /// load is called with the table being populated on top of the stack, like sqmodule_load. Static modules are found
+    /// before any script or binary module, and registering a name again replaces the previous module.
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    SQUIRREL_API SQRESULT sqrat_register_staticmodule(const SQChar* name, SQRATSTATICLOAD load);
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Same as sqrat_register_staticmodule for a module written against the HSQAPI table (a renamed sqmodule_load)
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    SQUIRREL_API SQRESULT sqrat_register_staticapimodule(const SQChar* name, SQRATMODULELOAD load);
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Adds import(name[, table]), import_lazy(name[, table]), import_reload(name[, table]), import_invalidate([name]),
+    /// import_addpath(path), import_clearpaths() and import_addbundle(path) to the root table
+    ///
+    /// import and import_reload fill the root table by default; import_lazy returns a new lazy table by default.
     /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     SQUIRREL_API SQRESULT sqrat_register_importlib(HSQUIRRELVM v);
 
@@ -48,4 +134,34 @@ extern "C" {
 } /*extern "C"*/
 #endif
 
+#ifdef __cplusplus
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Registers a static module while the program starts (see SQRAT_STATIC_MODULE)
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class SqratStaticModule {
+public:
+    SqratStaticModule(const SQChar* name, SQRATSTATICLOAD load) {
+        sqrat_register_staticmodule(name, load);
+    }
+
+    SqratStaticModule(const SQChar* name, SQRATMODULELOAD load) {
+        sqrat_register_staticapimodule(name, load);
+    }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Links the module entry point load into the executable under name, e.g. SQRAT_STATIC_MODULE(_SC("json"), &json_load)
+///
+/// Put it in a source file that is linked in directly: the linker drops unreferenced objects from static libraries.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#define SQRAT_STATIC_MODULE(name, load) static SqratStaticModule SQRAT_STATIC_MODULE_ID(__LINE__)(name, load)
+
+/// @cond DEV
+#define SQRAT_STATIC_MODULE_ID(line) SQRAT_STATIC_MODULE_ID2(line)
+#define SQRAT_STATIC_MODULE_ID2(line) sqrat_staticmodule_##line
+/// @endcond
+
+#endif
+
 #endif /*_SQ_IMPORT_H_*/
@@ -45,6 +45,18 @@
 #include <sqstdstring.h>
 #include <sqstdaux.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+#include <sys/stat.h>
+
 // IMPORT SPECIFIC
 #include <sqratimport.h>
 
@@ -102,12 +114,566 @@ void PrintUsage()
 		_SC("   -o              specifies output file for the -c option\n")
 		_SC("   -c              compiles only\n")
 		_SC("   -d              generates debug infos\n")
+		_SC("   -b <bundle>     packs the script files that follow into a bundle\n")
+		_SC("   -B <bundle>     makes the modules of a bundle importable\n")
+		_SC("   -C <dir>        compiles every .nut file under dir to .cnut, skipping up to date ones\n")
+		_SC("   -j <threads>    number of threads for -C (default one per processor)\n")
+		_SC("   --bench         runs the script repeatedly and reports timings instead of running it once\n")
+		_SC("   --function <f>  benchmarks the root function f (after running the script once)\n")
+		_SC("   --iterations <n> number of timed runs for --bench (default 100)\n")
+		_SC("   --warmup <n>    number of untimed runs before them (default 10)\n")
+		_SC("   --json          prints the --bench results as JSON\n")
+		_SC("   --import <m>    imports module m into the root table first (e.g. a native binding)\n")
 		_SC("   -v              displays version infos\n")
 		_SC("   -h              prints help\n"));
 }
 
+// Copies a command line argument into a string the Squirrel API accepts (free it with free())
+SQChar *ToSQChar(const char *arg)
+{
+	size_t len = strlen(arg);
+	SQChar *str = (SQChar *)malloc((len + 1) * sizeof(SQChar));
+#ifdef SQUNICODE
+	mbstowcs(str, arg, len + 1);
+#else
+	memcpy(str, arg, len + 1);
+#endif
+	return str;
+}
+
+int BuildBundle(HSQUIRRELVM v, const char *output, int count, char *files[])
+{
+	int i;
+	SQRESULT res;
+	SQChar *bundle = ToSQChar(output);
+	SQChar **paths = (SQChar **)malloc((count > 0 ? count : 1) * sizeof(SQChar *));
+	for(i = 0; i < count; i++)
+		paths[i] = ToSQChar(files[i]);
+	res = sqrat_bundle_build(v, bundle, (const SQChar * const *)paths, count);
+	for(i = 0; i < count; i++)
+		free(paths[i]);
+	free(paths);
+	free(bundle);
+	return SQ_SUCCEEDED(res);
+}
+
+// Bulk precompiler (-C): compiles every .nut file under a directory to .cnut, one VM per worker thread
+
+#define JOB_PENDING 0
+#define JOB_COMPILED 1
+#define JOB_UPTODATE 2
+#define JOB_FAILED 3
+
+typedef struct {
+	char *path;    // source file
+	char *output;  // bytecode file next to it
+	int status;
+	double ms;     // compile time
+	SQChar *error;
+} CompileJob;
+
+typedef struct {
+	CompileJob *jobs;
+	int count;
+	int capacity;
+	int next;      // first job not taken by a worker
+	int debuginfo;
+#ifdef _WIN32
+	CRITICAL_SECTION lock;
+#else
+	pthread_mutex_t lock;
+#endif
+} CompileQueue;
+
+double NowMs()
+{
+#ifdef _WIN32
+	LARGE_INTEGER freq, count;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return (double)count.QuadPart * 1000.0 / (double)freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+#endif
+}
+
+int ProcessorCount()
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (int)info.dwNumberOfProcessors;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (int)count : 1;
+#endif
+}
+
+void AddCompileJob(CompileQueue *q, const char *path)
+{
+	CompileJob *job;
+	size_t len = strlen(path);
+	if(q->count == q->capacity) {
+		q->capacity = q->capacity ? q->capacity * 2 : 64;
+		q->jobs = (CompileJob *)realloc(q->jobs, q->capacity * sizeof(CompileJob));
+	}
+	job = &q->jobs[q->count++];
+	job->path = (char *)malloc(len + 1);
+	memcpy(job->path, path, len + 1);
+	job->output = (char *)malloc(len + 2);
+	memcpy(job->output, path, len - 4);
+	memcpy(job->output + len - 4, ".cnut", 6);
+	job->status = JOB_PENDING;
+	job->ms = 0;
+	job->error = NULL;
+}
+
+// Returns 0 if dir or one of its subdirectories could not be read
+int CollectScripts(CompileQueue *q, const char *dir)
+{
+	char *path;
+	int ok = 1;
+	size_t dirlen = strlen(dir);
+#ifdef _WIN32
+	WIN32_FIND_DATAA data;
+	HANDLE find;
+	path = (char *)malloc(dirlen + 3);
+	sprintf(path, "%s\\*", dir);
+	find = FindFirstFileA(path, &data);
+	free(path);
+	if(find == INVALID_HANDLE_VALUE)
+		return 0;
+	do {
+		const char *name = data.cFileName;
+		size_t len = strlen(name);
+		if(strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+			continue;
+		path = (char *)malloc(dirlen + len + 2);
+		sprintf(path, "%s/%s", dir, name);
+		if(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			ok &= CollectScripts(q, path);
+		else if(len > 4 && strcmp(name + len - 4, ".nut") == 0)
+			AddCompileJob(q, path);
+		free(path);
+	} while(FindNextFileA(find, &data));
+	FindClose(find);
+#else
+	struct dirent *entry;
+	struct stat st;
+	DIR *d = opendir(dir);
+	if(d == NULL)
+		return 0;
+	while((entry = readdir(d)) != NULL) {
+		const char *name = entry->d_name;
+		size_t len = strlen(name);
+		if(strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+			continue;
+		path = (char *)malloc(dirlen + len + 2);
+		sprintf(path, "%s/%s", dir, name);
+		if(stat(path, &st) == 0) {
+			if(S_ISDIR(st.st_mode))
+				ok &= CollectScripts(q, path);
+			else if(S_ISREG(st.st_mode) && len > 4 && strcmp(name + len - 4, ".nut") == 0)
+				AddCompileJob(q, path);
+		}
+		free(path);
+	}
+	closedir(d);
+#endif
+	return ok;
+}
+
+int CompareJobs(const void *a, const void *b)
+{
+	return strcmp(((const CompileJob *)a)->path, ((const CompileJob *)b)->path);
+}
+
+// Moves a finished temporary file over the output in one step
+int MoveIntoPlace(const char *temp, const char *output)
+{
+#ifdef _WIN32
+	return MoveFileExA(temp, output, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return rename(temp, output) == 0;
+#endif
+}
+
+unsigned long ProcessId()
+{
+#ifdef _WIN32
+	return (unsigned long)GetCurrentProcessId();
+#else
+	return (unsigned long)getpid();
+#endif
+}
+
+// Compiles job number index of the queue, through a temporary file no other process or job writes to
+void CompileOne(HSQUIRRELVM v, CompileJob *job, int index)
+{
+	struct stat src, out;
+	SQChar *path, *sqtemp;
+	char *temp;
+	double start;
+	if(stat(job->path, &src) == 0 && stat(job->output, &out) == 0 && out.st_mtime >= src.st_mtime) {
+		job->status = JOB_UPTODATE;
+		return;
+	}
+	start = NowMs();
+	temp = (char *)malloc(strlen(job->output) + 48);
+	sprintf(temp, "%s.%lu.%d.tmp", job->output, ProcessId(), index);
+	path = ToSQChar(job->path);
+	sqtemp = ToSQChar(temp);
+	if(SQ_SUCCEEDED(sqstd_loadfile(v, path, SQTrue)) && SQ_SUCCEEDED(sqstd_writeclosuretofile(v, sqtemp))
+		&& MoveIntoPlace(temp, job->output)) {
+		job->status = JOB_COMPILED;
+	}
+	else {
+		const SQChar *err = _SC("cannot write output");
+		size_t len;
+		sq_getlasterror(v);
+		if(sq_gettype(v, -1) == OT_STRING)
+			sq_getstring(v, -1, &err);
+		len = scstrlen(err);
+		job->error = (SQChar *)malloc((len + 1) * sizeof(SQChar));
+		memcpy(job->error, err, (len + 1) * sizeof(SQChar));
+		job->status = JOB_FAILED;
+		remove(temp);
+	}
+	job->ms = NowMs() - start;
+	sq_settop(v, 0);
+	free(sqtemp);
+	free(path);
+	free(temp);
+}
+
+#ifdef _WIN32
+DWORD WINAPI CompileWorker(LPVOID arg)
+#else
+void *CompileWorker(void *arg)
+#endif
+{
+	CompileQueue *q = (CompileQueue *)arg;
+	HSQUIRRELVM v = sq_open(1024);
+	sq_enabledebuginfo(v, q->debuginfo);
+	for(;;) {
+		int i;
+#ifdef _WIN32
+		EnterCriticalSection(&q->lock);
+		i = q->next++;
+		LeaveCriticalSection(&q->lock);
+#else
+		pthread_mutex_lock(&q->lock);
+		i = q->next++;
+		pthread_mutex_unlock(&q->lock);
+#endif
+		if(i >= q->count)
+			break;
+		CompileOne(v, &q->jobs[i], i);
+	}
+	sq_close(v);
+	return 0;
+}
+
+int CompileTree(const char *dir, int threads, int debuginfo)
+{
+	CompileQueue q;
+	int i, compiled = 0, uptodate = 0, failed = 0;
+	double start = NowMs(), busy = 0;
+#ifdef _WIN32
+	HANDLE *workers;
+#else
+	pthread_t *workers;
+#endif
+	memset(&q, 0, sizeof(q));
+	q.debuginfo = debuginfo;
+	if(!CollectScripts(&q, dir)) {
+		fprintf(stderr, "sq : cannot read all of '%s'\n", dir);
+		failed++;
+	}
+	if(q.count > 1)
+		qsort(q.jobs, q.count, sizeof(CompileJob), CompareJobs);
+	if(threads <= 0)
+		threads = ProcessorCount();
+	if(threads > q.count)
+		threads = q.count > 0 ? q.count : 1;
+
+#ifdef _WIN32
+	InitializeCriticalSection(&q.lock);
+	workers = (HANDLE *)malloc(threads * sizeof(HANDLE));
+	for(i = 0; i < threads; i++)
+		workers[i] = CreateThread(NULL, 0, CompileWorker, &q, 0, NULL);
+	WaitForMultipleObjects(threads, workers, TRUE, INFINITE);
+	for(i = 0; i < threads; i++)
+		CloseHandle(workers[i]);
+	DeleteCriticalSection(&q.lock);
+#else
+	pthread_mutex_init(&q.lock, NULL);
+	workers = (pthread_t *)malloc(threads * sizeof(pthread_t));
+	for(i = 0; i < threads; i++)
+		pthread_create(&workers[i], NULL, CompileWorker, &q);
+	for(i = 0; i < threads; i++)
+		pthread_join(workers[i], NULL);
+	pthread_mutex_destroy(&q.lock);
+#endif
+	free(workers);
+
+	for(i = 0; i < q.count; i++) {
+		CompileJob *job = &q.jobs[i];
+		switch(job->status) {
+		case JOB_COMPILED:
+			compiled++;
+			busy += job->ms;
+			printf("%10.3f ms  %s\n", job->ms, job->path);
+			break;
+		case JOB_UPTODATE:
+			uptodate++;
+			printf("  up to date  %s\n", job->path);
+			break;
+		default:
+			failed++;
+			busy += job->ms;
+			printf("      failed  %s\n", job->path);
+			scfprintf(stdout, _SC("              %s\n"), job->error);
+			break;
+		}
+		free(job->path);
+		free(job->output);
+		free(job->error);
+	}
+	free(q.jobs);
+	printf("%d compiled, %d up to date, %d failed in %.3f ms (%.3f ms compiling on %d threads)\n",
+		compiled, uptodate, failed, NowMs() - start, busy, threads);
+	return failed == 0;
+}
+
+// Benchmark mode (--bench): runs a script, or one of its functions, repeatedly and reports timing statistics
+
+typedef struct {
+	int enabled;
+	int json;
+	int iterations;
+	int warmup;
+	const char *function; // root table function called per iteration (the whole script if NULL)
+} BenchOptions;
+
+double CpuMs()
+{
+#ifdef _WIN32
+	FILETIME created, exited, kernel, user;
+	ULARGE_INTEGER k, u;
+	GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user);
+	k.LowPart = kernel.dwLowDateTime;
+	k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime;
+	u.HighPart = user.dwHighDateTime;
+	return (double)(k.QuadPart + u.QuadPart) / 10000.0;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+#endif
+}
+
+// Peak resident memory of the process in KB
+long PeakMemoryKB()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if(!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return -1;
+	return (long)(counters.PeakWorkingSetSize / 1024);
+#else
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage) != 0)
+		return -1;
+#ifdef __APPLE__
+	return (long)(usage.ru_maxrss / 1024);
+#else
+	return (long)usage.ru_maxrss;
+#endif
+#endif
+}
+
+int CompareDoubles(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+// Nearest-rank percentile of sorted samples
+double Percentile(const double *sorted, int count, double p)
+{
+	int rank = (int)(p / 100.0 * count + 0.999999);
+	if(rank < 1)
+		rank = 1;
+	if(rank > count)
+		rank = count;
+	return sorted[rank - 1];
+}
+
+void PrintJsonString(const char *str)
+{
+	putchar('"');
+	for(; *str; str++) {
+		if(*str == '"' || *str == '\\')
+			putchar('\\');
+		putchar(*str);
+	}
+	putchar('"');
+}
+
+// Pushes what one iteration calls: the named root function, or the loaded script itself
+int PushBenchTarget(HSQUIRRELVM v, const BenchOptions *opts)
+{
+	SQChar *name;
+	int found;
+	if(opts->function == NULL) {
+		sq_push(v, 1);
+		return 1;
+	}
+	name = ToSQChar(opts->function);
+	sq_pushroottable(v);
+	sq_pushstring(v, name, -1);
+	found = SQ_SUCCEEDED(sq_get(v, -2));
+	if(found)
+		sq_remove(v, -2);
+	else
+		sq_pop(v, 1);
+	free(name);
+	return found;
+}
+
+void PrintLastError(HSQUIRRELVM v)
+{
+	const SQChar *err;
+	sq_getlasterror(v);
+	if(SQ_SUCCEEDED(sq_getstring(v, -1, &err)))
+		scprintf(_SC("Error [%s]\n"), err);
+	sq_pop(v, 1);
+}
+
+int RunBench(HSQUIRRELVM v, const SQChar *filename, const char *displayname, const BenchOptions *opts)
+{
+	int i, total = opts->warmup + opts->iterations, collected = 1;
+	long freed = 0, memoryBefore, memoryAfter;
+	double *wall, *cpu, wallSum = 0, cpuSum = 0;
+
+	sq_settop(v, 0);
+	if(SQ_FAILED(sqstd_loadfile(v, filename, SQTrue))) {
+		PrintLastError(v);
+		return 0;
+	}
+	if(opts->function != NULL) {
+		// run the script once so that it defines the function
+		sq_push(v, 1);
+		sq_pushroottable(v);
+		if(SQ_FAILED(sq_call(v, 1, SQFalse, SQTrue))) {
+			PrintLastError(v);
+			return 0;
+		}
+		sq_settop(v, 1);
+	}
+	if(!PushBenchTarget(v, opts)) {
+		fprintf(stderr, "sq : no function named '%s'\n", opts->function);
+		return 0;
+	}
+
+	wall = (double *)malloc((opts->iterations > 0 ? opts->iterations : 1) * sizeof(double));
+	cpu = (double *)malloc((opts->iterations > 0 ? opts->iterations : 1) * sizeof(double));
+	memoryBefore = PeakMemoryKB();
+	for(i = 0; i < total; i++) {
+		double wallStart, cpuStart, wallTime, cpuTime;
+		SQInteger garbage;
+		sq_push(v, 2);
+		sq_pushroottable(v);
+		wallStart = NowMs();
+		cpuStart = CpuMs();
+		if(SQ_FAILED(sq_call(v, 1, SQFalse, SQTrue))) {
+			PrintLastError(v);
+			free(wall);
+			free(cpu);
+			return 0;
+		}
+		wallTime = NowMs() - wallStart;
+		cpuTime = CpuMs() - cpuStart;
+		sq_settop(v, 2);
+		// collect the cycles each iteration leaves behind outside the timed region (what is freed measures the
+		// workload, how many collections ran does not: Squirrel only ever collects when asked to)
+		garbage = sq_collectgarbage(v);
+		if(i < opts->warmup)
+			continue;
+		wall[i - opts->warmup] = wallTime;
+		cpu[i - opts->warmup] = cpuTime;
+		wallSum += wallTime;
+		cpuSum += cpuTime;
+		if(garbage >= 0)
+			freed += (long)garbage;
+		else
+			collected = 0; // built without the cycle collector
+	}
+	memoryAfter = PeakMemoryKB();
+	sq_settop(v, 0);
+
+	if(opts->iterations > 0) {
+		int n = opts->iterations;
+		qsort(wall, n, sizeof(double), CompareDoubles);
+		qsort(cpu, n, sizeof(double), CompareDoubles);
+		if(opts->json) {
+			printf("{\"script\": ");
+			PrintJsonString(displayname);
+			if(opts->function != NULL) {
+				printf(", \"function\": ");
+				PrintJsonString(opts->function);
+			}
+			printf(", \"iterations\": %d, \"warmup\": %d", n, opts->warmup);
+			printf(", \"wall_ms\": {\"mean\": %.6f, \"min\": %.6f, \"p50\": %.6f, \"p99\": %.6f, \"max\": %.6f}",
+				wallSum / n, wall[0], Percentile(wall, n, 50), Percentile(wall, n, 99), wall[n - 1]);
+			printf(", \"cpu_ms\": {\"mean\": %.6f, \"p50\": %.6f, \"p99\": %.6f, \"total\": %.6f}",
+				cpuSum / n, Percentile(cpu, n, 50), Percentile(cpu, n, 99), cpuSum);
+			if(collected)
+				printf(", \"gc\": {\"cycles_freed\": %ld}", freed);
+			else
+				printf(", \"gc\": null");
+			printf(", \"peak_memory_kb\": {\"before\": %ld, \"after\": %ld}}\n", memoryBefore, memoryAfter);
+		}
+		else {
+			printf("%s%s%s: %d iterations (%d warmup)\n", displayname, opts->function ? " " : "",
+				opts->function ? opts->function : "", n, opts->warmup);
+			printf("  wall  mean %.3f ms  min %.3f  p50 %.3f  p99 %.3f  max %.3f\n",
+				wallSum / n, wall[0], Percentile(wall, n, 50), Percentile(wall, n, 99), wall[n - 1]);
+			printf("  cpu   mean %.3f ms  p50 %.3f  p99 %.3f  total %.3f ms\n",
+				cpuSum / n, Percentile(cpu, n, 50), Percentile(cpu, n, 99), cpuSum);
+			if(collected)
+				printf("  gc    %ld cycle objects left behind by the runs\n", freed);
+			else
+				printf("  gc    no cycle collector\n");
+			printf("  peak memory %ld KB (%ld KB before the runs)\n", memoryAfter, memoryBefore);
+		}
+	}
+	free(wall);
+	free(cpu);
+	return 1;
+}
+
+// Imports a module into the root table (for --import)
+int ImportModule(HSQUIRRELVM v, const char *module)
+{
+	SQChar *name = ToSQChar(module);
+	SQInteger top = sq_gettop(v);
+	SQRESULT res;
+	sq_pushstring(v, name, -1);
+	sq_pushroottable(v);
+	res = sqrat_import(v);
+	sq_settop(v, top);
+	free(name);
+	return SQ_SUCCEEDED(res);
+}
+
 #define _INTERACTIVE 0
 #define _DONE 2
+#define _ERROR 3
 //<<FIXME>> this func is a mess
 int getargs(HSQUIRRELVM v,int argc, char* argv[])
 {
@@ -116,6 +682,11 @@ int getargs(HSQUIRRELVM v,int argc, char* argv[])
 	static SQChar temp[500];
 	const SQChar *ret=NULL;
 	char * output = NULL;
+	char * bundle = NULL;
+	char * tree = NULL;
+	int threads = 0;
+	int debuginfo = 0;
+	BenchOptions bench = { 0, 0, 100, 10, NULL };
 	int lineinfo=0;
 	if(argc>1)
 	{
@@ -129,6 +700,7 @@ int getargs(HSQUIRRELVM v,int argc, char* argv[])
 				{
 				case 'd': //DEBUG(debug infos)
 					sq_enabledebuginfo(v,1);
+					debuginfo = 1;
 					break;
 				case 'c':
 					compiles_only = 1;
@@ -139,6 +711,56 @@ int getargs(HSQUIRRELVM v,int argc, char* argv[])
 						output = argv[arg];
 					}
 					break;
+				case '-':
+					if(strcmp(argv[arg], "--bench") == 0)
+						bench.enabled = 1;
+					else if(strcmp(argv[arg], "--json") == 0)
+						bench.json = 1;
+					else if(strcmp(argv[arg], "--iterations") == 0 && arg + 1 < argc)
+						bench.iterations = atoi(argv[++arg]);
+					else if(strcmp(argv[arg], "--warmup") == 0 && arg + 1 < argc)
+						bench.warmup = atoi(argv[++arg]);
+					else if(strcmp(argv[arg], "--function") == 0 && arg + 1 < argc)
+						bench.function = argv[++arg];
+					else if(strcmp(argv[arg], "--import") == 0 && arg + 1 < argc) {
+						if(!ImportModule(v, argv[++arg]))
+							fprintf(stderr, "cannot import '%s'\n", argv[arg]);
+					}
+					else {
+						PrintVersionInfos();
+						printf("unknown prameter '%s'\n", argv[arg]);
+						PrintUsage();
+						return _DONE;
+					}
+					break;
+				case 'C':
+					if(arg < argc) {
+						arg++;
+						tree = argv[arg];
+					}
+					break;
+				case 'j':
+					if(arg < argc) {
+						arg++;
+						threads = atoi(argv[arg]);
+					}
+					break;
+				case 'b':
+					if(arg < argc) {
+						arg++;
+						bundle = argv[arg];
+					}
+					break;
+				case 'B':
+					if(arg < argc) {
+						SQChar *path;
+						arg++;
+						path = ToSQChar(argv[arg]);
+						if(SQ_FAILED(sqrat_import_addbundle(v,path)))
+							scfprintf(stderr,_SC("cannot open bundle '%s'\n"),path);
+						free(path);
+					}
+					break;
 				case 'v':
 					PrintVersionInfos();
 					return _DONE;
@@ -157,6 +779,21 @@ int getargs(HSQUIRRELVM v,int argc, char* argv[])
 			arg++;
 		}
 
+		if(tree) {
+			return CompileTree(tree,threads,debuginfo) ? _DONE : _ERROR;
+		}
+
+		if(bundle) {
+			if(!BuildBundle(v,bundle,argc-arg,argv+arg)) {
+				const SQChar *err;
+				sq_getlasterror(v);
+				if(SQ_SUCCEEDED(sq_getstring(v,-1,&err)))
+					scprintf(_SC("Error [%s]\n"),err);
+				return _ERROR;
+			}
+			return _DONE;
+		}
+
 		// src file
 		
 		if(arg<argc) {
@@ -189,6 +826,13 @@ int getargs(HSQUIRRELVM v,int argc, char* argv[])
 			}
 			sq_createslot(v,-3);
 			sq_pop(v,1);
+			if(bench.enabled) {
+				if(bench.iterations < 0)
+					bench.iterations = 0;
+				if(bench.warmup < 0)
+					bench.warmup = 0;
+				return RunBench(v,filename,argv[arg-1],&bench) ? _DONE : _ERROR;
+			}
 			if(compiles_only) {
 				if(SQ_SUCCEEDED(sqstd_loadfile(v,filename,SQTrue))){
 					SQChar *outfile = _SC("out.cnut");
@@ -214,10 +858,9 @@ int getargs(HSQUIRRELVM v,int argc, char* argv[])
 			{
 				const SQChar *err;
 				sq_getlasterror(v);
-				if(SQ_SUCCEEDED(sq_getstring(v,-1,&err))) {
+				if(SQ_SUCCEEDED(sq_getstring(v,-1,&err)))
 					scprintf(_SC("Error [%s]\n"),err);
-					return _DONE;
-				}
+				return _ERROR;
 			}
 			
 		}
@@ -311,6 +954,7 @@ void Interactive(HSQUIRRELVM v)
 int main(int argc, char* argv[])
 {
 	HSQUIRRELVM v;
+	int retval = 0;
 	
 	const SQChar *filename=NULL;
 #if defined(_MSC_VER) && defined(_DEBUG)
@@ -345,6 +989,9 @@ int main(int argc, char* argv[])
 	case _INTERACTIVE:
 		Interactive(v);
 		break;
+	case _ERROR:
+		retval = 1;
+		break;
 	case _DONE:
 	default: 
 		break;
@@ -356,6 +1003,6 @@ int main(int argc, char* argv[])
 	_getch();
 	_CrtMemDumpAllObjectsSince( NULL );
 #endif
-	return 0;
+	return retval;
 }
 
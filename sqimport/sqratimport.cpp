@@ -27,10 +27,18 @@
 
 #include "sqratimport.h"
 #include "sqmodule.h"
+#include "sqrat/sqratBundle.h"
+#include "sqrat/sqratTable.h"
+#include "sqrat/sqratTrace.h"
 
 //#include "sqratlib/sqratBase.h"
 #include <sqstdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <map>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #if defined(_WIN32)
 
@@ -42,9 +50,62 @@
 
 #endif
 
-typedef SQRESULT (*SQMODULELOAD)(HSQUIRRELVM v, HSQAPI sq);
+typedef std::basic_string<SQChar> sqrat_string;
+
+// Registry slot holding the module cache of a VM (resolved path -> module table)
+#define SQRAT_MODULES_KEY _SC("__sqrat_modules__")
+// Registry slot holding the resolution cache of a VM (module name -> [resolved path, is binary])
+#define SQRAT_RESOLVED_KEY _SC("__sqrat_resolved__")
+// Registry slot holding the search paths of a VM (array of directories)
+#define SQRAT_PATHS_KEY _SC("__sqrat_importpaths__")
+// Registry slot holding the bundles of a VM (array of bundle paths, searched in order)
+#define SQRAT_BUNDLES_KEY _SC("__sqrat_bundles__")
+
+// Environment variable whose directories seed the search paths of every new VM
+#define SQRAT_PATH_ENV "SQRAT_IMPORT_PATH"
+#if defined(_WIN32)
+#define SQRAT_PATH_SEPARATOR ';'
+#else
+#define SQRAT_PATH_SEPARATOR ':'
+#endif
 
 static HSQAPI sqapi = NULL;
+static std::mutex sqapi_lock;
+
+// Entry points of the binary modules opened so far, shared by every VM (the libraries stay loaded)
+static std::map<sqrat_string, SQRATMODULELOAD> sqrat_binmodules;
+static std::mutex sqrat_binmodules_lock;
+
+// Bundles opened so far, shared by every VM (they stay mapped)
+static std::map<sqrat_string, Sqrat::Bundle*> sqrat_bundles;
+static std::mutex sqrat_bundles_lock;
+
+// Where a module name was found
+enum sqrat_modulekind {
+    SQRAT_MODULE_SCRIPT,
+    SQRAT_MODULE_BINARY,
+    SQRAT_MODULE_BUNDLED
+};
+
+struct sqrat_resolution {
+    sqrat_string path;  // script file, library or bundle file
+    sqrat_string entry; // name of the module inside the bundle
+    int kind;
+};
+
+// Module linked into the executable (one of the two entry points is set)
+struct sqrat_staticmodule {
+    SQRATSTATICLOAD load;
+    SQRATMODULELOAD apiLoad;
+};
+
+// Static modules are registered while the program starts, so the registry is created on first use
+static std::map<sqrat_string, sqrat_staticmodule>& sqrat_staticmodules(std::mutex*& lock) {
+    static std::map<sqrat_string, sqrat_staticmodule> modules;
+    static std::mutex modulesLock;
+    lock = &modulesLock;
+    return modules;
+}
 
 // Create and populate the HSQAPI structure with function pointers
 // If new functions are added to the Squirrel API, they should be added here too
@@ -222,25 +283,346 @@ static HSQAPI sqrat_newapi() {
 }
 
 
-static SQRESULT sqrat_importscript(HSQUIRRELVM v, const SQChar* moduleName) {
-    std::basic_string<SQChar> filename(moduleName);
-    filename += _SC(".nut");
-    if(SQ_FAILED(sqstd_loadfile(v, moduleName, true))) {
-        if(SQ_FAILED(sqstd_loadfile(v, filename.c_str(), true))) {
-            return SQ_ERROR;
+// Gets the HSQAPI table handed to modules, creating it the first time
+static HSQAPI sqrat_getapi() {
+    std::lock_guard<std::mutex> lock(sqapi_lock);
+    if(sqapi == NULL) {
+        sqapi = sqrat_newapi();
+    }
+    return sqapi;
+}
+
+static SQRESULT sqrat_addstaticmodule(const SQChar* name, SQRATSTATICLOAD load, SQRATMODULELOAD apiLoad) {
+    if(name == NULL || (load == NULL && apiLoad == NULL)) {
+        return SQ_ERROR;
+    }
+    std::mutex* lock;
+    std::map<sqrat_string, sqrat_staticmodule>& modules = sqrat_staticmodules(lock);
+    std::lock_guard<std::mutex> guard(*lock);
+    sqrat_staticmodule& module = modules[name];
+    module.load = load;
+    module.apiLoad = apiLoad;
+    return SQ_OK;
+}
+
+static bool sqrat_findstatic(const sqrat_string& name, sqrat_staticmodule& module) {
+    std::mutex* lock;
+    std::map<sqrat_string, sqrat_staticmodule>& modules = sqrat_staticmodules(lock);
+    std::lock_guard<std::mutex> guard(*lock);
+    std::map<sqrat_string, sqrat_staticmodule>::iterator it = modules.find(name);
+    if(it == modules.end()) {
+        return false;
+    }
+    module = it->second;
+    return true;
+}
+
+// Pushes a table kept in the registry, creating it on first use (returns true if it was just created)
+static bool sqrat_pushregistryslot(HSQUIRRELVM v, const SQChar* key, bool array) {
+    sq_pushregistrytable(v);
+    sq_pushstring(v, key, -1);
+    bool created = SQ_FAILED(sq_rawget(v, -2));
+    if(created) {
+        if(array) {
+            sq_newarray(v, 0);
+        } else {
+            sq_newtable(v);
+        }
+        sq_pushstring(v, key, -1);
+        sq_push(v, -2);
+        sq_rawset(v, -4);
+    }
+    sq_remove(v, -2); // pop registry table
+    return created;
+}
+
+// Replaces a table kept in the registry with an empty one
+static void sqrat_resetregistryslot(HSQUIRRELVM v, const SQChar* key, bool array) {
+    sq_pushregistrytable(v);
+    sq_pushstring(v, key, -1);
+    if(array) {
+        sq_newarray(v, 0);
+    } else {
+        sq_newtable(v);
+    }
+    sq_rawset(v, -3);
+    sq_pop(v, 1);
+}
+
+// Appends the directories listed in the environment to the path array on top of the stack
+static void sqrat_addenvpaths(HSQUIRRELVM v) {
+#if defined(SQUNICODE)
+    // the variable is read as narrow characters only
+#else
+    const char* env = getenv(SQRAT_PATH_ENV);
+    if(env == NULL) {
+        return;
+    }
+    std::string paths(env);
+    size_t start = 0;
+    while(start <= paths.size()) {
+        size_t end = paths.find(SQRAT_PATH_SEPARATOR, start);
+        if(end == std::string::npos) {
+            end = paths.size();
+        }
+        if(end > start) {
+            sq_pushstring(v, paths.c_str() + start, static_cast<SQInteger>(end - start));
+            sq_arrayappend(v, -2);
+        }
+        start = end + 1;
+    }
+#endif
+}
+
+// Reads the search paths of the VM, seeding them from the environment on first use
+static void sqrat_getpaths(HSQUIRRELVM v, std::vector<sqrat_string>& paths) {
+    if(sqrat_pushregistryslot(v, SQRAT_PATHS_KEY, true)) {
+        sqrat_addenvpaths(v);
+    }
+    sq_pushnull(v);
+    while(SQ_SUCCEEDED(sq_next(v, -2))) {
+        const SQChar* path;
+        if(SQ_SUCCEEDED(sq_getstring(v, -1, &path))) {
+            paths.push_back(path);
+        }
+        sq_pop(v, 2);
+    }
+    sq_pop(v, 2); // pop iterator and path array
+}
+
+// Gets the modification time of a regular file, returns false if there is no such file
+static bool sqrat_filetime(const sqrat_string& path, time_t& mtime) {
+#if defined(SQUNICODE) && defined(_WIN32)
+    struct _stat st;
+    if(_wstat(path.c_str(), &st) != 0 || (st.st_mode & _S_IFREG) == 0) {
+        return false;
+    }
+#elif defined(SQUNICODE)
+    std::string narrow(path.size() * 4 + 1, '\0');
+    size_t len = wcstombs(&narrow[0], path.c_str(), narrow.size());
+    if(len == static_cast<size_t>(-1)) {
+        return false;
+    }
+    narrow.resize(len);
+    struct stat st;
+    if(stat(narrow.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+#elif defined(_WIN32)
+    struct _stat st;
+    if(_stat(path.c_str(), &st) != 0 || (st.st_mode & _S_IFREG) == 0) {
+        return false;
+    }
+#else
+    struct stat st;
+    if(stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+#endif
+    mtime = st.st_mtime;
+    return true;
+}
+
+static bool sqrat_endswith(const sqrat_string& str, const SQChar* suffix) {
+    sqrat_string end(suffix);
+    return str.size() >= end.size() && str.compare(str.size() - end.size(), end.size(), end) == 0;
+}
+
+static bool sqrat_isabsolute(const sqrat_string& path) {
+    return (!path.empty() && (path[0] == _SC('/') || path[0] == _SC('\\'))) || (path.size() > 1 && path[1] == _SC(':'));
+}
+
+static sqrat_string sqrat_joinpath(const sqrat_string& dir, const sqrat_string& name) {
+    if(dir.empty() || sqrat_endswith(dir, _SC("/")) || sqrat_endswith(dir, _SC("\\"))) {
+        return dir + name;
+    }
+    return dir + _SC("/") + name;
+}
+
+// Picks the script for a module in one place: the name as given, then name.nut, taking a .cnut instead if it is at least as new
+static bool sqrat_resolvescript(const sqrat_string& base, sqrat_string& resolved) {
+    time_t sourceTime, compiledTime;
+    if(sqrat_filetime(base, sourceTime)) {
+        sqrat_string compiled = base.substr(0, base.size() - 4) + _SC(".cnut");
+        if(sqrat_endswith(base, _SC(".nut")) && sqrat_filetime(compiled, compiledTime) && compiledTime >= sourceTime) {
+            resolved = compiled;
+        } else {
+            resolved = base;
+        }
+        return true;
+    }
+    sqrat_string source = base + _SC(".nut");
+    sqrat_string compiled = base + _SC(".cnut");
+    bool hasSource = sqrat_filetime(source, sourceTime);
+    if(sqrat_filetime(compiled, compiledTime) && (!hasSource || compiledTime >= sourceTime)) {
+        resolved = compiled;
+        return true;
+    }
+    if(hasSource) {
+        resolved = source;
+        return true;
+    }
+    return false;
+}
+
+// Bundle names and paths are narrow strings (only ASCII survives in SQUNICODE builds)
+static std::string sqrat_narrow(const sqrat_string& str) {
+    return std::string(str.begin(), str.end());
+}
+
+// Gets a bundle opened by sqrat_import_addbundle (NULL if it is not open)
+static Sqrat::Bundle* sqrat_findbundle(const sqrat_string& path) {
+    std::lock_guard<std::mutex> lock(sqrat_bundles_lock);
+    std::map<sqrat_string, Sqrat::Bundle*>::iterator it = sqrat_bundles.find(path);
+    return it != sqrat_bundles.end() ? it->second : NULL;
+}
+
+// Looks a module name up in the bundles of the VM, as given and then without its extension
+static bool sqrat_resolvebundled(HSQUIRRELVM v, const sqrat_string& name, sqrat_resolution& resolved) {
+    std::vector<sqrat_string> entries(1, name);
+    if(sqrat_endswith(name, _SC(".nut"))) {
+        entries.push_back(name.substr(0, name.size() - 4));
+    } else if(sqrat_endswith(name, _SC(".cnut"))) {
+        entries.push_back(name.substr(0, name.size() - 5));
+    }
+    bool found = false;
+    sqrat_pushregistryslot(v, SQRAT_BUNDLES_KEY, true);
+    sq_pushnull(v);
+    while(!found && SQ_SUCCEEDED(sq_next(v, -2))) {
+        const SQChar* path;
+        Sqrat::Bundle* bundle;
+        if(SQ_SUCCEEDED(sq_getstring(v, -1, &path)) && (bundle = sqrat_findbundle(path)) != NULL) {
+            for(size_t i = 0; i < entries.size() && !found; ++i) {
+                const void* data;
+                size_t size;
+                if(bundle->Find(sqrat_narrow(entries[i]), data, size)) {
+                    resolved.path = path;
+                    resolved.entry = entries[i];
+                    resolved.kind = SQRAT_MODULE_BUNDLED;
+                    found = true;
+                }
+            }
         }
+        sq_pop(v, 2);
     }
+    sq_pop(v, 2); // pop iterator and bundle array
+    return found;
+}
+
+// Finds what a module name refers to: a bundled module, else a file next to the working directory or in a search path
+static void sqrat_resolve(HSQUIRRELVM v, const sqrat_string& name, sqrat_resolution& resolved) {
+    if(sqrat_resolvebundled(v, name, resolved)) {
+        return;
+    }
+    resolved.entry.clear();
+    std::vector<sqrat_string> dirs(1);
+    if(!sqrat_isabsolute(name)) {
+        sqrat_getpaths(v, dirs);
+    }
+    for(size_t i = 0; i < dirs.size(); ++i) {
+        if(sqrat_resolvescript(sqrat_joinpath(dirs[i], name), resolved.path)) {
+            resolved.kind = SQRAT_MODULE_SCRIPT;
+            return;
+        }
+    }
+    resolved.kind = SQRAT_MODULE_BINARY;
+    time_t mtime;
+    for(size_t i = 1; i < dirs.size(); ++i) {
+        resolved.path = sqrat_joinpath(dirs[i], name);
+        if(sqrat_filetime(resolved.path, mtime)) {
+            return;
+        }
+    }
+    resolved.path = name; // left to the system's library search
+}
+
+// Key of a module in the module cache (a bundled module is keyed as if the bundle were a directory)
+static sqrat_string sqrat_modulekey(const sqrat_resolution& resolved) {
+    return resolved.kind == SQRAT_MODULE_BUNDLED ? sqrat_joinpath(resolved.path, resolved.entry) : resolved.path;
+}
+
+// Looks a module name up in the resolution cache
+static bool sqrat_findresolved(HSQUIRRELVM v, const sqrat_string& name, sqrat_resolution& resolved) {
+    bool found = false;
+    sqrat_pushregistryslot(v, SQRAT_RESOLVED_KEY, false);
+    sq_pushstring(v, name.c_str(), -1);
+    if(SQ_SUCCEEDED(sq_rawget(v, -2))) {
+        const SQChar* path;
+        const SQChar* entry;
+        SQInteger kind;
+        sq_pushinteger(v, 0);
+        sq_rawget(v, -2);
+        sq_getstring(v, -1, &path);
+        resolved.path = path;
+        sq_pushinteger(v, 1);
+        sq_rawget(v, -3);
+        sq_getinteger(v, -1, &kind);
+        resolved.kind = static_cast<int>(kind);
+        sq_pushinteger(v, 2);
+        sq_rawget(v, -4);
+        sq_getstring(v, -1, &entry);
+        resolved.entry = entry;
+        sq_pop(v, 4);
+        found = true;
+    }
+    sq_pop(v, 1);
+    return found;
+}
+
+static void sqrat_rememberresolved(HSQUIRRELVM v, const sqrat_string& name, const sqrat_resolution& resolved) {
+    sqrat_pushregistryslot(v, SQRAT_RESOLVED_KEY, false);
+    sq_pushstring(v, name.c_str(), -1);
+    sq_newarray(v, 0);
+    sq_pushstring(v, resolved.path.c_str(), -1);
+    sq_arrayappend(v, -2);
+    sq_pushinteger(v, resolved.kind);
+    sq_arrayappend(v, -2);
+    sq_pushstring(v, resolved.entry.c_str(), -1);
+    sq_arrayappend(v, -2);
+    sq_rawset(v, -3);
+    sq_pop(v, 1);
+}
+
+// Runs the module closure on top of the stack with a new table as 'this', replacing the closure with the table
+static SQRESULT sqrat_runmodule(HSQUIRRELVM v) {
+    sq_newtable(v);
     sq_push(v, -2);
-    sq_call(v, 1, false, true);
+    sq_push(v, -2);
+    if(SQ_FAILED(sq_call(v, 1, false, true))) {
+        sq_pop(v, 3);
+        return SQ_ERROR;
+    }
+    sq_pop(v, 1); // pop the called closure
+    sq_remove(v, -2); // pop the loaded closure
     return SQ_OK;
 }
 
-static SQRESULT sqrat_importbin(HSQUIRRELVM v, const SQChar* moduleName) {
-#ifdef SQUNICODE
-#warning sqrat_importbin() Not Implemented
-    return SQ_ERROR;
-#else
-    SQMODULELOAD modLoad = 0;
+// Runs a script module with a new table as 'this', leaving the table on the stack
+static SQRESULT sqrat_importscript(HSQUIRRELVM v, const sqrat_string& path) {
+    if(SQ_FAILED(sqstd_loadfile(v, path.c_str(), true))) {
+        return SQ_ERROR;
+    }
+    return sqrat_runmodule(v);
+}
+
+// Runs a module read in place from a bundle, leaving the table on the stack
+static SQRESULT sqrat_importbundled(HSQUIRRELVM v, const sqrat_resolution& resolved) {
+    Sqrat::Bundle* bundle = sqrat_findbundle(resolved.path);
+    if(bundle == NULL || SQ_FAILED(bundle->Push(v, sqrat_narrow(resolved.entry)))) {
+        return sq_throwerror(v, _SC("bundled module is missing or damaged"));
+    }
+    return sqrat_runmodule(v);
+}
+
+// Finds the entry point of a binary module, opening the library only the first time
+static SQRATMODULELOAD sqrat_openbin(const SQChar* moduleName) {
+    std::lock_guard<std::mutex> lock(sqrat_binmodules_lock);
+    std::map<sqrat_string, SQRATMODULELOAD>::iterator it = sqrat_binmodules.find(moduleName);
+    if(it != sqrat_binmodules.end()) {
+        return it->second;
+    }
+
+    SQRATMODULELOAD modLoad = 0;
 
 #if defined(_WIN32)
     HMODULE mod;
@@ -248,14 +630,14 @@ static SQRESULT sqrat_importbin(HSQUIRRELVM v, const SQChar* moduleName) {
     if(mod == NULL) {
         mod = LoadLibrary(moduleName);
         if(mod == NULL) {
-            return SQ_ERROR;
+            return NULL;
         }
     }
 
-    modLoad = (SQMODULELOAD)GetProcAddress(mod, "sqmodule_load");
+    modLoad = (SQRATMODULELOAD)GetProcAddress(mod, "sqmodule_load");
     if(modLoad == NULL) {
         FreeLibrary(mod);
-        return SQ_ERROR;
+        return NULL;
     }
 #elif defined(__unix)
     /* adding .so to moduleName? */
@@ -263,49 +645,250 @@ static SQRESULT sqrat_importbin(HSQUIRRELVM v, const SQChar* moduleName) {
     if (mod == NULL) {
         mod = dlopen(moduleName, RTLD_NOW | RTLD_LOCAL);
         if (mod == NULL)
-            return SQ_ERROR;
+            return NULL;
     }
-    modLoad = (SQMODULELOAD) dlsym(mod, "sqmodule_load");
+    modLoad = (SQRATMODULELOAD) dlsym(mod, "sqmodule_load");
     if (modLoad == NULL) {
         dlclose(mod);
-        return SQ_ERROR;
+        return NULL;
     }
 #endif
 
-    if(sqapi == NULL) {
-        sqapi = sqrat_newapi(); // Caching this for multiple imports is probably a very good idea
-    }
+    sqrat_binmodules[moduleName] = modLoad;
+    return modLoad;
+}
 
-    SQRESULT res = modLoad(v, sqapi);
+// Loads a binary module into a new table, leaving the table on the stack
+static SQRESULT sqrat_importbin(HSQUIRRELVM v, const SQChar* moduleName) {
+#ifdef SQUNICODE
+#warning sqrat_importbin() Not Implemented
+    return sq_throwerror(v, _SC("binary modules are not supported"));
+#else
+    SQRATMODULELOAD modLoad = sqrat_openbin(moduleName);
+    if(modLoad == NULL) {
+        return sq_throwerror(v, _SC("cannot load binary module"));
+    }
 
-    return res;
+    sq_newtable(v);
+    if(SQ_FAILED(modLoad(v, sqrat_getapi()))) {
+        sq_pop(v, 1);
+        return SQ_ERROR;
+    }
+    return SQ_OK;
 #endif
 }
 
-SQRESULT sqrat_import(HSQUIRRELVM v) {
+// Loads a static module into a new table, leaving the table on the stack
+static SQRESULT sqrat_importstatic(HSQUIRRELVM v, const sqrat_staticmodule& module) {
+    sq_newtable(v);
+    SQRESULT res = module.load ? module.load(v) : module.apiLoad(v, sqrat_getapi());
+    if(SQ_FAILED(res)) {
+        sq_pop(v, 1);
+        return SQ_ERROR;
+    }
+    return SQ_OK;
+}
+
+// Copies every slot of the module table on top of the stack into the table below it
+static void sqrat_copymodule(HSQUIRRELVM v) {
+    sq_pushnull(v);
+    while(SQ_SUCCEEDED(sq_next(v, -2))) {
+        sq_newslot(v, -5, false);
+    }
+    sq_pop(v, 2); // pop iterator and module table
+}
+
+// Imports the module named at -2 into the table at -1, reusing the cached module table unless reload is set
+static SQRESULT sqrat_importmodule(HSQUIRRELVM v, bool reload) {
     const SQChar* moduleName;
     HSQOBJECT table;
     SQRESULT res = SQ_OK;
 
+    SQInteger base = sq_gettop(v) - 2;
+    SQInteger modules = base + 2;
 
     sq_getstring(v, -2, &moduleName);
+    sqrat_string name(moduleName);
     sq_getstackobj(v, -1, &table);
     sq_addref(v, &table);
 
-    sq_settop(v, 0); // Clear Stack
+    sq_settop(v, base); // Pop the arguments
     sq_pushobject(v, table); // Push the target table onto the stack
 
-    if(SQ_FAILED(sqrat_importscript(v, moduleName))) {
-        res = sqrat_importbin(v, moduleName);
+    // Static modules come first and are cached under their name
+    sqrat_staticmodule builtin;
+    bool isStatic = sqrat_findstatic(name, builtin);
+    sqrat_resolution resolved;
+    resolved.kind = SQRAT_MODULE_SCRIPT;
+    if(isStatic) {
+        resolved.path = name;
+    } else if(reload || !sqrat_findresolved(v, name, resolved)) {
+        sqrat_resolve(v, name, resolved);
     }
+    sqrat_string key = sqrat_modulekey(resolved);
 
-    sq_settop(v, 0); // Clean up the stack (just in case the module load leaves it messy)
+    sqrat_pushregistryslot(v, SQRAT_MODULES_KEY, false);
+    bool cached = false;
+    if(!reload) {
+        sq_pushstring(v, key.c_str(), -1);
+        cached = SQ_SUCCEEDED(sq_rawget(v, modules)); // pops the key when the module is not cached
+    }
+    if(!cached) {
+        Sqrat::Trace::Scope trace(v, Sqrat::Trace::TRACE_IMPORT, name.c_str(), resolved.path.c_str());
+        if(isStatic) {
+            res = sqrat_importstatic(v, builtin);
+        } else if(resolved.kind == SQRAT_MODULE_BUNDLED) {
+            res = sqrat_importbundled(v, resolved);
+        } else if(resolved.kind == SQRAT_MODULE_BINARY) {
+            res = sqrat_importbin(v, resolved.path.c_str());
+        } else {
+            res = sqrat_importscript(v, resolved.path);
+        }
+        if(SQ_SUCCEEDED(res)) {
+            sq_pushstring(v, key.c_str(), -1);
+            sq_push(v, -2);
+            sq_rawset(v, modules);
+        }
+    }
+    if(SQ_SUCCEEDED(res)) {
+        if(!isStatic) {
+            sqrat_rememberresolved(v, name, resolved);
+        }
+        sq_remove(v, modules); // pop module cache
+        sqrat_copymodule(v);
+    }
+
+    sq_settop(v, base); // Clean up the stack (just in case the module load leaves it messy)
     sq_pushobject(v, table); // return the target table
     sq_release(v, &table);
-    
+
     return res;
 }
 
+SQRESULT sqrat_import(HSQUIRRELVM v) {
+    return sqrat_importmodule(v, false);
+}
+
+SQRESULT sqrat_import_reload(HSQUIRRELVM v) {
+    return sqrat_importmodule(v, true);
+}
+
+// Loader of a lazy import (run by Sqrat::LazyBindings): imports the module named by its free variable into 'this'
+static SQInteger sqrat_lazymodule(HSQUIRRELVM v) {
+    sq_push(v, 2);
+    sq_push(v, 1);
+    if(SQ_FAILED(sqrat_import(v))) {
+        return SQ_ERROR; // keeps the error of the import itself
+    }
+    return 0;
+}
+
+SQRESULT sqrat_import_lazy(HSQUIRRELVM v) {
+    SQInteger top = sq_gettop(v);
+    sq_push(v, -2);
+    sq_newclosure(v, &sqrat_lazymodule, 1);
+    bool added = Sqrat::LazyBindings::Add(v, top);
+    sq_remove(v, top - 1); // pop module name
+    if(!added) {
+        return sq_throwerror(v, _SC("the table already has a delegate"));
+    }
+    return SQ_OK;
+}
+
+SQRESULT sqrat_import_invalidate(HSQUIRRELVM v, const SQChar* moduleName) {
+    if(moduleName == NULL) {
+        sqrat_resetregistryslot(v, SQRAT_MODULES_KEY, false);
+        sqrat_resetregistryslot(v, SQRAT_RESOLVED_KEY, false);
+        return SQ_OK;
+    }
+    sqrat_resolution resolved;
+    sqrat_staticmodule builtin;
+    if(sqrat_findstatic(moduleName, builtin)) {
+        sqrat_pushregistryslot(v, SQRAT_MODULES_KEY, false);
+        sq_pushstring(v, moduleName, -1);
+        sq_rawdeleteslot(v, -2, false);
+        sq_pop(v, 1);
+    } else if(sqrat_findresolved(v, moduleName, resolved)) {
+        sqrat_pushregistryslot(v, SQRAT_MODULES_KEY, false);
+        sq_pushstring(v, sqrat_modulekey(resolved).c_str(), -1);
+        sq_rawdeleteslot(v, -2, false);
+        sq_pop(v, 1);
+        sqrat_pushregistryslot(v, SQRAT_RESOLVED_KEY, false);
+        sq_pushstring(v, moduleName, -1);
+        sq_rawdeleteslot(v, -2, false);
+        sq_pop(v, 1);
+    }
+    return SQ_OK;
+}
+
+SQRESULT sqrat_import_addpath(HSQUIRRELVM v, const SQChar* path) {
+    if(sqrat_pushregistryslot(v, SQRAT_PATHS_KEY, true)) {
+        sqrat_addenvpaths(v);
+    }
+    sq_pushstring(v, path, -1);
+    sq_arrayappend(v, -2);
+    sq_pop(v, 1);
+    return SQ_OK;
+}
+
+SQRESULT sqrat_import_clearpaths(HSQUIRRELVM v) {
+    sqrat_resetregistryslot(v, SQRAT_PATHS_KEY, true);
+    sqrat_resetregistryslot(v, SQRAT_RESOLVED_KEY, false);
+    return SQ_OK;
+}
+
+SQRESULT sqrat_import_addbundle(HSQUIRRELVM v, const SQChar* path) {
+    {
+        std::lock_guard<std::mutex> lock(sqrat_bundles_lock);
+        if(sqrat_bundles.find(path) == sqrat_bundles.end()) {
+            Sqrat::Bundle* bundle = new Sqrat::Bundle(sqrat_narrow(path));
+            if(!bundle->IsOpen()) {
+                delete bundle;
+                return sq_throwerror(v, _SC("cannot open bundle"));
+            }
+            sqrat_bundles[path] = bundle;
+        }
+    }
+    sqrat_pushregistryslot(v, SQRAT_BUNDLES_KEY, true);
+    sq_pushstring(v, path, -1);
+    sq_arrayappend(v, -2);
+    sq_pop(v, 1);
+    sqrat_resetregistryslot(v, SQRAT_RESOLVED_KEY, false); // names found elsewhere may now come from the bundle
+    return SQ_OK;
+}
+
+SQRESULT sqrat_bundle_build(HSQUIRRELVM v, const SQChar* output, const SQChar* const* files, SQInteger count) {
+    Sqrat::BundleWriter writer;
+    for(SQInteger i = 0; i < count; ++i) {
+        sqrat_string name(files[i]);
+        if(sqrat_endswith(name, _SC(".nut"))) {
+            name.resize(name.size() - 4);
+        } else if(sqrat_endswith(name, _SC(".cnut"))) {
+            name.resize(name.size() - 5);
+        }
+        for(size_t j = 0; j < name.size(); ++j) {
+            if(name[j] == _SC('\\')) {
+                name[j] = _SC('/');
+            }
+        }
+        if(SQ_FAILED(writer.AddScript(v, sqrat_narrow(name), files[i]))) {
+            return SQ_ERROR;
+        }
+    }
+    if(!writer.Write(sqrat_narrow(output))) {
+        return sq_throwerror(v, _SC("cannot write bundle"));
+    }
+    return SQ_OK;
+}
+
+SQRESULT sqrat_register_staticmodule(const SQChar* name, SQRATSTATICLOAD load) {
+    return sqrat_addstaticmodule(name, load, NULL);
+}
+
+SQRESULT sqrat_register_staticapimodule(const SQChar* name, SQRATMODULELOAD load) {
+    return sqrat_addstaticmodule(name, NULL, load);
+}
+
 static SQInteger sqratbase_import(HSQUIRRELVM v) {
     SQInteger args = sq_gettop(v);
     switch(args) {
@@ -325,6 +908,60 @@ static SQInteger sqratbase_import(HSQUIRRELVM v) {
     return 1;
 }
 
+static SQInteger sqratbase_import_lazy(HSQUIRRELVM v) {
+    if(sq_gettop(v) == 2) {
+        sq_newtable(v);
+    }
+
+    if(SQ_FAILED(sqrat_import_lazy(v))) {
+        return SQ_ERROR;
+    }
+
+    return 1;
+}
+
+static SQInteger sqratbase_import_reload(HSQUIRRELVM v) {
+    if(sq_gettop(v) == 2) {
+        sq_pushroottable(v);
+    }
+
+    if(SQ_FAILED(sqrat_import_reload(v))) {
+        return SQ_ERROR;
+    }
+
+    return 1;
+}
+
+static SQInteger sqratbase_import_invalidate(HSQUIRRELVM v) {
+    const SQChar* moduleName = NULL;
+    if(sq_gettop(v) >= 2) {
+        sq_getstring(v, 2, &moduleName);
+    }
+    sqrat_import_invalidate(v, moduleName);
+    return 0;
+}
+
+static SQInteger sqratbase_import_addpath(HSQUIRRELVM v) {
+    const SQChar* path;
+    sq_getstring(v, 2, &path);
+    sqrat_import_addpath(v, path);
+    return 0;
+}
+
+static SQInteger sqratbase_import_clearpaths(HSQUIRRELVM v) {
+    sqrat_import_clearpaths(v);
+    return 0;
+}
+
+static SQInteger sqratbase_import_addbundle(HSQUIRRELVM v) {
+    const SQChar* path;
+    sq_getstring(v, 2, &path);
+    if(SQ_FAILED(sqrat_import_addbundle(v, path))) {
+        return SQ_ERROR;
+    }
+    return 0;
+}
+
 SQRESULT sqrat_register_importlib(HSQUIRRELVM v) {
     sq_pushroottable(v);
 
@@ -332,6 +969,34 @@ SQRESULT sqrat_register_importlib(HSQUIRRELVM v) {
     sq_newclosure(v, &sqratbase_import, 0);
     sq_newslot(v, -3, 0);
 
+    sq_pushstring(v, _SC("import_lazy"), -1);
+    sq_newclosure(v, &sqratbase_import_lazy, 0);
+    sq_setparamscheck(v, -2, _SC(".st"));
+    sq_newslot(v, -3, 0);
+
+    sq_pushstring(v, _SC("import_reload"), -1);
+    sq_newclosure(v, &sqratbase_import_reload, 0);
+    sq_newslot(v, -3, 0);
+
+    sq_pushstring(v, _SC("import_invalidate"), -1);
+    sq_newclosure(v, &sqratbase_import_invalidate, 0);
+    sq_setparamscheck(v, -1, _SC(".s"));
+    sq_newslot(v, -3, 0);
+
+    sq_pushstring(v, _SC("import_addpath"), -1);
+    sq_newclosure(v, &sqratbase_import_addpath, 0);
+    sq_setparamscheck(v, 2, _SC(".s"));
+    sq_newslot(v, -3, 0);
+
+    sq_pushstring(v, _SC("import_clearpaths"), -1);
+    sq_newclosure(v, &sqratbase_import_clearpaths, 0);
+    sq_newslot(v, -3, 0);
+
+    sq_pushstring(v, _SC("import_addbundle"), -1);
+    sq_newclosure(v, &sqratbase_import_addbundle, 0);
+    sq_setparamscheck(v, 2, _SC(".s"));
+    sq_newslot(v, -3, 0);
+
     sq_pop(v, 1); // pop sqrat table
 
     return SQ_OK;
@@ -0,0 +1,431 @@
+//
+// Bench: Minimal timing harness shared by the sqratbench programs
+//
+
+//
+// Copyright (c) 2009 Brandon Jones
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software. If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+#if !defined(_SQRAT_BENCH_H_)
+#define _SQRAT_BENCH_H_
+
+#include <squirrel.h>
+#include <sqstdaux.h>
+#include <sqstdblob.h>
+#include <sqstdmath.h>
+#include <sqstdstring.h>
+#include <sqrat.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#if !defined(NOMINMAX)
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace Bench {
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Name of the error mode the benchmark was compiled with
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+inline const char* ErrorMode() {
+#if defined(SCRAT_USE_EXCEPTIONS)
+    return "exceptions";
+#elif defined(SCRAT_NO_ERROR_CHECKING)
+    return "nocheck";
+#else
+    return "default";
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Gets a monotonic time in nanoseconds
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+inline double NowNs() {
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Gets the peak resident memory of the process in kilobytes (0 if unknown)
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+inline unsigned long PeakMemoryKB() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return static_cast<unsigned long>(counters.PeakWorkingSetSize / 1024);
+    }
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#if defined(__APPLE__)
+    return static_cast<unsigned long>(usage.ru_maxrss / 1024); // bytes on macOS
+#else
+    return static_cast<unsigned long>(usage.ru_maxrss);
+#endif
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Gets a percentile of samples sorted in ascending order (nearest rank)
+///
+/// \param sorted  Samples sorted in ascending order
+/// \param percent Percentile between 0 and 100
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+inline double Percentile(const std::vector<double>& sorted, double percent) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t rank = static_cast<size_t>(percent / 100.0 * static_cast<double>(sorted.size()) + 0.5);
+    return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Converts generated script text to the character type of Squirrel
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+inline Sqrat::string ToSq(const std::string& s) {
+#if defined(SQUNICODE)
+    return Sqrat::string_to_wstring(s);
+#else
+    return s;
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Print and error function of benchmark VMs (writes to stderr so that reports on stdout stay machine-readable)
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+inline void PrintFunc(HSQUIRRELVM, const SQChar* s, ...) {
+    va_list vl;
+    va_start(vl, s);
+#if defined(SQUNICODE)
+    vfwprintf(stderr, s, vl);
+#else
+    vfprintf(stderr, s, vl);
+#endif
+    va_end(vl);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Opens a VM with the standard libraries that benchmark scripts use
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+inline HSQUIRRELVM OpenVM() {
+    HSQUIRRELVM vm = sq_open(1024);
+    sq_setprintfunc(vm, PrintFunc, PrintFunc);
+    sqstd_seterrorhandlers(vm);
+    sq_pushroottable(vm);
+    sqstd_register_bloblib(vm);
+    sqstd_register_mathlib(vm);
+    sqstd_register_stringlib(vm);
+    sq_pop(vm, 1);
+    return vm;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Compiles and runs a script in the root table, reporting errors on stderr
+///
+/// \param vm     Target VM
+/// \param source Script text
+/// \param name   Name of the script (for errors)
+///
+/// \return True if the script ran without error
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+inline bool RunScript(HSQUIRRELVM vm, const std::string& source, const std::string& name) {
+    using namespace Sqrat;
+    Script script(vm);
+    SQTRY()
+        script.CompileString(ToSq(source), ToSq(name));
+        SQCATCH_NOEXCEPT(vm) {
+            PrintFunc(vm, _SC("%s\n"), SQWHAT_NOEXCEPT(vm));
+            SQCLEAR(vm);
+            return false;
+        }
+        script.Run();
+        SQCATCH_NOEXCEPT(vm) {
+            PrintFunc(vm, _SC("%s\n"), SQWHAT_NOEXCEPT(vm));
+            SQCLEAR(vm);
+            return false;
+        }
+    SQCATCH(vm) {
+        PrintFunc(vm, _SC("%s\n"), SQWHAT(vm));
+        return false;
+    }
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Writes a string as a JSON string literal
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+inline void PrintJsonString(FILE* out, const std::string& s) {
+    fputc('"', out);
+    for (size_t i = 0; i < s.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c == '"' || c == '\\') {
+            fputc('\\', out);
+            fputc(c, out);
+        } else if (c < 0x20) {
+            fprintf(out, "\\u%04x", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Runs benchmark cases and reports their cost per operation
+///
+/// \remarks
+/// A case is a callable taking the number of operations to perform. The runner grows that number until one run takes at
+/// least the minimum time, then times the number of repeats asked for and keeps the fastest and the median run.
+/// Cases may name a baseline case run before them (such as an empty script loop); its median is then subtracted to
+/// give the net cost of the operation alone.
+///
+/// Command line options:
+///   --json             report as one JSON document instead of a table
+///   --filter <text>    only run the cases whose name contains text
+///   --min-time <ms>    minimum duration of a timed run (default 50)
+///   --repeats <n>      number of timed runs per case (default 5)
+///   --list             print the case names and exit
+///
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+class Runner {
+public:
+
+    struct Result {
+        std::string name;
+        std::string baseline;
+        size_t      iterations;
+        double      minNs;
+        double      medianNs;
+        double      netNs;
+    };
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Constructs a Runner from the command line of the program
+    ///
+    /// \param program Name of the benchmark program (reported in the results)
+    /// \param argc    Number of arguments
+    /// \param argv    Arguments
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    Runner(const char* program, int argc, char** argv)
+        : m_program(program)
+        , m_json(false)
+        , m_list(false)
+        , m_minTimeNs(50e6)
+        , m_repeats(5)
+        , m_valid(true)
+    {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--json") {
+                m_json = true;
+            } else if (arg == "--list") {
+                m_list = true;
+            } else if (arg == "--filter" && hasValue) {
+                m_filter = argv[++i];
+            } else if (arg == "--min-time" && hasValue) {
+                m_minTimeNs = atof(argv[++i]) * 1e6;
+            } else if (arg == "--repeats" && hasValue) {
+                m_repeats = std::max(1, atoi(argv[++i]));
+            } else {
+                fprintf(stderr, "usage: %s [--json] [--list] [--filter <text>] [--min-time <ms>] [--repeats <n>]\n", program);
+                m_valid = false;
+            }
+        }
+        if (m_valid && !m_json && !m_list) {
+            printf("%s (%s errors)\n", program, ErrorMode());
+            printf("%-36s %14s %14s %14s %12s\n", "case", "median ns/op", "min ns/op", "net ns/op", "iterations");
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Checks whether the command line was understood
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool IsValid() const {
+        return m_valid;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Checks whether a case is selected by the filter
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool Selected(const std::string& name) const {
+        return m_filter.empty() || name.find(m_filter) != std::string::npos;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Times a case
+    ///
+    /// \param name     Name of the case
+    /// \param body     Callable performing the number of operations it is given
+    /// \param baseline Name of a case already run whose cost is subtracted (may be NULL)
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    template <class F>
+    void Run(const std::string& name, F body, const char* baseline = NULL) {
+        if (m_list) {
+            printf("%s\n", name.c_str());
+            return;
+        }
+        if (!Selected(name) && !isBaselineOfSelected(name)) {
+            return;
+        }
+
+        size_t iterations = 1;
+        for (;;) {
+            double start = NowNs();
+            body(iterations);
+            double elapsed = NowNs() - start;
+            if (elapsed >= m_minTimeNs || iterations >= (static_cast<size_t>(1) << 40)) {
+                break;
+            }
+            // aim a little past the minimum so the timed runs do not fall short of it
+            double scale = elapsed > 0 ? (m_minTimeNs * 1.2) / elapsed : 2.0;
+            iterations = static_cast<size_t>(iterations * std::min(std::max(scale, 2.0), 100.0));
+        }
+
+        std::vector<double> samples;
+        for (int i = 0; i < m_repeats; ++i) {
+            double start = NowNs();
+            body(iterations);
+            samples.push_back((NowNs() - start) / static_cast<double>(iterations));
+        }
+        std::sort(samples.begin(), samples.end());
+
+        Result result;
+        result.name = name;
+        result.baseline = baseline ? baseline : "";
+        result.iterations = iterations;
+        result.minNs = samples.front();
+        result.medianNs = samples[samples.size() / 2];
+        result.netNs = result.medianNs;
+        const Result* base = find(result.baseline);
+        if (base != NULL) {
+            result.netNs = std::max(0.0, result.medianNs - base->medianNs);
+        }
+        m_results.push_back(result);
+
+        if (!m_json && Selected(name)) {
+            printf("%-36s %14.1f %14.1f %14.1f %12lu\n", name.c_str(), result.medianNs, result.minNs, result.netNs,
+                   static_cast<unsigned long>(iterations));
+            fflush(stdout);
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Declares that a case is used as a baseline, so filtering never leaves it out
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void AddBaseline(const std::string& name) {
+        m_baselines.push_back(name);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Writes the JSON report if it was asked for
+    ///
+    /// \return Exit code of the program
+    ///
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    int Finish() {
+        if (!m_valid) {
+            return 2;
+        }
+        if (!m_json || m_list) {
+            return 0;
+        }
+        printf("{\"program\": ");
+        PrintJsonString(stdout, m_program);
+        printf(", \"mode\": \"%s\", \"squirrel\": %d, \"min_time_ms\": %.1f, \"repeats\": %d, \"results\": [",
+               ErrorMode(), SQUIRREL_VERSION_NUMBER, m_minTimeNs / 1e6, m_repeats);
+        bool first = true;
+        for (size_t i = 0; i < m_results.size(); ++i) {
+            const Result& r = m_results[i];
+            if (!Selected(r.name)) {
+                continue;
+            }
+            printf("%s\n  {\"name\": ", first ? "" : ",");
+            PrintJsonString(stdout, r.name);
+            printf(", \"baseline\": ");
+            PrintJsonString(stdout, r.baseline);
+            printf(", \"iterations\": %lu, \"median_ns\": %.2f, \"min_ns\": %.2f, \"net_ns\": %.2f}",
+                   static_cast<unsigned long>(r.iterations), r.medianNs, r.minNs, r.netNs);
+            first = false;
+        }
+        printf("\n]}\n");
+        return 0;
+    }
+
+private:
+
+    const Result* find(const std::string& name) const {
+        for (size_t i = 0; i < m_results.size(); ++i) {
+            if (m_results[i].name == name) {
+                return &m_results[i];
+            }
+        }
+        return NULL;
+    }
+
+    bool isBaselineOfSelected(const std::string& name) const {
+        return std::find(m_baselines.begin(), m_baselines.end(), name) != m_baselines.end();
+    }
+
+    std::string              m_program;
+    std::string              m_filter;
+    bool                     m_json;
+    bool                     m_list;
+    double                   m_minTimeNs;
+    int                      m_repeats;
+    bool                     m_valid;
+    std::vector<Result>      m_results;
+    std::vector<std::string> m_baselines;
+};
+
+}
+
+#endif
@@ -0,0 +1,492 @@
+//
+// Microbench: Cost of the individual paths of the binding layer
+//
+
+//
+// Copyright (c) 2009 Brandon Jones
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software. If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+//
+// Each case measures one path in isolation. Cases driven from a script run a loop and name loop_baseline (the same
+// loop with an empty body) as their baseline, so the net column is the cost of the binding alone. The program is built
+// once per error mode (sqratbench, sqratbench_exceptions and sqratbench_nocheck) so that the modes can be compared
+// case by case; run it with --json for machine-readable output.
+//
+
+#include <sqrat.h>
+#include <sqratimport.h>
+#include "Bench.h"
+
+using namespace Sqrat;
+
+namespace {
+
+const int MAX_ARITY = 14;
+
+int G0() {
+    return 0;
+}
+int G1(int a1) {
+    return a1;
+}
+int G2(int a1, int a2) {
+    return a1 + a2;
+}
+int G3(int a1, int a2, int a3) {
+    return a1 + a2 + a3;
+}
+int G4(int a1, int a2, int a3, int a4) {
+    return a1 + a2 + a3 + a4;
+}
+int G5(int a1, int a2, int a3, int a4, int a5) {
+    return a1 + a2 + a3 + a4 + a5;
+}
+int G6(int a1, int a2, int a3, int a4, int a5, int a6) {
+    return a1 + a2 + a3 + a4 + a5 + a6;
+}
+int G7(int a1, int a2, int a3, int a4, int a5, int a6, int a7) {
+    return a1 + a2 + a3 + a4 + a5 + a6 + a7;
+}
+int G8(int a1, int a2, int a3, int a4, int a5, int a6, int a7, int a8) {
+    return a1 + a2 + a3 + a4 + a5 + a6 + a7 + a8;
+}
+int G9(int a1, int a2, int a3, int a4, int a5, int a6, int a7, int a8, int a9) {
+    return a1 + a2 + a3 + a4 + a5 + a6 + a7 + a8 + a9;
+}
+int G10(int a1, int a2, int a3, int a4, int a5, int a6, int a7, int a8, int a9, int a10) {
+    return a1 + a2 + a3 + a4 + a5 + a6 + a7 + a8 + a9 + a10;
+}
+int G11(int a1, int a2, int a3, int a4, int a5, int a6, int a7, int a8, int a9, int a10, int a11) {
+    return a1 + a2 + a3 + a4 + a5 + a6 + a7 + a8 + a9 + a10 + a11;
+}
+int G12(int a1, int a2, int a3, int a4, int a5, int a6, int a7, int a8, int a9, int a10, int a11, int a12) {
+    return a1 + a2 + a3 + a4 + a5 + a6 + a7 + a8 + a9 + a10 + a11 + a12;
+}
+int G13(int a1, int a2, int a3, int a4, int a5, int a6, int a7, int a8, int a9, int a10, int a11, int a12, int a13) {
+    return a1 + a2 + a3 + a4 + a5 + a6 + a7 + a8 + a9 + a10 + a11 + a12 + a13;
+}
+int G14(int a1, int a2, int a3, int a4, int a5, int a6, int a7, int a8, int a9, int a10, int a11, int a12, int a13, int a14) {
+    return a1 + a2 + a3 + a4 + a5 + a6 + a7 + a8 + a9 + a10 + a11 + a12 + a13 + a14;
+}
+
+class Target {
+public:
+    Target() : value(0), m_prop(0) {
+    }
+
+    int M0() {
+        return 0;
+    }
+    int M1(int a1) {
+        return a1;
+    }
+    int M2(int a1, int a2) {
+        return a1 + a2;
+    }
+    int M3(int a1, int a2, int a3) {
+        return a1 + a2 + a3;
+    }
+    int M4(int a1, int a2, int a3, int a4) {
+        return a1 + a2 + a3 + a4;
+    }
+    int M5(int a1, int a2, int a3, int a4, int a5) {
+        return a1 + a2 + a3 + a4 + a5;
+    }
+    int M6(int a1, int a2, int a3, int a4, int a5, int a6) {
+        return a1 + a2 + a3 + a4 + a5 + a6;
+    }
+    int M7(int a1, int a2, int a3, int a4, int a5, int a6, int a7) {
+        return a1 + a2 + a3 + a4 + a5 + a6 + a7;
+    }
+    int M8(int a1, int a2, int a3, int a4, int a5, int a6, int a7, int a8) {
+        return a1 + a2 + a3 + a4 + a5 + a6 + a7 + a8;
+    }
+    int M9(int a1, int a2, int a3, int a4, int a5, int a6, int a7, int a8, int a9) {
+        return a1 + a2 + a3 + a4 + a5 + a6 + a7 + a8 + a9;
+    }
+    int M10(int a1, int a2, int a3, int a4, int a5, int a6, int a7, int a8, int a9, int a10) {
+        return a1 + a2 + a3 + a4 + a5 + a6 + a7 + a8 + a9 + a10;
+    }
+    int M11(int a1, int a2, int a3, int a4, int a5, int a6, int a7, int a8, int a9, int a10, int a11) {
+        return a1 + a2 + a3 + a4 + a5 + a6 + a7 + a8 + a9 + a10 + a11;
+    }
+    int M12(int a1, int a2, int a3, int a4, int a5, int a6, int a7, int a8, int a9, int a10, int a11, int a12) {
+        return a1 + a2 + a3 + a4 + a5 + a6 + a7 + a8 + a9 + a10 + a11 + a12;
+    }
+    int M13(int a1, int a2, int a3, int a4, int a5, int a6, int a7, int a8, int a9, int a10, int a11, int a12, int a13) {
+        return a1 + a2 + a3 + a4 + a5 + a6 + a7 + a8 + a9 + a10 + a11 + a12 + a13;
+    }
+    int M14(int a1, int a2, int a3, int a4, int a5, int a6, int a7, int a8, int a9, int a10, int a11, int a12, int a13, int a14) {
+        return a1 + a2 + a3 + a4 + a5 + a6 + a7 + a8 + a9 + a10 + a11 + a12 + a13 + a14;
+    }
+
+    int Echo() {
+        return 0;
+    }
+    int Echo(int val) {
+        return val;
+    }
+
+    int GetProp() const {
+        return m_prop;
+    }
+    void SetProp(const int& prop) {
+        m_prop = prop;
+    }
+
+    int value;
+
+private:
+    int m_prop;
+};
+
+struct Vec3 {
+    Vec3() : x(0), y(0), z(0) {
+    }
+    float x, y, z;
+};
+
+Vec3 AddVec(const Vec3& a, const Vec3& b) {
+    Vec3 r;
+    r.x = a.x + b.x;
+    r.y = a.y + b.y;
+    r.z = a.z + b.z;
+    return r;
+}
+
+size_t StringLength(const string& s) {
+    return s.size();
+}
+
+string Greeting() {
+    return _SC("hello from C++");
+}
+
+// Script array to std::vector
+int SumArray(Array a) {
+    std::vector<int> values(static_cast<size_t>(a.Length()));
+    if (!values.empty()) {
+        a.GetArray(&values[0], static_cast<int>(values.size()));
+    }
+    int sum = 0;
+    for (size_t i = 0; i < values.size(); ++i) {
+        sum += values[i];
+    }
+    return sum;
+}
+
+// std::vector to script array
+Array MakeArray(int size) {
+    std::vector<int> values(static_cast<size_t>(size), 7);
+    Array a(DefaultVM::Get(), size);
+    for (int i = 0; i < size; ++i) {
+        a.SetValue(i, values[i]);
+    }
+    return a;
+}
+
+void BindTarget(HSQUIRRELVM vm) {
+    Class<Target> target(vm, _SC("Target"));
+    target.Func(_SC("M0"), &Target::M0);
+    target.Func(_SC("M1"), &Target::M1);
+    target.Func(_SC("M2"), &Target::M2);
+    target.Func(_SC("M3"), &Target::M3);
+    target.Func(_SC("M4"), &Target::M4);
+    target.Func(_SC("M5"), &Target::M5);
+    target.Func(_SC("M6"), &Target::M6);
+    target.Func(_SC("M7"), &Target::M7);
+    target.Func(_SC("M8"), &Target::M8);
+    target.Func(_SC("M9"), &Target::M9);
+    target.Func(_SC("M10"), &Target::M10);
+    target.Func(_SC("M11"), &Target::M11);
+    target.Func(_SC("M12"), &Target::M12);
+    target.Func(_SC("M13"), &Target::M13);
+    target.Func(_SC("M14"), &Target::M14);
+    target.Overload<int (Target::*)()>(_SC("Echo"), &Target::Echo);
+    target.Overload<int (Target::*)(int)>(_SC("Echo"), &Target::Echo);
+    target.Var(_SC("value"), &Target::value);
+    target.Prop(_SC("prop"), &Target::GetProp, &Target::SetProp);
+    RootTable(vm).Bind(_SC("Target"), target);
+}
+
+void BindAll(HSQUIRRELVM vm) {
+    RootTable(vm).Func(_SC("G0"), &G0);
+    RootTable(vm).Func(_SC("G1"), &G1);
+    RootTable(vm).Func(_SC("G2"), &G2);
+    RootTable(vm).Func(_SC("G3"), &G3);
+    RootTable(vm).Func(_SC("G4"), &G4);
+    RootTable(vm).Func(_SC("G5"), &G5);
+    RootTable(vm).Func(_SC("G6"), &G6);
+    RootTable(vm).Func(_SC("G7"), &G7);
+    RootTable(vm).Func(_SC("G8"), &G8);
+    RootTable(vm).Func(_SC("G9"), &G9);
+    RootTable(vm).Func(_SC("G10"), &G10);
+    RootTable(vm).Func(_SC("G11"), &G11);
+    RootTable(vm).Func(_SC("G12"), &G12);
+    RootTable(vm).Func(_SC("G13"), &G13);
+    RootTable(vm).Func(_SC("G14"), &G14);
+    BindTarget(vm);
+
+    Class<Vec3> vec(vm, _SC("Vec3"));
+    vec.Var(_SC("x"), &Vec3::x);
+    vec.Var(_SC("y"), &Vec3::y);
+    vec.Var(_SC("z"), &Vec3::z);
+    RootTable(vm).Bind(_SC("Vec3"), vec);
+
+    RootTable(vm).Func(_SC("AddVec"), &AddVec);
+    RootTable(vm).Func(_SC("StringLength"), &StringLength);
+    RootTable(vm).Func(_SC("Greeting"), &Greeting);
+    RootTable(vm).Func(_SC("SumArray"), &SumArray);
+    RootTable(vm).Func(_SC("MakeArray"), &MakeArray);
+}
+
+std::string Number(int i) {
+    char buf[16];
+    sprintf(buf, "%d", i);
+    return buf;
+}
+
+std::string Arguments(int arity) {
+    std::string args;
+    for (int i = 1; i <= arity; ++i) {
+        args += (i > 1 ? ", " : "") + Number(i);
+    }
+    return args;
+}
+
+// Calls a script function taking the number of iterations
+struct ScriptLoop {
+    Function f;
+    void operator()(size_t n) {
+        f.Execute(static_cast<SQInteger>(n));
+    }
+};
+
+// Defines bench_<name>(n), which runs setup and then body n times, and times it against loop_baseline
+bool ScriptCase(Bench::Runner& runner, HSQUIRRELVM vm, const std::string& name, const std::string& setup, const std::string& body) {
+    std::string function = "bench_" + name;
+    std::string source = "function " + function + "(n) {\n" + setup + "\n"
+                         "    for (local i = 0; i < n; ++i) {\n        " + body + "\n    }\n}\n";
+    if (!Bench::RunScript(vm, source, name)) {
+        return false;
+    }
+    ScriptLoop loop;
+    loop.f = RootTable(vm).GetFunction(Bench::ToSq(function).c_str());
+    runner.Run(name, loop, name == "loop_baseline" ? NULL : "loop_baseline");
+    return true;
+}
+
+volatile size_t g_sink;
+
+struct ExecuteCase {
+    Function f;
+    int      arity;
+    void operator()(size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            if (arity == 0) {
+                f.Execute();
+            } else {
+                f.Execute(1, 2, 3);
+            }
+        }
+    }
+};
+
+struct EvaluateCase {
+    Function f;
+    int      arity;
+    void operator()(size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            if (arity == 0) {
+                g_sink = g_sink + *f.Evaluate<int>();
+            } else {
+                g_sink = g_sink + *f.Evaluate<int>(1, 2, 3);
+            }
+        }
+    }
+};
+
+struct EvaluateStringCase {
+    Function f;
+    void operator()(size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            g_sink = g_sink + f.Evaluate<string>()->size();
+        }
+    }
+};
+
+struct PushInstanceCase {
+    HSQUIRRELVM vm;
+    Target*     target;
+    void operator()(size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            ClassType<Target>::PushInstance(vm, target);
+            sq_poptop(vm);
+        }
+    }
+};
+
+struct GetInstanceCase {
+    HSQUIRRELVM vm;
+    void operator()(size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            g_sink = g_sink + reinterpret_cast<size_t>(ClassType<Target>::GetInstance(vm, -1));
+        }
+    }
+};
+
+struct PushStringCase {
+    HSQUIRRELVM vm;
+    string      value;
+    void operator()(size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            PushVar(vm, value);
+            sq_poptop(vm);
+        }
+    }
+};
+
+struct GetStringCase {
+    HSQUIRRELVM vm;
+    void operator()(size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            Var<string> s(vm, -1);
+            g_sink = g_sink + s.value.size();
+        }
+    }
+};
+
+struct VMOpenCloseCase {
+    void operator()(size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            sq_close(Bench::OpenVM());
+        }
+    }
+};
+
+struct ClassBindingCase {
+    void operator()(size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            HSQUIRRELVM vm = Bench::OpenVM();
+            BindTarget(vm);
+            sq_close(vm);
+        }
+    }
+};
+
+void ScriptCases(Bench::Runner& runner, HSQUIRRELVM vm) {
+    runner.AddBaseline("loop_baseline");
+    ScriptCase(runner, vm, "loop_baseline", "", "");
+    ScriptCase(runner, vm, "script_call_0", "local f = function() {}", "f();");
+
+    for (int k = 0; k <= MAX_ARITY; ++k) {
+        ScriptCase(runner, vm, "global_call_" + Number(k), "", "G" + Number(k) + "(" + Arguments(k) + ");");
+    }
+    for (int k = 0; k <= MAX_ARITY; ++k) {
+        ScriptCase(runner, vm, "member_call_" + Number(k), "local t = Target();", "t.M" + Number(k) + "(" + Arguments(k) + ");");
+    }
+
+    ScriptCase(runner, vm, "overload_call_0", "local t = Target();", "t.Echo();");
+    ScriptCase(runner, vm, "overload_call_1", "local t = Target();", "t.Echo(1);");
+    ScriptCase(runner, vm, "var_get", "local t = Target(); local v;", "v = t.value;");
+    ScriptCase(runner, vm, "var_set", "local t = Target();", "t.value = i;");
+    ScriptCase(runner, vm, "prop_get", "local t = Target(); local v;", "v = t.prop;");
+    ScriptCase(runner, vm, "prop_set", "local t = Target();", "t.prop = i;");
+
+    ScriptCase(runner, vm, "string_arg", "local s = \"a string passed to C++\";", "StringLength(s);");
+    ScriptCase(runner, vm, "string_return", "", "Greeting();");
+    ScriptCase(runner, vm, "vector_value_arg_return", "local a = Vec3(); local b = Vec3();", "AddVec(a, b);");
+    ScriptCase(runner, vm, "vector_array_to_cpp_64",
+               "local a = array(64); foreach (idx, v in a) a[idx] = idx;", "SumArray(a);");
+    ScriptCase(runner, vm, "vector_array_from_cpp_64", "", "MakeArray(64);");
+
+    ScriptCase(runner, vm, "instance_create_destroy", "", "Target();");
+}
+
+void NativeCases(Bench::Runner& runner, HSQUIRRELVM vm) {
+    Bench::RunScript(vm, "function noop() {}\n"
+                         "function zero() { return 0; }\n"
+                         "function add3(a, b, c) { return a + b + c; }\n"
+                         "function text() { return \"a string returned to C++\"; }\n", "functions");
+
+    ExecuteCase execute0 = { RootTable(vm).GetFunction(_SC("noop")), 0 };
+    runner.Run("function_execute_0", execute0);
+    ExecuteCase execute3 = { RootTable(vm).GetFunction(_SC("add3")), 3 };
+    runner.Run("function_execute_3", execute3);
+    EvaluateCase evaluate0 = { RootTable(vm).GetFunction(_SC("zero")), 0 };
+    runner.Run("function_evaluate_0", evaluate0);
+    EvaluateCase evaluate3 = { RootTable(vm).GetFunction(_SC("add3")), 3 };
+    runner.Run("function_evaluate_3", evaluate3);
+    EvaluateStringCase evaluateString = { RootTable(vm).GetFunction(_SC("text")) };
+    runner.Run("function_evaluate_string", evaluateString);
+
+    Target target;
+    PushInstanceCase pushInstance = { vm, &target };
+    runner.Run("push_instance", pushInstance);
+    ClassType<Target>::PushInstance(vm, &target);
+    GetInstanceCase getInstance = { vm };
+    runner.Run("get_instance", getInstance);
+    sq_poptop(vm);
+
+    PushStringCase pushString = { vm, _SC("a string pushed from C++") };
+    runner.Run("string_push", pushString);
+    sq_pushstring(vm, _SC("a string read by C++"), -1);
+    GetStringCase getString = { vm };
+    runner.Run("string_get", getString);
+    sq_poptop(vm);
+
+    runner.AddBaseline("vm_open_close");
+    VMOpenCloseCase openClose;
+    runner.Run("vm_open_close", openClose);
+    ClassBindingCase classBinding;
+    runner.Run("class_binding", classBinding, "vm_open_close");
+}
+
+void ImportCases(Bench::Runner& runner, HSQUIRRELVM vm) {
+    sqrat_register_importlib(vm);
+    // the test scripts are linked into the build directory next to the programs
+    if (!Bench::RunScript(vm, "::import(\"scripts/samplemodule\", {});", "import_check")) {
+        fprintf(stderr, "scripts/samplemodule.nut not found: skipping the import cases\n");
+        return;
+    }
+    ScriptCase(runner, vm, "import_cached", "", "::import(\"scripts/samplemodule\", {});");
+    ScriptCase(runner, vm, "import_reload", "", "::import_reload(\"scripts/samplemodule\", {});");
+}
+
+}
+
+int main(int argc, char** argv) {
+    Bench::Runner runner("sqratbench", argc, argv);
+    if (!runner.IsValid()) {
+        return runner.Finish();
+    }
+
+    HSQUIRRELVM vm = Bench::OpenVM();
+    DefaultVM::Set(vm);
+    BindAll(vm);
+    ScriptCases(runner, vm);
+    NativeCases(runner, vm);
+    ImportCases(runner, vm);
+    sq_close(vm);
+
+    return runner.Finish();
+}
@@ -0,0 +1,486 @@
+//
+// Scenarios: End-to-end workloads modelled on the ways Sqrat is embedded
+//
+
+//
+// Copyright (c) 2009 Brandon Jones
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software. If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+//
+// Unlike Microbench, each scenario mixes many paths the way a host does, so it also pays for garbage, identity map
+// growth and cache misses. A scenario times a number of samples (a frame, a published event, a cold start...) and
+// reports their throughput, latency percentiles and the peak resident memory of the process once it is done. The peak
+// only grows, so run one scenario per process (--scenario <name>) to compare memory.
+//
+// Command line options:
+//   --json              report as one JSON document instead of a table
+//   --scenario <name>   only run the named scenario
+//   --scale <factor>    multiply the size of every scenario (default 1)
+//
+
+#include <sqrat.h>
+#include <sqratimport.h>
+#include "sqratThread.h"
+#include "Bench.h"
+
+using namespace Sqrat;
+
+namespace {
+
+struct Options {
+    Options() : json(false), scale(1.0) {
+    }
+    bool        json;
+    double      scale;
+    std::string scenario;
+};
+
+struct Report {
+    std::string         name;
+    std::string         unit;           // what one sample is
+    size_t              operations;     // work items done in all samples
+    double              seconds;        // total time of all samples
+    std::vector<double> samples;        // latency of each sample in ns
+    unsigned long       peakMemoryKB;
+};
+
+size_t Scaled(const Options& options, size_t count) {
+    return std::max(static_cast<size_t>(1), static_cast<size_t>(static_cast<double>(count) * options.scale));
+}
+
+void Print(const Options& options, Report& report, bool first) {
+    std::sort(report.samples.begin(), report.samples.end());
+    double throughput = report.seconds > 0 ? static_cast<double>(report.operations) / report.seconds : 0;
+    double p50 = Bench::Percentile(report.samples, 50) / 1e3;
+    double p90 = Bench::Percentile(report.samples, 90) / 1e3;
+    double p99 = Bench::Percentile(report.samples, 99) / 1e3;
+    double max = report.samples.empty() ? 0 : report.samples.back() / 1e3;
+    if (options.json) {
+        printf("%s\n  {\"name\": ", first ? "" : ",");
+        Bench::PrintJsonString(stdout, report.name);
+        printf(", \"sample\": ");
+        Bench::PrintJsonString(stdout, report.unit);
+        printf(", \"samples\": %lu, \"operations\": %lu, \"seconds\": %.4f, \"ops_per_second\": %.1f, "
+               "\"p50_us\": %.2f, \"p90_us\": %.2f, \"p99_us\": %.2f, \"max_us\": %.2f, \"peak_rss_kb\": %lu}",
+               static_cast<unsigned long>(report.samples.size()), static_cast<unsigned long>(report.operations),
+               report.seconds, throughput, p50, p90, p99, max, report.peakMemoryKB);
+    } else {
+        printf("%-20s %-12s %10lu %14.0f %10.1f %10.1f %10.1f %10.1f %12lu\n", report.name.c_str(), report.unit.c_str(),
+               static_cast<unsigned long>(report.samples.size()), throughput, p50, p90, p99, max, report.peakMemoryKB);
+    }
+    fflush(stdout);
+}
+
+// Times one sample and records it in the report
+class Sample {
+public:
+    Sample(Report& report) : m_report(report), m_start(Bench::NowNs()) {
+    }
+    ~Sample() {
+        double elapsed = Bench::NowNs() - m_start;
+        m_report.samples.push_back(elapsed);
+        m_report.seconds += elapsed / 1e9;
+    }
+private:
+    Sample(const Sample&);
+    Sample& operator=(const Sample&);
+
+    Report& m_report;
+    double  m_start;
+};
+
+//
+// Entity update loop: a script updates every bound entity each frame through Var and Prop accessors
+//
+
+class Entity {
+public:
+    Entity() : x(0), y(0), vx(1), vy(-1), m_health(50) {
+    }
+
+    int GetHealth() const {
+        return m_health;
+    }
+    void SetHealth(const int& health) {
+        m_health = health;
+    }
+
+    float x, y, vx, vy;
+
+private:
+    int m_health;
+};
+
+void BindEntity(HSQUIRRELVM vm) {
+    Class<Entity> entity(vm, _SC("Entity"));
+    entity.Var(_SC("x"), &Entity::x);
+    entity.Var(_SC("y"), &Entity::y);
+    entity.Var(_SC("vx"), &Entity::vx);
+    entity.Var(_SC("vy"), &Entity::vy);
+    entity.Prop(_SC("health"), &Entity::GetHealth, &Entity::SetHealth);
+    RootTable(vm).Bind(_SC("Entity"), entity);
+}
+
+bool EntityUpdate(const Options& options, Report& report) {
+    size_t count = Scaled(options, 100000);
+    size_t frames = 20;
+    report.unit = "frame";
+
+    HSQUIRRELVM vm = Bench::OpenVM();
+    DefaultVM::Set(vm);
+    BindEntity(vm);
+    bool ok = Bench::RunScript(vm,
+        "function update(entities, dt) {\n"
+        "    foreach (e in entities) {\n"
+        "        local step = { x = e.vx * dt, y = e.vy * dt };\n"   // short-lived garbage, as in real frame code
+        "        e.x += step.x;\n"
+        "        e.y += step.y;\n"
+        "        if (e.health < 100) e.health += 1;\n"
+        "    }\n"
+        "}\n", "entity_update");
+
+    if (ok) {
+        std::vector<Entity> entities(count);
+        Array list(vm, static_cast<SQInteger>(count));
+        for (size_t i = 0; i < count; ++i) {
+            list.SetInstance(static_cast<SQInteger>(i), &entities[i]);
+        }
+        Function update = RootTable(vm).GetFunction(_SC("update"));
+        for (size_t frame = 0; frame < frames; ++frame) {
+            Sample sample(report);
+            update.Execute(list, 0.016f);
+        }
+        report.operations = count * frames;
+    }
+    sq_close(vm);
+    return ok;
+}
+
+//
+// Event bus: C++ publishes events that fan out to script callbacks
+//
+
+class EventBus {
+public:
+    void Subscribe(Function callback) {
+        m_subscribers.push_back(callback);
+    }
+
+    void Publish(const string& name, int value) {
+        for (size_t i = 0; i < m_subscribers.size(); ++i) {
+            m_subscribers[i].Execute(name, value);
+        }
+    }
+
+    size_t GetSubscriberCount() const {
+        return m_subscribers.size();
+    }
+
+    void Clear() {
+        m_subscribers.clear();
+    }
+
+private:
+    std::vector<Function> m_subscribers;
+};
+
+bool EventFanOut(const Options& options, Report& report) {
+    size_t events = Scaled(options, 50000);
+    report.unit = "publish";
+
+    HSQUIRRELVM vm = Bench::OpenVM();
+    DefaultVM::Set(vm);
+    EventBus bus;
+    RootTable(vm).Bind(_SC("EventBus"), Class<EventBus>(vm, _SC("EventBus"))
+        .Func(_SC("Subscribe"), &EventBus::Subscribe)
+        .Func(_SC("GetSubscriberCount"), &EventBus::GetSubscriberCount));
+    RootTable(vm).SetInstance(_SC("bus"), &bus);
+    bool ok = Bench::RunScript(vm,
+        "counts <- {};\n"
+        "for (local i = 0; i < 16; ++i) {\n"
+        "    local weight = i;\n"
+        "    bus.Subscribe(function(name, value) {\n"
+        "        if (name in ::counts) ::counts[name] += value * weight;\n"
+        "        else ::counts[name] <- value * weight;\n"
+        "    });\n"
+        "}\n", "event_fan_out");
+
+    if (ok) {
+        const string names[] = { _SC("moved"), _SC("damaged"), _SC("spawned"), _SC("despawned") };
+        for (size_t i = 0; i < events; ++i) {
+            Sample sample(report);
+            bus.Publish(names[i % 4], static_cast<int>(i));
+        }
+        report.operations = events * bus.GetSubscriberCount();
+    }
+    bus.Clear();
+    sq_close(vm);
+    return ok;
+}
+
+//
+// Rules engine: compiled expressions evaluated against every fact
+//
+
+bool RulesEngine(const Options& options, Report& report) {
+    size_t facts = Scaled(options, 10000);
+    const char* expressions[] = {
+        "fact.temperature > %d",
+        "fact.humidity < %d && fact.temperature > 10",
+        "fact.zone == \"zone%d\"",
+        "(fact.temperature - fact.humidity) * 2 > %d",
+        "fact.alarms.len() > %d || fact.zone == \"zone0\"",
+    };
+    const size_t expressionCount = sizeof(expressions) / sizeof(expressions[0]);
+    const size_t ruleCount = 200;
+    report.unit = "fact";
+
+    HSQUIRRELVM vm = Bench::OpenVM();
+    DefaultVM::Set(vm);
+    bool ok = true;
+    {
+        // rules share their text often, so most of them come out of the closure cache
+        ClosureCache cache(vm, 64);
+        std::vector<Function> rules;
+        for (size_t i = 0; i < ruleCount && ok; ++i) {
+            char expression[128];
+            sprintf(expression, expressions[i % expressionCount], static_cast<int>(i % 40));
+            string source = Bench::ToSq(std::string("return function(fact) { return ") + expression + "; }");
+            if (SQ_FAILED(cache.Compile(source, _SC("rule")))) {
+                ok = false;
+                break;
+            }
+            sq_pushroottable(vm);
+            if (SQ_FAILED(sq_call(vm, 1, SQTrue, SQTrue))) {
+                ok = false;
+                sq_poptop(vm);
+                break;
+            }
+            rules.push_back(Var<Function>(vm, -1).value);
+            sq_pop(vm, 2);
+        }
+
+        std::vector<Table> records;
+        for (size_t i = 0; i < facts && ok; ++i) {
+            Table fact(vm);
+            fact.SetValue(_SC("temperature"), static_cast<int>(i % 50));
+            fact.SetValue(_SC("humidity"), static_cast<int>((i * 7) % 100));
+            fact.SetValue(_SC("zone"), Bench::ToSq("zone" + std::string(1, static_cast<char>('0' + i % 10))));
+            fact.SetValue(_SC("alarms"), Array(vm, static_cast<SQInteger>(i % 4)));
+            records.push_back(fact);
+        }
+
+        size_t matches = 0;
+        for (size_t i = 0; i < records.size() && ok; ++i) {
+            Sample sample(report);
+            for (size_t r = 0; r < rules.size(); ++r) {
+                if (*rules[r].Evaluate<bool>(records[i])) {
+                    ++matches;
+                }
+            }
+        }
+        report.operations = records.size() * rules.size();
+        if (!options.json) {
+            fprintf(stderr, "rules_engine: %lu matches, closure cache %lu hits / %lu misses\n",
+                    static_cast<unsigned long>(matches), static_cast<unsigned long>(cache.GetHits()),
+                    static_cast<unsigned long>(cache.GetMisses()));
+        }
+    }
+    sq_close(vm);
+    return ok;
+}
+
+//
+// Coroutine tasks: many sqratthread tasks that suspend on every step, driven by the host loop
+//
+
+bool CoroutineTasks(const Options& options, Report& report) {
+    size_t tasks = Scaled(options, 2000);
+    size_t steps = 50;
+    report.unit = "quantum";
+
+    HSQUIRRELVM vm = Bench::OpenVM();
+    DefaultVM::Set(vm);
+    sqrat_register_importlib(vm);
+    char script[512];
+    sprintf(script,
+        "::import(\"sqratthread\");\n"
+        "done <- 0;\n"
+        "function worker(id, steps) {\n"
+        "    local acc = 0;\n"
+        "    for (local i = 0; i < steps; ++i) {\n"
+        "        acc += i * id;\n"
+        "        ::suspend();\n"
+        "    }\n"
+        "    ::done += 1;\n"
+        "}\n"
+        "for (local t = 0; t < %lu; ++t) ::schedule(worker)(t, %lu);\n",
+        static_cast<unsigned long>(tasks), static_cast<unsigned long>(steps));
+    bool ok = Bench::RunScript(vm, script, "coroutine_tasks");
+
+    if (ok) {
+        SQInteger pending = 1;
+        while (pending > 0) {
+            Sample sample(report);
+            pending = sqratthread_step(vm);
+        }
+        report.operations = tasks * (steps + 1);
+    }
+    sq_close(vm);
+    return ok;
+}
+
+//
+// Import-heavy cold start: a fresh VM binds its classes and imports a chain of modules
+//
+
+const int MODULE_COUNT = 30;
+
+std::string ModuleName(int i) {
+    char name[64];
+    sprintf(name, "sqratscenarios_module%d", i);
+    return name;
+}
+
+bool WriteModules() {
+    for (int i = 0; i < MODULE_COUNT; ++i) {
+        FILE* file = fopen((ModuleName(i) + ".nut").c_str(), "wb");
+        if (file == NULL) {
+            return false;
+        }
+        if (i > 0) {
+            fprintf(file, "::import(\"%s\");\n", ModuleName(i - 1).c_str());
+        }
+        fprintf(file, "module%d <- {\n", i);
+        for (int f = 0; f < 10; ++f) {
+            fprintf(file, "    function f%d(x) { return x * %d + %d; }\n", f, f, i);
+        }
+        fprintf(file, "}\n");
+        fprintf(file, "class Thing%d {\n    value = 0;\n    constructor() { value = %d; }\n"
+                      "    function Get() { return value; }\n}\n", i, i);
+        fprintf(file, "local e = Entity();\ne.x = %d;\n", i);
+        fclose(file);
+    }
+    return true;
+}
+
+void RemoveModules() {
+    for (int i = 0; i < MODULE_COUNT; ++i) {
+        remove((ModuleName(i) + ".nut").c_str());
+    }
+}
+
+bool ColdStart(const Options& options, Report& report) {
+    size_t starts = Scaled(options, 200);
+    report.unit = "start";
+
+    if (!WriteModules()) {
+        fprintf(stderr, "cold_start: cannot write the modules to the working directory\n");
+        RemoveModules();
+        return false;
+    }
+    std::string script = "::import(\"" + ModuleName(MODULE_COUNT - 1) + "\");";
+    bool ok = true;
+    for (size_t i = 0; i < starts && ok; ++i) {
+        Sample sample(report);
+        HSQUIRRELVM vm = Bench::OpenVM();
+        DefaultVM::Set(vm);
+        BindEntity(vm);
+        sqrat_register_importlib(vm);
+        ok = Bench::RunScript(vm, script, "cold_start");
+        sq_close(vm);
+    }
+    report.operations = starts;
+    RemoveModules();
+    return ok;
+}
+
+typedef bool (*ScenarioFunc)(const Options& options, Report& report);
+
+struct Scenario {
+    const char*  name;
+    ScenarioFunc run;
+};
+
+const Scenario SCENARIOS[] = {
+    { "entity_update",   &EntityUpdate },
+    { "event_fan_out",   &EventFanOut },
+    { "rules_engine",    &RulesEngine },
+    { "coroutine_tasks", &CoroutineTasks },
+    { "cold_start",      &ColdStart },
+};
+
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--json") {
+            options.json = true;
+        } else if (arg == "--scenario" && hasValue) {
+            options.scenario = argv[++i];
+        } else if (arg == "--scale" && hasValue) {
+            options.scale = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--json] [--scenario <name>] [--scale <factor>]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    sqrat_register_staticapimodule(_SC("sqratthread"), &sqmodule_load);
+
+    if (options.json) {
+        printf("{\"program\": \"sqratscenarios\", \"mode\": \"%s\", \"squirrel\": %d, \"scale\": %.3f, \"results\": [",
+               Bench::ErrorMode(), SQUIRREL_VERSION_NUMBER, options.scale);
+    } else {
+        printf("sqratscenarios (%s errors, scale %.3f)\n", Bench::ErrorMode(), options.scale);
+        printf("%-20s %-12s %10s %14s %10s %10s %10s %10s %12s\n", "scenario", "sample", "samples", "ops/s",
+               "p50 us", "p90 us", "p99 us", "max us", "peak rss kB");
+    }
+
+    int failures = 0;
+    bool first = true;
+    for (size_t i = 0; i < sizeof(SCENARIOS) / sizeof(SCENARIOS[0]); ++i) {
+        if (!options.scenario.empty() && options.scenario != SCENARIOS[i].name) {
+            continue;
+        }
+        Report report;
+        report.name = SCENARIOS[i].name;
+        report.operations = 0;
+        report.seconds = 0;
+        if (!SCENARIOS[i].run(options, report)) {
+            fprintf(stderr, "%s failed\n", SCENARIOS[i].name);
+            ++failures;
+            continue;
+        }
+        report.peakMemoryKB = Bench::PeakMemoryKB();
+        Print(options, report, first);
+        first = false;
+    }
+
+    if (options.json) {
+        printf("\n]}\n");
+    }
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,251 @@
+//
+// Copyright (c) 2009 Brandon Jones
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software. If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+#include <gtest/gtest.h>
+#include <sqrat.h>
+#include <sqrat/sqratChannel.h>
+#include <sqrat/sqratVM.h>
+#include <thread>
+#include "Fixture.h"
+
+using namespace Sqrat;
+
+TEST_F(SqratTest, ChannelThreads)
+{
+    Channel channel(8);
+    EXPECT_EQ(8u, channel.Capacity());
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < 4; ++p) {
+        producers.push_back(std::thread([channel]() mutable {
+            for (int i = 1; i <= 1000; ++i) {
+                MarshalledValue value(i);
+                channel.Send(value);
+            }
+        }));
+    }
+    long long totals[2] = {0, 0};
+    std::vector<std::thread> consumers;
+    for (int c = 0; c < 2; ++c) {
+        long long* total = &totals[c];
+        consumers.push_back(std::thread([channel, total]() mutable {
+            MarshalledValue value;
+            while (channel.Recv(value)) {
+                *total += value.GetInteger();
+            }
+        }));
+    }
+    for (size_t i = 0; i < producers.size(); ++i) {
+        producers[i].join();
+    }
+    channel.Close();
+    for (size_t i = 0; i < consumers.size(); ++i) {
+        consumers[i].join();
+    }
+    EXPECT_EQ(4 * 500500LL, totals[0] + totals[1]);
+
+    MarshalledValue value(1);
+    EXPECT_FALSE(channel.TrySend(value));
+    EXPECT_FALSE(channel.Send(value));
+}
+
+TEST_F(SqratTest, ChannelScript)
+{
+    DefaultVM::Set(vm);
+    RegisterChannelLib(vm);
+
+    Script script;
+    script.CompileString(_SC(" \
+        local c = newchannel(4); \
+        gTest.EXPECT_INT_EQ(4, c.capacity()); \
+        c.send(1); \
+        c.send(\"two\"); \
+        c.send([1, 2, { a = 3 }]); \
+        local b = newbuffer(Buffer.FLOAT64, 3); \
+        b.set(1, 2.5); \
+        c.send(b); \
+        gTest.EXPECT_INT_EQ(0, b.len()); \
+        gTest.EXPECT_INT_EQ(4, c.len()); \
+        gTest.EXPECT_FALSE(c.trysend(5)); \
+        \
+        gTest.EXPECT_INT_EQ(1, c.recv()); \
+        gTest.EXPECT_STR_EQ(\"two\", c.recv()); \
+        local a = c.recv(); \
+        gTest.EXPECT_INT_EQ(3, a.len()); \
+        gTest.EXPECT_INT_EQ(3, a[2].a); \
+        local r = c.recv(); \
+        gTest.EXPECT_INT_EQ(3, r.len()); \
+        gTest.EXPECT_FLOAT_EQ(2.5, r.get(1)); \
+        gTest.EXPECT_TRUE(c.tryrecv() == null); \
+        \
+        c.send(6); \
+        c.close(); \
+        gTest.EXPECT_TRUE(c.isclosed()); \
+        gTest.EXPECT_INT_EQ(6, c.recv()); \
+        gTest.EXPECT_TRUE(c.recv() == null); \
+        \
+        local kept = newbuffer(Buffer.FLOAT64, 3); \
+        local failed = false; \
+        try { c.send(kept); } catch (e) { failed = true; } \
+        gTest.EXPECT_TRUE(failed); \
+        gTest.EXPECT_INT_EQ(3, kept.len()); \
+        "));
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Compile Failed: ") << Sqrat::Error::Message(vm);
+    }
+
+    script.Run();
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Run Failed: ") << Sqrat::Error::Message(vm);
+    }
+}
+
+TEST_F(SqratTest, ChannelKeepsExactCapacity)
+{
+    Channel single(1);
+    EXPECT_EQ(1u, single.Capacity());
+    MarshalledValue first(1), second(2);
+    EXPECT_TRUE(single.TrySend(first));
+    EXPECT_FALSE(single.TrySend(second));
+    MarshalledValue value;
+    EXPECT_TRUE(single.TryRecv(value));
+    EXPECT_TRUE(single.TrySend(second));
+
+    Channel three(3);
+    EXPECT_EQ(3u, three.Capacity());
+    for (int i = 0; i < 3; ++i) {
+        MarshalledValue item(i);
+        EXPECT_TRUE(three.TrySend(item));
+    }
+    MarshalledValue extra(3);
+    EXPECT_FALSE(three.TrySend(extra));
+    EXPECT_EQ(3u, three.Size());
+}
+
+TEST_F(SqratTest, ChannelTrySendMovesBuffers)
+{
+    DefaultVM::Set(vm);
+    RegisterChannelLib(vm);
+
+    Script script;
+    script.CompileString(_SC(" \
+        local c = newchannel(1); \
+        local sent = newbuffer(Buffer.FLOAT64, 3); \
+        gTest.EXPECT_TRUE(c.trysend(sent)); \
+        gTest.EXPECT_INT_EQ(0, sent.len()); \
+        local kept = newbuffer(Buffer.FLOAT64, 3); \
+        gTest.EXPECT_FALSE(c.trysend(kept)); \
+        gTest.EXPECT_INT_EQ(3, kept.len()); \
+        gTest.EXPECT_INT_EQ(3, c.recv().len()); \
+        "));
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Compile Failed: ") << Sqrat::Error::Message(vm);
+    }
+
+    script.Run();
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Run Failed: ") << Sqrat::Error::Message(vm);
+    }
+
+    // A container that cannot be marshalled keeps the Buffers in it, even those before the offending value
+    Script mixed;
+    mixed.CompileString(_SC("values <- [newbuffer(Buffer.FLOAT64, 3), function() {}];"));
+    mixed.Run();
+    ASSERT_FALSE(Sqrat::Error::Occurred(vm));
+    Array values = RootTable(vm).GetSlot(_SC("values"));
+    sq_pushobject(vm, values.GetObject());
+    MarshalledValue message;
+    string errMsg;
+    EXPECT_FALSE(MarshalledValue::FromStack(vm, -1, message, errMsg, MarshalledValue::MARSHAL_MOVE));
+    sq_pop(vm, 1);
+    EXPECT_EQ(3u, values.GetValue<Buffer>(0)->Length());
+}
+
+TEST_F(SqratTest, ChannelSuspendsCoroutine)
+{
+    DefaultVM::Set(vm);
+    RegisterChannelLib(vm);
+
+    Channel channel(2);
+    RootTable(vm).SetValue(_SC("ch"), channel);
+
+    Script script;
+    script.CompileString(_SC(" \
+        received <- null; \
+        worker <- newthread(function() { ::received = ch.recv(); }); \
+        worker.call(); \
+        "));
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Compile Failed: ") << Sqrat::Error::Message(vm);
+    }
+    script.Run();
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Run Failed: ") << Sqrat::Error::Message(vm);
+    }
+
+    // the coroutine is parked instead of blocking the test
+    AsyncQueue* queue = AsyncQueue::Get(vm);
+    EXPECT_EQ(1u, queue->GetParkedCount());
+    EXPECT_EQ(0u, queue->Drain());
+
+    std::thread sender([channel]() mutable {
+        MarshalledValue value(42);
+        channel.Send(value);
+    });
+    sender.join();
+
+    EXPECT_TRUE(queue->Wait(std::chrono::seconds(5)));
+    EXPECT_EQ(1u, queue->Drain());
+    EXPECT_EQ(0u, queue->GetParkedCount());
+    EXPECT_EQ(42, *RootTable(vm).GetValue<int>(_SC("received")));
+}
+
+TEST_F(SqratTest, ChannelBetweenVMs)
+{
+    Channel channel(4);
+    SqratVM producer, consumer;
+    RegisterChannelLib(producer.GetVM());
+    RegisterChannelLib(consumer.GetVM());
+    producer.GetRootTable().SetValue(_SC("out"), channel);
+    consumer.GetRootTable().SetValue(_SC("inp"), channel);
+
+    SqratVM::ERROR_STATE producerState = SqratVM::SQRAT_NO_ERROR, consumerState = SqratVM::SQRAT_NO_ERROR;
+    std::thread producing([&producer, &producerState]() {
+        producerState = producer.DoString(_SC(" \
+            for (local i = 1; i <= 100; ++i) out.send({ n = i, sq = i * i }); \
+            out.close(); \
+            "));
+    });
+    std::thread consuming([&consumer, &consumerState]() {
+        consumerState = consumer.DoString(_SC(" \
+            total <- 0; \
+            for (local m = inp.recv(); m != null; m = inp.recv()) total += m.sq; \
+            "));
+    });
+    producing.join();
+    consuming.join();
+
+    EXPECT_EQ(SqratVM::SQRAT_NO_ERROR, producerState);
+    EXPECT_EQ(SqratVM::SQRAT_NO_ERROR, consumerState);
+    EXPECT_EQ(338350, *consumer.GetRootTable().GetValue<int>(_SC("total")));
+}
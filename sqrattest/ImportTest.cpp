@@ -23,7 +23,11 @@
 
 #include <gtest/gtest.h>
 #include <sqrat.h>
+#include <sqrat/sqratBundle.h>
 #include <sqratimport.h>
+#include <sqstdio.h>
+#include <stdio.h>
+#include <utime.h>
 #include "Fixture.h"
 
 using namespace Sqrat;
@@ -72,4 +76,219 @@ TEST_F(SqratTest, ImportScriptIntoTable) {
     if (Sqrat::Error::Occurred(vm)) {
         FAIL() << _SC("Run Failed: ") << Sqrat::Error::Message(vm);
     }
-}
\ No newline at end of file
+}
+
+TEST_F(SqratTest, ImportCachesModules) {
+    DefaultVM::Set(vm);
+
+    sqrat_register_importlib(vm);
+
+    Script script;
+    script.CompileString(_SC(" \
+        local a = ::import(\"scripts/countermodule\", {}); \
+        local b = ::import(\"scripts/countermodule.nut\", {}); \
+        ::import(\"scripts/countermodule\"); \
+        gTest.EXPECT_INT_EQ(1, ::importCount); \
+        gTest.EXPECT_INT_EQ(42, a.Value); \
+        gTest.EXPECT_INT_EQ(42, b.Value); \
+        gTest.EXPECT_INT_EQ(8, ::Twice(4)); \
+        \
+        local c = ::import_reload(\"scripts/countermodule\", {}); \
+        gTest.EXPECT_INT_EQ(2, ::importCount); \
+        gTest.EXPECT_INT_EQ(6, c.Twice(3)); \
+        ::import(\"scripts/countermodule\", {}); \
+        gTest.EXPECT_INT_EQ(2, ::importCount); \
+        \
+        ::import_invalidate(\"scripts/countermodule\"); \
+        ::import(\"scripts/countermodule\", {}); \
+        gTest.EXPECT_INT_EQ(3, ::importCount); \
+        ::import_invalidate(); \
+        ::import(\"scripts/countermodule\", {}); \
+        gTest.EXPECT_INT_EQ(4, ::importCount); \
+        \
+        local failed = null; \
+        try { ::import_reload(\"scripts/nosuchmodule\", {}); } catch (e) { failed = e; } \
+        gTest.EXPECT_STR_EQ(\"cannot load binary module\", failed); \
+        "));
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Compile Failed: ") << Sqrat::Error::Message(vm);
+    }
+
+    script.Run();
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Run Failed: ") << Sqrat::Error::Message(vm);
+    }
+}
+
+TEST_F(SqratTest, ImportLazy) {
+    DefaultVM::Set(vm);
+
+    sqrat_register_importlib(vm);
+
+    Script script;
+    script.CompileString(_SC(" \
+        local mod = ::import_lazy(\"scripts/countermodule\"); \
+        gTest.EXPECT_FALSE(\"importCount\" in getroottable()); \
+        gTest.EXPECT_INT_EQ(42, mod.Value); \
+        gTest.EXPECT_INT_EQ(1, ::importCount); \
+        gTest.EXPECT_INT_EQ(10, mod.Twice(5)); \
+        gTest.EXPECT_TRUE(mod.getdelegate() == null); \
+        \
+        ::import_lazy(\"scripts/samplemodule\", getroottable()); \
+        gTest.EXPECT_INT_EQ(10, ::RectArea(2, 5)); \
+        local failed = null; \
+        try { ::import_lazy(\"scripts/nosuchmodule\").x; } catch (e) { failed = e; } \
+        gTest.EXPECT_STR_EQ(\"cannot load binary module\", failed); \
+        "));
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Compile Failed: ") << Sqrat::Error::Message(vm);
+    }
+
+    script.Run();
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Run Failed: ") << Sqrat::Error::Message(vm);
+    }
+}
+
+static SQInteger Triple(HSQUIRRELVM v) {
+    SQInteger value;
+    sq_getinteger(v, 2, &value);
+    sq_pushinteger(v, value * 3);
+    return 1;
+}
+
+// Calls the Squirrel API directly
+static SQRESULT LoadDirect(HSQUIRRELVM v) {
+    sq_pushstring(v, _SC("Triple"), -1);
+    sq_newclosure(v, &Triple, 0);
+    sq_newslot(v, -3, SQFalse);
+    return SQ_OK;
+}
+
+// Written like a binary module's sqmodule_load
+static SQRESULT LoadThroughApi(HSQUIRRELVM v, HSQAPI api) {
+    api->pushstring(v, _SC("Answer"), -1);
+    api->pushinteger(v, 42);
+    api->newslot(v, -3, SQFalse);
+    return SQ_OK;
+}
+
+SQRAT_STATIC_MODULE(_SC("builtin/direct"), &LoadDirect);
+SQRAT_STATIC_MODULE(_SC("builtin/api"), &LoadThroughApi);
+
+TEST_F(SqratTest, ImportStaticModules) {
+    DefaultVM::Set(vm);
+
+    sqrat_register_importlib(vm);
+
+    Script script;
+    script.CompileString(_SC(" \
+        gTest.EXPECT_INT_EQ(9, ::import(\"builtin/direct\", {}).Triple(3)); \
+        gTest.EXPECT_INT_EQ(42, ::import(\"builtin/api\", {}).Answer); \
+        ::import(\"builtin/direct\"); \
+        gTest.EXPECT_INT_EQ(12, ::Triple(4)); \
+        "));
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Compile Failed: ") << Sqrat::Error::Message(vm);
+    }
+
+    script.Run();
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Run Failed: ") << Sqrat::Error::Message(vm);
+    }
+}
+
+static void WriteFile(const char* path, const char* text) {
+    FILE* file = fopen(path, "w");
+    ASSERT_TRUE(file != NULL);
+    fputs(text, file);
+    fclose(file);
+}
+
+TEST_F(SqratTest, ImportSearchPaths) {
+    DefaultVM::Set(vm);
+
+    sqrat_register_importlib(vm);
+
+    // pick.cnut is compiled from a different source than pick.nut, to tell which one got loaded
+    WriteFile("scripts/pick.nut", "Source <- \"nut\";");
+    ASSERT_TRUE(SQ_SUCCEEDED(sq_compilebuffer(vm, _SC("Source <- \"cnut\";"), 17, _SC("pick"), SQTrue)));
+    ASSERT_TRUE(SQ_SUCCEEDED(sqstd_writeclosuretofile(vm, _SC("scripts/pick.cnut"))));
+    sq_pop(vm, 1);
+
+    Script script;
+    script.CompileString(_SC(" \
+        ::import_addpath(\"scripts\"); \
+        gTest.EXPECT_INT_EQ(42, ::import(\"countermodule\", {}).Value); \
+        gTest.EXPECT_FLOAT_EQ(3.1415, ::import(\"samplemodule.nut\", {}).PI); \
+        gTest.EXPECT_STR_EQ(\"cnut\", ::import(\"pick\", {}).Source); \
+        "));
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Compile Failed: ") << Sqrat::Error::Message(vm);
+    }
+    script.Run();
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Run Failed: ") << Sqrat::Error::Message(vm);
+    }
+
+    // once the bytecode is older than its source the source wins (after the cached resolution is dropped)
+    struct utimbuf old;
+    old.actime = old.modtime = 1000000000;
+    utime("scripts/pick.cnut", &old);
+    sqrat_import_invalidate(vm, _SC("pick"));
+
+    Script reload;
+    reload.CompileString(_SC(" \
+        gTest.EXPECT_STR_EQ(\"nut\", ::import(\"pick\", {}).Source); \
+        ::import_clearpaths(); \
+        local failed = ::import(\"countermodule\", {}); \
+        gTest.EXPECT_FALSE(\"Value\" in failed); \
+        "));
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Compile Failed: ") << Sqrat::Error::Message(vm);
+    }
+    reload.Run();
+    remove("scripts/pick.nut");
+    remove("scripts/pick.cnut");
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Run Failed: ") << Sqrat::Error::Message(vm);
+    }
+}
+
+TEST_F(SqratTest, ImportBundles) {
+    DefaultVM::Set(vm);
+
+    sqrat_register_importlib(vm);
+
+    // the bundle outlives the script it was built from
+    WriteFile("scripts/bundled.nut", "Source <- \"bundle\";");
+    const SQChar* files[] = { _SC("scripts/bundled.nut"), _SC("scripts/countermodule.nut") };
+    ASSERT_TRUE(SQ_SUCCEEDED(sqrat_bundle_build(vm, _SC("scripts/test.sqb"), files, 2)));
+    remove("scripts/bundled.nut");
+
+    Bundle bundle("scripts/test.sqb");
+    ASSERT_TRUE(bundle.IsOpen());
+    ASSERT_EQ(2u, bundle.GetCount());
+    EXPECT_EQ("scripts/bundled", bundle.GetName(0));
+    EXPECT_EQ("scripts/countermodule", bundle.GetName(1));
+    Script direct;
+    ASSERT_TRUE(direct.LoadBytecode(bundle, "scripts/countermodule"));
+    EXPECT_FALSE(direct.LoadBytecode(bundle, "scripts/missing"));
+
+    ASSERT_TRUE(SQ_SUCCEEDED(sqrat_import_addbundle(vm, _SC("scripts/test.sqb"))));
+    EXPECT_TRUE(SQ_FAILED(sqrat_import_addbundle(vm, _SC("scripts/missing.sqb"))));
+    Script script;
+    script.CompileString(_SC(" \
+        gTest.EXPECT_STR_EQ(\"bundle\", ::import(\"scripts/bundled\", {}).Source); \
+        gTest.EXPECT_STR_EQ(\"bundle\", ::import(\"scripts/bundled.nut\", {}).Source); \
+        gTest.EXPECT_INT_EQ(42, ::import(\"scripts/countermodule\", {}).Value); \
+        "));
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Compile Failed: ") << Sqrat::Error::Message(vm);
+    }
+    script.Run();
+    remove("scripts/test.sqb");
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Run Failed: ") << Sqrat::Error::Message(vm);
+    }
+}
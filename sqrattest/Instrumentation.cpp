@@ -0,0 +1,119 @@
+//
+// Copyright (c) 2009 Brandon Jones
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software. If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+#define SCRAT_ENABLE_INSTRUMENTATION
+
+#include <gtest/gtest.h>
+#include <sqrat.h>
+#include "Fixture.h"
+
+using namespace Sqrat;
+
+class Meter {
+public:
+    Meter() : total(0) {
+    }
+
+    void Add(int amount) {
+        total += amount;
+    }
+
+    int total;
+};
+
+static int Twice(int x) {
+    return x * 2;
+}
+
+static const BindingCounters* FindCounters(const std::vector<BindingCounters>& counters, const string& name) {
+    for (size_t i = 0; i < counters.size(); ++i) {
+        if (counters[i].name == name) {
+            return &counters[i];
+        }
+    }
+    return NULL;
+}
+
+TEST_F(SqratTest, InstrumentationCountsCalls) {
+    DefaultVM::Set(vm);
+    EXPECT_TRUE(Instrumentation::IsEnabled());
+
+    RootTable().Bind(_SC("Meter"),
+                     Class<Meter>(vm, _SC("Meter"))
+                     .Func(_SC("Add"), &Meter::Add)
+                     .Var(_SC("total"), &Meter::total)
+                    );
+    RootTable().Func(_SC("Twice"), &Twice);
+    Instrumentation::Register(vm);
+
+    Script script;
+    script.CompileString(_SC(" \
+        local m = Meter(); \
+        for (local i = 0; i < 10; ++i) { \
+            m.Add(i); \
+        } \
+        gTest.EXPECT_INT_EQ(45, m.total); \
+        gTest.EXPECT_INT_EQ(6, Twice(3)); \
+        local failed = false; \
+        try { Twice(\"three\"); } catch (e) { failed = true; } \
+        gTest.EXPECT_TRUE(failed); \
+        \
+        local found = false; \
+        foreach (entry in instrumentation_snapshot()) { \
+            if (entry.name == \"Meter.Add\") { \
+                found = true; \
+                gTest.EXPECT_INT_EQ(10, entry.calls); \
+                gTest.EXPECT_TRUE(entry.marshal_ns >= 0); \
+            } \
+        } \
+        gTest.EXPECT_TRUE(found); \
+        "));
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Compile Failed: ") << Sqrat::Error::Message(vm);
+    }
+
+    script.Run();
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Run Failed: ") << Sqrat::Error::Message(vm);
+    }
+
+    std::vector<BindingCounters> counters = Instrumentation::Snapshot(vm);
+    const BindingCounters* add = FindCounters(counters, _SC("Meter.Add"));
+    ASSERT_TRUE(add != NULL);
+    EXPECT_EQ(10u, add->calls);
+    EXPECT_EQ(0u, add->errors);
+    EXPECT_LE(add->calleeNs, add->totalNs);
+    EXPECT_LE(add->maxNs, add->totalNs);
+
+    const BindingCounters* twice = FindCounters(counters, _SC("Twice"));
+    ASSERT_TRUE(twice != NULL);
+    EXPECT_EQ(2u, twice->calls);
+    EXPECT_EQ(1u, twice->errors);
+
+    const BindingCounters* total = FindCounters(counters, _SC("Meter.total (get)"));
+    ASSERT_TRUE(total != NULL);
+    EXPECT_EQ(1u, total->calls);
+
+    Instrumentation::Reset(vm);
+    EXPECT_TRUE(Instrumentation::Snapshot(vm).empty());
+}
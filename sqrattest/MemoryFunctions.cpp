@@ -0,0 +1,76 @@
+//
+// Copyright (c) 2009 Brandon Jones
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software. If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+
+// This test is its own program: it replaces Squirrel's allocators with the accounting ones. They take over when
+// Squirrel is built with SQ_EXCLUDE_DEFAULT_MEMFUNCTIONS, and also with a static libsquirrel (whose own sqmem.o is then
+// never linked in).
+#define SCRAT_DEFINE_MEMORY_FUNCTIONS
+
+#include <gtest/gtest.h>
+#include <sqrat.h>
+#include <sqrat/sqratVM.h>
+#include "Fixture.h"
+
+using namespace Sqrat;
+
+class Payload {
+public:
+    Payload() {}
+};
+
+TEST_F(SqratTest, MemoryFunctionsChargeVMAllocations)
+{
+    SqratVM vm1(1024, SqratVM::LIB_ALL, true);
+    MemoryAccount* account = vm1.GetMemoryAccount();
+    ASSERT_TRUE(account != NULL);
+    Class<Payload> payload(vm1.GetVM(), _SC("Payload"));
+    RootTable(vm1.GetVM()).Bind(_SC("Payload"), payload);
+
+    // opening the VM already went through sq_vm_malloc
+    EXPECT_LT(0u, account->Allocations());
+    size_t opened = account->CurrentBytes();
+    EXPECT_LT(0u, opened);
+
+    ASSERT_EQ(SqratVM::SQRAT_NO_ERROR, vm1.DoString(_SC("big <- array(10000, 0);")));
+    size_t grown = account->CurrentBytes();
+    EXPECT_LE(opened + 10000 * sizeof(HSQOBJECT), grown);
+    EXPECT_LE(grown, account->PeakBytes());
+
+    unsigned long long frees = account->Frees();
+    ASSERT_EQ(SqratVM::SQRAT_NO_ERROR, vm1.DoString(_SC("big = null;")));
+    EXPECT_LT(frees, account->Frees());
+    EXPECT_GE(grown - 10000 * sizeof(HSQOBJECT), account->CurrentBytes());
+
+    // the budget now sees what scripts allocate without any help from the bindings
+    vm1.SetMemoryBudget(0, account->CurrentBytes() + 256 * 1024);
+    EXPECT_EQ(SqratVM::SQRAT_RUNTIME_ERROR, vm1.DoString(_SC(" \
+        local kept = []; \
+        while (true) { \
+            kept.append(array(1024, 0)); \
+            Payload(); \
+        } \
+        ")));
+    EXPECT_EQ(string(_SC("memory budget exceeded")), vm1.GetLastErrorMsg());
+    vm1.SetMemoryBudget(0, 0);
+}
@@ -0,0 +1,170 @@
+//
+// Copyright (c) 2009 Brandon Jones
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software. If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+#include <gtest/gtest.h>
+#include <sqrat.h>
+#include <atomic>
+#include <stdexcept>
+#include "Fixture.h"
+
+using namespace Sqrat;
+
+static std::thread::id vmThread;
+
+static int Checksum(const SQChar* text, int rounds)
+{
+    if (rounds < 0) {
+        throw std::runtime_error("negative rounds");
+    }
+    int sum = 0;
+    for (int r = 0; r < rounds; ++r) {
+        for (const SQChar* c = text; *c; ++c) {
+            sum = (sum * 31 + static_cast<int>(*c)) % 1000003;
+        }
+    }
+    return sum;
+}
+
+static bool OffVMThread()
+{
+    return std::this_thread::get_id() != vmThread;
+}
+
+TEST_F(SqratTest, ThreadPoolRunsJobs)
+{
+    std::atomic<int> total(0);
+    {
+        ThreadPool pool(3);
+        EXPECT_EQ(3u, pool.GetThreadCount());
+        for (int i = 1; i <= 100; ++i) {
+            pool.Submit([&total, i]() { total += i; });
+        }
+        // the destructor runs whatever is still queued
+    }
+    EXPECT_EQ(5050, total.load());
+}
+
+class Dictionary
+{
+public:
+    Dictionary() { ++live; }
+    ~Dictionary() { --live; }
+
+    int Weight(const SQChar* word) const
+    {
+        return Checksum(word, 20000) + 1;
+    }
+
+    static int live;
+};
+
+int Dictionary::live = 0;
+
+namespace Sqrat {
+template <>
+struct OffloadSafe<Dictionary> {
+    static const bool value = true;
+};
+}
+
+TEST_F(SqratTest, OffloadFunc)
+{
+    DefaultVM::Set(vm);
+    vmThread = std::this_thread::get_id();
+    RootTable().OffloadFunc(_SC("Checksum"), &Checksum);
+    RootTable().OffloadFunc(_SC("OffVMThread"), &OffVMThread);
+
+    Script script;
+    script.CompileString(_SC("\
+        gTest.EXPECT_FALSE(OffVMThread()); /* called from the host: runs in place */ \
+        sums <- [null, null, null, null]; \
+        offloaded <- null; \
+        failed <- null; \
+        workers <- []; \
+        foreach (i, text in [\"alpha\", \"beta\", \"gamma\", \"delta\"]) { \
+            local w = newthread(function(slot, text) { ::sums[slot] = Checksum(text, 20000); }); \
+            w.call(i, text); \
+            workers.append(w); \
+        } \
+        local other = newthread(function() { \
+            ::offloaded = OffVMThread(); \
+            try { Checksum(\"x\", -1); } catch (e) { ::failed = e; } \
+        }); \
+        other.call(); \
+        workers.append(other); \
+        "));
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Compile Failed: ") << Sqrat::Error::Message(vm);
+    }
+    script.Run();
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Run Failed: ") << Sqrat::Error::Message(vm);
+    }
+
+    AsyncQueue* queue = AsyncQueue::Get(vm);
+    while (queue->GetParkedCount() > 0) {
+        ASSERT_TRUE(queue->Wait(std::chrono::seconds(10)));
+        queue->Drain();
+    }
+
+    Array sums = RootTable().GetSlot(_SC("sums"));
+    EXPECT_EQ(Checksum(_SC("alpha"), 20000), *sums.GetValue<int>(0));
+    EXPECT_EQ(Checksum(_SC("beta"), 20000), *sums.GetValue<int>(1));
+    EXPECT_EQ(Checksum(_SC("gamma"), 20000), *sums.GetValue<int>(2));
+    EXPECT_EQ(Checksum(_SC("delta"), 20000), *sums.GetValue<int>(3));
+    EXPECT_TRUE(*RootTable().GetValue<bool>(_SC("offloaded")));
+    EXPECT_EQ(string(_SC("negative rounds")), *RootTable().GetValue<string>(_SC("failed")));
+}
+
+TEST_F(SqratTest, OffloadMemberFunc)
+{
+    DefaultVM::Set(vm);
+    Class<Dictionary> dictionaryClass(vm, _SC("Dictionary"));
+    dictionaryClass.OffloadFunc(_SC("Weight"), &Dictionary::Weight);
+    RootTable().Bind(_SC("Dictionary"), dictionaryClass);
+
+    Script script;
+    script.CompileString(_SC("\
+        dict <- Dictionary(); \
+        gTest.EXPECT_INT_EQ(dict.Weight(\"alpha\"), dict.Weight(\"alpha\")); /* in place from the host */ \
+        weight <- null; \
+        worker <- newthread(function() { ::weight = ::dict.Weight(\"alpha\"); }); \
+        worker.call(); \
+        dict = null; /* the pending call keeps the instance alive */ \
+        "));
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Compile Failed: ") << Sqrat::Error::Message(vm);
+    }
+    script.Run();
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Run Failed: ") << Sqrat::Error::Message(vm);
+    }
+    EXPECT_EQ(1, Dictionary::live);
+
+    AsyncQueue* queue = AsyncQueue::Get(vm);
+    while (queue->GetParkedCount() > 0) {
+        ASSERT_TRUE(queue->Wait(std::chrono::seconds(10)));
+        queue->Drain();
+    }
+    EXPECT_EQ(Checksum(_SC("alpha"), 20000) + 1, *RootTable().GetValue<int>(_SC("weight")));
+}
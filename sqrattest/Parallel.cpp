@@ -0,0 +1,106 @@
+//
+// Copyright (c) 2009 Brandon Jones
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software. If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+#include <gtest/gtest.h>
+#include <gtest/gtest.h>
+#include <sqrat.h>
+#include <stdexcept>
+#include "Fixture.h"
+
+using namespace Sqrat;
+
+static int Square(int x)
+{
+    return x * x;
+}
+
+static int Add(int a, int b)
+{
+    return a + b;
+}
+
+static double Root(double x)
+{
+    if (x < 0) {
+        throw std::runtime_error("negative input");
+    }
+    return x * 0.5;
+}
+
+static string Label(const SQChar* text)
+{
+    return string(_SC("<")) + text + _SC(">");
+}
+
+TEST_F(SqratTest, ParallelMapReduce)
+{
+    DefaultVM::Set(vm);
+    RegisterParallelLib(vm);
+    RootTable().PureFunc(_SC("Square"), &Square);
+    RootTable().PureFunc(_SC("Add"), &Add);
+    RootTable().PureFunc(_SC("Root"), &Root);
+    RootTable().PureFunc(_SC("Label"), &Label);
+
+    Script script;
+    script.CompileString(_SC("\
+        gTest.EXPECT_INT_EQ(49, Square(7)); /* still callable directly */ \
+        local input = []; \
+        for (local i = 0; i < 10000; ++i) input.append(i % 100); \
+        local squares = parallel_map(Square, input); \
+        gTest.EXPECT_INT_EQ(10000, squares.len()); \
+        local ok = true; \
+        foreach (i, v in squares) if (v != (i % 100) * (i % 100)) ok = false; \
+        gTest.EXPECT_TRUE(ok); \
+        gTest.EXPECT_INT_EQ(495000, parallel_reduce(Add, input, 0)); \
+        gTest.EXPECT_INT_EQ(495010, parallel_reduce(Add, input, 10)); \
+        gTest.EXPECT_INT_EQ(495000, parallel_reduce(Add, input)); \
+        gTest.EXPECT_INT_EQ(3, parallel_reduce(Add, [], 3)); \
+        gTest.EXPECT_INT_EQ(0, parallel_map(Square, []).len()); \
+        local labels = parallel_map(Label, [\"a\", \"b\"]); \
+        gTest.EXPECT_STR_EQ(\"<b>\", labels[1]); \
+        \
+        /* functions not bound with PureFunc run in order on the VM */ \
+        local doubled = parallel_map(function(x) { return x * 2; }, [1, 2, 3]); \
+        gTest.EXPECT_INT_EQ(6, doubled[2]); \
+        gTest.EXPECT_INT_EQ(6, parallel_reduce(function(a, b) { return a + b; }, [1, 2, 3])); \
+        \
+        local failed = null; \
+        local values = []; \
+        for (local i = 0; i < 1000; ++i) values.append(i == 700 ? -1.0 : i.tofloat()); \
+        try { parallel_map(Root, values); } catch (e) { failed = e; } \
+        gTest.EXPECT_STR_EQ(\"negative input\", failed); \
+        failed = null; \
+        try { parallel_map(Square, [1, \"two\"]); } catch (e) { failed = e; } \
+        gTest.EXPECT_TRUE(failed != null); \
+        failed = null; \
+        try { parallel_map(Add, [1, 2]); } catch (e) { failed = e; } \
+        gTest.EXPECT_TRUE(failed != null); \
+        "));
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Compile Failed: ") << Sqrat::Error::Message(vm);
+    }
+    script.Run();
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Run Failed: ") << Sqrat::Error::Message(vm);
+    }
+}
@@ -0,0 +1,147 @@
+//
+// Copyright (c) 2009 Brandon Jones
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software. If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+#include <gtest/gtest.h>
+#include <sqrat.h>
+#include <sqrat/sqratProfiler.h>
+#include "Fixture.h"
+
+using namespace Sqrat;
+
+static const ProfileEntry* FindEntry(const std::vector<ProfileEntry>& entries, const string& name) {
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].name == name) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+TEST_F(SqratTest, ProfilerCallTree) {
+    DefaultVM::Set(vm);
+
+    Script functions;
+    functions.CompileString(_SC(" \
+        function inner(n) { \
+            local sum = 0; \
+            for (local i = 0; i < n; ++i) { \
+                sum += i; \
+            } \
+            return sum; \
+        } \
+        function outer() { \
+            local total = 0; \
+            for (local i = 0; i < 5; ++i) { \
+                total += inner(100); \
+            } \
+            return total; \
+        } \
+        "));
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Compile Failed: ") << Sqrat::Error::Message(vm);
+    }
+    functions.Run();
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Run Failed: ") << Sqrat::Error::Message(vm);
+    }
+
+    Script call;
+    call.CompileString(_SC("outer();"));
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Compile Failed: ") << Sqrat::Error::Message(vm);
+    }
+
+    EXPECT_FALSE(Profiler::IsRunning(vm));
+    Profiler::Start(vm);
+    EXPECT_TRUE(Profiler::IsRunning(vm));
+    call.Run();
+    Profiler::Stop(vm);
+    EXPECT_FALSE(Profiler::IsRunning(vm));
+
+    // not recorded
+    call.Run();
+
+    std::vector<ProfileEntry> entries = Profiler::Report(vm);
+    const ProfileEntry* outer = FindEntry(entries, _SC("outer"));
+    const ProfileEntry* inner = FindEntry(entries, _SC("inner"));
+    ASSERT_TRUE(outer != NULL);
+    ASSERT_TRUE(inner != NULL);
+    EXPECT_EQ(1u, outer->calls);
+    EXPECT_EQ(5u, inner->calls);
+    EXPECT_FALSE(inner->native);
+    EXPECT_GE(outer->inclusiveNs, inner->inclusiveNs);
+    EXPECT_GE(outer->inclusiveNs, outer->exclusiveNs);
+    EXPECT_EQ(inner->inclusiveNs, inner->exclusiveNs);
+
+    string stacks = Profiler::CollapsedStacks(vm);
+    EXPECT_NE(string::npos, stacks.find(_SC("outer (")));
+    EXPECT_NE(string::npos, stacks.find(_SC(";inner (")));
+
+    Profiler::Reset(vm);
+    EXPECT_TRUE(Profiler::Report(vm).empty());
+    EXPECT_TRUE(Profiler::CollapsedStacks(vm).empty());
+}
+
+TEST_F(SqratTest, ProfilerFromScript) {
+    DefaultVM::Set(vm);
+    Profiler::Register(vm);
+
+    Script script;
+    script.CompileString(_SC(" \
+        function leaf() { \
+            return 1; \
+        } \
+        function branch() { \
+            local n = 0; \
+            for (local i = 0; i < 10; ++i) { \
+                n += leaf(); \
+            } \
+            return n; \
+        } \
+        \
+        profiler_start(3); \
+        branch(); \
+        profiler_stop(); \
+        branch(); \
+        \
+        local calls = {}; \
+        foreach (entry in profiler_report()) { \
+            calls[entry.name] <- entry.calls; \
+            gTest.EXPECT_TRUE(entry.inclusive_ns >= entry.exclusive_ns); \
+        } \
+        gTest.EXPECT_INT_EQ(1, calls.branch); \
+        gTest.EXPECT_INT_EQ(10, calls.leaf); \
+        gTest.EXPECT_TRUE(profiler_collapsed().find(\"branch (\") != null); \
+        \
+        profiler_reset(); \
+        gTest.EXPECT_INT_EQ(0, profiler_report().len()); \
+        "));
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Compile Failed: ") << Sqrat::Error::Message(vm);
+    }
+
+    script.Run();
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Run Failed: ") << Sqrat::Error::Message(vm);
+    }
+}
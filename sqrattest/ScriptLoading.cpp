@@ -23,6 +23,11 @@
 
 #include <gtest/gtest.h>
 #include <sqrat.h>
+#include <sqrat/sqratCompileCache.h>
+#include <sqrat/sqratMappedFile.h>
+#include <time.h>
+#include <utime.h>
+#include <vector>
 #include "Fixture.h"
 
 using namespace Sqrat;
@@ -97,3 +102,139 @@ TEST_F(SqratTest, LoadScriptBytecode) {
         }
     }
 }
+
+TEST_F(SqratTest, BytecodeBuffer) {
+    Bytecode buffer;
+    const char chunk[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_EQ(10, buffer.AppendData(chunk, sizeof(chunk)));
+    }
+    EXPECT_EQ(10000u, buffer.Size());
+    EXPECT_GE(buffer.Capacity(), 10000u);
+    EXPECT_LT(buffer.Capacity(), 20000u); // grown by doubling, not by each append
+
+    size_t capacity = buffer.Capacity();
+    buffer.Clear();
+    EXPECT_EQ(0u, buffer.Size());
+    EXPECT_EQ(capacity, buffer.Capacity());
+
+    // a view reads the caller's memory in place
+    buffer.SetView(chunk, sizeof(chunk));
+    EXPECT_EQ(static_cast<const void*>(chunk), buffer.Data());
+    char out[4];
+    EXPECT_EQ(4, buffer.ReadData(out, sizeof(out)));
+    EXPECT_EQ(3, out[3]);
+}
+
+TEST_F(SqratTest, LoadScriptBytecodeFromMemory) {
+    DefaultVM::Set(vm);
+
+    Bytecode bytecode;
+    {
+        Script script;
+        script.CompileString(_SC("y <- 6 * 7;"));
+        ASSERT_TRUE(script.SaveBytecode(bytecode));
+        EXPECT_GT(bytecode.Size(), 0u);
+    }
+
+    // the caller keeps ownership of the memory, nothing is copied before sq_readclosure reads it
+    std::vector<char> image(static_cast<char*>(bytecode.Data()), static_cast<char*>(bytecode.Data()) + bytecode.Size());
+    Script script;
+    ASSERT_TRUE(script.LoadBytecode(&image[0], image.size()));
+    std::string errMsg;
+    if (!script.Run(errMsg)) {
+        FAIL() << _SC("Script Run Failed: ") << errMsg;
+    }
+    EXPECT_EQ(42, *RootTable(vm).GetValue<int>(_SC("y")));
+
+    // the same Bytecode can be reused for another script
+    size_t capacity = bytecode.Capacity();
+    Script other;
+    other.CompileString(_SC("z <- 1;"));
+    ASSERT_TRUE(other.SaveBytecode(bytecode));
+    EXPECT_EQ(capacity, bytecode.Capacity());
+}
+
+TEST_F(SqratTest, CompileCache) {
+    DefaultVM::Set(vm);
+    FILE* file = fopen("scripts/cached.nut", "wb");
+    ASSERT_TRUE(file != NULL);
+    fputs("cached <- 1;", file);
+    fclose(file);
+
+    CompileCache cache("scripts/cache");
+    cache.Clear();
+    Script script;
+    script.SetCompileCache(&cache);
+    std::string errMsg;
+    ASSERT_TRUE(script.CompileFile(_SC("scripts/cached.nut"), errMsg)) << errMsg;
+    ASSERT_TRUE(script.Run(errMsg)) << errMsg;
+    EXPECT_EQ(0u, cache.GetHits());
+    EXPECT_EQ(1u, cache.GetMisses());
+
+    // the second load reads the entry instead of compiling
+    ASSERT_TRUE(script.CompileFile(_SC("scripts/cached.nut"), errMsg)) << errMsg;
+    ASSERT_TRUE(script.Run(errMsg)) << errMsg;
+    EXPECT_EQ(1u, cache.GetHits());
+    EXPECT_EQ(1, *RootTable(vm).GetValue<int>(_SC("cached")));
+
+    // editing the file replaces its entry
+    file = fopen("scripts/cached.nut", "wb");
+    ASSERT_TRUE(file != NULL);
+    fputs("cached <- 2;", file);
+    fclose(file);
+    ASSERT_TRUE(script.CompileFile(_SC("scripts/cached.nut"), errMsg)) << errMsg;
+    ASSERT_TRUE(script.Run(errMsg)) << errMsg;
+    EXPECT_EQ(1u, cache.GetHits());
+    EXPECT_EQ(2u, cache.GetMisses());
+    EXPECT_EQ(2, *RootTable(vm).GetValue<int>(_SC("cached")));
+
+    // a temporary file left behind by a crashed writer
+    const char* abandoned = "scripts/cache/0000000000000000.sqcc.1.1.tmp";
+    file = fopen(abandoned, "wb");
+    ASSERT_TRUE(file != NULL);
+    fclose(file);
+    struct utimbuf old;
+    old.actime = old.modtime = time(NULL) - 2 * 3600;
+    utime(abandoned, &old);
+
+    // a cache too small for any entry keeps nothing around, and its first scan sweeps the abandoned file
+    CompileCache tiny("scripts/cache", 1);
+    script.SetCompileCache(&tiny);
+    ASSERT_TRUE(script.CompileFile(_SC("scripts/cached.nut"), errMsg)) << errMsg;
+    ASSERT_TRUE(script.CompileFile(_SC("scripts/cached.nut"), errMsg)) << errMsg;
+    EXPECT_EQ(0u, tiny.GetHits());
+    EXPECT_EQ(2u, tiny.GetMisses());
+    file = fopen(abandoned, "rb");
+    EXPECT_TRUE(file == NULL);
+    if (file != NULL) {
+        fclose(file);
+    }
+
+    remove("scripts/cached.nut");
+}
+
+TEST_F(SqratTest, LoadMappedScript) {
+    DefaultVM::Set(vm);
+    std::string errMsg;
+    Script script;
+    ASSERT_TRUE(script.CompileMappedFile(_SC("scripts/hello.nut"), errMsg)) << errMsg;
+    ASSERT_TRUE(script.Run(errMsg)) << errMsg;
+
+    Script compiled;
+    compiled.CompileString(_SC("mapped <- 7;"));
+    compiled.WriteCompiledFile(_SC("scripts/mapped.cnut"));
+
+    // bytecode goes straight from the mapping to sq_readclosure
+    Script fromBytecode;
+    ASSERT_TRUE(fromBytecode.LoadBytecodeFile(_SC("scripts/mapped.cnut")));
+    ASSERT_TRUE(fromBytecode.Run(errMsg)) << errMsg;
+    EXPECT_EQ(7, *RootTable(vm).GetValue<int>(_SC("mapped")));
+
+    Script detected;
+    ASSERT_TRUE(detected.CompileMappedFile(_SC("scripts/mapped.cnut"), errMsg)) << errMsg;
+
+    EXPECT_FALSE(fromBytecode.LoadBytecodeFile(_SC("scripts/hello.nut")));
+    EXPECT_FALSE(script.CompileMappedFile(_SC("scripts/missing.nut"), errMsg));
+    remove("scripts/mapped.cnut");
+}
@@ -54,4 +54,98 @@ TEST_F(SqratTest, SqratVM)
     bind(vm1.GetVM());
     bind(vm2.GetVM());
     
-}
\ No newline at end of file
+}
+TEST_F(SqratTest, SqratVMClosureCache)
+{
+    SqratVM vm1;
+    Sqrat::ClosureCache& cache = vm1.GetClosureCache();
+    cache.SetCapacity(2);
+
+    for (int i = 0; i < 5; ++i) {
+        Sqrat::RootTable(vm1.GetVM()).SetValue(_SC("x"), i);
+        ASSERT_EQ(SqratVM::SQRAT_NO_ERROR, vm1.DoString(_SC("y <- x * 2;")));
+        EXPECT_EQ(i * 2, *Sqrat::RootTable(vm1.GetVM()).GetValue<int>(_SC("y")));
+    }
+    EXPECT_EQ(4u, cache.GetHits());
+    EXPECT_EQ(1u, cache.GetMisses());
+
+    // the least recently used text is dropped once capacity is reached
+    vm1.DoString(_SC("a <- 1;"));
+    vm1.DoString(_SC("b <- 2;"));
+    EXPECT_EQ(2u, cache.GetSize());
+    vm1.DoString(_SC("y <- x * 2;"));
+    EXPECT_EQ(4u, cache.GetHits());
+    EXPECT_EQ(4u, cache.GetMisses());
+
+    EXPECT_TRUE(cache.Invalidate(_SC("y <- x * 2;")));
+    EXPECT_FALSE(cache.Invalidate(_SC("y <- x * 2;")));
+
+    // compile errors are reported and never cached
+    EXPECT_EQ(SqratVM::SQRAT_COMPILE_ERROR, vm1.DoString(_SC("y <- ;")));
+    EXPECT_EQ(SqratVM::SQRAT_COMPILE_ERROR, vm1.DoString(_SC("y <- ;")));
+    EXPECT_EQ(1u, cache.GetSize());
+}
+static std::vector<void*> grownBlocks;
+
+// Stands for a binding that allocates on behalf of the script
+static void growBlock()
+{
+    grownBlocks.push_back(MemoryAccount::Malloc(4096));
+}
+
+TEST_F(SqratTest, SqratVMMemoryBudget)
+{
+    SqratVM vm1(1024, SqratVM::LIB_ALL, true);
+    MemoryAccount* account = vm1.GetMemoryAccount();
+    ASSERT_TRUE(account != NULL);
+    bind(vm1.GetVM());
+
+    ASSERT_EQ(SqratVM::SQRAT_NO_ERROR, vm1.DoString(_SC("kept <- [simpleclass(), simpleclass(), simpleclass()];")));
+    std::vector<ClassMemory> classes = account->Classes();
+    ASSERT_EQ(1u, classes.size());
+    EXPECT_EQ(string(_SC("simpleclass")), classes[0].name);
+    EXPECT_EQ(3u, classes[0].instances);
+    EXPECT_EQ(3 * sizeof(simpleclass), classes[0].bytes);
+
+    // this build of Squirrel keeps its own allocators, so charge the account by hand
+    size_t before = account->CurrentBytes();
+    unsigned long long allocations = account->Allocations();
+    void* block;
+    {
+        MemoryAccount::Scope scope(account);
+        block = MemoryAccount::Malloc(4096);
+        block = MemoryAccount::Realloc(block, 4096, 8192);
+    }
+    EXPECT_EQ(before + 8192, account->CurrentBytes());
+    EXPECT_LE(before + 8192, account->PeakBytes());
+    EXPECT_EQ(allocations + 1, account->Allocations());
+
+    // over the soft limit, the first construction fails and the script can carry on
+    vm1.SetMemoryBudget(before + 1024, 0);
+    EXPECT_EQ(SqratVM::SQRAT_NO_ERROR, vm1.DoString(_SC(" \
+        local caught = false; \
+        try { simpleclass(); } catch (e) { caught = true; } \
+        simpleclass(); \
+        if (!caught) throw \"soft limit not raised\"; \
+        ")));
+
+    // over the hard limit, the VM refuses to run
+    vm1.SetMemoryBudget(0, before + 1024);
+    EXPECT_EQ(SqratVM::SQRAT_RUNTIME_ERROR, vm1.DoString(_SC("simpleclass();")));
+    EXPECT_EQ(string(_SC("memory budget exceeded")), vm1.GetLastErrorMsg());
+
+    MemoryAccount::Free(block, 8192);
+    EXPECT_EQ(before, account->CurrentBytes());
+    EXPECT_EQ(SqratVM::SQRAT_NO_ERROR, vm1.DoString(_SC("simpleclass();")));
+
+    // a running script is stopped at the first bound call after it went over the hard limit
+    RootTable(vm1.GetVM()).Func(_SC("growBlock"), &growBlock);
+    vm1.SetMemoryBudget(0, before + 3 * 4096 + 1024);
+    EXPECT_EQ(SqratVM::SQRAT_RUNTIME_ERROR, vm1.DoString(_SC("while (true) growBlock();")));
+    EXPECT_EQ(4u, grownBlocks.size());
+    for (size_t i = 0; i < grownBlocks.size(); ++i) {
+        MemoryAccount::Free(grownBlocks[i], 4096);
+    }
+    grownBlocks.clear();
+    EXPECT_EQ(before, account->CurrentBytes());
+}
@@ -24,6 +24,7 @@
 
 #include <gtest/gtest.h>
 #include <sqrat.h>
+#include <thread>
 #include "Fixture.h"
 /* test demonstrating Sourceforge bug 3507590 */
    
@@ -51,7 +52,7 @@ TEST_F(SqratTest, SuspendVM)
     Script script;
     script.CompileString(_SC("\
         c <- C(); \
-        //c.suspend(); /* this would fail in the curent Sqrat; no solution yet */\
+        //c.suspend(); /* a plain Func cannot suspend its caller, bind with AsyncFunc instead (see below) */\
         ::suspend(); \
         gTest.EXPECT_INT_EQ(1, 0); /* should not reach here */ \
         "));
@@ -64,4 +65,93 @@ TEST_F(SqratTest, SuspendVM)
         FAIL() << _SC("Run Failed: ") << Sqrat::Error::Message(vm);
     }
     
-}
\ No newline at end of file
+}
+
+
+class Storage
+{
+public:
+    // completed later by the test, standing in for an I/O thread
+    std::future<int> Load(int key)
+    {
+        pending = std::make_shared<std::promise<int> >();
+        requested = key;
+        return pending->get_future();
+    }
+
+    std::shared_ptr<std::promise<int> > pending;
+    int requested;
+};
+
+static AsyncCallback<string> lastLookup;
+
+static void Lookup(AsyncCallback<string> done, const SQChar* name)
+{
+    if (string(name) == _SC("missing")) {
+        done.Fail(_SC("not found"));
+        return;
+    }
+    lastLookup = done;
+}
+
+static std::future<int> Ready(int x)
+{
+    std::promise<int> p;
+    p.set_value(x * 2);
+    return p.get_future();
+}
+
+TEST_F(SqratTest, SuspendVMAsyncFunc)
+{
+    DefaultVM::Set(vm);
+    Class<Storage> storageClass(vm, _SC("Storage"));
+    storageClass.AsyncFunc(_SC("Load"), &Storage::Load);
+    RootTable().Bind(_SC("Storage"), storageClass);
+    RootTable().AsyncFunc(_SC("Lookup"), &Lookup);
+    RootTable().AsyncFunc(_SC("Ready"), &Ready);
+
+    Script script;
+    script.CompileString(_SC("\
+        storage <- Storage(); \
+        loaded <- null; \
+        found <- null; \
+        failed <- null; \
+        gTest.EXPECT_INT_EQ(8, Ready(4)); /* ready futures return right away, even outside a coroutine */ \
+        worker <- newthread(function() { \
+            ::loaded = storage.Load(7); \
+            ::found = Lookup(\"key\"); \
+            try { Lookup(\"missing\"); } catch (e) { ::failed = e; } \
+        }); \
+        worker.call(); \
+        "));
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Compile Failed: ") << Sqrat::Error::Message(vm);
+    }
+    script.Run();
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Run Failed: ") << Sqrat::Error::Message(vm);
+    }
+
+    // the member call suspended the coroutine instead of failing
+    AsyncQueue* queue = AsyncQueue::Get(vm);
+    Storage* storage = *RootTable().GetValue<Storage*>(_SC("storage"));
+    ASSERT_TRUE(storage != NULL);
+    EXPECT_EQ(7, storage->requested);
+    EXPECT_EQ(1u, queue->GetParkedCount());
+
+    std::thread io([storage]() { storage->pending->set_value(49); });
+    io.join();
+    EXPECT_TRUE(queue->Wait(std::chrono::seconds(5))); // a thread waiting on the future completes the ticket
+    queue->Drain();
+    EXPECT_EQ(49, *RootTable().GetValue<int>(_SC("loaded")));
+
+    // the callback form parks it again until the callback runs
+    EXPECT_EQ(1u, queue->GetParkedCount());
+    std::thread rpc([]() { lastLookup(_SC("value")); });
+    rpc.join();
+    while (queue->GetParkedCount() > 0 && queue->Wait(std::chrono::seconds(5))) {
+        queue->Drain();
+    }
+    EXPECT_EQ(string(_SC("value")), *RootTable().GetValue<string>(_SC("found")));
+    EXPECT_EQ(string(_SC("not found")), *RootTable().GetValue<string>(_SC("failed")));
+}
@@ -434,3 +434,47 @@ TEST_F(SqratTest, PassingTableIn3) {
     
 }
 
+static int lazyBinds = 0;
+
+static void BindGeometry(Table& table)
+{
+    ++lazyBinds;
+    table.Func(_SC("AddTwo"), &AddTwo);
+    table.SetValue(_SC("ORIGIN"), 0);
+}
+
+TEST_F(SqratTest, LazyBind)
+{
+    DefaultVM::Set(vm);
+    lazyBinds = 0;
+    RootTable().LazyBind(&BindGeometry);
+    RootTable().LazyBind([](Table& table) {
+        ++lazyBinds;
+        table.Func(_SC("GetGreeting"), &GetGreeting);
+    });
+    EXPECT_EQ(0, lazyBinds);
+
+    Script script;
+    script.CompileString(_SC(" \
+        gTest.EXPECT_INT_EQ(5, AddTwo(2, 3)); \
+        gTest.EXPECT_INT_EQ(1, ::lazyCount()); \
+        gTest.EXPECT_STR_EQ(\"Hello world!\", GetGreeting()); \
+        gTest.EXPECT_INT_EQ(2, ::lazyCount()); \
+        local failed = false; \
+        try { NotBound(); } catch (e) { failed = true; } \
+        gTest.EXPECT_TRUE(failed); \
+        "));
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Compile Failed: ") << Sqrat::Error::Message(vm);
+    }
+    RootTable().SquirrelFunc(_SC("lazyCount"), [](HSQUIRRELVM v) -> SQInteger {
+        sq_pushinteger(v, lazyBinds);
+        return 1;
+    });
+
+    script.Run();
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Run Failed: ") << Sqrat::Error::Message(vm);
+    }
+    EXPECT_EQ(2, lazyBinds);
+}
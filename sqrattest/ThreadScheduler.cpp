@@ -0,0 +1,166 @@
+//
+// Copyright (c) 2009 Brandon Jones
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software. If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+#include <gtest/gtest.h>
+#include <sqrat.h>
+#include <sqratimport.h>
+#include <sqratThread.h>
+#include <chrono>
+#include <thread>
+#include "Fixture.h"
+
+using namespace Sqrat;
+
+SQRAT_STATIC_MODULE(_SC("sqratthread"), &sqmodule_load);
+
+static AsyncTicket waitTicket;
+
+// Parks the calling task until the test completes waitTicket
+static SQInteger WaitForHost(HSQUIRRELVM v)
+{
+    waitTicket = AsyncQueue::Find(v)->Park(v);
+    return sq_suspendvm(v);
+}
+
+static void RunScript(HSQUIRRELVM vm, const SQChar* code)
+{
+    Script script;
+    script.CompileString(code);
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Compile Failed: ") << Sqrat::Error::Message(vm);
+    }
+
+    script.Run();
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Run Failed: ") << Sqrat::Error::Message(vm);
+    }
+}
+
+TEST_F(SqratTest, SchedulerRunsTasksInOrder)
+{
+    DefaultVM::Set(vm);
+    sqrat_register_importlib(vm);
+
+    RunScript(vm, _SC(" \
+        ::import(\"sqratthread\"); \
+        log <- []; \
+        function worker(name, rounds) { \
+            for (local i = 0; i < rounds; ++i) { \
+                ::log.append(name + i); \
+                ::suspend(); \
+            } \
+        } \
+        ::schedule(worker)(\"a\", 2); \
+        ::schedule(worker)(\"b\", 3); \
+        ::run(); \
+        gTest.EXPECT_STR_EQ(\"a0,b0,a1,b1,b2\", ::log.reduce(@(acc, s) acc + \",\" + s)); \
+        "));
+}
+
+TEST_F(SqratTest, SchedulerWakesSleepersByDeadline)
+{
+    DefaultVM::Set(vm);
+    sqrat_register_importlib(vm);
+
+    RunScript(vm, _SC(" \
+        ::import(\"sqratthread\"); \
+        log <- []; \
+        function sleeper(name, seconds) { \
+            ::sleep(seconds); \
+            ::log.append(name); \
+        } \
+        ::schedule(sleeper)(\"late\", 0.06); \
+        ::schedule(sleeper)(\"early\", 0.02); \
+        ::schedule(sleeper)(\"tie1\", 0.04); \
+        ::schedule(sleeper)(\"tie2\", 0.04); \
+        ::schedule(function() { ::log.append(\"awake\"); })(); \
+        ::run(); \
+        gTest.EXPECT_STR_EQ(\"awake,early,tie1,tie2,late\", ::log.reduce(@(acc, s) acc + \",\" + s)); \
+        "));
+}
+
+TEST_F(SqratTest, SchedulerReusesFinishedThreads)
+{
+    DefaultVM::Set(vm);
+    sqrat_register_importlib(vm);
+
+    RunScript(vm, _SC(" \
+        ::import(\"sqratthread\"); \
+        threads <- []; \
+        function record() { \
+            ::threads.append(::getthread().ref()); \
+        } \
+        ::schedule(record)(); \
+        ::run(); \
+        ::schedule(record)(); \
+        ::run(); \
+        gTest.EXPECT_TRUE(::threads[0] == ::threads[1]); \
+        \
+        ::setstacksize(512); \
+        ::schedule(record)(); \
+        ::run(); \
+        gTest.EXPECT_FALSE(::threads[0] == ::threads[2]); \
+        "));
+}
+
+TEST_F(SqratTest, SchedulerSleepsAfterAsyncResume)
+{
+    DefaultVM::Set(vm);
+    sqrat_register_importlib(vm);
+    AsyncQueue::Get(vm);
+    RootTable(vm).SquirrelFunc(_SC("waitforhost"), &WaitForHost);
+
+    RunScript(vm, _SC(" \
+        ::import(\"sqratthread\"); \
+        log <- []; \
+        ::schedule(function() { \
+            ::log.append(\"got \" + ::waitforhost()); \
+            ::sleep(0.05); \
+            ::log.append(\"slept\"); \
+        })(); \
+        "));
+
+    EXPECT_EQ(1, sqratthread_step(vm));
+    ASSERT_TRUE(waitTicket.IsValid());
+
+    waitTicket.Complete([](HSQUIRRELVM thread, string&) {
+        sq_pushinteger(thread, 7);
+        return true;
+    });
+
+    // The drain resumes the task and its sleep must suspend it rather than block this thread
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    EXPECT_EQ(1, sqratthread_step(vm));
+    EXPECT_TRUE(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(40));
+    Array log = RootTable(vm).GetSlot(_SC("log"));
+    EXPECT_EQ(1, log.Length());
+
+    while (sqratthread_step(vm) > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_EQ(2, log.Length());
+    EXPECT_EQ(string(_SC("got 7")), *log.GetValue<string>(0));
+    EXPECT_EQ(string(_SC("slept")), *log.GetValue<string>(1));
+
+    waitTicket = AsyncTicket();
+}
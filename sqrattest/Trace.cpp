@@ -0,0 +1,192 @@
+//
+// Copyright (c) 2009 Brandon Jones
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software. If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+#define SCRAT_ENABLE_INSTRUMENTATION
+
+#include <gtest/gtest.h>
+#include <sqrat.h>
+#include <sqrat/sqratProfiler.h>
+#include <sqrat/sqratTrace.h>
+#include <thread>
+#include "Fixture.h"
+
+using namespace Sqrat;
+
+static int Twice(int x) {
+    return x * 2;
+}
+
+static bool Contains(const std::string& json, const char* text) {
+    return json.find(text) != std::string::npos;
+}
+
+TEST_F(SqratTest, TraceScriptAndBindings) {
+    DefaultVM::Set(vm);
+    RootTable().Func(_SC("Twice"), &Twice);
+
+    Trace::Flush(); // events left by other tests
+    Trace::Start();
+    Trace::Attach(vm);
+    EXPECT_TRUE(Trace::IsAttached(vm));
+
+    Script script;
+    script.CompileString(_SC(" \
+        function quadruple(x) { \
+            return Twice(Twice(x)); \
+        } \
+        gTest.EXPECT_INT_EQ(12, quadruple(3)); \
+        "), _SC("trace_test"));
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Compile Failed: ") << Sqrat::Error::Message(vm);
+    }
+
+    script.Run();
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Run Failed: ") << Sqrat::Error::Message(vm);
+    }
+    Trace::CollectGarbage(vm);
+    Trace::Stop();
+
+    std::string json = Trace::Flush();
+    EXPECT_TRUE(Contains(json, "{\"traceEvents\":["));
+    EXPECT_TRUE(Contains(json, "{\"name\":\"quadruple\",\"cat\":\"script\",\"ph\":\"B\""));
+    EXPECT_TRUE(Contains(json, "{\"name\":\"quadruple\",\"cat\":\"script\",\"ph\":\"E\""));
+    EXPECT_TRUE(Contains(json, "\"source\":\"trace_test\""));
+    EXPECT_TRUE(Contains(json, "{\"name\":\"Twice\",\"cat\":\"native\",\"ph\":\"B\""));
+    EXPECT_TRUE(Contains(json, "\"cat\":\"compile\""));
+    EXPECT_TRUE(Contains(json, "\"cat\":\"gc\""));
+    EXPECT_TRUE(Contains(json, "\"dropped_events\":\"0\""));
+
+    // drained by the previous flush
+    json = Trace::Flush();
+    EXPECT_FALSE(Contains(json, "\"cat\":\"script\""));
+
+    Trace::Detach(vm);
+    EXPECT_FALSE(Trace::IsAttached(vm));
+}
+
+TEST_F(SqratTest, TraceFilters) {
+    DefaultVM::Set(vm);
+
+    HSQUIRRELVM other = sq_open(1024);
+
+    Trace::Flush();
+    Trace::Start(Trace::TRACE_SCRIPT);
+    std::vector<string> functions;
+    functions.push_back(_SC("traced"));
+    Trace::Attach(vm, functions);
+    EXPECT_FALSE(Trace::IsAttached(other));
+
+    Script script;
+    script.CompileString(_SC(" \
+        function traced() { \
+            return 1; \
+        } \
+        function untraced() { \
+            return 2; \
+        } \
+        gTest.EXPECT_INT_EQ(3, traced() + untraced()); \
+        "));
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Compile Failed: ") << Sqrat::Error::Message(vm);
+    }
+
+    script.Run();
+    if (Sqrat::Error::Occurred(vm)) {
+        FAIL() << _SC("Run Failed: ") << Sqrat::Error::Message(vm);
+    }
+
+    Script otherScript(other);
+    otherScript.CompileString(_SC("function traced() { return 1; } traced();"));
+    otherScript.Run();
+    otherScript.Release();
+    Trace::Stop();
+
+    std::string json = Trace::Flush();
+    EXPECT_TRUE(Contains(json, "\"name\":\"traced\""));
+    EXPECT_FALSE(Contains(json, "\"name\":\"untraced\""));
+    EXPECT_FALSE(Contains(json, "\"name\":\"EXPECT_INT_EQ\""));
+    EXPECT_FALSE(Contains(json, "\"cat\":\"compile\""));
+
+    // one begin and one end, from vm only
+    size_t count = 0;
+    for (size_t pos = json.find("\"name\":\"traced\""); pos != std::string::npos; pos = json.find("\"name\":\"traced\"", pos + 1)) {
+        ++count;
+    }
+    EXPECT_EQ(2u, count);
+
+    Trace::Detach(vm);
+    sq_close(other);
+}
+
+TEST_F(SqratTest, TraceKeepsEventsOfEndedThreads) {
+    DefaultVM::Set(vm);
+
+    Trace::Flush();
+    Trace::Start(Trace::TRACE_IMPORT);
+    std::thread worker([this]() {
+        Trace::Record('i', Trace::TRACE_IMPORT, vm, _SC("from_worker"), NULL, 0);
+    });
+    worker.join();
+    Trace::Stop();
+
+    // the ring of the worker outlives it until it has been flushed
+    EXPECT_TRUE(Contains(Trace::Flush(), "\"name\":\"from_worker\""));
+    EXPECT_FALSE(Contains(Trace::Flush(), "\"name\":\"from_worker\""));
+}
+
+#if !defined(SQUNICODE)
+TEST_F(SqratTest, TraceTruncatesOnCodePoints) {
+    DefaultVM::Set(vm);
+
+    // 62 ASCII characters and a two byte character that does not fit in the 63 kept
+    std::string name(62, 'a');
+    name += "\xC3\xA9";
+
+    Trace::Flush();
+    Trace::Start(Trace::TRACE_IMPORT);
+    Trace::Record('i', Trace::TRACE_IMPORT, vm, name.c_str(), NULL, 0);
+    Trace::Stop();
+
+    std::string json = Trace::Flush();
+    EXPECT_TRUE(Contains(json, ("\"name\":\"" + std::string(62, 'a') + "\"").c_str()));
+    EXPECT_FALSE(Contains(json, "\xC3"));
+}
+#endif
+
+TEST_F(SqratTest, TraceAndProfilerShareTheHook) {
+    DefaultVM::Set(vm);
+
+    EXPECT_TRUE(Trace::Attach(vm));
+    EXPECT_FALSE(Profiler::Start(vm));
+    EXPECT_FALSE(Profiler::IsRunning(vm));
+    Trace::Detach(vm);
+
+    EXPECT_TRUE(Profiler::Start(vm));
+    EXPECT_FALSE(Trace::Attach(vm));
+    EXPECT_FALSE(Trace::IsAttached(vm));
+    Profiler::Stop(vm);
+
+    EXPECT_TRUE(Trace::Attach(vm));
+    Trace::Detach(vm);
+}
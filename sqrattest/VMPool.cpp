@@ -0,0 +1,175 @@
+//
+// Copyright (c) 2009 Brandon Jones
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software. If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+#include <gtest/gtest.h>
+#include <sqrat.h>
+#include <sqrat/sqratVMPool.h>
+#include "Fixture.h"
+
+using namespace Sqrat;
+
+class Accumulator
+{
+public:
+    Accumulator() : total(0) {}
+    int Add(int x) { total += x; return total; }
+    int total;
+};
+
+static int Square(int x)
+{
+    return x * x;
+}
+
+static void BindPool(SqratVM& vm)
+{
+    vm.GetRootTable().Func(_SC("Square"), &Square);
+    vm.GetRootTable().Bind(_SC("Accumulator"), Class<Accumulator>(vm.GetVM(), _SC("Accumulator"))
+        .Func(_SC("Add"), &Accumulator::Add)
+    );
+    vm.DoString(_SC("\
+        function sumSquares(n) { \
+            local acc = Accumulator(); \
+            for (local i = 1; i <= n; ++i) acc.Add(Square(i)); \
+            return acc.total; \
+        } \
+        function describe(t) { return { name = t.name, count = t.items.len() }; } \
+        function fail() { throw \"boom\"; } \
+    "));
+}
+
+TEST_F(SqratTest, VMPoolRunsJobs)
+{
+    VMPool pool(4, BindPool);
+    ASSERT_EQ(4u, pool.GetReadyWorkerCount());
+
+    std::vector<std::future<MarshalledValue> > results;
+    for (int n = 0; n < 200; ++n) {
+        std::vector<MarshalledValue> args;
+        args.push_back(MarshalledValue(n));
+        results.push_back(pool.Submit(_SC("sumSquares"), args));
+    }
+    for (int n = 0; n < 200; ++n) {
+        MarshalledValue value = results[n].get();
+        EXPECT_EQ(MarshalledValue::TYPE_INTEGER, value.GetType());
+        EXPECT_EQ(n * (n + 1) * (2 * n + 1) / 6, value.GetInteger());
+    }
+
+    VMPoolStats stats = pool.GetStats();
+    EXPECT_EQ(200u, stats.submitted);
+    EXPECT_EQ(200u, stats.completed);
+    EXPECT_EQ(0u, stats.failed);
+    EXPECT_EQ(0u, stats.queueDepth);
+    ASSERT_EQ(4u, stats.workers.size());
+    unsigned long long jobs = 0, histogram = 0;
+    for (size_t i = 0; i < stats.workers.size(); ++i) {
+        jobs += stats.workers[i].jobs;
+        for (size_t b = 0; b < stats.workers[i].latency.size(); ++b) {
+            histogram += stats.workers[i].latency[b];
+        }
+        EXPECT_GE(stats.workers[i].utilisation, 0.0);
+        EXPECT_LE(stats.workers[i].utilisation, 1.0);
+    }
+    EXPECT_EQ(200u, jobs);
+    EXPECT_EQ(200u, histogram);
+}
+
+TEST_F(SqratTest, VMPoolMarshalsTables)
+{
+    VMPool pool(2, BindPool);
+
+    MarshalledValue items = MarshalledValue::NewArray();
+    items.Append(MarshalledValue(1));
+    items.Append(MarshalledValue(2.5));
+    items.Append(MarshalledValue(_SC("three")));
+    MarshalledValue arg = MarshalledValue::NewTable();
+    arg.Set(MarshalledValue(_SC("name")), MarshalledValue(_SC("widget")));
+    arg.Set(MarshalledValue(_SC("items")), items);
+
+    std::vector<MarshalledValue> args;
+    args.push_back(arg);
+    MarshalledValue value = pool.Submit(_SC("describe"), args).get();
+    ASSERT_EQ(MarshalledValue::TYPE_TABLE, value.GetType());
+    ASSERT_TRUE(value.Find(MarshalledValue(_SC("name"))) != NULL);
+    EXPECT_EQ(string(_SC("widget")), value.Find(MarshalledValue(_SC("name")))->GetString());
+    ASSERT_TRUE(value.Find(MarshalledValue(_SC("count"))) != NULL);
+    EXPECT_EQ(3, value.Find(MarshalledValue(_SC("count")))->GetInteger());
+}
+
+TEST_F(SqratTest, VMPoolReportsErrors)
+{
+    VMPool pool(2, BindPool);
+
+    std::future<MarshalledValue> thrown = pool.Submit(_SC("fail"));
+    std::future<MarshalledValue> missing = pool.Submit(_SC("doesNotExist"));
+    EXPECT_THROW(thrown.get(), Sqrat::Exception);
+    EXPECT_THROW(missing.get(), Sqrat::Exception);
+    EXPECT_EQ(2u, pool.GetStats().failed);
+
+    // a failed job leaves the worker usable
+    std::vector<MarshalledValue> args;
+    args.push_back(MarshalledValue(3));
+    EXPECT_EQ(14, pool.Submit(_SC("sumSquares"), args).get().GetInteger());
+}
+
+TEST_F(SqratTest, VMPoolShutdown)
+{
+    VMPool pool(2, BindPool);
+    std::vector<MarshalledValue> args;
+    args.push_back(MarshalledValue(10));
+    std::future<MarshalledValue> queued = pool.Submit(_SC("sumSquares"), args);
+    pool.Shutdown();
+    EXPECT_EQ(385, queued.get().GetInteger());
+    EXPECT_THROW(pool.Submit(_SC("sumSquares"), args).get(), Sqrat::Exception);
+}
+
+TEST_F(SqratTest, CompiledScriptSharedByVMs)
+{
+    CompiledScript image = CompiledScript::FromString(vm, _SC("function triple(x) { return x * 3; }"));
+    ASSERT_FALSE(image.IsEmpty());
+
+    // every thread instantiates the same image in its own VM without compiling
+    std::vector<int> results(4, 0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.push_back(std::thread([&image, &results, i]() {
+            SqratVM worker;
+            if (worker.DoCompiled(image) == SqratVM::SQRAT_NO_ERROR) {
+                Function triple = worker.GetRootTable().GetFunction(_SC("triple"));
+                results[i] = *triple.Evaluate<int>(i + 1);
+            }
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_EQ((i + 1) * 3, results[i]);
+    }
+
+    DefaultVM::Set(vm);
+    Script script(image);
+    std::string errMsg;
+    ASSERT_TRUE(script.Run(errMsg)) << errMsg;
+    EXPECT_TRUE(RootTable(vm).HasKey(_SC("triple")));
+}
@@ -4,7 +4,7 @@
 
 SQUIRREL_INCLUDE=/usr/local/include/squirrel
 SQUIRREL_LIB=/usr/local/lib
-CFLAGS="-g -O0 -I. -I../include -I../gtest-1.3.0/include -I${SQUIRREL_INCLUDE}" 
+CFLAGS="-g -O0 -pthread -I. -I../include -I../gtest-1.3.0/include -I${SQUIRREL_INCLUDE}" 
 LDFLAGS=-L${SQUIRREL_LIB}
 LIBS="../gtest-1.3.0/libgtest.a -lsqstdlib -lsquirrel -lstdc++ -lm "
 
@@ -13,6 +13,10 @@ mkdir -p bin
 gcc $CFLAGS \
      ../sqimport/sqratimport.cpp ImportTest.cpp Main.cpp \
      -o bin/ImportTest  ${LDFLAGS} ${LIBS} -ldl
+
+gcc $CFLAGS -I../sqratthread \
+     ../sqimport/sqratimport.cpp ../sqratthread/sqratThread.cpp ThreadScheduler.cpp Main.cpp \
+     -o bin/ThreadScheduler  ${LDFLAGS} ${LIBS} -ldl
      
 TEST_CPPS="ClassBinding.cpp\
     ClassInstances.cpp\
@@ -28,7 +32,15 @@ TEST_CPPS="ClassBinding.cpp\
     NullPointerReturn.cpp\
     FuncInputArgumentType.cpp \
     ArrayBinding.cpp \
-    UniqueObject.cpp "
+    UniqueObject.cpp \
+    VMPool.cpp \
+    Channel.cpp \
+    Offload.cpp \
+    Parallel.cpp \
+    Instrumentation.cpp \
+    Profiler.cpp \
+    Trace.cpp \
+    MemoryFunctions.cpp "
 
 for f in $TEST_CPPS; do
     gcc $CFLAGS \
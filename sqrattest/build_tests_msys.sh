@@ -4,7 +4,7 @@
 
 SQUIRREL_INCLUDE=C:/SQUIRREL3/include
 SQUIRREL_LIB=C:/SQUIRREL3/lib
-CFLAGS="-g -O0 -I. -I../include -IC:/gtest-1.7.0/include -I${SQUIRREL_INCLUDE}"
+CFLAGS="-g -O0 -pthread -I. -I../include -IC:/gtest-1.7.0/include -I${SQUIRREL_INCLUDE}"
 LDFLAGS=-L${SQUIRREL_LIB}
 LIBS="C:/gtest-1.7.0/build/libgtest.a -lsqstdlib -lsquirrel -lstdc++ -lm"
 
@@ -14,6 +14,10 @@ gcc $CFLAGS \
      ../sqimport/sqratimport.cpp ImportTest.cpp Main.cpp \
      -o bin/ImportTest ${LDFLAGS} ${LIBS}
 
+gcc $CFLAGS -I../sqratthread \
+     ../sqimport/sqratimport.cpp ../sqratthread/sqratThread.cpp ThreadScheduler.cpp Main.cpp \
+     -o bin/ThreadScheduler ${LDFLAGS} ${LIBS}
+
 TEST_CPPS="ClassBinding.cpp\
     ClassInstances.cpp\
     ClassProperties.cpp\
@@ -28,7 +32,15 @@ TEST_CPPS="ClassBinding.cpp\
     NullPointerReturn.cpp\
     FuncInputArgumentType.cpp \
     ArrayBinding.cpp \
-    UniqueObject.cpp "
+    UniqueObject.cpp \
+    VMPool.cpp \
+    Channel.cpp \
+    Offload.cpp \
+    Parallel.cpp \
+    Instrumentation.cpp \
+    Profiler.cpp \
+    Trace.cpp \
+    MemoryFunctions.cpp "
 
 for f in $TEST_CPPS; do
     gcc $CFLAGS \
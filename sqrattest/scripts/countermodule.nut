@@ -0,0 +1,7 @@
+::importCount <- ("importCount" in getroottable()) ? ::importCount + 1 : 1;
+
+Value <- 42;
+
+function Twice(x) {
+	return x * 2;
+}
\ No newline at end of file
@@ -27,19 +27,62 @@
 
 //#include "sqratlib/sqratBase.h"
 #include "sqratThread.h"
-#include <time.h>
+#include <sqrat/sqratAsync.h>
+#include <sqrat/sqratTrace.h>
 #include <string.h>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <queue>
+#include <thread>
+#include <vector>
 
 static HSQAPI sq;
 
+static const SQInteger SQRAT_DEFAULT_STACKSIZE = 256; // Initial stack size of task threads
+static const size_t SQRAT_THREADPOOL_SIZE = 64;       // Finished threads kept around for reuse
+
+// A scheduled function and the thread that runs it
+struct SqratTask {
+    HSQOBJECT thread;
+    HSQOBJECT func;
+    HSQOBJECT args;   // Array filled in by the closure that schedule returns
+    bool started;
+};
+
+typedef std::chrono::steady_clock SqratClock;
+
+// A task sleeping until its deadline
+struct SqratTimer {
+    SqratClock::time_point deadline;
+    unsigned long long order;   // Keeps tasks with equal deadlines in the order they went to sleep
+    SqratTask task;
+
+    bool operator>(const SqratTimer& other) const {
+        return deadline > other.deadline || (deadline == other.deadline && order > other.order);
+    }
+};
+
+// Scheduler state of a VM, kept in the registry (see sqrat_getscheduler)
+struct SqratScheduler {
+    SqratScheduler() : current(NULL), timerOrder(0), stackSize(SQRAT_DEFAULT_STACKSIZE), running(false) {}
+
+    std::deque<SqratTask> runQueue;                                 // Tasks that can run, in order
+    Sqrat::unordered_map<HSQUIRRELVM, SqratTask>::type parked;       // Tasks waiting for an asynchronous call
+    std::vector<HSQOBJECT> threadPool;                              // Finished threads, all of stackSize
+    std::vector<HSQUIRRELVM> resumed;                               // Scratch space for AsyncQueue::TakeResumed
+    std::priority_queue<SqratTimer, std::vector<SqratTimer>, std::greater<SqratTimer> > timers; // Sleeping tasks, soonest first
+    HSQUIRRELVM current;                                            // Thread of the task being run
+    Sqrat::unordered_map<HSQUIRRELVM, SqratClock::time_point>::type sleeping; // Deadlines passed to sleep, until the task is filed
+    unsigned long long timerOrder;
+    SQInteger stackSize;
+    bool running;                                                   // Set while run is looping
+};
+
 //
 // Thread lib utility functions (not visible externally)
 //
 
-static SQFloat sqrat_clock() {
-    return ((SQFloat)clock())/(SQFloat)CLOCKS_PER_SEC;
-}
-
 static SQInteger sqrat_strlen(const SQChar* str) {
 #if defined(_UNICODE)
     return static_cast<SQInteger>(wcslen(str) * sizeof(SQChar));
@@ -48,23 +91,65 @@ static SQInteger sqrat_strlen(const SQChar* str) {
 #endif
 }
 
-static void sqrat_pushtaskarray(HSQUIRRELVM v) {
-    HSQOBJECT taskarray;
+static SQInteger sqrat_releasescheduler(SQUserPointer ptr, SQInteger /*size*/) {
+    // Task objects go down with the VM, so their references are not released here
+    delete *reinterpret_cast<SqratScheduler**>(ptr);
+    return 0;
+}
 
-    sq->pushroottable(v);
-    sq->pushstring(v,_SC("__sqrat_taskarray__"),-1);
-    if(SQ_FAILED(sq->get(v, -2))) {
-        // Not found, create a new namespace
-        sq->pushstring(v,_SC("__sqrat_taskarray__"),-1);
-        sq->newarray(v, 0);
-        sq->getstackobj(v,-1,&taskarray); // Save namespace for later use
-        sq->newslot(v, -3, 0);
-        sq->pop(v, 1); // pop root table
-
-        sq->pushobject(v, taskarray); // push the newly bound array
+static SqratScheduler* sqrat_getscheduler(HSQUIRRELVM v) {
+    SqratScheduler* scheduler = NULL;
+    SQUserPointer ud;
+
+    sq->pushregistrytable(v);
+    sq->pushstring(v, _SC("__sqrat_scheduler__"), -1);
+    if(SQ_SUCCEEDED(sq->rawget(v, -2))) {
+        sq->getuserdata(v, -1, &ud, NULL);
+        scheduler = *reinterpret_cast<SqratScheduler**>(ud);
+        sq->pop(v, 2);
+        return scheduler;
+    }
+
+    // Not found, create a new one that lives as long as the VM
+    sq->pushstring(v, _SC("__sqrat_scheduler__"), -1);
+    ud = sq->newuserdata(v, sizeof(SqratScheduler*));
+    *reinterpret_cast<SqratScheduler**>(ud) = scheduler = new SqratScheduler();
+    sq->setreleasehook(v, -1, &sqrat_releasescheduler);
+    sq->rawset(v, -3);
+    sq->pop(v, 1); // pop registry
+    return scheduler;
+}
+
+// Takes a thread from the pool or creates a new one
+static void sqrat_newthread(HSQUIRRELVM v, SqratScheduler* scheduler, HSQOBJECT& thread) {
+    if(!scheduler->threadPool.empty()) {
+        thread = scheduler->threadPool.back();
+        scheduler->threadPool.pop_back();
+        return;
+    }
+    sq->newthread(v, scheduler->stackSize);
+    sq->getstackobj(v, -1, &thread);
+    sq->addref(v, &thread);
+    sq->pop(v, 1);
+}
+
+// Drops a finished task and returns its thread to the pool
+static void sqrat_finishtask(HSQUIRRELVM v, SqratScheduler* scheduler, SqratTask& task) {
+    sq->release(v, &task.func);
+    sq->release(v, &task.args);
+    sq->settop(task.thread._unVal.pThread, 0);
+    if(scheduler->threadPool.size() < SQRAT_THREADPOOL_SIZE) {
+        scheduler->threadPool.push_back(task.thread);
     } else {
-        sq->remove(v, -2); // pop sqrat table
+        sq->release(v, &task.thread);
+    }
+}
+
+static void sqrat_clearthreadpool(HSQUIRRELVM v, SqratScheduler* scheduler) {
+    for(size_t i = 0; i < scheduler->threadPool.size(); ++i) {
+        sq->release(v, &scheduler->threadPool[i]);
     }
+    scheduler->threadPool.clear();
 }
 
 static SQRESULT sqrat_pushclosure(HSQUIRRELVM v, const SQChar* script) {
@@ -84,219 +169,257 @@ static SQRESULT sqrat_pushclosure(HSQUIRRELVM v, const SQChar* script) {
 static SQInteger sqrat_schedule_argcall(HSQUIRRELVM v) {
     SQInteger nparams = sq->gettop(v) - 2; // Get the number of parameters provided
 
-    // The task table is the last argument (free variable), so we can operate on immediately
-    sq->pushstring(v, _SC("args"), -1);
-
-    sq->newarray(v, 0); // Create the array for the arguments
-
-    // Loop through all arguments and push them into the arg array
+    // The argument array is the last argument (free variable), so we can operate on it immediately
     for(SQInteger i = 0; i < nparams; ++i) {
         sq->push(v, i+2);
         sq->arrayappend(v, -2);
     }
-
-    sq->newslot(v, -3, 0); // Push the arg array into the task table
     return 0;
 }
 
-// This is a horrid way to get this functionality in there, but I can't find any alternatives right now.
-static SQRESULT sqrat_pushsleep(HSQUIRRELVM v) {
-    SQChar* sleep_script = _SC(" \
-		__sqratsleep__ <- function(timeout) { \
-			local begin = clock(); \
-			local now; \
-			do { \
-				::suspend(); \
-				now = clock(); \
-			} while( (now - begin) < timeout ); \
-		} \
-	");
-
-    if(SQ_FAILED(sq->compilebuffer(v, sleep_script, sqrat_strlen(sleep_script), _SC(""), true))) {
-        return SQ_ERROR;
+// Finds the completion queue of the VM, if the host created one (see Sqrat::AsyncQueue)
+static Sqrat::AsyncQueue* sqrat_getasyncqueue(HSQUIRRELVM v) {
+    Sqrat::AsyncQueue* queue = NULL;
+    SQUserPointer ud;
+    sq->pushregistrytable(v);
+    sq->pushstring(v, Sqrat::AsyncQueue::RegistryKey(), -1);
+    if(SQ_SUCCEEDED(sq->rawget(v, -2))) {
+        if(SQ_SUCCEEDED(sq->getuserdata(v, -1, &ud, NULL))) {
+            queue = *reinterpret_cast<Sqrat::AsyncQueue**>(ud);
+        }
+        sq->pop(v, 1);
     }
+    sq->pop(v, 1);
+    return queue;
+}
 
-    sq->pushroottable(v);
-    if(SQ_FAILED(sq->call(v, 1, 0, 1))) {
-        sq->remove(v, -1); // remove compiled closure
-        return SQ_ERROR;
+// Resumes the threads whose asynchronous calls have completed, through the closure the host registered
+static void sqrat_drainasyncqueue(HSQUIRRELVM v) {
+    sq->pushregistrytable(v);
+    sq->pushstring(v, Sqrat::AsyncQueue::DrainKey(), -1);
+    if(SQ_SUCCEEDED(sq->rawget(v, -2))) {
+        sq->pushroottable(v);
+        sq->call(v, 1, 0, 1);
+        sq->pop(v, 1); // pop the closure
     }
-    sq->remove(v, -1); // remove compiled closure
-
-    sq->pushroottable(v);
-    sq->pushstring(v, _SC("__sqratsleep__"), -1);
-    SQRESULT res = sq->get(v, -2);
+    sq->pop(v, 1); // pop the registry
+}
 
-    sq->remove(v, -2); // remove root table
+// Whether the host traces the tasks of this VM (see Sqrat::Trace)
+static bool sqrat_istraced(HSQUIRRELVM v) {
+    if(!Sqrat::Trace::IsEnabled(Sqrat::Trace::TRACE_THREAD)) {
+        return false;
+    }
+    sq->pushregistrytable(v);
+    sq->pushstring(v, Sqrat::Trace::RegistryKey(), -1);
+    bool traced = SQ_SUCCEEDED(sq->rawget(v, -2));
+    if(traced) {
+        sq->pop(v, 1);
+    }
+    sq->pop(v, 1);
+    return traced;
+}
 
-    return res;
+// Marks a point in the life of a task on its own track (instants, so that the spans of its functions stay nested)
+static void sqrat_tracetask(bool traced, HSQUIRRELVM threadVm, const SQChar* what) {
+    if(traced) {
+        Sqrat::Trace::Record('i', Sqrat::Trace::TRACE_THREAD, threadVm, what, NULL, 0);
+    }
 }
 
 //
 // Thread lib main functions
 //
 
-static SQRESULT sqrat_sleep(HSQUIRRELVM v, SQFloat timeout) {
-    return sq->suspendvm(v);
-
-    // Get "::suspend"
-    /*HSQOBJECT suspend;
-    sq->pushroottable(v);
-    sq->pushstring(v, _SC("suspend"), -1);
-    if(SQ_FAILED(sq->get(v, -2))) {
-        return SQ_ERROR;
-    }
-    sq->getstackobj(v, -1, &suspend);
-    sq->pop(v, 2);
+// Whether v is the thread of a task that is running now
+// (the one the run queue resumed, or one that Drain resumed, which stays in parked until sqrat_step files it)
+static bool sqrat_istask(SqratScheduler* scheduler, HSQUIRRELVM v) {
+    return v == scheduler->current || scheduler->parked.find(v) != scheduler->parked.end();
+}
 
-    // Loop ::suspend until the appropriate time has passed
-    SQFloat timeStart = sqrat_clock();
-    SQFloat timeNow = 0;
+// Suspends the current task until the timeout has passed, blocks the OS thread if v is not a task
+static SQRESULT sqrat_sleep(HSQUIRRELVM v, SQFloat timeout) {
+    SqratScheduler* scheduler = sqrat_getscheduler(v);
+    SqratClock::duration duration = std::chrono::duration_cast<SqratClock::duration>(std::chrono::duration<double>(timeout > 0 ? timeout : 0));
 
-    while(timeNow - timeStart < timeout) {
-        sq->pushobject(v, suspend);
-        sq->pushroottable(v);
-        if(SQ_FAILED(sq->call(v, 1, 0, 1))) {
-            return SQ_ERROR;
-        }
-        timeNow = sqrat_clock();
+    if(!sqrat_istask(scheduler, v)) {
+        std::this_thread::sleep_for(duration);
+        return SQ_OK;
     }
 
-    return SQ_OK;*/
+    scheduler->sleeping[v] = SqratClock::now() + duration;
+    return sq->suspendvm(v);
 }
 
 static void sqrat_schedule(HSQUIRRELVM v, SQInteger idx) {
-    HSQOBJECT thread;
-    HSQOBJECT func;
-    HSQOBJECT task;
-
-    sq->getstackobj(v, idx, &func);
-    SQInteger stksize = 256; // TODO: Allow initial stack size to be configurable
+    SqratScheduler* scheduler = sqrat_getscheduler(v);
+    SqratTask task;
 
-    sqrat_pushtaskarray(v); // Push the task array
+    sq->getstackobj(v, idx, &task.func);
+    sq->addref(v, &task.func);
 
-    // Create the task
-    sq->newtable(v);
-    sq->getstackobj(v, -1, &task);
-
-    // Create the thread and add it to the task table
-    sq->pushstring(v, _SC("thread"), -1);
-    sq->newthread(v, stksize);
-    sq->getstackobj(v, -1, &thread);
-    sq->newslot(v, -3, 0);
-
-    // Push the function to be called onto the thread stack
-    sq->pushobject(v, func);
-    sq->move(thread._unVal.pThread, v, -1);
-    sq->pop(v, 1);
+    sqrat_newthread(v, scheduler, task.thread);
+    task.started = false;
 
     // Args will be pushed later, in the closure
+    sq->newarray(v, 0);
+    sq->getstackobj(v, -1, &task.args);
+    sq->addref(v, &task.args);
 
-    sq->arrayappend(v, -2); // Add the task to the task array
+    scheduler->runQueue.push_back(task);
 
-    sq->pushobject(v, task); // Push the task object as a free variable for the temporary closure
     sq->newclosure(v, sqrat_schedule_argcall, 1); // push a temporary closure used to retrieve call args
 }
 
-// Wow... this has to be one of the ugliest functions I've ever writter. Ever.
-// Building complex logic with the squirrel stack really sucks.
-static void sqrat_run(HSQUIRRELVM v) {
+// Calls the function of a task that has not run yet
+static void sqrat_starttask(HSQUIRRELVM v, SqratTask& task) {
+    HSQUIRRELVM threadVm = task.thread._unVal.pThread;
+    SQInteger nparams;
+
+    sq->pushobject(threadVm, task.func);
+    sq->pushroottable(threadVm); // Push the threads root table
+
+    // Push the arguments onto the thread stack
+    sq->pushobject(v, task.args);
+    nparams = sq->getsize(v, -1);
+    for(SQInteger a = 0; a < nparams; ++a) {
+        sq->pushinteger(v, a);
+        if(SQ_FAILED(sq->rawget(v, -2))) {
+            sq->pushnull(threadVm);
+        } else {
+            sq->move(threadVm, v, -1);
+            sq->pop(v, 1);
+        }
+    }
+    sq->pop(v, 1); // Pop the arg array
 
-    HSQOBJECT taskArray;
-    HSQOBJECT thread;
-    HSQUIRRELVM threadVm;
-    SQInteger nparams;  // Number of parameters to pass to a function
-    SQInteger arrayidx; //Cached index of the task array
-
-    // Push the tasklist
-    sqrat_pushtaskarray(v); // Push the task array to the stack
-
-    sq->getstackobj(v, -1, &taskArray);
-    arrayidx = sq->gettop(v); // Cache the stack location of the task array
-
-    SQInteger tasklistSize = sq->getsize(v, arrayidx); // Query the initial size of the task array
-    do {
-        SQInteger i = 0;
-
-        // This outer while is to allow us to pick up any new tasks that are added during the loop,
-        // but still give us an opportunity to sleep after running through the initial tasks
-        while(i < tasklistSize) {
-
-            for(; i < tasklistSize; ++i) {
-                sq->pushinteger(v, i);
-                if(SQ_FAILED(sq->get(v, -2))) { // Get the task
-                    sq->arrayremove(v, -2, i);
-                    sq->pop(v, 1);
-                    --tasklistSize;
-                    --i;
-                    continue;
-                }
+    task.started = true;
+    sq->call(threadVm, nparams+1, 0, 1); // Call the thread
+}
 
-                // Now that we have the task, get the thread
-                sq->pushstring(v, _SC("thread"), -1);
-                if(SQ_FAILED(sq->get(v, -2))) {
-                    sq->arrayremove(v, -3, i);
-                    sq->pop(v, 1);
-                    --tasklistSize;
-                    --i;
-                    continue;
-                }
-                sq->getstackobj(v, -1, &thread);
-                sq->pop(v, 1);
-
-                threadVm = thread._unVal.pThread;
-
-                if(sq->getvmstate(threadVm) == SQ_VMSTATE_IDLE) { // New thread? If so we need to call it
-
-                    // Function to be called is already pushed to the thread (happens in schedule)
-                    sq->pushroottable(threadVm); // Pus the threads root table
-
-                    sq->pushstring(v, _SC("args"), -1);
-                    if(SQ_FAILED(sq->get(v, -2))) { // Check to see if we have arguments for this thread
-                        nparams = 0; // No arguments
-                    } else {
-                        nparams = sq->getsize(v, -1); // Get the number of args in the arg array
-
-                        // Push the arguments onto the thread stack
-                        for(SQInteger a = 0; a < nparams; ++a) {
-                            sq->pushinteger(v, a);
-                            if(SQ_FAILED(sq->get(v, -2))) {
-                                sq->pushnull(threadVm); // Is this the best way to handle this?
-                            } else {
-                                sq->move(threadVm, v, -1);
-                                sq->pop(v, 1);
-                            }
-                        }
-
-                        sq->pop(v, 1); // Pop the arg array
-                    }
-
-                    sq->call(threadVm, nparams+1, 0, 1); // Call the thread
-
-                } else {
-                    // If the thread is suspended, wake it up.
-                    // This function changed in Squirrel 2.2.3,
-                    // removing the last parameter makes it compatible with 2.2.2 and earlier
-                    sq->wakeupvm(threadVm, 0, 0, 1, 0);
-                }
+// Files a task that just ran according to the state it was left in
+static void sqrat_requeuetask(HSQUIRRELVM v, SqratScheduler* scheduler, Sqrat::AsyncQueue* queue, SqratTask& task, bool traced) {
+    HSQUIRRELVM threadVm = task.thread._unVal.pThread;
+    Sqrat::unordered_map<HSQUIRRELVM, SqratClock::time_point>::type::iterator wake = scheduler->sleeping.find(threadVm);
+
+    scheduler->current = NULL;
+    if(sq->getvmstate(threadVm) == SQ_VMSTATE_IDLE) { // Finished (or failed)
+        sqrat_tracetask(traced, threadVm, _SC("finish"));
+        sqrat_finishtask(v, scheduler, task);
+    } else if(wake != scheduler->sleeping.end()) { // Off the run queue until the deadline
+        sqrat_tracetask(traced, threadVm, _SC("sleep"));
+        SqratTimer timer;
+        timer.deadline = wake->second;
+        timer.order = scheduler->timerOrder++;
+        timer.task = task;
+        scheduler->timers.push(timer);
+    } else if(queue != NULL && queue->IsParked(threadVm)) { // Drain resumes it once its call completes
+        sqrat_tracetask(traced, threadVm, _SC("park"));
+        scheduler->parked[threadVm] = task;
+    } else { // Suspended itself, run it again next quantum
+        sqrat_tracetask(traced, threadVm, _SC("yield"));
+        scheduler->runQueue.push_back(task);
+    }
+    if(wake != scheduler->sleeping.end()) {
+        scheduler->sleeping.erase(wake);
+    }
+}
 
-                if(sq->getvmstate(threadVm) == SQ_VMSTATE_IDLE) { // Check to see if the thread is finished (idle again)
-                    sq->arrayremove(v, -2, i); // Remove the task from the task array
+// Runs one quantum: every task that was runnable when it started gets to run once
+// Returns the number of tasks still pending
+static SQInteger sqrat_step(HSQUIRRELVM v) {
+    SqratScheduler* scheduler = sqrat_getscheduler(v);
+    Sqrat::AsyncQueue* queue = sqrat_getasyncqueue(v);
+    bool traced = sqrat_istraced(v);
+
+    // Resume the tasks whose asynchronous calls have completed
+    if(queue != NULL) {
+        queue->TrackResumed(true);
+        sqrat_drainasyncqueue(v);
+        queue->TakeResumed(scheduler->resumed);
+        for(size_t i = 0; i < scheduler->resumed.size(); ++i) {
+            Sqrat::unordered_map<HSQUIRRELVM, SqratTask>::type::iterator it = scheduler->parked.find(scheduler->resumed[i]);
+            if(it != scheduler->parked.end()) {
+                SqratTask task = it->second;
+                scheduler->parked.erase(it);
+                sqrat_requeuetask(v, scheduler, queue, task, traced);
+            }
+        }
+    }
 
-                    --tasklistSize; // Adjust the for variables to account for the removal
-                    --i;
-                }
+    // Wake the tasks whose deadline has passed
+    if(!scheduler->timers.empty()) {
+        SqratClock::time_point now = SqratClock::now();
+        while(!scheduler->timers.empty() && scheduler->timers.top().deadline <= now) {
+            scheduler->runQueue.push_back(scheduler->timers.top().task);
+            scheduler->timers.pop();
+        }
+    }
 
-                sq->pop(v, 1); // Pop off the task
-            }
+    // Tasks queued during this quantum wait for the next one
+    size_t count = scheduler->runQueue.size();
+    for(size_t i = 0; i < count; ++i) {
+        SqratTask task = scheduler->runQueue.front();
+        scheduler->runQueue.pop_front();
+
+        scheduler->current = task.thread._unVal.pThread;
+        if(!task.started) {
+            sqrat_tracetask(traced, scheduler->current, _SC("start"));
+            sqrat_starttask(v, task);
+        } else if(sq->getvmstate(task.thread._unVal.pThread) == SQ_VMSTATE_SUSPENDED) {
+            sqrat_tracetask(traced, scheduler->current, _SC("resume"));
+            // This function changed in Squirrel 2.2.3,
+            // removing the last parameter makes it compatible with 2.2.2 and earlier
+            sq->wakeupvm(task.thread._unVal.pThread, 0, 0, 1, 0);
+        }
 
-            // Yield to system if needed
+        sqrat_requeuetask(v, scheduler, queue, task, traced);
+    }
 
-            tasklistSize = sq->getsize(v, arrayidx); // Get the task
+    return static_cast<SQInteger>(scheduler->runQueue.size() + scheduler->parked.size() + scheduler->timers.size());
+}
 
+// Runs quanta until every task has finished
+static SQRESULT sqrat_run(HSQUIRRELVM v) {
+    SqratScheduler* scheduler = sqrat_getscheduler(v);
+    if(scheduler->running) {
+        return SQ_ERROR;
+    }
+    scheduler->running = true;
+
+    while(sqrat_step(v) > 0) {
+        // Nothing can run: block until the next deadline or until an asynchronous call completes
+        if(scheduler->runQueue.empty()) {
+            SqratClock::duration timeout = std::chrono::milliseconds(100);
+            if(!scheduler->timers.empty()) {
+                timeout = scheduler->timers.top().deadline - SqratClock::now();
+                if(timeout <= SqratClock::duration::zero()) {
+                    continue;
+                }
+            }
+            Sqrat::AsyncQueue* queue = sqrat_getasyncqueue(v);
+            if(queue != NULL) {
+                queue->Wait(timeout);
+            } else if(!scheduler->timers.empty()) {
+                std::this_thread::sleep_for(timeout);
+            }
         }
+    }
+
+    scheduler->running = false;
+    return SQ_OK;
+}
 
-    } while(tasklistSize > 0); // Loop until we have no more pending tasks
+static SQRESULT sqrat_setstacksize(HSQUIRRELVM v, SQInteger size) {
+    if(size <= 0) {
+        return SQ_ERROR;
+    }
+    SqratScheduler* scheduler = sqrat_getscheduler(v);
+    if(scheduler->stackSize != size) {
+        sqrat_clearthreadpool(v, scheduler); // Pooled threads have the old size
+        scheduler->stackSize = size;
+    }
+    return SQ_OK;
 }
 
 //
@@ -305,9 +428,8 @@ static void sqrat_run(HSQUIRRELVM v) {
 
 static SQInteger sqratbase_sleep(HSQUIRRELVM v) {
     SQFloat timeout;
-    sq->getfloat(v, -1, &timeout);
-    sqrat_sleep(v, timeout);
-    return 0;
+    sq->getfloat(v, 2, &timeout);
+    return sqrat_sleep(v, timeout);
 }
 
 static SQInteger sqratbase_schedule(HSQUIRRELVM v) {
@@ -316,7 +438,23 @@ static SQInteger sqratbase_schedule(HSQUIRRELVM v) {
 }
 
 static SQInteger sqratbase_run(HSQUIRRELVM v) {
-    sqrat_run(v);
+    if(SQ_FAILED(sqrat_run(v))) {
+        return sq->throwerror(v, _SC("run cannot be called while the scheduler is running"));
+    }
+    return 0;
+}
+
+static SQInteger sqratbase_step(HSQUIRRELVM v) {
+    sq->pushinteger(v, sqrat_step(v));
+    return 1;
+}
+
+static SQInteger sqratbase_setstacksize(HSQUIRRELVM v) {
+    SQInteger size;
+    sq->getinteger(v, 2, &size);
+    if(SQ_FAILED(sqrat_setstacksize(v, size))) {
+        return sq->throwerror(v, _SC("stack size must be positive"));
+    }
     return 0;
 }
 
@@ -336,6 +474,18 @@ static SQInteger sqratbase_getthread(HSQUIRRELVM v) {
     return 1;
 }
 
+//
+// Native interface for hosts running their own loop
+//
+
+SQInteger sqratthread_step(HSQUIRRELVM v) {
+    return sqrat_step(v);
+}
+
+SQRESULT sqratthread_setstacksize(HSQUIRRELVM v, SQInteger size) {
+    return sqrat_setstacksize(v, size);
+}
+
 //
 // Module registration
 //
@@ -352,22 +502,23 @@ SQRESULT sqmodule_load(HSQUIRRELVM v, HSQAPI api) {
     sq->newclosure(v, &sqratbase_run, 0);
     sq->newslot(v, -3, 0);
 
+    sq->pushstring(v, _SC("step"), -1);
+    sq->newclosure(v, &sqratbase_step, 0);
+    sq->newslot(v, -3, 0);
+
+    sq->pushstring(v, _SC("setstacksize"), -1);
+    sq->newclosure(v, &sqratbase_setstacksize, 0);
+    sq->setparamscheck(v, 2, _SC(".i"));
+    sq->newslot(v, -3, 0);
+
     sq->pushstring(v, _SC("getthread"), -1);
     sq->newclosure(v, &sqratbase_getthread, 0);
     sq->newslot(v, -3, 0);
 
-    // Would rather do this...
-    /*sq->pushstring(v, _SC("sleep"), -1);
-    sq->newclosure(v, &sqratbase_sleep, 0);
-    sq->newslot(v, -3, 0);*/
-
-    // Than this...
     sq->pushstring(v, _SC("sleep"), -1);
-    if(SQ_FAILED(sqrat_pushsleep(v))) {
-        sq->pop(v, 1);
-    } else {
-        sq->newslot(v, -3, 0);
-    }
+    sq->newclosure(v, &sqratbase_sleep, 0);
+    sq->setparamscheck(v, 2, _SC(".n"));
+    sq->newslot(v, -3, 0);
 
     return SQ_OK;
 }
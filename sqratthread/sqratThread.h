@@ -30,11 +30,21 @@
 
 #include "sqmodule.h"
 
+#if defined(_WIN32)
+#define SQRATTHREAD_API __declspec(dllexport)
+#else
+#define SQRATTHREAD_API
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-    __declspec(dllexport) SQRESULT sqmodule_load(HSQUIRRELVM v, HSQAPI api);
+    SQRATTHREAD_API SQRESULT sqmodule_load(HSQUIRRELVM v, HSQAPI api);
+
+    // For hosts that drive the scheduler from their own loop (valid once the module has been loaded)
+    SQRATTHREAD_API SQInteger sqratthread_step(HSQUIRRELVM v);                          // Runs one quantum, returns the number of pending tasks
+    SQRATTHREAD_API SQRESULT sqratthread_setstacksize(HSQUIRRELVM v, SQInteger size);   // Stack size of threads created for new tasks
 
 #ifdef __cplusplus
 } /*extern "C"*/